@@ -75,6 +75,16 @@
 
 #define AUDIO_SKT_DISCONNECTED (-1)
 
+// When this property is "true", the stack offers a shared-memory ring (see
+// osi/include/shm_ring.h) on every A2DP source data connection, and output
+// streams write PCM into it instead of into the data socket. The socket then
+// only tells either side that the other one went away.
+#define A2DP_SHM_RING_PROPERTY "persist.bluetooth.a2dp_shm_ring"
+
+// How long an output stream waits for the ring after connecting the data
+// socket before it falls back to writing into the socket.
+#define A2DP_SHM_RING_OFFER_TIMEOUT_MS 200
+
 typedef enum {
   A2DP_CTRL_CMD_NONE,
   A2DP_CTRL_CMD_CHECK_READY,
@@ -148,4 +158,8 @@ extern size_t audio_a2dp_hw_stream_compute_buffer_size(
 // Returns a string representation of |event|.
 extern const char* audio_a2dp_hw_dump_ctrl_event(tA2DP_CTRL_CMD event);
 
+// Returns true if A2DP source PCM should go through a shared-memory ring,
+// see |A2DP_SHM_RING_PROPERTY|.
+extern bool audio_a2dp_hw_shm_ring_enabled(void);
+
 #endif /* A2DP_AUDIO_HW_H */
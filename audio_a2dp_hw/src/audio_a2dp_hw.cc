@@ -46,6 +46,7 @@
 #include "osi/include/hash_map_utils.h"
 #include "osi/include/log.h"
 #include "osi/include/osi.h"
+#include "osi/include/shm_ring.h"
 #include "osi/include/socket_utils/sockets.h"
 
 #include "audio_a2dp_hw.h"
@@ -114,6 +115,13 @@ struct a2dp_stream_common {
   std::recursive_mutex* mutex;  // See note below on mutex acquisition order.
   int ctrl_fd;
   int audio_fd;
+  // Shared-memory ring used instead of |audio_fd| for PCM. It stays mapped
+  // until the next connection or until the stream is destroyed, since a
+  // writer may still be blocked on it when another thread tears the path
+  // down; |audio_ring_active| tells whether it belongs to |audio_fd|.
+  shm_ring_t* audio_ring;
+  bool audio_ring_active;
+  bool audio_ring_allowed;
   size_t buffer_sz;
   struct a2dp_config cfg;
   a2dp_state_t state;
@@ -321,6 +329,29 @@ static int skt_write(int fd, const void* p, size_t len) {
   return (int)count;
 }
 
+static int shm_write(shm_ring_t* ring, int fd, const void* p, size_t len) {
+  FNLOG();
+
+  ts_log("shm_write", len, NULL);
+
+  size_t count = 0;
+  while (count < len) {
+    count += shm_ring_write(ring, (const uint8_t*)p + count, len - count);
+    if (count == len) break;
+
+    shm_ring_wait_result_t result =
+        shm_ring_wait_writable(ring, SOCK_SEND_TIMEOUT_MS, fd);
+    if (result == SHM_RING_READY) continue;
+    if (result == SHM_RING_TIMEOUT) {
+      WARN("write timeout exceeded, sent %zu bytes", count);
+    } else {
+      ERROR("write failed, stack detached (result %d)", result);
+    }
+    return -1;
+  }
+  return (int)count;
+}
+
 static int skt_disconnect(int fd) {
   INFO("fd %d", fd);
 
@@ -745,6 +776,9 @@ static void a2dp_stream_common_init(struct a2dp_stream_common* common) {
 
   common->ctrl_fd = AUDIO_SKT_DISCONNECTED;
   common->audio_fd = AUDIO_SKT_DISCONNECTED;
+  common->audio_ring = NULL;
+  common->audio_ring_active = false;
+  common->audio_ring_allowed = false;
   common->state = AUDIO_A2DP_STATE_STOPPED;
 
   /* manages max capacity of socket pipe */
@@ -756,6 +790,40 @@ static void a2dp_stream_common_destroy(struct a2dp_stream_common* common) {
 
   delete common->mutex;
   common->mutex = NULL;
+
+  shm_ring_free(common->audio_ring);
+  common->audio_ring = NULL;
+}
+
+/* Picks up the shared-memory ring the stack offers on a new data connection */
+static void a2dp_open_audio_ring(struct a2dp_stream_common* common) {
+  shm_ring_free(common->audio_ring);
+  common->audio_ring = NULL;
+  common->audio_ring_active = false;
+
+  if (!common->audio_ring_allowed) return;
+
+  common->audio_ring =
+      shm_ring_receive(common->audio_fd, A2DP_SHM_RING_OFFER_TIMEOUT_MS);
+  if (common->audio_ring == NULL) {
+    WARN("no shared memory ring from stack, writing to socket");
+    return;
+  }
+
+  if (!shm_ring_send_ack(common->audio_fd, true)) {
+    ERROR("unable to accept shared memory ring (%s)", strerror(errno));
+    return;
+  }
+
+  INFO("using shared memory ring of %zu bytes",
+       shm_ring_capacity(common->audio_ring));
+  common->audio_ring_active = true;
+}
+
+static void a2dp_close_audio_path(struct a2dp_stream_common* common) {
+  common->audio_ring_active = false;
+  skt_disconnect(common->audio_fd);
+  common->audio_fd = AUDIO_SKT_DISCONNECTED;
 }
 
 static int start_audio_datapath(struct a2dp_stream_common* common) {
@@ -780,6 +848,7 @@ static int start_audio_datapath(struct a2dp_stream_common* common) {
       ERROR("Audiopath start failed - error opening data socket");
       goto error;
     }
+    a2dp_open_audio_ring(common);
   }
   common->state = (a2dp_state_t)AUDIO_A2DP_STATE_STARTED;
   return 0;
@@ -807,8 +876,7 @@ static int stop_audio_datapath(struct a2dp_stream_common* common) {
   common->state = (a2dp_state_t)AUDIO_A2DP_STATE_STOPPED;
 
   /* disconnect audio path */
-  skt_disconnect(common->audio_fd);
-  common->audio_fd = AUDIO_SKT_DISCONNECTED;
+  a2dp_close_audio_path(common);
 
   return 0;
 }
@@ -827,9 +895,7 @@ static int suspend_audio_datapath(struct a2dp_stream_common* common,
     common->state = AUDIO_A2DP_STATE_SUSPENDED;
 
   /* disconnect audio path */
-  skt_disconnect(common->audio_fd);
-
-  common->audio_fd = AUDIO_SKT_DISCONNECTED;
+  a2dp_close_audio_path(common);
 
   return 0;
 }
@@ -865,13 +931,21 @@ static ssize_t out_write(struct audio_stream_out* stream, const void* buffer,
     goto finish;
   }
 
-  lock.unlock();
-  sent = skt_write(out->common.audio_fd, buffer, bytes);
-  lock.lock();
+  {
+    const int audio_fd = out->common.audio_fd;
+    shm_ring_t* audio_ring =
+        out->common.audio_ring_active ? out->common.audio_ring : NULL;
+    lock.unlock();
+    if (audio_ring != NULL) {
+      sent = shm_write(audio_ring, audio_fd, buffer, bytes);
+    } else {
+      sent = skt_write(audio_fd, buffer, bytes);
+    }
+    lock.lock();
+  }
 
   if (sent == -1) {
-    skt_disconnect(out->common.audio_fd);
-    out->common.audio_fd = AUDIO_SKT_DISCONNECTED;
+    a2dp_close_audio_path(&out->common);
     if ((out->common.state != AUDIO_A2DP_STATE_SUSPENDED) &&
         (out->common.state != AUDIO_A2DP_STATE_STOPPING)) {
       out->common.state = AUDIO_A2DP_STATE_STOPPED;
@@ -1491,6 +1565,7 @@ static int adev_open_output_stream(struct audio_hw_device* dev,
 
   /* initialize a2dp specifics */
   a2dp_stream_common_init(&out->common);
+  out->common.audio_ring_allowed = audio_a2dp_hw_shm_ring_enabled();
 
   // Make sure we always have the feeding parameters configured
   btav_a2dp_codec_config_t codec_config;
@@ -18,6 +18,10 @@
 
 #include "audio_a2dp_hw.h"
 
+#include <string.h>
+
+#include "osi/include/properties.h"
+
 #define CASE_RETURN_STR(const) \
   case const:                  \
     return #const;
@@ -39,3 +43,9 @@ const char* audio_a2dp_hw_dump_ctrl_event(tA2DP_CTRL_CMD event) {
 
   return "UNKNOWN A2DP_CTRL_CMD";
 }
+
+bool audio_a2dp_hw_shm_ring_enabled(void) {
+  char value[PROPERTY_VALUE_MAX] = {0};
+  osi_property_get(A2DP_SHM_RING_PROPERTY, value, "false");
+  return strncmp(value, "true", 4) == 0;
+}
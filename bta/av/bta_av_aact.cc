@@ -569,6 +569,7 @@ void bta_av_sink_data_cback(uint8_t handle, BT_HDR* p_pkt, uint32_t time_stamp,
                             uint8_t m_pt) {
   int index = 0;
   tBTA_AV_SCB* p_scb;
+  tBTA_AV_MEDIA av_media;
   APPL_TRACE_DEBUG(
       "%s: avdt_handle: %d pkt_len=0x%x  offset = 0x%x "
       "number of frames 0x%x sequence number 0x%x",
@@ -588,8 +589,10 @@ void bta_av_sink_data_cback(uint8_t handle, BT_HDR* p_pkt, uint32_t time_stamp,
     return;
   }
   p_pkt->event = BTA_AV_SINK_MEDIA_DATA_EVT;
+  av_media.sink_data.p_pkt = p_pkt;
+  av_media.sink_data.time_stamp = time_stamp;
   p_scb->seps[p_scb->sep_idx].p_app_sink_data_cback(BTA_AV_SINK_MEDIA_DATA_EVT,
-                                                    (tBTA_AV_MEDIA*)p_pkt);
+                                                    &av_media);
   /* Free the buffer: a copy of the packet has been delivered */
   osi_free(p_pkt);
 }
@@ -2089,126 +2092,149 @@ void bta_av_reconfig(tBTA_AV_SCB* p_scb, tBTA_AV_DATA* p_data) {
 
 /*******************************************************************************
  *
- * Function         bta_av_data_path
+ * Function         bta_av_write_media
  *
- * Description      Handle stream data path.
+ * Description      Queue one media buffer to AVDTP, fragmenting the payload
+ *                  if it is larger than the stream MTU.
  *
  * Returns          void
  *
  ******************************************************************************/
-void bta_av_data_path(tBTA_AV_SCB* p_scb, UNUSED_ATTR tBTA_AV_DATA* p_data) {
-  BT_HDR* p_buf = NULL;
-  uint32_t timestamp;
-  bool new_buf = false;
+static void bta_av_write_media(tBTA_AV_SCB* p_scb, BT_HDR* p_buf,
+                               uint32_t timestamp) {
   uint8_t m_pt = 0x60;
   tAVDT_DATA_OPT_MASK opt;
 
-  if (p_scb->cong) return;
-
   if (p_scb->current_codec->useRtpHeaderMarkerBit()) {
     m_pt |= AVDT_MARKER_SET;
   }
 
-  // Always get the current number of bufs que'd up
-  p_scb->l2c_bufs =
-      (uint8_t)L2CA_FlushChannel(p_scb->l2c_cid, L2CAP_FLUSH_CHANS_GET);
+  /* opt is a bit mask, it could have several options set */
+  opt = AVDT_DATA_OPT_NONE;
+  if (p_scb->no_rtp_hdr) {
+    opt |= AVDT_DATA_OPT_NO_RTP;
+  }
+
+  //
+  // Fragment the payload if larger than the MTU.
+  // NOTE: The fragmentation is RTP-compatibie.
+  //
+  size_t extra_fragments_n = 0;
+  if (p_buf->len > 0) {
+    extra_fragments_n = (p_buf->len / p_scb->stream_mtu) +
+                        ((p_buf->len % p_scb->stream_mtu) ? 1 : 0) - 1;
+  }
+  std::vector<BT_HDR*> extra_fragments;
+  extra_fragments.reserve(extra_fragments_n);
+
+  uint8_t* data_begin = (uint8_t*)(p_buf + 1) + p_buf->offset;
+  uint8_t* data_end = (uint8_t*)(p_buf + 1) + p_buf->offset + p_buf->len;
+  while (extra_fragments_n-- > 0) {
+    data_begin += p_scb->stream_mtu;
+    size_t fragment_len = data_end - data_begin;
+    if (fragment_len > p_scb->stream_mtu) fragment_len = p_scb->stream_mtu;
+
+    BT_HDR* p_buf2 = (BT_HDR*)osi_malloc(BT_DEFAULT_BUFFER_SIZE);
+    p_buf2->offset = p_buf->offset;
+    p_buf2->len = 0;
+    p_buf2->layer_specific = 0;
+    uint8_t* packet2 = (uint8_t*)(p_buf2 + 1) + p_buf2->offset + p_buf2->len;
+    memcpy(packet2, data_begin, fragment_len);
+    p_buf2->len += fragment_len;
+    extra_fragments.push_back(p_buf2);
+    p_buf->len -= fragment_len;
+  }
+
+  if (!extra_fragments.empty()) {
+    // Reset the RTP Marker bit for all fragments except the last one
+    m_pt &= ~AVDT_MARKER_SET;
+  }
+  AVDT_WriteReqOpt(p_scb->avdt_handle, p_buf, timestamp, m_pt, opt);
+  for (size_t i = 0; i < extra_fragments.size(); i++) {
+    if (i + 1 == extra_fragments.size()) {
+      // Set the RTP Marker bit for the last fragment
+      m_pt |= AVDT_MARKER_SET;
+    }
+    BT_HDR* p_buf2 = extra_fragments[i];
+    AVDT_WriteReqOpt(p_scb->avdt_handle, p_buf2, timestamp, m_pt, opt);
+  }
+}
 
-  if (!list_is_empty(p_scb->a2dp_list)) {
-    p_buf = (BT_HDR*)list_front(p_scb->a2dp_list);
-    list_remove(p_scb->a2dp_list, p_buf);
-    /* use q_info.a2dp data, read the timestamp */
-    timestamp = *(uint32_t*)(p_buf + 1);
-  } else {
-    new_buf = true;
-    /* A2DP_list empty, call co_data, dup data to other channels */
-    p_buf = (BT_HDR*)p_scb->p_cos->data(p_scb->cfg.codec_info, &timestamp);
+/*******************************************************************************
+ *
+ * Function         bta_av_data_path
+ *
+ * Description      Handle stream data path. All buffers the media task has
+ *                  ready are handed to AVDTP in one pass, for as long as
+ *                  L2CAP keeps draining, so that a batch encoded in one
+ *                  media tick doesn't take one WRITE_CFM round trip per
+ *                  packet. The stream is marked congested once, after the
+ *                  batch, until the WRITE_CFM of the batch clears it.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void bta_av_data_path(tBTA_AV_SCB* p_scb, UNUSED_ATTR tBTA_AV_DATA* p_data) {
+  BT_HDR* p_buf = NULL;
+  uint32_t timestamp;
+  bool new_buf;
+  bool written = false;
 
-    if (p_buf) {
-      /* use the offset area for the time stamp */
-      *(uint32_t*)(p_buf + 1) = timestamp;
+  if (p_scb->cong) return;
+
+  while (true) {
+    // Always get the current number of bufs que'd up
+    p_scb->l2c_bufs =
+        (uint8_t)L2CA_FlushChannel(p_scb->l2c_cid, L2CAP_FLUSH_CHANS_GET);
+
+    new_buf = false;
+    if (!list_is_empty(p_scb->a2dp_list)) {
+      p_buf = (BT_HDR*)list_front(p_scb->a2dp_list);
+      list_remove(p_scb->a2dp_list, p_buf);
+      /* use q_info.a2dp data, read the timestamp */
+      timestamp = *(uint32_t*)(p_buf + 1);
+    } else {
+      new_buf = true;
+      /* A2DP_list empty, call co_data for this channel's own copy */
+      p_buf = (BT_HDR*)p_scb->p_cos->data(p_scb->hndl, p_scb->cfg.codec_info,
+                                          &timestamp);
 
-      /* dup the data to other channels */
-      bta_av_dup_audio_buf(p_scb, p_buf);
+      /* use the offset area for the time stamp */
+      if (p_buf) *(uint32_t*)(p_buf + 1) = timestamp;
     }
-  }
 
-  if (p_buf) {
+    if (p_buf == NULL) break;
+
     if (p_scb->l2c_bufs < (BTA_AV_QUEUE_DATA_CHK_NUM)) {
       /* There's a buffer, just queue it to L2CAP.
        * There's no need to increment it here, it is always read from
        * L2CAP (see above).
        */
+      bta_av_write_media(p_scb, p_buf, timestamp);
+      written = true;
+      continue;
+    }
 
-      /* opt is a bit mask, it could have several options set */
-      opt = AVDT_DATA_OPT_NONE;
-      if (p_scb->no_rtp_hdr) {
-        opt |= AVDT_DATA_OPT_NO_RTP;
-      }
-
-      //
-      // Fragment the payload if larger than the MTU.
-      // NOTE: The fragmentation is RTP-compatibie.
-      //
-      size_t extra_fragments_n = 0;
-      if (p_buf->len > 0) {
-        extra_fragments_n = (p_buf->len / p_scb->stream_mtu) +
-                            ((p_buf->len % p_scb->stream_mtu) ? 1 : 0) - 1;
-      }
-      std::vector<BT_HDR*> extra_fragments;
-      extra_fragments.reserve(extra_fragments_n);
-
-      uint8_t* data_begin = (uint8_t*)(p_buf + 1) + p_buf->offset;
-      uint8_t* data_end = (uint8_t*)(p_buf + 1) + p_buf->offset + p_buf->len;
-      while (extra_fragments_n-- > 0) {
-        data_begin += p_scb->stream_mtu;
-        size_t fragment_len = data_end - data_begin;
-        if (fragment_len > p_scb->stream_mtu) fragment_len = p_scb->stream_mtu;
-
-        BT_HDR* p_buf2 = (BT_HDR*)osi_malloc(BT_DEFAULT_BUFFER_SIZE);
-        p_buf2->offset = p_buf->offset;
-        p_buf2->len = 0;
-        p_buf2->layer_specific = 0;
-        uint8_t* packet2 =
-            (uint8_t*)(p_buf2 + 1) + p_buf2->offset + p_buf2->len;
-        memcpy(packet2, data_begin, fragment_len);
-        p_buf2->len += fragment_len;
-        extra_fragments.push_back(p_buf2);
-        p_buf->len -= fragment_len;
-      }
-
-      if (!extra_fragments.empty()) {
-        // Reset the RTP Marker bit for all fragments except the last one
-        m_pt &= ~AVDT_MARKER_SET;
-      }
-      AVDT_WriteReqOpt(p_scb->avdt_handle, p_buf, timestamp, m_pt, opt);
-      for (size_t i = 0; i < extra_fragments.size(); i++) {
-        if (i + 1 == extra_fragments.size()) {
-          // Set the RTP Marker bit for the last fragment
-          m_pt |= AVDT_MARKER_SET;
-        }
-        BT_HDR* p_buf2 = extra_fragments[i];
-        AVDT_WriteReqOpt(p_scb->avdt_handle, p_buf2, timestamp, m_pt, opt);
-      }
-      p_scb->cong = true;
+    /* there's a buffer, but L2CAP does not seem to be moving data */
+    if (new_buf) {
+      /* just got this buffer from co_data,
+       * put it in queue */
+      list_append(p_scb->a2dp_list, p_buf);
     } else {
-      /* there's a buffer, but L2CAP does not seem to be moving data */
-      if (new_buf) {
-        /* just got this buffer from co_data,
-         * put it in queue */
-        list_append(p_scb->a2dp_list, p_buf);
+      /* just dequeue it from the a2dp_list */
+      if (list_length(p_scb->a2dp_list) < 3) {
+        /* put it back to the queue */
+        list_prepend(p_scb->a2dp_list, p_buf);
       } else {
-        /* just dequeue it from the a2dp_list */
-        if (list_length(p_scb->a2dp_list) < 3) {
-          /* put it back to the queue */
-          list_prepend(p_scb->a2dp_list, p_buf);
-        } else {
-          /* too many buffers in a2dp_list, drop it. */
-          bta_av_co_audio_drop(p_scb->hndl);
-          osi_free(p_buf);
-        }
+        /* too many buffers in a2dp_list, drop it. */
+        bta_av_co_audio_drop(p_scb->hndl);
+        osi_free(p_buf);
       }
     }
+    break;
   }
+
+  if (written) p_scb->cong = true;
 }
 
 /*******************************************************************************
@@ -2372,7 +2398,7 @@ void bta_av_start_ok(tBTA_AV_SCB* p_scb, tBTA_AV_DATA* p_data) {
       tBTA_AV_API_STOP stop;
       p_scb->role |= BTA_AV_ROLE_SUSPEND;
       p_scb->cong = true; /* do not allow the media data to go through */
-      /* do not duplicate the media packets to this channel */
+      /* do not queue the media packets for this channel */
       p_scb->p_cos->stop(p_scb->hndl);
       p_scb->co_started = false;
       stop.flush = false;
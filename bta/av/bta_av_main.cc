@@ -1078,45 +1078,6 @@ uint16_t bta_av_chk_mtu(tBTA_AV_SCB* p_scb, UNUSED_ATTR uint16_t mtu) {
   return ret_mtu;
 }
 
-/*******************************************************************************
- *
- * Function         bta_av_dup_audio_buf
- *
- * Description      dup the audio data to the q_info.a2dp of other audio
- *                  channels
- *
- * Returns          void
- *
- ******************************************************************************/
-void bta_av_dup_audio_buf(tBTA_AV_SCB* p_scb, BT_HDR* p_buf) {
-  /* Test whether there is more than one audio channel connected */
-  if ((p_buf == NULL) || (bta_av_cb.audio_open_cnt < 2)) return;
-
-  uint16_t copy_size = BT_HDR_SIZE + p_buf->len + p_buf->offset;
-  for (int i = 0; i < BTA_AV_NUM_STRS; i++) {
-    tBTA_AV_SCB* p_scbi = bta_av_cb.p_scb[i];
-
-    if (i == p_scb->hdi) continue; /* Ignore the original channel */
-    if ((p_scbi == NULL) || !p_scbi->co_started)
-      continue; /* Ignore if SCB is not used or started */
-    if (!(bta_av_cb.conn_audio & BTA_AV_HNDL_TO_MSK(i)))
-      continue; /* Audio is not connected */
-
-    /* Enqueue the data */
-    BT_HDR* p_new = (BT_HDR*)osi_malloc(copy_size);
-    memcpy(p_new, p_buf, copy_size);
-    list_append(p_scbi->a2dp_list, p_new);
-
-    if (list_length(p_scbi->a2dp_list) > p_bta_av_cfg->audio_mqs) {
-      // Drop the oldest packet
-      bta_av_co_audio_drop(p_scbi->hndl);
-      BT_HDR* p_buf_drop = static_cast<BT_HDR*>(list_front(p_scbi->a2dp_list));
-      list_remove(p_scbi->a2dp_list, p_buf_drop);
-      osi_free(p_buf_drop);
-    }
-  }
-}
-
 /*******************************************************************************
  *
  * Function         bta_av_sm_execute
@@ -28,8 +28,12 @@
 #include "bt_target.h"
 
 #include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "bt_common.h"
@@ -44,8 +48,6 @@
 #include "sdpdefs.h"
 #include "utl.h"
 
-static void bta_gattc_cache_write(BD_ADDR server_bda, uint16_t num_attr,
-                                  tBTA_GATTC_NV_ATTR* attr);
 static void bta_gattc_char_dscpt_disc_cmpl(uint16_t conn_id,
                                            tBTA_GATTC_SERV* p_srvc_cb);
 static tBTA_GATT_STATUS bta_gattc_sdp_service_disc(
@@ -60,8 +62,17 @@ tBTA_GATTC_CHARACTERISTIC* bta_gattc_get_characteristic_srcb(
 
 #define BTA_GATT_SDP_DB_SIZE 4096
 
+/* a characteristic has handles left for descriptors before the next one */
+#define BTA_GATTC_CHAR_HAS_DSCP_RANGE(p_rec) \
+  ((p_rec)->s_handle < (p_rec)->e_handle)
+
+#ifndef GATT_CACHE_PREFIX
 #define GATT_CACHE_PREFIX "/data/misc/bluetooth/gatt_cache_"
-#define GATT_CACHE_VERSION 2
+#endif
+#ifndef GATT_HASH_PREFIX
+#define GATT_HASH_PREFIX "/data/misc/bluetooth/gatt_hash_"
+#endif
+#define GATT_CACHE_VERSION 3
 
 static void bta_gattc_generate_cache_file_name(char* buffer, size_t buffer_len,
                                                BD_ADDR bda) {
@@ -69,10 +80,66 @@ static void bta_gattc_generate_cache_file_name(char* buffer, size_t buffer_len,
            bda[0], bda[1], bda[2], bda[3], bda[4], bda[5]);
 }
 
+static void bta_gattc_generate_hash_file_name(char* buffer, size_t buffer_len,
+                                              uint64_t db_hash) {
+  snprintf(buffer, buffer_len, "%s%016" PRIx64, GATT_HASH_PREFIX, db_hash);
+}
+
 /*****************************************************************************
  *  Constants and data types
  ****************************************************************************/
 
+/* Cache file: a header followed by the service, characteristic, descriptor
+ * and included service tables. Records refer to each other by table index,
+ * so the image is position independent and can be used straight from a
+ * read-only mapping. */
+#define BTA_GATTC_CACHE_MAGIC 0x43544147 /* "GATC" */
+
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t num_srvc;
+  uint16_t num_char;
+  uint16_t num_dscr;
+  uint16_t num_incl;
+  uint16_t reserved;
+  uint64_t db_hash; /* hash of the tables, also names the shared image */
+} tBTA_GATTC_CACHE_HDR;
+
+typedef struct {
+  tBT_UUID uuid;
+  uint16_t s_handle;
+  uint16_t e_handle;
+  uint16_t first_char; /* index into the characteristic table */
+  uint16_t num_char;
+  uint16_t first_incl; /* index into the included service table */
+  uint16_t num_incl;
+  uint8_t is_primary;
+} tBTA_GATTC_CACHE_SRVC;
+
+typedef struct {
+  tBT_UUID uuid;
+  uint16_t handle; /* value handle */
+  uint16_t first_dscr; /* index into the descriptor table */
+  uint16_t num_dscr;
+  uint8_t prop;
+} tBTA_GATTC_CACHE_CHAR;
+
+typedef struct {
+  tBT_UUID uuid;
+  uint16_t handle;
+} tBTA_GATTC_CACHE_DSCR;
+
+typedef struct {
+  tBT_UUID uuid;
+  uint16_t handle;
+  uint16_t incl_srvc_idx; /* index into the service table */
+} tBTA_GATTC_CACHE_INCL;
+
+static void bta_gattc_cache_write(BD_ADDR server_bda,
+                                  const tBTA_GATTC_CACHE_HDR* p_hdr,
+                                  size_t len);
+
 typedef struct {
   tSDP_DISCOVERY_DB* p_sdp_db;
   uint16_t sdp_conn_id;
@@ -266,6 +333,25 @@ static tBTA_GATT_STATUS bta_gattc_add_char_to_cache(tBTA_GATTC_SERV* p_srvc_cb,
   return BTA_GATT_OK;
 }
 
+/*******************************************************************************
+ *
+ * Function         bta_gattc_next_char_to_cache
+ *
+ * Description      Move on to the next characteristic of the explore pending
+ *                  list and add it into database cache.
+ *
+ * Returns          None.
+ *
+ ******************************************************************************/
+static void bta_gattc_next_char_to_cache(tBTA_GATTC_SERV* p_srvc_cb) {
+  tBTA_GATTC_ATTR_REC* p_rec =
+      p_srvc_cb->p_srvc_list + (++p_srvc_cb->cur_char_idx);
+
+  p_srvc_cb->total_char--;
+  bta_gattc_add_char_to_cache(p_srvc_cb, p_rec->char_decl_handle,
+                              p_rec->s_handle, &p_rec->uuid, p_rec->property);
+}
+
 /*******************************************************************************
  *
  * Function         bta_gattc_add_attr_to_cache
@@ -353,15 +439,17 @@ void bta_gattc_get_disc_range(tBTA_GATTC_SERV* p_srvc_cb, uint16_t* p_s_hdl,
   if (is_srvc) {
     p_rec = p_srvc_cb->p_srvc_list + p_srvc_cb->cur_srvc_idx;
     *p_s_hdl = p_rec->s_handle;
+    *p_e_hdl = p_rec->e_handle;
   } else {
+    /* descriptors of every characteristic in the sweep */
     p_rec = p_srvc_cb->p_srvc_list + p_srvc_cb->cur_char_idx;
     *p_s_hdl = p_rec->s_handle + 1;
+    p_rec = p_srvc_cb->p_srvc_list + p_srvc_cb->dscp_sweep_end_idx;
+    *p_e_hdl = p_rec->e_handle;
   }
 
-  *p_e_hdl = p_rec->e_handle;
 #if (BTA_GATT_DEBUG == TRUE)
-  APPL_TRACE_DEBUG("discover range [%d ~ %d]", p_rec->s_handle,
-                   p_rec->e_handle);
+  APPL_TRACE_DEBUG("discover range [%d ~ %d]", *p_s_hdl, *p_e_hdl);
 #endif
   return;
 }
@@ -460,8 +548,31 @@ tBTA_GATT_STATUS bta_gattc_start_disc_char(uint16_t conn_id,
  ******************************************************************************/
 void bta_gattc_start_disc_char_dscp(uint16_t conn_id,
                                     tBTA_GATTC_SERV* p_srvc_cb) {
+  tBTA_GATTC_ATTR_REC* p_list = p_srvc_cb->p_srvc_list;
+  uint8_t last_idx = p_srvc_cb->cur_char_idx + p_srvc_cb->total_char - 1;
+  /* 16-bit handle/UUID pairs that fit into one Find Information response */
+  uint16_t pairs_per_rsp = (p_srvc_cb->mtu - 2) / 4;
+  uint8_t i;
+
   APPL_TRACE_DEBUG("starting discover characteristics descriptor");
 
+  /* characteristics followed directly by the next declaration have no
+   * descriptors and need no request */
+  while (p_srvc_cb->cur_char_idx < last_idx &&
+         !BTA_GATTC_CHAR_HAS_DSCP_RANGE(p_list + p_srvc_cb->cur_char_idx))
+    bta_gattc_next_char_to_cache(p_srvc_cb);
+
+  /* Sweep the descriptors of following characteristics with the same Find
+   * Information procedure. The declaration and value of each characteristic
+   * in between come back too, so stop where skipping them would cost more
+   * than a response worth of entries. */
+  p_srvc_cb->dscp_sweep_end_idx = p_srvc_cb->cur_char_idx;
+  for (i = p_srvc_cb->cur_char_idx + 1; i <= last_idx; i++) {
+    if (!BTA_GATTC_CHAR_HAS_DSCP_RANGE(p_list + i)) continue;
+    if (2 * (i - p_srvc_cb->dscp_sweep_end_idx) > pairs_per_rsp) break;
+    p_srvc_cb->dscp_sweep_end_idx = i;
+  }
+
   if (bta_gattc_discover_procedure(conn_id, p_srvc_cb, GATT_DISC_CHAR_DSCPT) !=
       0)
     bta_gattc_char_dscpt_disc_cmpl(conn_id, p_srvc_cb);
@@ -570,13 +681,14 @@ static void bta_gattc_char_disc_cmpl(uint16_t conn_id,
  ******************************************************************************/
 static void bta_gattc_char_dscpt_disc_cmpl(uint16_t conn_id,
                                            tBTA_GATTC_SERV* p_srvc_cb) {
-  tBTA_GATTC_ATTR_REC* p_rec = NULL;
+  /* add the rest of the sweep, which had no descriptors after the last one
+   * found, into cache */
+  while (p_srvc_cb->cur_char_idx < p_srvc_cb->dscp_sweep_end_idx)
+    bta_gattc_next_char_to_cache(p_srvc_cb);
 
-  if (--p_srvc_cb->total_char > 0) {
-    p_rec = p_srvc_cb->p_srvc_list + (++p_srvc_cb->cur_char_idx);
+  if (p_srvc_cb->total_char > 1) {
     /* add the next characteristic into cache */
-    bta_gattc_add_char_to_cache(p_srvc_cb, p_rec->char_decl_handle,
-                                p_rec->s_handle, &p_rec->uuid, p_rec->property);
+    bta_gattc_next_char_to_cache(p_srvc_cb);
 
     /* start discoverying next characteristic for char descriptor */
     bta_gattc_start_disc_char_dscp(conn_id, p_srvc_cb);
@@ -586,6 +698,7 @@ static void bta_gattc_char_dscpt_disc_cmpl(uint16_t conn_id,
 #if (BTA_GATT_DEBUG == TRUE)
     APPL_TRACE_ERROR("all char has been explored");
 #endif
+    p_srvc_cb->total_char = 0;
     p_srvc_cb->cur_srvc_idx++;
     bta_gattc_explore_srvc(conn_id, p_srvc_cb);
   }
@@ -868,11 +981,26 @@ void bta_gattc_disc_res_cback(uint16_t conn_id, tGATT_DISC_TYPE disc_type,
                                    p_data->value.dclr_value.char_prop);
         break;
 
-      case GATT_DISC_CHAR_DSCPT:
+      case GATT_DISC_CHAR_DSCPT: {
+        tBTA_GATTC_ATTR_REC* p_rec;
+
+        /* move on to the characteristic owning this handle */
+        while (p_srvc_cb->cur_char_idx < p_srvc_cb->dscp_sweep_end_idx &&
+               p_data->handle >
+                   (p_srvc_cb->p_srvc_list + p_srvc_cb->cur_char_idx)->e_handle)
+          bta_gattc_next_char_to_cache(p_srvc_cb);
+
+        /* skip the declarations and values of swept characteristics */
+        p_rec = p_srvc_cb->p_srvc_list + p_srvc_cb->cur_char_idx;
+        if (p_data->handle <= p_rec->s_handle ||
+            p_data->handle > p_rec->e_handle)
+          break;
+
         bta_gattc_add_attr_to_cache(p_srvc_cb, p_data->handle, &p_data->type, 0,
                                     0 /* incl_srvc_handle */,
                                     BTA_GATTC_ATTR_TYPE_CHAR_DESCR);
         break;
+      }
     }
   }
 }
@@ -1269,148 +1397,342 @@ void bta_gattc_get_gatt_db(uint16_t conn_id, uint16_t start_handle,
 
 /*******************************************************************************
  *
- * Function         bta_gattc_rebuild_cache
+ * Function         bta_gattc_cache_hash
+ *
+ * Description      64-bit FNV-1a hash of the cache tables. Identical server
+ *                  databases hash the same, whichever device they came from.
+ *
+ * Returns          hash value.
+ *
+ ******************************************************************************/
+static uint64_t bta_gattc_cache_hash(const uint8_t* p_data, size_t len) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+
+  while (len--) {
+    hash ^= *p_data++;
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+/*******************************************************************************
  *
- * Description      rebuild server cache from NV cache.
+ * Function         bta_gattc_cache_size
  *
- * Parameters
+ * Description      Size of a cache image holding the given table lengths.
+ *
+ * Returns          size in bytes.
+ *
+ ******************************************************************************/
+static size_t bta_gattc_cache_size(const tBTA_GATTC_CACHE_HDR* p_hdr) {
+  return sizeof(tBTA_GATTC_CACHE_HDR) +
+         p_hdr->num_srvc * sizeof(tBTA_GATTC_CACHE_SRVC) +
+         p_hdr->num_char * sizeof(tBTA_GATTC_CACHE_CHAR) +
+         p_hdr->num_dscr * sizeof(tBTA_GATTC_CACHE_DSCR) +
+         p_hdr->num_incl * sizeof(tBTA_GATTC_CACHE_INCL);
+}
+
+/*******************************************************************************
+ *
+ * Function         bta_gattc_cache_tables
+ *
+ * Description      Locate the tables following the header of a cache image.
  *
  * Returns          None.
  *
  ******************************************************************************/
-void bta_gattc_rebuild_cache(tBTA_GATTC_SERV* p_srvc_cb, uint16_t num_attr,
-                             tBTA_GATTC_NV_ATTR* p_attr) {
-  /* first attribute loading, initialize buffer */
-  APPL_TRACE_ERROR("%s: bta_gattc_rebuild_cache", __func__);
+static void bta_gattc_cache_tables(const tBTA_GATTC_CACHE_HDR* p_hdr,
+                                   tBTA_GATTC_CACHE_SRVC** pp_srvc,
+                                   tBTA_GATTC_CACHE_CHAR** pp_char,
+                                   tBTA_GATTC_CACHE_DSCR** pp_dscr,
+                                   tBTA_GATTC_CACHE_INCL** pp_incl) {
+  *pp_srvc = (tBTA_GATTC_CACHE_SRVC*)(p_hdr + 1);
+  *pp_char = (tBTA_GATTC_CACHE_CHAR*)(*pp_srvc + p_hdr->num_srvc);
+  *pp_dscr = (tBTA_GATTC_CACHE_DSCR*)(*pp_char + p_hdr->num_char);
+  *pp_incl = (tBTA_GATTC_CACHE_INCL*)(*pp_dscr + p_hdr->num_dscr);
+}
 
-  list_free(p_srvc_cb->p_srvc_cache);
-  p_srvc_cb->p_srvc_cache = NULL;
-
-  while (num_attr > 0 && p_attr != NULL) {
-    switch (p_attr->attr_type) {
-      case BTA_GATTC_ATTR_TYPE_SRVC:
-        bta_gattc_add_srvc_to_cache(p_srvc_cb, p_attr->s_handle,
-                                    p_attr->e_handle, &p_attr->uuid,
-                                    p_attr->is_primary);
-        break;
+/*******************************************************************************
+ *
+ * Function         bta_gattc_cache_is_valid
+ *
+ * Description      Check a cache image read from storage: header, table sizes
+ *                  against the image length, table offsets and hash.
+ *
+ * Returns          true if the image can be used.
+ *
+ ******************************************************************************/
+static bool bta_gattc_cache_is_valid(const tBTA_GATTC_CACHE_HDR* p_hdr,
+                                     size_t len) {
+  tBTA_GATTC_CACHE_SRVC* p_srvc;
+  tBTA_GATTC_CACHE_CHAR* p_char;
+  tBTA_GATTC_CACHE_DSCR* p_dscr;
+  tBTA_GATTC_CACHE_INCL* p_incl;
+
+  if (len < sizeof(tBTA_GATTC_CACHE_HDR) ||
+      p_hdr->magic != BTA_GATTC_CACHE_MAGIC ||
+      p_hdr->version != GATT_CACHE_VERSION ||
+      bta_gattc_cache_size(p_hdr) != len)
+    return false;
 
-      case BTA_GATTC_ATTR_TYPE_CHAR:
-        // TODO(jpawlowski): store decl_handle properly.
-        bta_gattc_add_char_to_cache(p_srvc_cb, p_attr->s_handle,
-                                    p_attr->s_handle, &p_attr->uuid,
-                                    p_attr->prop);
-        break;
+  bta_gattc_cache_tables(p_hdr, &p_srvc, &p_char, &p_dscr, &p_incl);
 
-      case BTA_GATTC_ATTR_TYPE_CHAR_DESCR:
-      case BTA_GATTC_ATTR_TYPE_INCL_SRVC:
-        bta_gattc_add_attr_to_cache(p_srvc_cb, p_attr->s_handle, &p_attr->uuid,
-                                    p_attr->prop, p_attr->incl_srvc_handle,
-                                    p_attr->attr_type);
-        break;
-    }
-    p_attr++;
-    num_attr--;
+  for (uint16_t i = 0; i < p_hdr->num_srvc; i++) {
+    if (p_srvc[i].first_char + p_srvc[i].num_char > p_hdr->num_char ||
+        p_srvc[i].first_incl + p_srvc[i].num_incl > p_hdr->num_incl)
+      return false;
+  }
+  for (uint16_t i = 0; i < p_hdr->num_char; i++) {
+    if (p_char[i].first_dscr + p_char[i].num_dscr > p_hdr->num_dscr)
+      return false;
   }
+  for (uint16_t i = 0; i < p_hdr->num_incl; i++) {
+    if (p_incl[i].incl_srvc_idx >= p_hdr->num_srvc) return false;
+  }
+
+  return bta_gattc_cache_hash((const uint8_t*)(p_hdr + 1),
+                              len - sizeof(tBTA_GATTC_CACHE_HDR)) ==
+         p_hdr->db_hash;
 }
 
 /*******************************************************************************
  *
- * Function         bta_gattc_fill_nv_attr
+ * Function         bta_gattc_rebuild_cache
  *
- * Description      fill a NV attribute entry value
+ * Description      rebuild server cache from a cache image. Services,
+ *                  characteristics and their descriptors are laid out in
+ *                  order, so each record is attached to its owner by index.
  *
  * Returns          None.
  *
  ******************************************************************************/
-void bta_gattc_fill_nv_attr(tBTA_GATTC_NV_ATTR* p_attr, uint8_t type,
-                            uint16_t s_handle, uint16_t e_handle, tBT_UUID uuid,
-                            uint8_t prop, uint16_t incl_srvc_handle,
-                            bool is_primary) {
-  p_attr->s_handle = s_handle;
-  p_attr->e_handle = e_handle;
-  p_attr->attr_type = type;
-  p_attr->is_primary = is_primary;
-  p_attr->id = 0;
-  p_attr->prop = prop;
-  p_attr->incl_srvc_handle = incl_srvc_handle;
-
-  memcpy(&p_attr->uuid, &uuid, sizeof(tBT_UUID));
+static void bta_gattc_rebuild_cache(tBTA_GATTC_SERV* p_srvc_cb,
+                                    const tBTA_GATTC_CACHE_HDR* p_hdr) {
+  tBTA_GATTC_CACHE_SRVC* p_srvc;
+  tBTA_GATTC_CACHE_CHAR* p_char;
+  tBTA_GATTC_CACHE_DSCR* p_dscr;
+  tBTA_GATTC_CACHE_INCL* p_incl;
+  tBTA_GATTC_SERVICE** services = (tBTA_GATTC_SERVICE**)osi_malloc(
+      (p_hdr->num_srvc + 1) * sizeof(tBTA_GATTC_SERVICE*));
+
+  list_free(p_srvc_cb->p_srvc_cache);
+  p_srvc_cb->p_srvc_cache = list_new(service_free);
+
+  bta_gattc_cache_tables(p_hdr, &p_srvc, &p_char, &p_dscr, &p_incl);
+
+  for (uint16_t i = 0; i < p_hdr->num_srvc; i++) {
+    tBTA_GATTC_SERVICE* p_new_srvc =
+        (tBTA_GATTC_SERVICE*)osi_malloc(sizeof(tBTA_GATTC_SERVICE));
+
+    p_new_srvc->s_handle = p_srvc[i].s_handle;
+    p_new_srvc->e_handle = p_srvc[i].e_handle;
+    p_new_srvc->is_primary = p_srvc[i].is_primary;
+    memcpy(&p_new_srvc->uuid, &p_srvc[i].uuid, sizeof(tBT_UUID));
+    p_new_srvc->handle = p_srvc[i].s_handle;
+    p_new_srvc->characteristics = list_new(characteristic_free);
+    p_new_srvc->included_svc = list_new(osi_free);
+
+    list_append(p_srvc_cb->p_srvc_cache, p_new_srvc);
+    services[i] = p_new_srvc;
+  }
+
+  for (uint16_t i = 0; i < p_hdr->num_srvc; i++) {
+    tBTA_GATTC_SERVICE* service = services[i];
+
+    for (uint16_t c = p_srvc[i].first_char;
+         c < p_srvc[i].first_char + p_srvc[i].num_char; c++) {
+      tBTA_GATTC_CHARACTERISTIC* characteristic =
+          (tBTA_GATTC_CHARACTERISTIC*)osi_malloc(
+              sizeof(tBTA_GATTC_CHARACTERISTIC));
+
+      characteristic->handle = p_char[c].handle;
+      characteristic->properties = p_char[c].prop;
+      characteristic->descriptors = list_new(osi_free);
+      memcpy(&characteristic->uuid, &p_char[c].uuid, sizeof(tBT_UUID));
+      characteristic->service = service;
+      list_append(service->characteristics, characteristic);
+
+      for (uint16_t d = p_char[c].first_dscr;
+           d < p_char[c].first_dscr + p_char[c].num_dscr; d++) {
+        tBTA_GATTC_DESCRIPTOR* descriptor =
+            (tBTA_GATTC_DESCRIPTOR*)osi_malloc(sizeof(tBTA_GATTC_DESCRIPTOR));
+
+        descriptor->handle = p_dscr[d].handle;
+        memcpy(&descriptor->uuid, &p_dscr[d].uuid, sizeof(tBT_UUID));
+        descriptor->characteristic = characteristic;
+        list_append(characteristic->descriptors, descriptor);
+      }
+    }
+
+    for (uint16_t n = p_srvc[i].first_incl;
+         n < p_srvc[i].first_incl + p_srvc[i].num_incl; n++) {
+      tBTA_GATTC_INCLUDED_SVC* isvc =
+          (tBTA_GATTC_INCLUDED_SVC*)osi_malloc(sizeof(tBTA_GATTC_INCLUDED_SVC));
+
+      isvc->handle = p_incl[n].handle;
+      memcpy(&isvc->uuid, &p_incl[n].uuid, sizeof(tBT_UUID));
+      isvc->owning_service = service;
+      isvc->included_service = services[p_incl[n].incl_srvc_idx];
+      list_append(service->included_svc, isvc);
+    }
+  }
+
+  osi_free(services);
 }
 
 /*******************************************************************************
  *
- * Function         bta_gattc_cache_save
+ * Function         bta_gattc_cache_build
  *
- * Description      save the server cache into NV
+ * Description      Flatten the server cache into a cache image: a header
+ *                  followed by the service, characteristic, descriptor and
+ *                  included service tables, linked by table index.
  *
- * Returns          None.
+ * Returns          image allocated with osi_calloc, size in *p_len.
  *
  ******************************************************************************/
-void bta_gattc_cache_save(tBTA_GATTC_SERV* p_srvc_cb, uint16_t conn_id) {
-  if (!p_srvc_cb->p_srvc_cache || list_is_empty(p_srvc_cb->p_srvc_cache))
-    return;
-
-  int i = 0;
-  size_t db_size =
-      bta_gattc_get_db_size(p_srvc_cb->p_srvc_cache, 0x0000, 0xFFFF);
-  tBTA_GATTC_NV_ATTR* nv_attr =
-      (tBTA_GATTC_NV_ATTR*)osi_malloc(db_size * sizeof(tBTA_GATTC_NV_ATTR));
-
-  for (list_node_t* sn = list_begin(p_srvc_cb->p_srvc_cache);
-       sn != list_end(p_srvc_cb->p_srvc_cache); sn = list_next(sn)) {
+static tBTA_GATTC_CACHE_HDR* bta_gattc_cache_build(list_t* p_cache,
+                                                   size_t* p_len) {
+  tBTA_GATTC_CACHE_HDR hdr;
+  tBTA_GATTC_CACHE_SRVC* p_srvc;
+  tBTA_GATTC_CACHE_CHAR* p_char;
+  tBTA_GATTC_CACHE_DSCR* p_dscr;
+  tBTA_GATTC_CACHE_INCL* p_incl;
+  uint16_t srvc_idx = 0, char_idx = 0, dscr_idx = 0, incl_idx = 0;
+
+  memset(&hdr, 0, sizeof(hdr));
+  for (list_node_t* sn = list_begin(p_cache); sn != list_end(p_cache);
+       sn = list_next(sn)) {
     tBTA_GATTC_SERVICE* p_cur_srvc = (tBTA_GATTC_SERVICE*)list_node(sn);
 
-    bta_gattc_fill_nv_attr(&nv_attr[i++], BTA_GATTC_ATTR_TYPE_SRVC,
-                           p_cur_srvc->s_handle, p_cur_srvc->e_handle,
-                           p_cur_srvc->uuid, 0 /* properties */,
-                           0 /* incl_srvc_handle */, p_cur_srvc->is_primary);
+    hdr.num_srvc++;
+    hdr.num_incl += list_length(p_cur_srvc->included_svc);
+    for (list_node_t* cn = list_begin(p_cur_srvc->characteristics);
+         cn != list_end(p_cur_srvc->characteristics); cn = list_next(cn)) {
+      tBTA_GATTC_CHARACTERISTIC* p_cur_char =
+          (tBTA_GATTC_CHARACTERISTIC*)list_node(cn);
+
+      hdr.num_char++;
+      hdr.num_dscr += list_length(p_cur_char->descriptors);
+    }
   }
 
-  for (list_node_t* sn = list_begin(p_srvc_cb->p_srvc_cache);
-       sn != list_end(p_srvc_cb->p_srvc_cache); sn = list_next(sn)) {
+  /* zero filled, so padding hashes the same on every save */
+  *p_len = bta_gattc_cache_size(&hdr);
+  tBTA_GATTC_CACHE_HDR* p_hdr = (tBTA_GATTC_CACHE_HDR*)osi_calloc(*p_len);
+  memcpy(p_hdr, &hdr, sizeof(hdr));
+  p_hdr->magic = BTA_GATTC_CACHE_MAGIC;
+  p_hdr->version = GATT_CACHE_VERSION;
+  bta_gattc_cache_tables(p_hdr, &p_srvc, &p_char, &p_dscr, &p_incl);
+
+  for (list_node_t* sn = list_begin(p_cache); sn != list_end(p_cache);
+       sn = list_next(sn)) {
     tBTA_GATTC_SERVICE* p_cur_srvc = (tBTA_GATTC_SERVICE*)list_node(sn);
+    tBTA_GATTC_CACHE_SRVC* p_rec = &p_srvc[srvc_idx++];
 
-    if (!p_cur_srvc->characteristics ||
-        list_is_empty(p_cur_srvc->characteristics))
-      continue;
+    memcpy(&p_rec->uuid, &p_cur_srvc->uuid, sizeof(tBT_UUID));
+    p_rec->s_handle = p_cur_srvc->s_handle;
+    p_rec->e_handle = p_cur_srvc->e_handle;
+    p_rec->is_primary = p_cur_srvc->is_primary;
+    p_rec->first_char = char_idx;
+    p_rec->num_char = list_length(p_cur_srvc->characteristics);
+    p_rec->first_incl = incl_idx;
+    p_rec->num_incl = list_length(p_cur_srvc->included_svc);
 
     for (list_node_t* cn = list_begin(p_cur_srvc->characteristics);
          cn != list_end(p_cur_srvc->characteristics); cn = list_next(cn)) {
-      tBTA_GATTC_CHARACTERISTIC* p_char =
+      tBTA_GATTC_CHARACTERISTIC* p_cur_char =
           (tBTA_GATTC_CHARACTERISTIC*)list_node(cn);
+      tBTA_GATTC_CACHE_CHAR* p_char_rec = &p_char[char_idx++];
 
-      bta_gattc_fill_nv_attr(
-          &nv_attr[i++], BTA_GATTC_ATTR_TYPE_CHAR, p_char->handle, 0,
-          p_char->uuid, p_char->properties, 0 /* incl_srvc_handle */, false);
+      memcpy(&p_char_rec->uuid, &p_cur_char->uuid, sizeof(tBT_UUID));
+      p_char_rec->handle = p_cur_char->handle;
+      p_char_rec->prop = p_cur_char->properties;
+      p_char_rec->first_dscr = dscr_idx;
+      p_char_rec->num_dscr = list_length(p_cur_char->descriptors);
 
-      if (!p_char->descriptors || list_is_empty(p_char->descriptors)) continue;
-
-      for (list_node_t* dn = list_begin(p_char->descriptors);
-           dn != list_end(p_char->descriptors); dn = list_next(dn)) {
+      for (list_node_t* dn = list_begin(p_cur_char->descriptors);
+           dn != list_end(p_cur_char->descriptors); dn = list_next(dn)) {
         tBTA_GATTC_DESCRIPTOR* p_desc = (tBTA_GATTC_DESCRIPTOR*)list_node(dn);
+        tBTA_GATTC_CACHE_DSCR* p_dscr_rec = &p_dscr[dscr_idx++];
 
-        bta_gattc_fill_nv_attr(
-            &nv_attr[i++], BTA_GATTC_ATTR_TYPE_CHAR_DESCR, p_desc->handle, 0,
-            p_desc->uuid, 0 /* properties */, 0 /* incl_srvc_handle */, false);
+        memcpy(&p_dscr_rec->uuid, &p_desc->uuid, sizeof(tBT_UUID));
+        p_dscr_rec->handle = p_desc->handle;
       }
     }
 
-    if (!p_cur_srvc->included_svc || list_is_empty(p_cur_srvc->included_svc))
-      continue;
-
     for (list_node_t* an = list_begin(p_cur_srvc->included_svc);
          an != list_end(p_cur_srvc->included_svc); an = list_next(an)) {
       tBTA_GATTC_INCLUDED_SVC* p_isvc = (tBTA_GATTC_INCLUDED_SVC*)list_node(an);
+      tBTA_GATTC_CACHE_INCL* p_incl_rec = &p_incl[incl_idx++];
+      uint16_t idx = 0;
+
+      for (list_node_t* n = list_begin(p_cache);
+           n != list_end(p_cache) && list_node(n) != p_isvc->included_service;
+           n = list_next(n))
+        idx++;
 
-      bta_gattc_fill_nv_attr(&nv_attr[i++], BTA_GATTC_ATTR_TYPE_INCL_SRVC,
-                             p_isvc->handle, 0, p_isvc->uuid,
-                             0 /* properties */,
-                             p_isvc->included_service->s_handle, false);
+      memcpy(&p_incl_rec->uuid, &p_isvc->uuid, sizeof(tBT_UUID));
+      p_incl_rec->handle = p_isvc->handle;
+      p_incl_rec->incl_srvc_idx = idx;
     }
   }
 
-  bta_gattc_cache_write(p_srvc_cb->server_bda, db_size, nv_attr);
-  osi_free(nv_attr);
+  p_hdr->db_hash = bta_gattc_cache_hash((const uint8_t*)(p_hdr + 1),
+                                        *p_len - sizeof(tBTA_GATTC_CACHE_HDR));
+  return p_hdr;
+}
+
+/*******************************************************************************
+ *
+ * Function         bta_gattc_cache_save
+ *
+ * Description      save the server cache into NV
+ *
+ * Returns          None.
+ *
+ ******************************************************************************/
+void bta_gattc_cache_save(tBTA_GATTC_SERV* p_srvc_cb, uint16_t conn_id) {
+  if (!p_srvc_cb->p_srvc_cache || list_is_empty(p_srvc_cb->p_srvc_cache))
+    return;
+
+  size_t len;
+  tBTA_GATTC_CACHE_HDR* p_hdr =
+      bta_gattc_cache_build(p_srvc_cb->p_srvc_cache, &len);
+
+  bta_gattc_cache_write(p_srvc_cb->server_bda, p_hdr, len);
+  osi_free(p_hdr);
+}
+
+/*******************************************************************************
+ *
+ * Function         bta_gattc_cache_map
+ *
+ * Description      Map a cache file read-only.
+ *
+ * Parameter        fname: cache file name
+ *                  p_len: set to the mapped length
+ *
+ * Returns          the mapped image, NULL if the file can't be mapped. Release
+ *                  with munmap().
+ *
+ ******************************************************************************/
+static const tBTA_GATTC_CACHE_HDR* bta_gattc_cache_map(const char* fname,
+                                                       size_t* p_len) {
+  struct stat st;
+  void* p_map = NULL;
+  int fd = open(fname, O_RDONLY);
+
+  if (fd < 0) return NULL;
+
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    *p_len = st.st_size;
+    p_map = mmap(NULL, *p_len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p_map == MAP_FAILED) p_map = NULL;
+  }
+
+  close(fd);
+  return (const tBTA_GATTC_CACHE_HDR*)p_map;
 }
 
 /*******************************************************************************
@@ -1429,99 +1751,104 @@ bool bta_gattc_cache_load(tBTA_GATTC_CLCB* p_clcb) {
   bta_gattc_generate_cache_file_name(fname, sizeof(fname),
                                      p_clcb->p_srcb->server_bda);
 
-  FILE* fd = fopen(fname, "rb");
-  if (!fd) {
+  size_t len = 0;
+  const tBTA_GATTC_CACHE_HDR* p_hdr = bta_gattc_cache_map(fname, &len);
+  if (!p_hdr) {
     APPL_TRACE_ERROR("%s: can't open GATT cache file %s for reading, error: %s",
                      __func__, fname, strerror(errno));
     return false;
   }
 
-  uint16_t cache_ver = 0;
-  tBTA_GATTC_NV_ATTR* attr = NULL;
-  bool success = false;
-  uint16_t num_attr = 0;
-
-  if (fread(&cache_ver, sizeof(uint16_t), 1, fd) != 1) {
-    APPL_TRACE_ERROR("%s: can't read GATT cache version from: %s", __func__,
-                     fname);
-    goto done;
-  }
-
-  if (cache_ver != GATT_CACHE_VERSION) {
-    APPL_TRACE_ERROR("%s: wrong GATT cache version: %s", __func__, fname);
-    goto done;
+  bool success = bta_gattc_cache_is_valid(p_hdr, len);
+  if (success) {
+    bta_gattc_rebuild_cache(p_clcb->p_srcb, p_hdr);
+  } else {
+    APPL_TRACE_ERROR("%s: wrong or corrupted GATT cache: %s", __func__, fname);
   }
 
-  if (fread(&num_attr, sizeof(uint16_t), 1, fd) != 1) {
-    APPL_TRACE_ERROR("%s: can't read number of GATT attributes: %s", __func__,
-                     fname);
-    goto done;
-  }
+  munmap((void*)p_hdr, len);
+  return success;
+}
 
-  attr = (tBTA_GATTC_NV_ATTR*)osi_malloc(sizeof(tBTA_GATTC_NV_ATTR) * num_attr);
+/*******************************************************************************
+ *
+ * Function         bta_gattc_cache_write_file
+ *
+ * Description      Write a cache image to a temporary file and rename it into
+ *                  place, so readers never see a partial image.
+ *
+ * Returns          true on success, false otherwise
+ *
+ ******************************************************************************/
+static bool bta_gattc_cache_write_file(const char* fname,
+                                       const tBTA_GATTC_CACHE_HDR* p_hdr,
+                                       size_t len) {
+  char tmp_fname[260] = {0};
+  snprintf(tmp_fname, sizeof(tmp_fname), "%s.tmp", fname);
 
-  if (fread(attr, sizeof(tBTA_GATTC_NV_ATTR), num_attr, fd) != num_attr) {
-    APPL_TRACE_ERROR("%s: can't read GATT attributes: %s", __func__, fname);
-    goto done;
+  FILE* fd = fopen(tmp_fname, "wb");
+  if (!fd) {
+    APPL_TRACE_ERROR("%s: can't open GATT cache file for writing: %s", __func__,
+                     tmp_fname);
+    return false;
   }
 
-  bta_gattc_rebuild_cache(p_clcb->p_srcb, num_attr, attr);
-
-  success = true;
+  if (fwrite(p_hdr, len, 1, fd) != 1) {
+    APPL_TRACE_ERROR("%s: can't write GATT cache: %s", __func__, tmp_fname);
+    fclose(fd);
+    unlink(tmp_fname);
+    return false;
+  }
 
-done:
-  osi_free(attr);
-  fclose(fd);
-  return success;
+  if (fclose(fd) != 0 || rename(tmp_fname, fname) != 0) {
+    APPL_TRACE_ERROR("%s: can't store GATT cache %s: %s", __func__, fname,
+                     strerror(errno));
+    unlink(tmp_fname);
+    return false;
+  }
+  return true;
 }
 
 /*******************************************************************************
  *
  * Function         bta_gattc_cache_write
  *
- * Description      This callout function is executed by GATT when a server
- *                  cache is available to save.
+ * Description      Store a cache image for a server. The image is kept once
+ *                  per database hash and each device's cache file is a hard
+ *                  link to it, so peers with identical databases share it.
  *
  * Parameter        server_bda: server bd address of this cache belongs to
- *                  num_attr: number of attribute to be save.
- *                  attr: pointer to the list of attributes to save.
+ *                  p_hdr: cache image to save.
+ *                  len: size of the image.
  * Returns
  *
  ******************************************************************************/
-static void bta_gattc_cache_write(BD_ADDR server_bda, uint16_t num_attr,
-                                  tBTA_GATTC_NV_ATTR* attr) {
+static void bta_gattc_cache_write(BD_ADDR server_bda,
+                                  const tBTA_GATTC_CACHE_HDR* p_hdr,
+                                  size_t len) {
   char fname[255] = {0};
+  char hash_fname[255] = {0};
   bta_gattc_generate_cache_file_name(fname, sizeof(fname), server_bda);
+  bta_gattc_generate_hash_file_name(hash_fname, sizeof(hash_fname),
+                                    p_hdr->db_hash);
 
-  FILE* fd = fopen(fname, "wb");
-  if (!fd) {
-    APPL_TRACE_ERROR("%s: can't open GATT cache file for writing: %s", __func__,
-                     fname);
-    return;
-  }
+  /* drop the previous image of this device first */
+  bta_gattc_cache_reset(server_bda);
 
-  uint16_t cache_ver = GATT_CACHE_VERSION;
-  if (fwrite(&cache_ver, sizeof(uint16_t), 1, fd) != 1) {
-    APPL_TRACE_ERROR("%s: can't write GATT cache version: %s", __func__, fname);
-    fclose(fd);
-    return;
-  }
+  size_t shared_len = 0;
+  const tBTA_GATTC_CACHE_HDR* p_shared =
+      bta_gattc_cache_map(hash_fname, &shared_len);
+  bool shared = p_shared != NULL && shared_len == len &&
+                memcmp(p_shared, p_hdr, len) == 0;
+  if (p_shared) munmap((void*)p_shared, shared_len);
 
-  if (fwrite(&num_attr, sizeof(uint16_t), 1, fd) != 1) {
-    APPL_TRACE_ERROR("%s: can't write GATT cache attribute count: %s", __func__,
-                     fname);
-    fclose(fd);
-    return;
-  }
+  if (!shared) shared = bta_gattc_cache_write_file(hash_fname, p_hdr, len);
 
-  if (fwrite(attr, sizeof(tBTA_GATTC_NV_ATTR), num_attr, fd) != num_attr) {
-    APPL_TRACE_ERROR("%s: can't write GATT cache attributes: %s", __func__,
-                     fname);
-    fclose(fd);
-    return;
+  if (!shared || link(hash_fname, fname) != 0) {
+    APPL_TRACE_WARNING("%s: can't share GATT cache %s, storing a copy",
+                       __func__, hash_fname);
+    bta_gattc_cache_write_file(fname, p_hdr, len);
   }
-
-  fclose(fd);
 }
 
 /*******************************************************************************
@@ -1540,5 +1867,28 @@ void bta_gattc_cache_reset(BD_ADDR server_bda) {
   BTIF_TRACE_DEBUG("%s", __func__);
   char fname[255] = {0};
   bta_gattc_generate_cache_file_name(fname, sizeof(fname), server_bda);
+
+  size_t len = 0;
+  bool has_hash = false;
+  uint64_t db_hash = 0;
+  const tBTA_GATTC_CACHE_HDR* p_hdr = bta_gattc_cache_map(fname, &len);
+  if (p_hdr) {
+    if (len >= sizeof(tBTA_GATTC_CACHE_HDR) &&
+        p_hdr->magic == BTA_GATTC_CACHE_MAGIC) {
+      has_hash = true;
+      db_hash = p_hdr->db_hash;
+    }
+    munmap((void*)p_hdr, len);
+  }
+
   unlink(fname);
+
+  /* remove the shared image once no device links to it any more */
+  if (has_hash) {
+    char hash_fname[255] = {0};
+    struct stat st;
+
+    bta_gattc_generate_hash_file_name(hash_fname, sizeof(hash_fname), db_hash);
+    if (stat(hash_fname, &st) == 0 && st.st_nlink == 1) unlink(hash_fname);
+  }
 }
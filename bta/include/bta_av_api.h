@@ -437,10 +437,17 @@ typedef struct {
   ;
 } tBTA_AVK_CONFIG;
 
+/* data associated with BTA_AV_SINK_MEDIA_DATA_EVT */
+typedef struct {
+  BT_HDR* p_pkt;       /* media payload, past the RTP header */
+  uint32_t time_stamp; /* RTP timestamp of the first sample in the packet */
+} tBTA_AV_SINK_MEDIA_DATA;
+
 /* union of data associated with AV Media callback */
 typedef union {
   BT_HDR* p_data;
   tBTA_AVK_CONFIG avk_config;
+  tBTA_AV_SINK_MEDIA_DATA sink_data;
 } tBTA_AV_MEDIA;
 
 #define BTA_GROUP_NAVI_MSG_OP_DATA_LEN 5
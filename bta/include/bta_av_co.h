@@ -160,13 +160,15 @@ void bta_av_co_audio_stop(tBTA_AV_HNDL hndl);
  * Function         bta_av_co_audio_src_data_path
  *
  * Description      This function is called to get the next data buffer from
- *                  the audio codec
+ *                  the audio codec for the stream with handle hndl. Each
+ *                  started audio stream gets its own copy of the data.
  *
  * Returns          NULL if data is not ready.
  *                  Otherwise, a buffer (BT_HDR*) containing the audio data.
  *
  ******************************************************************************/
-void* bta_av_co_audio_src_data_path(const uint8_t* p_codec_info,
+void* bta_av_co_audio_src_data_path(tBTA_AV_HNDL hndl,
+                                    const uint8_t* p_codec_info,
                                     uint32_t* p_timestamp);
 
 /*******************************************************************************
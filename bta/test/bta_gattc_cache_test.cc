@@ -0,0 +1,580 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2017 Google, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "bta/gatt/bta_gattc_int.h"
+#include "osi/include/allocator.h"
+#include "osi/include/list.h"
+
+// GATT_CACHE_PREFIX and GATT_HASH_PREFIX are set by the build, so that the
+// cache files go to a scratch directory.
+
+#define TEST_CONN_ID 1
+
+static BD_ADDR bda_1 = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66};
+static BD_ADDR bda_2 = {0x66, 0x55, 0x44, 0x33, 0x22, 0x11};
+
+// One attribute of the simulated server
+typedef struct {
+  uint16_t handle;
+  enum { SERVICE, CHAR_DECL, CHAR_VALUE, DESCRIPTOR } kind;
+  uint16_t uuid;
+  uint16_t end_or_value_handle;
+} test_attr_t;
+
+// A discovery procedure started through GATTC_Discover()
+typedef struct {
+  tGATT_DISC_TYPE type;
+  uint16_t s_handle;
+  uint16_t e_handle;
+} test_disc_req_t;
+
+static std::vector<test_attr_t> server_db;
+static std::deque<test_disc_req_t> disc_reqs;
+static tBTA_GATTC_SERV srvc_cb;
+static tBTA_GATTC_CLCB clcb;
+static bool discovery_done;
+
+tGATT_STATUS GATTC_Discover(uint16_t conn_id, tGATT_DISC_TYPE disc_type,
+                            tGATT_DISC_PARAM* p_param) {
+  disc_reqs.push_back({disc_type, p_param->s_handle, p_param->e_handle});
+  return GATT_SUCCESS;
+}
+
+tBTA_GATTC_SERV* bta_gattc_find_scb_by_cid(uint16_t conn_id) {
+  return &srvc_cb;
+}
+tBTA_GATTC_CLCB* bta_gattc_find_clcb_by_conn_id(uint16_t conn_id) {
+  return &clcb;
+}
+void bta_gattc_reset_discover_st(tBTA_GATTC_SERV* p_srcb,
+                                 tBTA_GATT_STATUS status) {
+  discovery_done = true;
+}
+
+// The rest of the stack is not under test here
+uint8_t appl_trace_level = BT_TRACE_LEVEL_NONE;
+uint8_t btif_trace_level = BT_TRACE_LEVEL_NONE;
+void LogMsg(uint32_t trace_set_mask, const char* fmt_str, ...) {}
+void bta_to_btif_uuid(bt_uuid_t* p_dest, tBT_UUID* p_src) {}
+bool bta_gattc_sm_execute(tBTA_GATTC_CLCB* p_clcb, uint16_t event,
+                          tBTA_GATTC_DATA* p_data) {
+  return true;
+}
+bool bta_gattc_uuid_compare(const tBT_UUID* p_src, const tBT_UUID* p_tar,
+                            bool is_precise) {
+  return false;
+}
+bool btm_sec_is_a_bonded_dev(BD_ADDR bda) { return false; }
+tSDP_DISC_REC* SDP_FindServiceInDb(tSDP_DISCOVERY_DB* p_db,
+                                   uint16_t service_uuid,
+                                   tSDP_DISC_REC* p_start_rec) {
+  return NULL;
+}
+bool SDP_InitDiscoveryDb(tSDP_DISCOVERY_DB* p_db, uint32_t len,
+                         uint16_t num_uuid, tSDP_UUID* p_uuid_list,
+                         uint16_t num_attr, uint16_t* p_attr_list) {
+  return false;
+}
+bool SDP_FindServiceUUIDInRec(tSDP_DISC_REC* p_rec, tBT_UUID* p_uuid) {
+  return false;
+}
+bool SDP_FindProtocolListElemInRec(tSDP_DISC_REC* p_rec, uint16_t layer_uuid,
+                                   tSDP_PROTOCOL_ELEM* p_elem) {
+  return false;
+}
+bool SDP_ServiceSearchAttributeRequest2(uint8_t* p_bd_addr,
+                                        tSDP_DISCOVERY_DB* p_db,
+                                        tSDP_DISC_CMPL_CB2* p_cb2,
+                                        void* user_data) {
+  return false;
+}
+
+// Runs |req| against |server_db|, one response of at most |mtu| octets at a
+// time, like the GATT client would.
+static void run_disc_req(const test_disc_req_t& req, uint16_t mtu) {
+  if (req.type == GATT_DISC_SRVC_ALL) {
+    for (const test_attr_t& attr : server_db) {
+      if (attr.kind != test_attr_t::SERVICE) continue;
+      tGATT_DISC_RES res;
+      memset(&res, 0, sizeof(res));
+      res.handle = attr.handle;
+      res.value.group_value.e_handle = attr.end_or_value_handle;
+      res.value.group_value.service_type.len = LEN_UUID_16;
+      res.value.group_value.service_type.uu.uuid16 = attr.uuid;
+      bta_gattc_disc_res_cback(TEST_CONN_ID, req.type, &res);
+    }
+  } else if (req.type == GATT_DISC_CHAR || req.type == GATT_DISC_CHAR_DSCPT) {
+    /* 7 octet declarations or 4 octet handle/UUID pairs per response */
+    size_t per_rsp =
+        (req.type == GATT_DISC_CHAR) ? (mtu - 2) / 7 : (mtu - 2) / 4;
+    uint16_t s_handle = req.s_handle;
+
+    while (s_handle <= req.e_handle) {
+      std::vector<test_attr_t> rsp;
+      for (const test_attr_t& attr : server_db) {
+        if (attr.handle < s_handle || attr.handle > req.e_handle) continue;
+        if (req.type == GATT_DISC_CHAR && attr.kind != test_attr_t::CHAR_DECL)
+          continue;
+        if (rsp.size() < per_rsp) rsp.push_back(attr);
+      }
+      if (rsp.empty()) break;
+
+      for (const test_attr_t& attr : rsp) {
+        tGATT_DISC_RES res;
+        memset(&res, 0, sizeof(res));
+        res.handle = attr.handle;
+        res.type.len = LEN_UUID_16;
+        res.type.uu.uuid16 = attr.uuid;
+        if (req.type == GATT_DISC_CHAR) {
+          res.value.dclr_value.val_handle = attr.end_or_value_handle;
+          res.value.dclr_value.char_uuid.len = LEN_UUID_16;
+          res.value.dclr_value.char_uuid.uu.uuid16 = attr.uuid;
+          res.value.dclr_value.char_prop = GATT_CHAR_PROP_BIT_READ;
+        }
+        bta_gattc_disc_res_cback(TEST_CONN_ID, req.type, &res);
+      }
+      s_handle = rsp.back().handle + 1;
+    }
+  }
+  bta_gattc_disc_cmpl_cback(TEST_CONN_ID, req.type, GATT_SUCCESS);
+}
+
+class BtaGattcCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    server_db.clear();
+    disc_reqs.clear();
+    memset(&srvc_cb, 0, sizeof(srvc_cb));
+    memset(&clcb, 0, sizeof(clcb));
+    clcb.state = BTA_GATTC_DISCOVER_ST;
+    clcb.p_srcb = &srvc_cb;
+    clcb.transport = BTA_TRANSPORT_LE;
+    discovery_done = false;
+    next_handle = 1;
+    RemoveCacheFiles();
+  }
+
+  void TearDown() override {
+    list_free(srvc_cb.p_srvc_cache);
+    osi_free(srvc_cb.p_srvc_list);
+    RemoveCacheFiles();
+  }
+
+  // Starts over with an empty server database.
+  void ClearServer() {
+    server_db.clear();
+    disc_reqs_done.clear();
+    next_handle = 1;
+  }
+
+  // Adds a service to the server; the characteristics added next are in it.
+  void AddService(uint16_t uuid) {
+    server_db.push_back({next_handle++, test_attr_t::SERVICE, uuid, 0});
+    service_idx = server_db.size() - 1;
+    server_db[service_idx].end_or_value_handle = next_handle - 1;
+  }
+
+  // Adds a characteristic with |num_dscr| descriptors to the last service.
+  void AddCharacteristic(uint16_t uuid, int num_dscr) {
+    uint16_t decl_handle = next_handle++;
+    uint16_t value_handle = next_handle++;
+    server_db.push_back(
+        {decl_handle, test_attr_t::CHAR_DECL, uuid, value_handle});
+    server_db.push_back({value_handle, test_attr_t::CHAR_VALUE, uuid, 0});
+    for (int i = 0; i < num_dscr; i++)
+      server_db.push_back({next_handle++, test_attr_t::DESCRIPTOR,
+                           (uint16_t)(GATT_UUID_CHAR_DESCRIPTION + i), 0});
+    server_db[service_idx].end_or_value_handle = next_handle - 1;
+  }
+
+  // Adds a battery service, with 2 descriptors on its first characteristic.
+  void AddBatteryService() {
+    AddService(UUID_SERVCLASS_BATTERY);
+    AddCharacteristic(0x2a19, 2);
+    AddCharacteristic(0x2a1a, 0);
+  }
+
+  // Adds a device information service, with one descriptor.
+  void AddDeviceInfoService() {
+    AddService(UUID_SERVCLASS_DEVICE_INFO);
+    AddCharacteristic(0x2a29, 1);
+    AddCharacteristic(0x2a24, 0);
+  }
+
+  // Discovers the whole server database at |mtu|.
+  void Discover(uint16_t mtu) {
+    srvc_cb.mtu = mtu;
+    ASSERT_EQ(BTA_GATT_OK, bta_gattc_init_cache(&srvc_cb));
+    bta_gattc_discover_procedure(TEST_CONN_ID, &srvc_cb, GATT_DISC_SRVC_ALL);
+    while (!disc_reqs.empty()) {
+      test_disc_req_t req = disc_reqs.front();
+      disc_reqs.pop_front();
+      disc_reqs_done.push_back(req);
+      run_disc_req(req, mtu);
+    }
+    EXPECT_TRUE(discovery_done);
+  }
+
+  // Returns the Find Information procedures the discovery started.
+  std::vector<test_disc_req_t> DescriptorRequests() {
+    std::vector<test_disc_req_t> reqs;
+    for (const test_disc_req_t& req : disc_reqs_done)
+      if (req.type == GATT_DISC_CHAR_DSCPT) reqs.push_back(req);
+    return reqs;
+  }
+
+  // Checks that the cache holds the server database, each descriptor under
+  // the characteristic it follows.
+  void ExpectCacheMatchesServer() {
+    std::vector<test_attr_t> expected;
+    for (const test_attr_t& attr : server_db)
+      if (attr.kind != test_attr_t::CHAR_DECL) expected.push_back(attr);
+
+    size_t i = 0;
+    for (list_node_t* sn = list_begin(srvc_cb.p_srvc_cache);
+         sn != list_end(srvc_cb.p_srvc_cache); sn = list_next(sn)) {
+      tBTA_GATTC_SERVICE* p_srvc = (tBTA_GATTC_SERVICE*)list_node(sn);
+      ASSERT_LT(i, expected.size());
+      EXPECT_EQ(test_attr_t::SERVICE, expected[i].kind);
+      EXPECT_EQ(expected[i].uuid, p_srvc->uuid.uu.uuid16);
+      EXPECT_EQ(expected[i].end_or_value_handle, p_srvc->e_handle);
+      EXPECT_EQ(expected[i++].handle, p_srvc->s_handle);
+
+      for (list_node_t* cn = list_begin(p_srvc->characteristics);
+           cn != list_end(p_srvc->characteristics); cn = list_next(cn)) {
+        tBTA_GATTC_CHARACTERISTIC* p_char =
+            (tBTA_GATTC_CHARACTERISTIC*)list_node(cn);
+        ASSERT_LT(i, expected.size());
+        EXPECT_EQ(test_attr_t::CHAR_VALUE, expected[i].kind);
+        EXPECT_EQ(expected[i].uuid, p_char->uuid.uu.uuid16);
+        EXPECT_EQ(expected[i++].handle, p_char->handle);
+        EXPECT_EQ(GATT_CHAR_PROP_BIT_READ, p_char->properties);
+        EXPECT_EQ(p_srvc, p_char->service);
+
+        for (list_node_t* dn = list_begin(p_char->descriptors);
+             dn != list_end(p_char->descriptors); dn = list_next(dn)) {
+          tBTA_GATTC_DESCRIPTOR* p_dscr = (tBTA_GATTC_DESCRIPTOR*)list_node(dn);
+          ASSERT_LT(i, expected.size());
+          EXPECT_EQ(test_attr_t::DESCRIPTOR, expected[i].kind);
+          EXPECT_EQ(expected[i].uuid, p_dscr->uuid.uu.uuid16);
+          EXPECT_EQ(expected[i++].handle, p_dscr->handle);
+          EXPECT_EQ(p_char, p_dscr->characteristic);
+        }
+      }
+    }
+    EXPECT_EQ(expected.size(), i);
+  }
+
+  // Saves the cache as that of the device |bda|.
+  void Save(BD_ADDR bda) {
+    memcpy(srvc_cb.server_bda, bda, BD_ADDR_LEN);
+    bta_gattc_cache_save(&srvc_cb, TEST_CONN_ID);
+  }
+
+  // Drops the cache and loads that of the device |bda| instead.
+  bool Load(BD_ADDR bda) {
+    list_free(srvc_cb.p_srvc_cache);
+    srvc_cb.p_srvc_cache = NULL;
+    memcpy(srvc_cb.server_bda, bda, BD_ADDR_LEN);
+    return bta_gattc_cache_load(&clcb);
+  }
+
+  std::string CacheFile(BD_ADDR bda) {
+    char fname[255];
+    snprintf(fname, sizeof(fname), "%s%02x%02x%02x%02x%02x%02x",
+             GATT_CACHE_PREFIX, bda[0], bda[1], bda[2], bda[3], bda[4],
+             bda[5]);
+    return fname;
+  }
+
+  // Returns the names of the shared images, i.e. the files starting with
+  // GATT_HASH_PREFIX.
+  std::vector<std::string> HashFiles() {
+    return FilesStartingWith(GATT_HASH_PREFIX);
+  }
+
+  static std::vector<std::string> FilesStartingWith(const std::string& prefix) {
+    std::vector<std::string> files;
+    std::string dir = prefix.substr(0, prefix.rfind('/') + 1);
+    std::string base = prefix.substr(dir.size());
+    DIR* p_dir = opendir(dir.c_str());
+    if (p_dir == NULL) return files;
+    struct dirent* p_ent;
+    while ((p_ent = readdir(p_dir)) != NULL) {
+      if (strncmp(p_ent->d_name, base.c_str(), base.size()) == 0)
+        files.push_back(dir + p_ent->d_name);
+    }
+    closedir(p_dir);
+    return files;
+  }
+
+  static void RemoveCacheFiles() {
+    for (const std::string& fname : FilesStartingWith(GATT_CACHE_PREFIX))
+      unlink(fname.c_str());
+    for (const std::string& fname : FilesStartingWith(GATT_HASH_PREFIX))
+      unlink(fname.c_str());
+  }
+
+  static int LinkCount(const std::string& fname) {
+    struct stat st;
+    if (stat(fname.c_str(), &st) != 0) return 0;
+    return st.st_nlink;
+  }
+
+  static off_t FileSize(const std::string& fname) {
+    struct stat st;
+    if (stat(fname.c_str(), &st) != 0) return -1;
+    return st.st_size;
+  }
+
+  // Flips the low bit of the octet at |pos| in |fname|.
+  static void FlipBit(const std::string& fname, off_t pos) {
+    int fd = open(fname.c_str(), O_RDWR);
+    ASSERT_GE(fd, 0);
+    uint8_t octet;
+    ASSERT_EQ(1, pread(fd, &octet, 1, pos));
+    octet ^= 1;
+    ASSERT_EQ(1, pwrite(fd, &octet, 1, pos));
+    close(fd);
+  }
+
+  uint16_t next_handle;
+  size_t service_idx;
+  std::vector<test_disc_req_t> disc_reqs_done;
+};
+
+TEST_F(BtaGattcCacheTest, sweep_assigns_descriptors_to_their_characteristic) {
+  AddService(UUID_SERVCLASS_BATTERY);
+  AddCharacteristic(0x2a00, 2); /* handles 2 to 5 */
+  AddCharacteristic(0x2a01, 0); /* handles 6 and 7 */
+  AddCharacteristic(0x2a02, 1); /* handles 8 to 10 */
+
+  Discover(GATT_DEF_BLE_MTU_SIZE);
+
+  /* One procedure from after the first value to the end of the service */
+  std::vector<test_disc_req_t> reqs = DescriptorRequests();
+  ASSERT_EQ(1u, reqs.size());
+  EXPECT_EQ(4, reqs[0].s_handle);
+  EXPECT_EQ(10, reqs[0].e_handle);
+  ExpectCacheMatchesServer();
+}
+
+TEST_F(BtaGattcCacheTest, characteristics_without_descriptors_are_not_swept) {
+  AddService(UUID_SERVCLASS_BATTERY);
+  AddCharacteristic(0x2a00, 0);
+  AddCharacteristic(0x2a01, 0);
+  AddCharacteristic(0x2a02, 0);
+  AddService(UUID_SERVCLASS_DEVICE_INFO);
+  AddCharacteristic(0x2a03, 0);
+  AddCharacteristic(0x2a04, 1);
+
+  Discover(GATT_DEF_BLE_MTU_SIZE);
+
+  /* Only the last characteristic has room for descriptors */
+  std::vector<test_disc_req_t> reqs = DescriptorRequests();
+  ASSERT_EQ(1u, reqs.size());
+  EXPECT_EQ(reqs[0].s_handle, reqs[0].e_handle);
+  EXPECT_EQ(next_handle - 1, reqs[0].e_handle);
+  ExpectCacheMatchesServer();
+}
+
+TEST_F(BtaGattcCacheTest, sweep_stops_at_gap) {
+  AddService(UUID_SERVCLASS_BATTERY);
+  AddCharacteristic(0x2a00, 1); /* handles 2 to 4 */
+  AddCharacteristic(0x2a01, 0);
+  AddCharacteristic(0x2a02, 0);
+  AddCharacteristic(0x2a03, 1); /* handles 9 to 11 */
+
+  /* A Find Information response holds 5 handles at the default MTU, fewer
+   * than the 6 declarations and values in the gap */
+  Discover(GATT_DEF_BLE_MTU_SIZE);
+
+  std::vector<test_disc_req_t> reqs = DescriptorRequests();
+  ASSERT_EQ(2u, reqs.size());
+  EXPECT_EQ(4, reqs[0].s_handle);
+  EXPECT_EQ(4, reqs[0].e_handle);
+  EXPECT_EQ(11, reqs[1].s_handle);
+  EXPECT_EQ(11, reqs[1].e_handle);
+  ExpectCacheMatchesServer();
+}
+
+TEST_F(BtaGattcCacheTest, larger_mtu_sweeps_across_gap) {
+  AddService(UUID_SERVCLASS_BATTERY);
+  AddCharacteristic(0x2a00, 1);
+  AddCharacteristic(0x2a01, 0);
+  AddCharacteristic(0x2a02, 0);
+  AddCharacteristic(0x2a03, 1);
+
+  Discover(GATT_MAX_MTU_SIZE);
+
+  std::vector<test_disc_req_t> reqs = DescriptorRequests();
+  ASSERT_EQ(1u, reqs.size());
+  EXPECT_EQ(4, reqs[0].s_handle);
+  EXPECT_EQ(11, reqs[0].e_handle);
+  ExpectCacheMatchesServer();
+}
+
+TEST_F(BtaGattcCacheTest, sweep_spans_several_responses) {
+  AddService(UUID_SERVCLASS_BATTERY);
+  for (uint16_t uuid = 0x2a00; uuid < 0x2a08; uuid++)
+    AddCharacteristic(uuid, uuid % 3);
+  AddService(UUID_SERVCLASS_DEVICE_INFO);
+  for (uint16_t uuid = 0x2a10; uuid < 0x2a14; uuid++)
+    AddCharacteristic(uuid, 2);
+
+  Discover(GATT_DEF_BLE_MTU_SIZE);
+
+  /* Far fewer procedures than characteristics with descriptors */
+  EXPECT_EQ(2u, DescriptorRequests().size());
+  ExpectCacheMatchesServer();
+}
+
+TEST_F(BtaGattcCacheTest, save_and_load_round_trip) {
+  AddBatteryService();
+  AddDeviceInfoService();
+  Discover(GATT_DEF_BLE_MTU_SIZE);
+
+  Save(bda_1);
+  ASSERT_EQ(1u, HashFiles().size());
+  EXPECT_EQ(2, LinkCount(CacheFile(bda_1)));
+
+  ASSERT_TRUE(Load(bda_1));
+  ExpectCacheMatchesServer();
+  EXPECT_FALSE(Load(bda_2));
+}
+
+TEST_F(BtaGattcCacheTest, load_rejects_truncated_cache) {
+  AddBatteryService();
+  Discover(GATT_DEF_BLE_MTU_SIZE);
+  Save(bda_1);
+
+  std::string fname = CacheFile(bda_1);
+  off_t size = FileSize(fname);
+  for (off_t new_size : {size - 1, size / 2, (off_t)8, (off_t)0}) {
+    ASSERT_EQ(0, truncate(fname.c_str(), new_size));
+    EXPECT_FALSE(Load(bda_1)) << "size " << new_size;
+  }
+}
+
+TEST_F(BtaGattcCacheTest, load_rejects_corrupt_cache) {
+  AddBatteryService();
+  Discover(GATT_DEF_BLE_MTU_SIZE);
+  Save(bda_1);
+
+  /* The header starts with the magic number, the version and the number of
+   * services; the last octet is in the tables, covered by the hash */
+  std::string fname = CacheFile(bda_1);
+  for (off_t pos : {(off_t)0, (off_t)4, (off_t)6, FileSize(fname) - 1}) {
+    FlipBit(fname, pos);
+    EXPECT_FALSE(Load(bda_1)) << "octet " << pos;
+    FlipBit(fname, pos);
+    EXPECT_TRUE(Load(bda_1)) << "octet " << pos;
+  }
+  ExpectCacheMatchesServer();
+}
+
+TEST_F(BtaGattcCacheTest, hash_collision_is_not_shared) {
+  AddDeviceInfoService();
+  Discover(GATT_DEF_BLE_MTU_SIZE);
+  Save(bda_2);
+  ASSERT_EQ(1u, HashFiles().size());
+  std::string hash_fname = HashFiles()[0];
+  bta_gattc_cache_reset(bda_2);
+  EXPECT_EQ(0u, HashFiles().size());
+
+  /* Device 1 links to an image named after the hash of device 2's
+   * database, as if the two databases hashed the same */
+  ClearServer();
+  AddBatteryService();
+  Discover(GATT_DEF_BLE_MTU_SIZE);
+  Save(bda_1);
+  ASSERT_EQ(1u, HashFiles().size());
+  ASSERT_EQ(0, rename(HashFiles()[0].c_str(), hash_fname.c_str()));
+
+  /* Device 2 gets an image of its own, device 1 keeps its own */
+  ClearServer();
+  AddDeviceInfoService();
+  Discover(GATT_DEF_BLE_MTU_SIZE);
+  Save(bda_2);
+  EXPECT_EQ(1, LinkCount(CacheFile(bda_1)));
+  EXPECT_EQ(2, LinkCount(CacheFile(bda_2)));
+
+  ASSERT_TRUE(Load(bda_2));
+  ExpectCacheMatchesServer();
+  ClearServer();
+  AddBatteryService();
+  ASSERT_TRUE(Load(bda_1));
+  ExpectCacheMatchesServer();
+}
+
+TEST_F(BtaGattcCacheTest, reset_keeps_image_shared_with_other_device) {
+  AddBatteryService();
+  Discover(GATT_DEF_BLE_MTU_SIZE);
+  Save(bda_1);
+  Save(bda_2);
+
+  ASSERT_EQ(1u, HashFiles().size());
+  std::string hash_fname = HashFiles()[0];
+  EXPECT_EQ(3, LinkCount(hash_fname));
+
+  bta_gattc_cache_reset(bda_1);
+  EXPECT_EQ(0, LinkCount(CacheFile(bda_1)));
+  EXPECT_EQ(2, LinkCount(hash_fname));
+  EXPECT_FALSE(Load(bda_1));
+  ASSERT_TRUE(Load(bda_2));
+  ExpectCacheMatchesServer();
+
+  /* The image goes with the last device linking to it */
+  bta_gattc_cache_reset(bda_2);
+  EXPECT_EQ(0, LinkCount(CacheFile(bda_2)));
+  EXPECT_EQ(0u, HashFiles().size());
+}
+
+TEST_F(BtaGattcCacheTest, saving_new_database_keeps_other_device_link) {
+  AddBatteryService();
+  Discover(GATT_DEF_BLE_MTU_SIZE);
+  Save(bda_1);
+  Save(bda_2);
+
+  ClearServer();
+  AddDeviceInfoService();
+  Discover(GATT_DEF_BLE_MTU_SIZE);
+  Save(bda_1);
+  EXPECT_EQ(2u, HashFiles().size());
+  EXPECT_EQ(2, LinkCount(CacheFile(bda_1)));
+  EXPECT_EQ(2, LinkCount(CacheFile(bda_2)));
+
+  ASSERT_TRUE(Load(bda_1));
+  ExpectCacheMatchesServer();
+  ClearServer();
+  AddBatteryService();
+  ASSERT_TRUE(Load(bda_2));
+  ExpectCacheMatchesServer();
+}
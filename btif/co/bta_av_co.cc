@@ -660,10 +660,12 @@ void bta_av_co_audio_close(tBTA_AV_HNDL hndl) {
  ** Returns          void
  **
  ******************************************************************************/
-void bta_av_co_audio_start(UNUSED_ATTR tBTA_AV_HNDL hndl,
+void bta_av_co_audio_start(tBTA_AV_HNDL hndl,
                            UNUSED_ATTR uint8_t* p_codec_info,
                            UNUSED_ATTR bool* p_no_rtp_hdr) {
-  APPL_TRACE_DEBUG("%s", __func__);
+  APPL_TRACE_DEBUG("%s: handle: 0x%x", __func__, hndl);
+
+  btif_a2dp_source_on_peer_started(hndl);
 }
 
 /*******************************************************************************
@@ -677,8 +679,10 @@ void bta_av_co_audio_start(UNUSED_ATTR tBTA_AV_HNDL hndl,
  ** Returns          void
  **
  ******************************************************************************/
-void bta_av_co_audio_stop(UNUSED_ATTR tBTA_AV_HNDL hndl) {
-  APPL_TRACE_DEBUG("%s", __func__);
+void bta_av_co_audio_stop(tBTA_AV_HNDL hndl) {
+  APPL_TRACE_DEBUG("%s: handle: 0x%x", __func__, hndl);
+
+  btif_a2dp_source_on_peer_stopped(hndl);
 }
 
 /*******************************************************************************
@@ -686,19 +690,21 @@ void bta_av_co_audio_stop(UNUSED_ATTR tBTA_AV_HNDL hndl) {
  ** Function         bta_av_co_audio_src_data_path
  **
  ** Description      This function is called to manage data transfer from
- **                  the audio codec to AVDTP.
+ **                  the audio codec to AVDTP for the stream with handle hndl.
  **
  ** Returns          Pointer to the GKI buffer to send, NULL if no buffer to
  **                  send
  **
  ******************************************************************************/
-void* bta_av_co_audio_src_data_path(const uint8_t* p_codec_info,
+void* bta_av_co_audio_src_data_path(tBTA_AV_HNDL hndl,
+                                    const uint8_t* p_codec_info,
                                     uint32_t* p_timestamp) {
   BT_HDR* p_buf;
 
-  APPL_TRACE_DEBUG("%s: codec: %s", __func__, A2DP_CodecName(p_codec_info));
+  APPL_TRACE_DEBUG("%s: handle: 0x%x codec: %s", __func__, hndl,
+                   A2DP_CodecName(p_codec_info));
 
-  p_buf = btif_a2dp_source_audio_readbuf();
+  p_buf = btif_a2dp_source_audio_readbuf(hndl);
   if (p_buf == NULL) return NULL;
 
   /*
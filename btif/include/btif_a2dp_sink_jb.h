@@ -0,0 +1,173 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2017 Google, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#ifndef BTIF_A2DP_SINK_JB_H
+#define BTIF_A2DP_SINK_JB_H
+
+//
+// Jitter buffer of the A2DP Sink. It holds the received media packets,
+// decodes them in RTP timestamp order into a PCM FIFO, and plays the FIFO
+// out one tick at a time, resampled to make up for the drift between the
+// source and sink clocks. Streams whose timestamps don't count samples are
+// played in arrival order instead.
+//
+// All functions must be called on the same thread.
+//
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "oi_codec_sbc.h"
+#include "osi/include/list.h"
+
+// Audio played per tick, in ms.
+#define BTIF_A2DP_SINK_JB_TICK_MS 20
+
+// Samples per channel played in a tick at the highest SBC sample rate.
+#define BTIF_A2DP_SINK_JB_MAX_TICK_SAMPLES (48 * BTIF_A2DP_SINK_JB_TICK_MS)
+
+// Decoded samples per channel waiting for playout: a tick at the highest
+// rate correction, plus a packet of 15 frames.
+#define BTIF_A2DP_SINK_JB_PCM_FIFO_SAMPLES \
+  (2 * BTIF_A2DP_SINK_JB_MAX_TICK_SAMPLES + 15 * SBC_MAX_SAMPLES_PER_FRAME)
+
+// Buckets of the playout histograms: below 1 ms, then powers of two.
+#define BTIF_A2DP_SINK_JB_HISTOGRAM_BUCKETS 10
+
+// A received media packet, followed by its payload.
+typedef struct {
+  uint16_t num_frames_to_be_processed;
+  uint16_t len;
+  uint16_t offset;
+  uint16_t layer_specific;
+  uint32_t time_stamp;  // RTP timestamp of the first sample
+  uint32_t num_samples; // samples per channel in the SBC frames
+  uint64_t arrival_us;  // time the packet was received
+} tBT_SBC_HDR;
+
+typedef struct {
+  size_t counts[BTIF_A2DP_SINK_JB_HISTOGRAM_BUCKETS];
+} btif_a2dp_sink_histogram_t;
+
+typedef struct {
+  size_t total_packets;       // packets admitted to the jitter buffer
+  size_t late_packets;        // packets that missed their playout time
+  size_t overflow_packets;    // packets dropped because the buffer was full
+  size_t underruns;           // times playout ran out of packets
+  size_t rebuffers;           // underruns that outlasted the target depth
+  uint64_t concealed_samples; // silence played for missing packets
+  btif_a2dp_sink_histogram_t underrun_ms_histogram;
+  btif_a2dp_sink_histogram_t late_ms_histogram;
+  btif_a2dp_sink_histogram_t depth_ms_histogram;
+} btif_a2dp_sink_stats_t;
+
+// What the RTP timestamps of a stream count.
+typedef enum {
+  BTIF_A2DP_SINK_JB_CLOCK_UNKNOWN,  // too few packets seen to tell
+  BTIF_A2DP_SINK_JB_CLOCK_SAMPLES,  // samples: play on the RTP timeline
+  BTIF_A2DP_SINK_JB_CLOCK_ARRIVAL,  // something else: play in arrival order
+} btif_a2dp_sink_jb_clock_t;
+
+// Decodes the SBC frames of |p_msg| into |pcm|, which has room for
+// |max_samples| interleaved stereo samples per channel. Returns the number of
+// samples per channel decoded.
+typedef uint32_t (*btif_a2dp_sink_jb_decode_t)(tBT_SBC_HDR* p_msg,
+                                                int16_t* pcm,
+                                                uint32_t max_samples);
+
+// Jitter buffer and playout state.
+// Packets are played on the RTP timeline: |play_ts| is the timestamp of the
+// first sample in the PCM FIFO, and playout advances it by the samples
+// consumed, whether they were decoded or concealed. In arrival order, the
+// packets are given consecutive timestamps as they are admitted.
+typedef struct {
+  btif_a2dp_sink_jb_decode_t decode;
+  uint32_t sample_rate;
+  list_t* packets;      // admitted packets, oldest first
+  bool playing;         // false while buffering up to the target depth
+  uint32_t play_ts;     // RTP timestamp of the next sample to play
+  uint32_t pcm_len;     // samples per channel in the PCM FIFO
+  uint64_t phase;       // fraction of a sample played, in 1/2^32
+  bool have_last;       // whether the fields below hold a packet
+  uint64_t last_arrival_us;
+  uint32_t last_time_stamp;
+  uint32_t last_rtp_ts;      // as received, for checking the clock
+  uint32_t last_num_samples;
+  btif_a2dp_sink_jb_clock_t clock;
+  uint32_t clock_checks;     // consecutive packet pairs checked
+  uint32_t clock_matches;    // pairs whose timestamps counted samples
+  uint32_t arrival_ts;       // timestamp of the next packet in arrival order
+  int64_t jitter_us;    // smoothed inter-arrival jitter
+  uint32_t target_ms;   // depth to buffer up to and hold
+  int32_t depth_avg_ms; // smoothed depth, for the drift correction
+  int32_t drift_ppm;    // playout rate correction
+  uint32_t underrun_ms; // length of the underrun in progress
+  btif_a2dp_sink_stats_t stats;
+  // Decoded samples, interleaved as the decoder writes them
+  int16_t pcm[BTIF_A2DP_SINK_JB_PCM_FIFO_SAMPLES * SBC_MAX_CHANNELS];
+  // Samples played by the last tick
+  int16_t out[BTIF_A2DP_SINK_JB_MAX_TICK_SAMPLES * SBC_MAX_CHANNELS];
+} btif_a2dp_sink_jb_t;
+
+// Initializes |jb|, which decodes packets with |decode|.
+void btif_a2dp_sink_jb_init(btif_a2dp_sink_jb_t* jb,
+                            btif_a2dp_sink_jb_decode_t decode);
+
+// Frees the packets held by |jb|.
+void btif_a2dp_sink_jb_cleanup(btif_a2dp_sink_jb_t* jb);
+
+// Empties |jb| for a new stream at |sample_rate| Hz, whose timestamp clock is
+// checked again from its first packets.
+void btif_a2dp_sink_jb_start_stream(btif_a2dp_sink_jb_t* jb,
+                                    uint32_t sample_rate);
+
+// Drops the buffered packets and decoded samples, so that playout buffers up
+// to the target depth again from the next packet.
+void btif_a2dp_sink_jb_reset(btif_a2dp_sink_jb_t* jb);
+
+// Returns the samples per channel buffered ahead of the playout point, or
+// ahead of the oldest packet while buffering up.
+int64_t btif_a2dp_sink_jb_depth(const btif_a2dp_sink_jb_t* jb);
+
+// Admits |p_msg|, which |jb| takes ownership of, measures its inter-arrival
+// jitter and sets the target depth from it.
+void btif_a2dp_sink_jb_admit_packet(btif_a2dp_sink_jb_t* jb,
+                                    tBT_SBC_HDR* p_msg);
+
+// Fills the PCM FIFO up to |needed| samples per channel, decoding packets in
+// timestamp order. Gaps between packets are concealed with silence, and
+// samples of late packets that are already past the playout point are
+// dropped. Returns false if the packets ran out, with the rest concealed.
+bool btif_a2dp_sink_jb_fill(btif_a2dp_sink_jb_t* jb, uint32_t needed);
+
+// Returns the playout rate correction, in parts per million, for an average
+// depth of |depth_avg_ms| against a target of |target_ms|.
+int32_t btif_a2dp_sink_jb_drift_ppm(int32_t depth_avg_ms, uint32_t target_ms);
+
+// Resamples |in| to |out_samples| samples per channel of |out| by linear
+// interpolation, stepping through |in| by |step| from |phase|, both in
+// 1/2^32 of a sample. Returns the position in |in| after the last step.
+uint64_t btif_a2dp_sink_jb_resample(const int16_t* in, int16_t* out,
+                                    uint32_t out_samples, uint64_t phase,
+                                    uint64_t step);
+
+// Plays a tick of audio into |jb->out| once the target depth is buffered.
+// Returns the samples per channel played, or 0 if nothing was.
+uint32_t btif_a2dp_sink_jb_tick(btif_a2dp_sink_jb_t* jb);
+
+#endif /* BTIF_A2DP_SINK_JB_H */
@@ -86,9 +86,17 @@ void btif_a2dp_source_on_suspended(tBTA_AV_SUSPEND* p_av_suspend);
 // If |enable| is true, the discarding is enabled, otherwise is disabled.
 void btif_a2dp_source_set_tx_flush(bool enable);
 
-// Get the next A2DP buffer to send.
+// Process a notification that BTA AV started the audio stream with handle
+// |hndl|. From then on, the encoded audio is queued for that stream as well.
+void btif_a2dp_source_on_peer_started(tBTA_AV_HNDL hndl);
+
+// Process a notification that BTA AV stopped the audio stream with handle
+// |hndl|. The encoded audio still queued for that stream is discarded.
+void btif_a2dp_source_on_peer_stopped(tBTA_AV_HNDL hndl);
+
+// Get the next A2DP buffer to send on the audio stream with handle |hndl|.
 // Returns the next A2DP buffer to send if available, otherwise NULL.
-BT_HDR* btif_a2dp_source_audio_readbuf(void);
+BT_HDR* btif_a2dp_source_audio_readbuf(tBTA_AV_HNDL hndl);
 
 // Dump debug-related information for the A2DP Source module.
 // |fd| is the file descriptor to use for writing the ASCII formatted
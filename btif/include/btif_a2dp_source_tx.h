@@ -0,0 +1,94 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2017 Google, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#ifndef BTIF_A2DP_SOURCE_TX_H
+#define BTIF_A2DP_SOURCE_TX_H
+
+//
+// TX queues of the A2DP Source, one per BTA AV audio stream. The audio is
+// encoded once, by the single encoder of the A2DP Source, and every stream
+// BTA AV has started gets its own copy of each packet. A peer whose link
+// falls behind only drops its own audio. Every stream gets the same codec
+// configuration; there are no per-peer encoders.
+//
+// Streams are started, stopped and read on the BTU thread, and the packets
+// are queued and flushed on the A2DP Source worker thread. A stream is
+// flushed before it is marked started, so packets queued once it is started
+// are all new. A stream is marked stopped before it is flushed, so a packet
+// queued while it stops may be left behind; it is flushed when the stream
+// is started again, before BTA AV reads from it.
+//
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "bt_types.h"
+#include "bta_av_api.h"
+
+// Drops reported by |btif_a2dp_source_tx_enqueue|.
+typedef struct {
+  size_t dropouts;      // streams whose queue overflowed and was flushed
+  size_t dropped_n;     // packets flushed from those queues
+  size_t max_dropped_n; // most packets flushed from one queue
+} btif_a2dp_source_tx_drops_t;
+
+// Creates the TX queues, with no stream started.
+void btif_a2dp_source_tx_init(void);
+
+// Frees the TX queues and the packets in them.
+void btif_a2dp_source_tx_cleanup(void);
+
+// Flushes the TX queue of the stream with handle |hndl| and starts queueing
+// packets for it. Returns false if |hndl| is not a valid stream handle.
+bool btif_a2dp_source_tx_start_stream(tBTA_AV_HNDL hndl);
+
+// Stops queueing packets for the stream with handle |hndl| and flushes its
+// TX queue. Returns false if |hndl| is not a valid stream handle.
+bool btif_a2dp_source_tx_stop_stream(tBTA_AV_HNDL hndl);
+
+// Returns true if packets are queued for the stream with handle |hndl|.
+bool btif_a2dp_source_tx_is_streaming(tBTA_AV_HNDL hndl);
+
+// Returns true if no stream with a lower handle than |hndl| is started.
+bool btif_a2dp_source_tx_is_first_stream(tBTA_AV_HNDL hndl);
+
+// Returns the length of the longest TX queue of the started streams, i.e.
+// the backlog of the slowest link.
+size_t btif_a2dp_source_tx_queue_length(void);
+
+// Queues |p_buf|, holding |frames_n| encoded frames, for every started
+// stream, and takes ownership of it. A stream whose queue would exceed
+// |max_frames| is flushed first, which is reported in |p_drops|. Returns
+// false if no stream is started, in which case |p_buf| is freed.
+bool btif_a2dp_source_tx_enqueue(BT_HDR* p_buf, size_t frames_n,
+                                 size_t max_frames,
+                                 btif_a2dp_source_tx_drops_t* p_drops);
+
+// Gets the next packet to send on the stream with handle |hndl|.
+// Returns NULL if there is none.
+BT_HDR* btif_a2dp_source_tx_readbuf(tBTA_AV_HNDL hndl);
+
+// Flushes the TX queues of all streams. Returns the number of packets
+// flushed.
+size_t btif_a2dp_source_tx_flush(void);
+
+// Returns the number of dropouts of the stream with handle |hndl| since
+// |btif_a2dp_source_tx_init| was called.
+size_t btif_a2dp_source_tx_dropouts(tBTA_AV_HNDL hndl);
+
+#endif /* BTIF_A2DP_SOURCE_TX_H */
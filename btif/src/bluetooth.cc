@@ -56,9 +56,12 @@
 #include "device/include/controller.h"
 #include "btif_debug.h"
 #include "btif_storage.h"
+#include "btm_ble_api.h"
 #include "btsnoop.h"
 #include "btsnoop_mem.h"
+#include "btu.h"
 #include "device/include/interop.h"
+#include "l2c_api.h"
 #include "osi/include/alarm.h"
 #include "osi/include/allocation_tracker.h"
 #include "osi/include/log.h"
@@ -322,6 +325,9 @@ static void dump(int fd, const char** arguments) {
   wakelock_debug_dump(fd);
   osi_allocator_debug_dump(fd);
   alarm_debug_dump(fd);
+  btu_debug_dump(fd);
+  L2CA_DebugDump(fd);
+  BTM_BleDebugDump(fd);
 #if (BTSNOOP_MEM == TRUE)
   btif_debug_btsnoop_dump(fd);
 #endif
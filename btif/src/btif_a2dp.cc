@@ -31,6 +31,7 @@
 #include "btif_av.h"
 #include "btif_util.h"
 #include "osi/include/log.h"
+#include "uipc.h"
 
 void btif_a2dp_on_idle(void) {
   APPL_TRACE_EVENT("## ON A2DP IDLE ## peer_sep = %d", btif_av_get_peer_sep());
@@ -120,4 +121,5 @@ void btif_a2dp_on_offload_started(tBTA_AV_STATUS status) {
 void btif_debug_a2dp_dump(int fd) {
   btif_a2dp_source_debug_dump(fd);
   btif_a2dp_sink_debug_dump(fd);
+  UIPC_DebugDump(fd);
 }
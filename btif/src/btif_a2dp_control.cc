@@ -53,6 +53,16 @@ void btif_a2dp_control_cleanup(void) {
   UIPC_Close(UIPC_CH_ID_ALL);
 }
 
+/* Offers the audio HAL a shared-memory ring for the PCM data when we are the
+ * source and the ring is enabled; otherwise the data socket is used. */
+static void btif_a2dp_control_set_audio_ring(void) {
+  size_t size = 0;
+  if (btif_av_get_peer_sep() == AVDT_TSEP_SNK &&
+      audio_a2dp_hw_shm_ring_enabled())
+    size = AUDIO_STREAM_OUTPUT_BUFFER_SZ;
+  UIPC_Ioctl(UIPC_CH_ID_AV_AUDIO, UIPC_SET_SHM_RING, (void*)(uintptr_t)size);
+}
+
 static void btif_a2dp_recv_ctrl_data(void) {
   tA2DP_CTRL_CMD cmd = A2DP_CTRL_CMD_NONE;
   int n;
@@ -110,6 +120,7 @@ static void btif_a2dp_recv_ctrl_data(void) {
 
       if (btif_av_stream_ready()) {
         /* Setup audio data channel listener */
+        btif_a2dp_control_set_audio_ring();
         UIPC_Open(UIPC_CH_ID_AV_AUDIO, btif_a2dp_data_cb);
 
         /*
@@ -128,6 +139,7 @@ static void btif_a2dp_recv_ctrl_data(void) {
          * Already started, setup audio data channel listener and ACK
          * back immediately.
          */
+        btif_a2dp_control_set_audio_ring();
         UIPC_Open(UIPC_CH_ID_AV_AUDIO, btif_a2dp_data_cb);
         btif_a2dp_command_ack(A2DP_CTRL_ACK_SUCCESS);
         break;
@@ -24,14 +24,17 @@
 #include "bt_common.h"
 #include "btif_a2dp.h"
 #include "btif_a2dp_sink.h"
+#include "btif_a2dp_sink_jb.h"
 #include "btif_av.h"
 #include "btif_av_co.h"
 #include "btif_avrcp_audio_track.h"
 #include "btif_util.h"
 #include "osi/include/fixed_queue.h"
+#include "osi/include/list.h"
 #include "osi/include/log.h"
 #include "osi/include/osi.h"
 #include "osi/include/thread.h"
+#include "osi/include/time.h"
 
 #include "oi_codec_sbc.h"
 #include "oi_status.h"
@@ -41,10 +44,7 @@
  */
 #define MAX_INPUT_A2DP_FRAME_QUEUE_SZ (MAX_PCM_FRAME_NUM_PER_TICK * 2)
 
-#define BTIF_SINK_MEDIA_TIME_TICK_MS 20
-
-/* In case of A2DP Sink, we will delay start by 5 AVDTP Packets */
-#define MAX_A2DP_DELAYED_START_FRAME_COUNT 5
+#define BTIF_SINK_MEDIA_TIME_TICK_MS BTIF_A2DP_SINK_JB_TICK_MS
 
 enum {
   BTIF_A2DP_SINK_STATE_OFF,
@@ -71,13 +71,6 @@ typedef struct {
   btif_a2dp_sink_focus_state_t focus_state;
 } tBTIF_MEDIA_SINK_FOCUS_UPDATE;
 
-typedef struct {
-  uint16_t num_frames_to_be_processed;
-  uint16_t len;
-  uint16_t offset;
-  uint16_t layer_specific;
-} tBT_SBC_HDR;
-
 /* BTIF A2DP Sink control block */
 typedef struct {
   thread_t* worker_thread;
@@ -85,7 +78,7 @@ typedef struct {
   fixed_queue_t* rx_audio_queue;
   bool rx_flush; /* discards any incoming data when true */
   alarm_t* decode_alarm;
-  uint8_t frames_to_process;
+  btif_a2dp_sink_jb_t jb;
   tA2DP_SAMPLE_RATE sample_rate;
   tA2DP_CHANNEL_COUNT channel_count;
   btif_a2dp_sink_focus_state_t rx_focus_state; /* audio focus state */
@@ -99,8 +92,6 @@ static int btif_a2dp_sink_state = BTIF_A2DP_SINK_STATE_OFF;
 static OI_CODEC_SBC_DECODER_CONTEXT btif_a2dp_sink_context;
 static uint32_t btif_a2dp_sink_context_data[CODEC_DATA_WORDS(
     2, SBC_CODEC_FAST_FILTER_BUFFERS)];
-static int16_t
-    btif_a2dp_sink_pcm_data[15 * SBC_MAX_SAMPLES_PER_FRAME * SBC_MAX_CHANNELS];
 
 static void btif_a2dp_sink_startup_delayed(void* context);
 static void btif_a2dp_sink_shutdown_delayed(void* context);
@@ -110,8 +101,9 @@ static void btif_decode_alarm_cb(void* context);
 static void btif_a2dp_sink_audio_handle_start_decoding(void);
 static void btif_a2dp_sink_avk_handle_timer(UNUSED_ATTR void* context);
 static void btif_a2dp_sink_audio_rx_flush_req(void);
-/* Handle incoming media packets A2DP SINK streaming */
-static void btif_a2dp_sink_handle_inc_media(tBT_SBC_HDR* p_msg);
+static uint32_t btif_a2dp_sink_handle_inc_media(tBT_SBC_HDR* p_msg,
+                                                int16_t* pcm,
+                                                uint32_t max_samples);
 static void btif_a2dp_sink_decoder_update_event(
     tBTIF_MEDIA_SINK_DECODER_UPDATE* p_buf);
 static void btif_a2dp_sink_clear_track_event(void);
@@ -154,6 +146,8 @@ bool btif_a2dp_sink_startup(void) {
   btif_a2dp_sink_cb.rx_focus_state = BTIF_A2DP_SINK_FOCUS_NOT_GRANTED;
   btif_a2dp_sink_cb.audio_track = NULL;
   btif_a2dp_sink_cb.rx_audio_queue = fixed_queue_new(SIZE_MAX);
+  btif_a2dp_sink_jb_init(&btif_a2dp_sink_cb.jb,
+                         btif_a2dp_sink_handle_inc_media);
 
   btif_a2dp_sink_cb.cmd_msg_queue = fixed_queue_new(SIZE_MAX);
   fixed_queue_register_dequeue(
@@ -202,6 +196,7 @@ void btif_a2dp_sink_shutdown(void) {
 static void btif_a2dp_sink_shutdown_delayed(UNUSED_ATTR void* context) {
   fixed_queue_free(btif_a2dp_sink_cb.rx_audio_queue, NULL);
   btif_a2dp_sink_cb.rx_audio_queue = NULL;
+  btif_a2dp_sink_jb_cleanup(&btif_a2dp_sink_cb.jb);
 
   btif_a2dp_sink_state = BTIF_A2DP_SINK_STATE_OFF;
 }
@@ -327,22 +322,20 @@ static void btif_a2dp_sink_audio_handle_start_decoding(void) {
             btif_decode_alarm_cb, NULL);
 }
 
-static void btif_a2dp_sink_handle_inc_media(tBT_SBC_HDR* p_msg) {
+/* Decodes all SBC frames of |p_msg| into |pcm|, and returns the number of
+ * samples per channel decoded. */
+static uint32_t btif_a2dp_sink_handle_inc_media(tBT_SBC_HDR* p_msg,
+                                                int16_t* pcm,
+                                                uint32_t max_samples) {
   uint8_t* sbc_start_frame = ((uint8_t*)(p_msg + 1) + p_msg->offset + 1);
   int count;
   uint32_t pcmBytes, availPcmBytes;
-  int16_t* pcmDataPointer =
-      btif_a2dp_sink_pcm_data; /* Will be overwritten on next packet receipt */
+  int16_t* pcmDataPointer = pcm;
   OI_STATUS status;
   int num_sbc_frames = p_msg->num_frames_to_be_processed;
   uint32_t sbc_frame_len = p_msg->len - 1;
-  availPcmBytes = sizeof(btif_a2dp_sink_pcm_data);
-
-  if ((btif_av_get_peer_sep() == AVDT_TSEP_SNK) ||
-      (btif_a2dp_sink_cb.rx_flush)) {
-    APPL_TRACE_DEBUG("State Changed happened in this tick");
-    return;
-  }
+  availPcmBytes = max_samples * 2 * sizeof(pcm[0]);
+  const uint32_t startPcmBytes = availPcmBytes;
 
   APPL_TRACE_DEBUG("%s Number of SBC frames %d, frame_len %d", __func__,
                    num_sbc_frames, sbc_frame_len);
@@ -363,19 +356,27 @@ static void btif_a2dp_sink_handle_inc_media(tBT_SBC_HDR* p_msg) {
     p_msg->len = sbc_frame_len + 1;
   }
 
-#ifndef OS_GENERIC
-  BtifAvrcpAudioTrackWriteData(
-      btif_a2dp_sink_cb.audio_track, (void*)btif_a2dp_sink_pcm_data,
-      (sizeof(btif_a2dp_sink_pcm_data) - availPcmBytes));
-#endif
+  return (startPcmBytes - availPcmBytes) / (2 * sizeof(pcm[0]));
+}
+
+// Returns the number of samples per channel in the SBC frames of an A2DP
+// media payload, from the payload header and the first frame header.
+static uint32_t btif_a2dp_sink_payload_samples(const uint8_t* p_payload,
+                                               uint16_t len) {
+  if (len < 3 || p_payload[1] != 0x9C) return 0;  // SBC syncword
+
+  uint32_t num_frames = p_payload[0] & 0x0f;
+  uint32_t blocks = 4 * (((p_payload[2] >> 4) & 0x03) + 1);
+  uint32_t subbands = (p_payload[2] & 0x01) ? 8 : 4;
+  return num_frames * blocks * subbands;
 }
 
 static void btif_a2dp_sink_avk_handle_timer(UNUSED_ATTR void* context) {
+  btif_a2dp_sink_jb_t* jb = &btif_a2dp_sink_cb.jb;
   tBT_SBC_HDR* p_msg;
-  int num_sbc_frames;
-  int num_frames_to_process;
 
-  if (fixed_queue_is_empty(btif_a2dp_sink_cb.rx_audio_queue)) {
+  if (fixed_queue_is_empty(btif_a2dp_sink_cb.rx_audio_queue) &&
+      list_is_empty(jb->packets) && !jb->playing) {
     APPL_TRACE_DEBUG("%s: empty queue", __func__);
     return;
   }
@@ -387,49 +388,25 @@ static void btif_a2dp_sink_avk_handle_timer(UNUSED_ATTR void* context) {
     return;
   }
   /* Play only in BTIF_A2DP_SINK_FOCUS_GRANTED case */
-  if (btif_a2dp_sink_cb.rx_flush) {
+  if (btif_a2dp_sink_cb.rx_flush ||
+      btif_av_get_peer_sep() == AVDT_TSEP_SNK) {
     fixed_queue_flush(btif_a2dp_sink_cb.rx_audio_queue, osi_free);
+    btif_a2dp_sink_jb_reset(jb);
     return;
   }
+  if (btif_a2dp_sink_cb.sample_rate == 0) return;
 
-  num_frames_to_process = btif_a2dp_sink_cb.frames_to_process;
-  APPL_TRACE_DEBUG(" Process Frames + ");
-
-  do {
-    p_msg = (tBT_SBC_HDR*)fixed_queue_try_peek_first(
-        btif_a2dp_sink_cb.rx_audio_queue);
-    if (p_msg == NULL) return;
-    /* Number of frames in queue packets */
-    num_sbc_frames = p_msg->num_frames_to_be_processed;
-    APPL_TRACE_DEBUG("Frames left in topmost packet %d", num_sbc_frames);
-    APPL_TRACE_DEBUG("Remaining frames to process in tick %d",
-                     num_frames_to_process);
-    APPL_TRACE_DEBUG("Number of packets in queue %d",
-                     fixed_queue_length(btif_a2dp_sink_cb.rx_audio_queue));
-
-    if (num_sbc_frames > num_frames_to_process) {
-      /* Queue packet has more frames */
-      p_msg->num_frames_to_be_processed = num_frames_to_process;
-      btif_a2dp_sink_handle_inc_media(p_msg);
-      p_msg->num_frames_to_be_processed =
-          num_sbc_frames - num_frames_to_process;
-      num_frames_to_process = 0;
-      break;
-    }
-    /* Queue packet has less frames */
-    btif_a2dp_sink_handle_inc_media(p_msg);
-    p_msg =
-        (tBT_SBC_HDR*)fixed_queue_try_dequeue(btif_a2dp_sink_cb.rx_audio_queue);
-    if (p_msg == NULL) {
-      APPL_TRACE_ERROR("Insufficient data in queue");
-      break;
-    }
-    num_frames_to_process =
-        num_frames_to_process - p_msg->num_frames_to_be_processed;
-    osi_free(p_msg);
-  } while (num_frames_to_process > 0);
+  while ((p_msg = (tBT_SBC_HDR*)fixed_queue_try_dequeue(
+              btif_a2dp_sink_cb.rx_audio_queue)) != NULL)
+    btif_a2dp_sink_jb_admit_packet(jb, p_msg);
 
-  APPL_TRACE_DEBUG("Process Frames - ");
+  uint32_t out_samples = btif_a2dp_sink_jb_tick(jb);
+  if (out_samples == 0) return;
+
+#ifndef OS_GENERIC
+  BtifAvrcpAudioTrackWriteData(btif_a2dp_sink_cb.audio_track, (void*)jb->out,
+                               out_samples * 2 * sizeof(jb->out[0]));
+#endif
 }
 
 /* when true media task discards any rx frames */
@@ -443,6 +420,8 @@ static void btif_a2dp_sink_audio_rx_flush_event(void) {
   APPL_TRACE_DEBUG("%s", __func__);
 
   fixed_queue_flush(btif_a2dp_sink_cb.rx_audio_queue, osi_free);
+  btif_a2dp_sink_jb_start_stream(&btif_a2dp_sink_cb.jb,
+                                 btif_a2dp_sink_cb.sample_rate);
 }
 
 static void btif_a2dp_sink_decoder_update_event(
@@ -471,6 +450,7 @@ static void btif_a2dp_sink_decoder_update_event(
   }
   btif_a2dp_sink_cb.sample_rate = sample_rate;
   btif_a2dp_sink_cb.channel_count = channel_count;
+  btif_a2dp_sink_jb_start_stream(&btif_a2dp_sink_cb.jb, sample_rate);
 
   btif_a2dp_sink_cb.rx_flush = false;
   APPL_TRACE_DEBUG("%s: Reset to Sink role", __func__);
@@ -493,18 +473,9 @@ static void btif_a2dp_sink_decoder_update_event(
     APPL_TRACE_ERROR("%s: A2dpSink: Track creation failed", __func__);
     return;
   }
-
-  btif_a2dp_sink_cb.frames_to_process = A2DP_GetSinkFramesCountToProcess(
-      BTIF_SINK_MEDIA_TIME_TICK_MS, p_buf->codec_info);
-  APPL_TRACE_DEBUG("%s: Frames to be processed in 20 ms %d", __func__,
-                   btif_a2dp_sink_cb.frames_to_process);
-  if (btif_a2dp_sink_cb.frames_to_process == 0) {
-    APPL_TRACE_ERROR("%s: Cannot compute the number of frames to process",
-                     __func__);
-  }
 }
 
-uint8_t btif_a2dp_sink_enqueue_buf(BT_HDR* p_pkt) {
+uint8_t btif_a2dp_sink_enqueue_buf(BT_HDR* p_pkt, uint32_t time_stamp) {
   if (btif_a2dp_sink_cb.rx_flush) /* Flush enabled, do not enqueue */
     return fixed_queue_length(btif_a2dp_sink_cb.rx_audio_queue);
 
@@ -526,11 +497,15 @@ uint8_t btif_a2dp_sink_enqueue_buf(BT_HDR* p_pkt) {
   p_msg->len = p_pkt->len;
   p_msg->offset = 0;
   p_msg->layer_specific = p_pkt->layer_specific;
+  p_msg->time_stamp = time_stamp;
+  p_msg->num_samples =
+      btif_a2dp_sink_payload_samples((uint8_t*)(p_msg + 1), p_msg->len);
+  p_msg->arrival_us = time_get_os_boottime_us();
   BTIF_TRACE_VERBOSE("%s: frames to process %d, len %d", __func__,
                      p_msg->num_frames_to_be_processed, p_msg->len);
   fixed_queue_enqueue(btif_a2dp_sink_cb.rx_audio_queue, p_msg);
-  if (fixed_queue_length(btif_a2dp_sink_cb.rx_audio_queue) ==
-      MAX_A2DP_DELAYED_START_FRAME_COUNT) {
+  /* The decode tick buffers up to the jitter buffer target before playing */
+  if (btif_a2dp_sink_cb.decode_alarm == NULL) {
     BTIF_TRACE_DEBUG("%s: Initiate decoding", __func__);
     btif_a2dp_sink_audio_handle_start_decoding();
   }
@@ -539,18 +514,66 @@ uint8_t btif_a2dp_sink_enqueue_buf(BT_HDR* p_pkt) {
 }
 
 void btif_a2dp_sink_audio_rx_flush_req(void) {
-  if (fixed_queue_is_empty(btif_a2dp_sink_cb.rx_audio_queue)) {
-    /* Queue is already empty */
-    return;
-  }
-
+  /* The jitter buffer may hold packets even if the queue is empty */
   BT_HDR* p_buf = reinterpret_cast<BT_HDR*>(osi_malloc(sizeof(BT_HDR)));
   p_buf->event = BTIF_MEDIA_SINK_AUDIO_RX_FLUSH;
   fixed_queue_enqueue(btif_a2dp_sink_cb.cmd_msg_queue, p_buf);
 }
 
-void btif_a2dp_sink_debug_dump(UNUSED_ATTR int fd) {
-  // Nothing to do
+static void btif_a2dp_sink_dump_histogram(
+    int fd, const char* name, const btif_a2dp_sink_histogram_t* hist) {
+  dprintf(fd, "  %-56s:", name);
+  for (size_t i = 0; i < BTIF_A2DP_SINK_JB_HISTOGRAM_BUCKETS; i++) {
+    if (i == 0)
+      dprintf(fd, " <1:%zu", hist->counts[i]);
+    else if (i == BTIF_A2DP_SINK_JB_HISTOGRAM_BUCKETS - 1)
+      dprintf(fd, " %u+:%zu", 1u << (i - 1), hist->counts[i]);
+    else
+      dprintf(fd, " %u-%u:%zu", 1u << (i - 1), 1u << i, hist->counts[i]);
+  }
+  dprintf(fd, "\n");
+}
+
+void btif_a2dp_sink_debug_dump(int fd) {
+  const btif_a2dp_sink_jb_t* jb = &btif_a2dp_sink_cb.jb;
+  const btif_a2dp_sink_stats_t* stats = &jb->stats;
+
+  dprintf(fd, "\nA2DP Sink State:\n");
+  dprintf(fd, "  Jitter buffer:\n");
+
+  dprintf(fd,
+          "  Depth in ms (target/average)                            : %u / "
+          "%d\n",
+          jb->target_ms, jb->depth_avg_ms);
+
+  dprintf(fd,
+          "  Inter-arrival jitter in us                              : %lld\n",
+          (long long)jb->jitter_us);
+
+  dprintf(fd,
+          "  Clock drift correction in ppm                           : %d\n",
+          jb->drift_ppm);
+
+  dprintf(fd,
+          "  Counts (packets/late/overflow)                          : %zu / "
+          "%zu / %zu\n",
+          stats->total_packets, stats->late_packets, stats->overflow_packets);
+
+  dprintf(fd,
+          "  Counts (underruns/rebuffers)                            : %zu / "
+          "%zu\n",
+          stats->underruns, stats->rebuffers);
+
+  dprintf(fd,
+          "  Concealed samples                                       : %llu\n",
+          (unsigned long long)stats->concealed_samples);
+
+  btif_a2dp_sink_dump_histogram(fd, "Underrun length in ms",
+                                &stats->underrun_ms_histogram);
+  btif_a2dp_sink_dump_histogram(fd, "Late packet lateness in ms",
+                                &stats->late_ms_histogram);
+  btif_a2dp_sink_dump_histogram(fd, "Depth per tick in ms",
+                                &stats->depth_ms_histogram);
 }
 
 void btif_a2dp_sink_set_focus_state_req(btif_a2dp_sink_focus_state_t state) {
@@ -572,6 +595,7 @@ static void btif_a2dp_sink_set_focus_state_event(
   btif_a2dp_sink_cb.rx_focus_state = state;
   if (btif_a2dp_sink_cb.rx_focus_state == BTIF_A2DP_SINK_FOCUS_NOT_GRANTED) {
     fixed_queue_flush(btif_a2dp_sink_cb.rx_audio_queue, osi_free);
+    btif_a2dp_sink_jb_reset(&btif_a2dp_sink_cb.jb);
     btif_a2dp_sink_cb.rx_flush = true;
   } else if (btif_a2dp_sink_cb.rx_focus_state == BTIF_A2DP_SINK_FOCUS_GRANTED) {
     btif_a2dp_sink_cb.rx_flush = false;
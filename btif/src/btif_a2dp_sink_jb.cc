@@ -0,0 +1,364 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2017 Google, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#define LOG_TAG "bt_btif_a2dp_sink_jb"
+
+#include "btif_a2dp_sink_jb.h"
+
+#include <string.h>
+
+#include "bt_common.h"
+#include "osi/include/allocator.h"
+#include "osi/include/log.h"
+
+/* Bounds of the jitter buffer target depth, in ms */
+#define BTIF_A2DP_SINK_MIN_TARGET_DEPTH_MS (2 * BTIF_A2DP_SINK_JB_TICK_MS)
+#define BTIF_A2DP_SINK_MAX_TARGET_DEPTH_MS 300
+
+/* The target depth covers this many times the inter-arrival jitter */
+#define BTIF_A2DP_SINK_JITTER_MULTIPLIER 4
+
+/* Packets beyond twice the target depth and this slack are dropped, oldest
+ * first, rather than played late; in ms */
+#define BTIF_A2DP_SINK_OVERFLOW_SLACK_MS (2 * BTIF_A2DP_SINK_JB_TICK_MS)
+
+/* Playout rate correction per ms of depth off the target, and its bound, in
+ * parts per million. It absorbs the drift between the source and sink
+ * clocks. */
+#define BTIF_A2DP_SINK_DRIFT_PPM_PER_MS 20
+#define BTIF_A2DP_SINK_MAX_DRIFT_PPM 2000
+
+/* Consecutive packet pairs checked before trusting the timestamps to count
+ * samples, and how many of them must. Lost packets still count, as the
+ * timestamp then advances by a few packets' worth of samples. */
+#define BTIF_A2DP_SINK_CLOCK_CHECKS 4
+#define BTIF_A2DP_SINK_CLOCK_MIN_MATCHES 3
+#define BTIF_A2DP_SINK_CLOCK_MAX_LOST 3
+
+static uint32_t btif_a2dp_sink_jb_samples_to_ms(const btif_a2dp_sink_jb_t* jb,
+                                                int64_t num_samples) {
+  if (num_samples <= 0 || jb->sample_rate == 0) return 0;
+  return (uint32_t)(num_samples * 1000 / jb->sample_rate);
+}
+
+static void btif_a2dp_sink_histogram_add(btif_a2dp_sink_histogram_t* hist,
+                                         uint32_t value_ms) {
+  size_t bucket = 0;
+  while (value_ms != 0 && bucket < BTIF_A2DP_SINK_JB_HISTOGRAM_BUCKETS - 1) {
+    value_ms >>= 1;
+    bucket++;
+  }
+  hist->counts[bucket]++;
+}
+
+void btif_a2dp_sink_jb_init(btif_a2dp_sink_jb_t* jb,
+                            btif_a2dp_sink_jb_decode_t decode) {
+  memset(jb, 0, sizeof(*jb));
+  jb->decode = decode;
+  jb->packets = list_new(osi_free);
+}
+
+void btif_a2dp_sink_jb_cleanup(btif_a2dp_sink_jb_t* jb) {
+  list_free(jb->packets);
+  jb->packets = NULL;
+}
+
+void btif_a2dp_sink_jb_start_stream(btif_a2dp_sink_jb_t* jb,
+                                    uint32_t sample_rate) {
+  btif_a2dp_sink_jb_reset(jb);
+  jb->sample_rate = sample_rate;
+  jb->clock = BTIF_A2DP_SINK_JB_CLOCK_UNKNOWN;
+  jb->clock_checks = 0;
+  jb->clock_matches = 0;
+}
+
+void btif_a2dp_sink_jb_reset(btif_a2dp_sink_jb_t* jb) {
+  if (jb->packets != NULL) list_clear(jb->packets);
+  jb->playing = false;
+  jb->pcm_len = 0;
+  jb->phase = 0;
+  jb->have_last = false;
+  jb->depth_avg_ms = 0;
+  jb->drift_ppm = 0;
+  jb->underrun_ms = 0;
+}
+
+int64_t btif_a2dp_sink_jb_depth(const btif_a2dp_sink_jb_t* jb) {
+  if (list_is_empty(jb->packets)) return jb->playing ? jb->pcm_len : 0;
+
+  tBT_SBC_HDR* p_front = (tBT_SBC_HDR*)list_front(jb->packets);
+  tBT_SBC_HDR* p_back = (tBT_SBC_HDR*)list_back(jb->packets);
+  uint32_t start_ts = jb->playing ? jb->play_ts : p_front->time_stamp;
+  int64_t depth =
+      (int32_t)(p_back->time_stamp + p_back->num_samples - start_ts);
+  return (depth > (int64_t)jb->pcm_len) ? depth : jb->pcm_len;
+}
+
+// Checks whether the timestamp of |p_msg| advanced from the previous packet
+// by the samples that packet holds, and settles the stream clock once
+// enough packets were checked. Going to arrival order, the packets already
+// admitted are given consecutive timestamps from the oldest one.
+static void btif_a2dp_sink_jb_check_clock(btif_a2dp_sink_jb_t* jb,
+                                          const tBT_SBC_HDR* p_msg) {
+  if (jb->clock != BTIF_A2DP_SINK_JB_CLOCK_UNKNOWN || !jb->have_last) return;
+
+  int32_t delta = (int32_t)(p_msg->time_stamp - jb->last_rtp_ts);
+  if (jb->last_num_samples != 0 && delta > 0 &&
+      delta % jb->last_num_samples == 0 &&
+      delta / jb->last_num_samples <= 1 + BTIF_A2DP_SINK_CLOCK_MAX_LOST)
+    jb->clock_matches++;
+  if (++jb->clock_checks < BTIF_A2DP_SINK_CLOCK_CHECKS) return;
+
+  if (jb->clock_matches >= BTIF_A2DP_SINK_CLOCK_MIN_MATCHES) {
+    jb->clock = BTIF_A2DP_SINK_JB_CLOCK_SAMPLES;
+    return;
+  }
+
+  LOG_WARN(LOG_TAG,
+           "%s: timestamps don't count samples (%u of %u packets did), "
+           "playing in arrival order",
+           __func__, jb->clock_matches, jb->clock_checks);
+  jb->clock = BTIF_A2DP_SINK_JB_CLOCK_ARRIVAL;
+  if (!list_is_empty(jb->packets))
+    jb->arrival_ts = ((tBT_SBC_HDR*)list_front(jb->packets))->time_stamp;
+  else
+    jb->arrival_ts = p_msg->time_stamp;
+  for (const list_node_t* node = list_begin(jb->packets);
+       node != list_end(jb->packets); node = list_next(node)) {
+    tBT_SBC_HDR* p_buf = (tBT_SBC_HDR*)list_node(node);
+    p_buf->time_stamp = jb->arrival_ts;
+    jb->arrival_ts += p_buf->num_samples;
+  }
+}
+
+void btif_a2dp_sink_jb_admit_packet(btif_a2dp_sink_jb_t* jb,
+                                    tBT_SBC_HDR* p_msg) {
+  btif_a2dp_sink_jb_check_clock(jb, p_msg);
+  const uint32_t rtp_ts = p_msg->time_stamp;
+  if (jb->clock == BTIF_A2DP_SINK_JB_CLOCK_ARRIVAL) {
+    p_msg->time_stamp = jb->arrival_ts;
+    jb->arrival_ts += p_msg->num_samples;
+  }
+
+  // RFC 3550 interarrival jitter: the change in transit time between
+  // consecutive packets, smoothed over 16 packets. Timestamps that aren't
+  // known to count samples say nothing about it.
+  if (jb->have_last && jb->clock != BTIF_A2DP_SINK_JB_CLOCK_UNKNOWN &&
+      jb->sample_rate > 0) {
+    int64_t arrival_us = (int64_t)(p_msg->arrival_us - jb->last_arrival_us);
+    int64_t media_us =
+        (int64_t)(int32_t)(p_msg->time_stamp - jb->last_time_stamp) *
+        1000000 / jb->sample_rate;
+    int64_t transit_us = arrival_us - media_us;
+    if (transit_us < 0) transit_us = -transit_us;
+    jb->jitter_us += (transit_us - jb->jitter_us) / 16;
+  }
+  jb->have_last = true;
+  jb->last_arrival_us = p_msg->arrival_us;
+  jb->last_time_stamp = p_msg->time_stamp;
+  jb->last_rtp_ts = rtp_ts;
+  jb->last_num_samples = p_msg->num_samples;
+
+  jb->stats.total_packets++;
+  list_append(jb->packets, p_msg);
+
+  uint32_t target_ms = BTIF_A2DP_SINK_MIN_TARGET_DEPTH_MS +
+                       BTIF_A2DP_SINK_JITTER_MULTIPLIER * jb->jitter_us / 1000;
+  if (target_ms > BTIF_A2DP_SINK_MAX_TARGET_DEPTH_MS)
+    target_ms = BTIF_A2DP_SINK_MAX_TARGET_DEPTH_MS;
+  jb->target_ms = target_ms;
+
+  // Drop the oldest packets if a burst put playout far behind the source,
+  // and skip playout ahead to the packets kept. The depth isn't known until
+  // the timestamps are.
+  if (jb->clock == BTIF_A2DP_SINK_JB_CLOCK_UNKNOWN) return;
+  const uint32_t max_depth_ms =
+      2 * jb->target_ms + BTIF_A2DP_SINK_OVERFLOW_SLACK_MS;
+  while (list_length(jb->packets) > 1 &&
+         btif_a2dp_sink_jb_samples_to_ms(jb, btif_a2dp_sink_jb_depth(jb)) >
+             max_depth_ms) {
+    jb->stats.overflow_packets++;
+    list_remove(jb->packets, list_front(jb->packets));
+    if (jb->playing) {
+      tBT_SBC_HDR* p_front = (tBT_SBC_HDR*)list_front(jb->packets);
+      jb->play_ts = p_front->time_stamp - jb->pcm_len;
+    }
+  }
+}
+
+// Decodes |p_msg| to the end of the PCM FIFO, and returns the number of
+// samples per channel decoded.
+static uint32_t btif_a2dp_sink_jb_decode(btif_a2dp_sink_jb_t* jb,
+                                         tBT_SBC_HDR* p_msg) {
+  uint32_t decoded =
+      jb->decode(p_msg, &jb->pcm[jb->pcm_len * 2],
+                 BTIF_A2DP_SINK_JB_PCM_FIFO_SAMPLES - jb->pcm_len);
+  jb->pcm_len += decoded;
+  return decoded;
+}
+
+bool btif_a2dp_sink_jb_fill(btif_a2dp_sink_jb_t* jb, uint32_t needed) {
+  const uint32_t max_gap =
+      jb->sample_rate * BTIF_A2DP_SINK_MAX_TARGET_DEPTH_MS / 1000;
+
+  while (jb->pcm_len < needed) {
+    tBT_SBC_HDR* p_msg = list_is_empty(jb->packets)
+                             ? NULL
+                             : (tBT_SBC_HDR*)list_front(jb->packets);
+    uint32_t end_ts = jb->play_ts + jb->pcm_len;
+    int32_t gap;
+
+    if (p_msg == NULL) {
+      gap = needed - jb->pcm_len;
+    } else {
+      gap = (int32_t)(p_msg->time_stamp - end_ts);
+      if ((gap < 0 && (uint32_t)-gap >= p_msg->num_samples + max_gap) ||
+          (gap > 0 && (uint32_t)gap > max_gap)) {
+        // The source restarted or skipped its timestamps, or packets were
+        // dropped on overflow; carry on from this packet without a pause.
+        jb->play_ts = p_msg->time_stamp - jb->pcm_len;
+        gap = 0;
+      }
+      if (gap > 0 && (uint32_t)gap > needed - jb->pcm_len)
+        gap = needed - jb->pcm_len;
+    }
+
+    if (gap > 0) {
+      memset(&jb->pcm[jb->pcm_len * 2], 0, gap * 2 * sizeof(jb->pcm[0]));
+      jb->pcm_len += gap;
+      jb->stats.concealed_samples += gap;
+      if (p_msg == NULL) return false;
+      continue;
+    }
+
+    uint32_t late = (uint32_t)-gap;
+    uint32_t start = jb->pcm_len;
+    if (late != 0) {
+      jb->stats.late_packets++;
+      btif_a2dp_sink_histogram_add(&jb->stats.late_ms_histogram,
+                                   btif_a2dp_sink_jb_samples_to_ms(jb, late));
+    }
+    if (late < p_msg->num_samples) {
+      uint32_t decoded = btif_a2dp_sink_jb_decode(jb, p_msg);
+      if (late >= decoded) {
+        jb->pcm_len = start;
+      } else if (late != 0) {
+        memmove(&jb->pcm[start * 2], &jb->pcm[(start + late) * 2],
+                (decoded - late) * 2 * sizeof(jb->pcm[0]));
+        jb->pcm_len -= late;
+      }
+    }
+    list_remove(jb->packets, p_msg);
+  }
+  return true;
+}
+
+int32_t btif_a2dp_sink_jb_drift_ppm(int32_t depth_avg_ms, uint32_t target_ms) {
+  int32_t drift_ppm =
+      (depth_avg_ms - (int32_t)target_ms) * BTIF_A2DP_SINK_DRIFT_PPM_PER_MS;
+  if (drift_ppm > BTIF_A2DP_SINK_MAX_DRIFT_PPM)
+    drift_ppm = BTIF_A2DP_SINK_MAX_DRIFT_PPM;
+  if (drift_ppm < -BTIF_A2DP_SINK_MAX_DRIFT_PPM)
+    drift_ppm = -BTIF_A2DP_SINK_MAX_DRIFT_PPM;
+  return drift_ppm;
+}
+
+uint64_t btif_a2dp_sink_jb_resample(const int16_t* in, int16_t* out,
+                                    uint32_t out_samples, uint64_t phase,
+                                    uint64_t step) {
+  uint64_t pos = phase;
+  for (uint32_t i = 0; i < out_samples; i++, pos += step) {
+    const int16_t* s = &in[(pos >> 32) * 2];
+    int64_t frac = (pos >> 16) & 0xffff;
+    out[i * 2] = s[0] + (int16_t)(((s[2] - s[0]) * frac) >> 16);
+    out[i * 2 + 1] = s[1] + (int16_t)(((s[3] - s[1]) * frac) >> 16);
+  }
+  return pos;
+}
+
+// Plays one tick of audio from the jitter buffer. The FIFO is resampled by
+// linear interpolation at a rate that holds the depth at its target, which
+// makes up for the drift between the source and sink clocks.
+static uint32_t btif_a2dp_sink_jb_play_tick(btif_a2dp_sink_jb_t* jb) {
+  const uint32_t out_samples =
+      jb->sample_rate * BTIF_A2DP_SINK_JB_TICK_MS / 1000;
+  if (out_samples > BTIF_A2DP_SINK_JB_MAX_TICK_SAMPLES) return 0;
+
+  uint32_t depth_ms =
+      btif_a2dp_sink_jb_samples_to_ms(jb, btif_a2dp_sink_jb_depth(jb));
+  btif_a2dp_sink_histogram_add(&jb->stats.depth_ms_histogram, depth_ms);
+  jb->depth_avg_ms += ((int32_t)depth_ms - jb->depth_avg_ms) / 8;
+  jb->drift_ppm = btif_a2dp_sink_jb_drift_ppm(jb->depth_avg_ms, jb->target_ms);
+
+  // Input samples advanced per output sample, in 1/2^32.
+  const uint64_t step =
+      (1ULL << 32) + ((int64_t)jb->drift_ppm * (1LL << 32) / 1000000);
+  const uint64_t end = jb->phase + out_samples * step;
+  const uint32_t needed = (uint32_t)((end - step) >> 32) + 2;
+
+  if (btif_a2dp_sink_jb_fill(jb, needed)) {
+    if (jb->underrun_ms != 0) {
+      btif_a2dp_sink_histogram_add(&jb->stats.underrun_ms_histogram,
+                                   jb->underrun_ms);
+      jb->underrun_ms = 0;
+    }
+  } else {
+    if (jb->underrun_ms == 0) jb->stats.underruns++;
+    jb->underrun_ms += BTIF_A2DP_SINK_JB_TICK_MS;
+    if (jb->underrun_ms > jb->target_ms) {
+      // The stream stalled; stop playing silence and buffer up again.
+      APPL_TRACE_DEBUG("%s: rebuffering after %u ms underrun", __func__,
+                       jb->underrun_ms);
+      btif_a2dp_sink_histogram_add(&jb->stats.underrun_ms_histogram,
+                                   jb->underrun_ms);
+      jb->stats.rebuffers++;
+      btif_a2dp_sink_jb_reset(jb);
+      return 0;
+    }
+  }
+
+  btif_a2dp_sink_jb_resample(jb->pcm, jb->out, out_samples, jb->phase, step);
+
+  const uint32_t consumed = (uint32_t)(end >> 32);
+  jb->phase = end & 0xffffffff;
+  jb->pcm_len -= consumed;
+  jb->play_ts += consumed;
+  memmove(jb->pcm, &jb->pcm[consumed * 2],
+          jb->pcm_len * 2 * sizeof(jb->pcm[0]));
+  return out_samples;
+}
+
+uint32_t btif_a2dp_sink_jb_tick(btif_a2dp_sink_jb_t* jb) {
+  if (!jb->playing) {
+    // Buffer up to the target depth, on a timeline known to be right,
+    // before playing.
+    if (jb->clock == BTIF_A2DP_SINK_JB_CLOCK_UNKNOWN || jb->sample_rate == 0)
+      return 0;
+    if (btif_a2dp_sink_jb_samples_to_ms(jb, btif_a2dp_sink_jb_depth(jb)) <
+        jb->target_ms)
+      return 0;
+    tBT_SBC_HDR* p_front = (tBT_SBC_HDR*)list_front(jb->packets);
+    jb->play_ts = p_front->time_stamp;
+    jb->pcm_len = 0;
+    jb->phase = 0;
+    jb->depth_avg_ms = jb->target_ms;
+    jb->playing = true;
+  }
+
+  return btif_a2dp_sink_jb_play_tick(jb);
+}
@@ -31,6 +31,7 @@
 #include "btif_a2dp.h"
 #include "btif_a2dp_control.h"
 #include "btif_a2dp_source.h"
+#include "btif_a2dp_source_tx.h"
 #include "btif_av.h"
 #include "btif_av_co.h"
 #include "btif_util.h"
@@ -39,6 +40,7 @@
 #include "osi/include/metrics.h"
 #include "osi/include/mutex.h"
 #include "osi/include/osi.h"
+#include "osi/include/properties.h"
 #include "osi/include/thread.h"
 #include "osi/include/time.h"
 #include "uipc.h"
@@ -53,6 +55,19 @@ using system_bt_osi::A2dpSessionMetrics;
  */
 #define MAX_OUTPUT_A2DP_FRAME_QUEUE_SZ (MAX_PCM_FRAME_NUM_PER_TICK * 2)
 
+/**
+ * In batched mode the media timer period is stretched to a multiple of the
+ * encoder interval while the link keeps up, so that a single wakeup encodes
+ * several intervals worth of audio and hands all of it to BTA AV at once.
+ * The multiple is read from the property below; 1 (the default) disables
+ * batching.
+ */
+#define BTIF_A2DP_SOURCE_BATCH_PROPERTY "persist.bluetooth.a2dp_source.batch"
+#define BTIF_A2DP_SOURCE_MAX_BATCH_TICKS 4
+
+/* Consecutive healthy media ticks before the period is stretched further */
+#define BTIF_A2DP_SOURCE_BATCH_GROW_TICKS 50
+
 enum {
   BTIF_A2DP_SOURCE_STATE_OFF,
   BTIF_A2DP_SOURCE_STATE_STARTING_UP,
@@ -147,16 +162,25 @@ typedef struct {
   size_t media_read_total_underflow_bytes;
   size_t media_read_total_underflow_count;
   uint64_t media_read_last_underflow_us;
+
+  size_t media_timer_total_batched_intervals;
+  size_t media_timer_max_batch_ticks;
+  size_t media_timer_batch_backoffs;
 } btif_media_stats_t;
 
 typedef struct {
   thread_t* worker_thread;
   fixed_queue_t* cmd_msg_queue;
-  fixed_queue_t* tx_audio_queue;
   bool tx_flush; /* Discards any outgoing data when true */
   alarm_t* media_alarm;
+  /* The one encoder; its output is queued for every started stream */
   const tA2DP_ENCODER_INTERFACE* encoder_interface;
   period_ms_t encoder_interval_ms; /* Local copy of the encoder interval */
+  size_t max_batch_ticks;  /* Encoder intervals per media tick, upper bound */
+  size_t batch_ticks;      /* Encoder intervals per media tick, current */
+  size_t batch_healthy_ticks; /* Media ticks since the last period change */
+  bool batch_backoff;         /* Set on a dropout or an underflow */
+  uint64_t last_tick_us;      /* Timestamp of the previous media tick */
   btif_media_stats_t stats;
   btif_media_stats_t accumulated_stats;
 } tBTIF_A2DP_SOURCE_CB;
@@ -179,6 +203,7 @@ static void btif_a2dp_source_encoder_init_req(
 static bool btif_a2dp_source_audio_tx_flush_req(void);
 static void btif_a2dp_source_alarm_cb(void* context);
 static void btif_a2dp_source_audio_handle_timer(void* context);
+static void btif_a2dp_source_update_batch(size_t pending_n);
 static uint32_t btif_a2dp_source_read_callback(uint8_t* p_buf, uint32_t len);
 static bool btif_a2dp_source_enqueue_callback(BT_HDR* p_buf, size_t frames_n);
 static void log_tstamps_us(const char* comment, uint64_t timestamp_us);
@@ -242,6 +267,11 @@ void btif_a2dp_source_accumulate_stats(btif_media_stats_t* src,
   dst->media_read_total_underflow_count +=
       src->media_read_total_underflow_count;
   dst->media_read_last_underflow_us = src->media_read_last_underflow_us;
+  dst->media_timer_total_batched_intervals +=
+      src->media_timer_total_batched_intervals;
+  dst->media_timer_max_batch_ticks = std::max(dst->media_timer_max_batch_ticks,
+                                              src->media_timer_max_batch_ticks);
+  dst->media_timer_batch_backoffs += src->media_timer_batch_backoffs;
   btif_a2dp_source_accumulate_scheduling_stats(&src->tx_queue_enqueue_stats,
                                                &dst->tx_queue_enqueue_stats);
   btif_a2dp_source_accumulate_scheduling_stats(&src->tx_queue_dequeue_stats,
@@ -269,7 +299,7 @@ bool btif_a2dp_source_startup(void) {
     return false;
   }
 
-  btif_a2dp_source_cb.tx_audio_queue = fixed_queue_new(SIZE_MAX);
+  btif_a2dp_source_tx_init();
 
   btif_a2dp_source_cb.cmd_msg_queue = fixed_queue_new(SIZE_MAX);
   fixed_queue_register_dequeue(
@@ -320,8 +350,7 @@ void btif_a2dp_source_shutdown(void) {
 
 static void btif_a2dp_source_shutdown_delayed(UNUSED_ATTR void* context) {
   btif_a2dp_control_cleanup();
-  fixed_queue_free(btif_a2dp_source_cb.tx_audio_queue, NULL);
-  btif_a2dp_source_cb.tx_audio_queue = NULL;
+  btif_a2dp_source_tx_cleanup();
 
   btif_a2dp_source_state = BTIF_A2DP_SOURCE_STATE_OFF;
   BluetoothMetricsLogger::GetInstance()->LogBluetoothSessionEnd(
@@ -579,6 +608,16 @@ void btif_a2dp_source_on_suspended(tBTA_AV_SUSPEND* p_av_suspend) {
   btif_a2dp_source_stop_audio_req();
 }
 
+void btif_a2dp_source_on_peer_started(tBTA_AV_HNDL hndl) {
+  if (btif_a2dp_source_tx_start_stream(hndl))
+    APPL_TRACE_EVENT("## A2DP SOURCE STREAM 0x%x STARTED ##", hndl);
+}
+
+void btif_a2dp_source_on_peer_stopped(tBTA_AV_HNDL hndl) {
+  if (btif_a2dp_source_tx_stop_stream(hndl))
+    APPL_TRACE_EVENT("## A2DP SOURCE STREAM 0x%x STOPPED ##", hndl);
+}
+
 /* when true media task discards any tx frames */
 void btif_a2dp_source_set_tx_flush(bool enable) {
   APPL_TRACE_EVENT("## DROP TX %d ##", enable);
@@ -607,6 +646,16 @@ static void btif_a2dp_source_audio_tx_start_event(void) {
     return;
   }
 
+  /* Always start unbatched, the period is stretched once the link is stable */
+  int32_t max_batch_ticks =
+      osi_property_get_int32(BTIF_A2DP_SOURCE_BATCH_PROPERTY, 1);
+  btif_a2dp_source_cb.max_batch_ticks =
+      std::min(std::max(max_batch_ticks, 1), BTIF_A2DP_SOURCE_MAX_BATCH_TICKS);
+  btif_a2dp_source_cb.batch_ticks = 1;
+  btif_a2dp_source_cb.batch_healthy_ticks = 0;
+  btif_a2dp_source_cb.batch_backoff = false;
+  btif_a2dp_source_cb.last_tick_us = 0;
+
   alarm_set(btif_a2dp_source_cb.media_alarm,
             btif_a2dp_source_cb.encoder_interface->get_encoder_interval_ms(),
             btif_a2dp_source_alarm_cb, NULL);
@@ -660,23 +709,95 @@ static void btif_a2dp_source_audio_handle_timer(UNUSED_ATTR void* context) {
 
   if (alarm_is_scheduled(btif_a2dp_source_cb.media_alarm)) {
     CHECK(btif_a2dp_source_cb.encoder_interface != NULL);
+    size_t transmit_queue_length = btif_a2dp_source_tx_queue_length();
     if (btif_a2dp_source_cb.encoder_interface->set_transmit_queue_length !=
         NULL) {
-      size_t transmit_queue_length =
-          fixed_queue_length(btif_a2dp_source_cb.tx_audio_queue);
       btif_a2dp_source_cb.encoder_interface->set_transmit_queue_length(
           transmit_queue_length);
     }
-    btif_a2dp_source_cb.encoder_interface->send_frames(timestamp_us);
+
+    /*
+     * Encode one encoder interval at a time, so that the encoders see the
+     * same per-call frame counts as in unbatched mode, then signal BTA AV
+     * once for the whole batch.
+     */
+    uint64_t interval_us = btif_a2dp_source_cb.encoder_interval_ms * 1000;
+    size_t intervals_n = 1;
+    if (btif_a2dp_source_cb.last_tick_us != 0 && interval_us != 0) {
+      intervals_n =
+          (timestamp_us - btif_a2dp_source_cb.last_tick_us + interval_us / 2) /
+          interval_us;
+      intervals_n = std::min(std::max<size_t>(intervals_n, 1),
+                             btif_a2dp_source_cb.batch_ticks);
+    }
+    uint64_t expected_delta_us = interval_us * btif_a2dp_source_cb.batch_ticks;
+    btif_a2dp_source_cb.last_tick_us = timestamp_us;
+
+    for (size_t i = intervals_n; i > 0; i--) {
+      btif_a2dp_source_cb.encoder_interface->send_frames(
+          timestamp_us - (i - 1) * interval_us);
+    }
     bta_av_ci_src_data_ready(BTA_AV_CHNL_AUDIO);
     update_scheduling_stats(&btif_a2dp_source_cb.stats.tx_queue_enqueue_stats,
-                            timestamp_us,
-                            btif_a2dp_source_cb.encoder_interval_ms * 1000);
+                            timestamp_us, expected_delta_us);
+    if (intervals_n > 1) {
+      btif_a2dp_source_cb.stats.media_timer_total_batched_intervals +=
+          intervals_n;
+    }
+
+    btif_a2dp_source_update_batch(transmit_queue_length);
   } else {
     APPL_TRACE_ERROR("ERROR Media task Scheduled after Suspend");
   }
 }
 
+/*
+ * Adapts the media timer period. The period is stretched one encoder interval
+ * at a time after BTIF_A2DP_SOURCE_BATCH_GROW_TICKS ticks in which the TX queue
+ * was drained in time, provided the larger batch still fits comfortably in the
+ * TX queue. Any dropout, underflow or TX queue build-up falls back to one
+ * encoder interval per tick.
+ */
+static void btif_a2dp_source_update_batch(size_t pending_n) {
+  if (btif_a2dp_source_cb.max_batch_ticks <= 1) return;
+
+  // Buffers left over from the previous tick mean the link isn't keeping up
+  if (pending_n > 1) btif_a2dp_source_cb.batch_backoff = true;
+
+  size_t batch_ticks = btif_a2dp_source_cb.batch_ticks;
+  size_t queue_length = btif_a2dp_source_tx_queue_length();
+
+  if (btif_a2dp_source_cb.batch_backoff) {
+    btif_a2dp_source_cb.batch_backoff = false;
+    btif_a2dp_source_cb.batch_healthy_ticks = 0;
+    if (batch_ticks > 1) {
+      btif_a2dp_source_cb.stats.media_timer_batch_backoffs++;
+      batch_ticks = 1;
+    }
+  } else if (++btif_a2dp_source_cb.batch_healthy_ticks >=
+             BTIF_A2DP_SOURCE_BATCH_GROW_TICKS) {
+    btif_a2dp_source_cb.batch_healthy_ticks = 0;
+    // |queue_length| is what this tick produced that BTA AV hasn't picked up
+    // yet; the next batch must not get near the overflow check.
+    if (batch_ticks < btif_a2dp_source_cb.max_batch_ticks &&
+        queue_length * (batch_ticks + 1) <=
+            batch_ticks * (MAX_OUTPUT_A2DP_FRAME_QUEUE_SZ / 2)) {
+      batch_ticks++;
+    }
+  }
+
+  if (batch_ticks == btif_a2dp_source_cb.batch_ticks) return;
+
+  APPL_TRACE_DEBUG("%s: media tick is now %u encoder intervals", __func__,
+                   (uint32_t)batch_ticks);
+  btif_a2dp_source_cb.batch_ticks = batch_ticks;
+  btif_a2dp_source_cb.stats.media_timer_max_batch_ticks = std::max(
+      batch_ticks, btif_a2dp_source_cb.stats.media_timer_max_batch_ticks);
+  alarm_set(btif_a2dp_source_cb.media_alarm,
+            btif_a2dp_source_cb.encoder_interval_ms * batch_ticks,
+            btif_a2dp_source_alarm_cb, NULL);
+}
+
 static uint32_t btif_a2dp_source_read_callback(uint8_t* p_buf, uint32_t len) {
   uint16_t event;
   uint32_t bytes_read = UIPC_Read(UIPC_CH_ID_AV_AUDIO, &event, p_buf, len);
@@ -689,6 +810,7 @@ static uint32_t btif_a2dp_source_read_callback(uint8_t* p_buf, uint32_t len) {
     btif_a2dp_source_cb.stats.media_read_total_underflow_count++;
     btif_a2dp_source_cb.stats.media_read_last_underflow_us =
         time_get_os_boottime_us();
+    btif_a2dp_source_cb.batch_backoff = true;
   }
 
   return bytes_read;
@@ -708,48 +830,42 @@ static bool btif_a2dp_source_enqueue_callback(BT_HDR* p_buf, size_t frames_n) {
     LOG_VERBOSE(LOG_TAG, "%s: tx suspended, discarded frame", __func__);
 
     btif_a2dp_source_cb.stats.tx_queue_total_flushed_messages +=
-        fixed_queue_length(btif_a2dp_source_cb.tx_audio_queue);
+        btif_a2dp_source_tx_flush();
     btif_a2dp_source_cb.stats.tx_queue_last_flushed_us = now_us;
-    fixed_queue_flush(btif_a2dp_source_cb.tx_audio_queue, osi_free);
 
     osi_free(p_buf);
     return false;
   }
 
-  // Check for TX queue overflow
-  // TODO: Using frames_n here is probably wrong: should be "+ 1" instead.
-  if (fixed_queue_length(btif_a2dp_source_cb.tx_audio_queue) + frames_n >
-      MAX_OUTPUT_A2DP_FRAME_QUEUE_SZ) {
-    LOG_WARN(LOG_TAG, "%s: TX queue buffer size now=%u adding=%u max=%d",
-             __func__,
-             (uint32_t)fixed_queue_length(btif_a2dp_source_cb.tx_audio_queue),
-             (uint32_t)frames_n, MAX_OUTPUT_A2DP_FRAME_QUEUE_SZ);
+  /* Update the statistics */
+  btif_a2dp_source_cb.stats.tx_queue_total_frames += frames_n;
+  btif_a2dp_source_cb.stats.tx_queue_max_frames_per_packet = std::max(
+      frames_n, btif_a2dp_source_cb.stats.tx_queue_max_frames_per_packet);
+  CHECK(btif_a2dp_source_cb.encoder_interface != NULL);
+
+  btif_a2dp_source_tx_drops_t drops;
+  if (!btif_a2dp_source_tx_enqueue(p_buf, frames_n,
+                                   MAX_OUTPUT_A2DP_FRAME_QUEUE_SZ, &drops)) {
+    LOG_VERBOSE(LOG_TAG, "%s: no stream started, discarded frame", __func__);
+    return false;
+  }
+
+  if (drops.dropouts != 0) {
     // Keep track of drop-outs
-    btif_a2dp_source_cb.stats.tx_queue_dropouts++;
+    btif_a2dp_source_cb.stats.tx_queue_dropouts += drops.dropouts;
     btif_a2dp_source_cb.stats.tx_queue_last_dropouts_us = now_us;
-
-    // Flush all queued buffers
-    size_t drop_n = fixed_queue_length(btif_a2dp_source_cb.tx_audio_queue);
-    btif_a2dp_source_cb.stats.tx_queue_max_dropped_messages = std::max(
-        drop_n, btif_a2dp_source_cb.stats.tx_queue_max_dropped_messages);
-    while (fixed_queue_length(btif_a2dp_source_cb.tx_audio_queue)) {
-      btif_a2dp_source_cb.stats.tx_queue_total_dropped_messages++;
-      osi_free(fixed_queue_try_dequeue(btif_a2dp_source_cb.tx_audio_queue));
-    }
+    btif_a2dp_source_cb.batch_backoff = true;
+    btif_a2dp_source_cb.stats.tx_queue_total_dropped_messages +=
+        drops.dropped_n;
+    btif_a2dp_source_cb.stats.tx_queue_max_dropped_messages =
+        std::max(drops.max_dropped_n,
+                 btif_a2dp_source_cb.stats.tx_queue_max_dropped_messages);
 
     // Request RSSI for log purposes if we had to flush buffers
     bt_bdaddr_t peer_bda = btif_av_get_addr();
     BTM_ReadRSSI(peer_bda.address, btm_read_rssi_cb);
   }
 
-  /* Update the statistics */
-  btif_a2dp_source_cb.stats.tx_queue_total_frames += frames_n;
-  btif_a2dp_source_cb.stats.tx_queue_max_frames_per_packet = std::max(
-      frames_n, btif_a2dp_source_cb.stats.tx_queue_max_frames_per_packet);
-  CHECK(btif_a2dp_source_cb.encoder_interface != NULL);
-
-  fixed_queue_enqueue(btif_a2dp_source_cb.tx_audio_queue, p_buf);
-
   return true;
 }
 
@@ -761,10 +877,9 @@ static void btif_a2dp_source_audio_tx_flush_event(UNUSED_ATTR BT_HDR* p_msg) {
     btif_a2dp_source_cb.encoder_interface->feeding_flush();
 
   btif_a2dp_source_cb.stats.tx_queue_total_flushed_messages +=
-      fixed_queue_length(btif_a2dp_source_cb.tx_audio_queue);
+      btif_a2dp_source_tx_flush();
   btif_a2dp_source_cb.stats.tx_queue_last_flushed_us =
       time_get_os_boottime_us();
-  fixed_queue_flush(btif_a2dp_source_cb.tx_audio_queue, osi_free);
 
   UIPC_Ioctl(UIPC_CH_ID_AV_AUDIO, UIPC_REQ_RX_FLUSH, NULL);
 }
@@ -790,14 +905,15 @@ static bool btif_a2dp_source_audio_tx_flush_req(void) {
   return true;
 }
 
-BT_HDR* btif_a2dp_source_audio_readbuf(void) {
+BT_HDR* btif_a2dp_source_audio_readbuf(tBTA_AV_HNDL hndl) {
   uint64_t now_us = time_get_os_boottime_us();
-  BT_HDR* p_buf =
-      (BT_HDR*)fixed_queue_try_dequeue(btif_a2dp_source_cb.tx_audio_queue);
+  BT_HDR* p_buf = btif_a2dp_source_tx_readbuf(hndl);
 
   btif_a2dp_source_cb.stats.tx_queue_total_readbuf_calls++;
   btif_a2dp_source_cb.stats.tx_queue_last_readbuf_us = now_us;
-  if (p_buf != NULL) {
+  // BTA AV reads all streams in the same pass, so the dequeue scheduling is
+  // only tracked on the first started one
+  if (p_buf != NULL && btif_a2dp_source_tx_is_first_stream(hndl)) {
     // Update the statistics
     update_scheduling_stats(&btif_a2dp_source_cb.stats.tx_queue_dequeue_stats,
                             now_us,
@@ -811,7 +927,7 @@ static void log_tstamps_us(const char* comment, uint64_t timestamp_us) {
   static uint64_t prev_us = 0;
   APPL_TRACE_DEBUG("[%s] ts %08llu, diff : %08llu, queue sz %d", comment,
                    timestamp_us, timestamp_us - prev_us,
-                   fixed_queue_length(btif_a2dp_source_cb.tx_audio_queue));
+                   btif_a2dp_source_tx_queue_length());
   prev_us = timestamp_us;
 }
 
@@ -913,6 +1029,13 @@ void btif_a2dp_source_debug_dump(int fd) {
           "  Counts (max dropped)                                    : %zu\n",
           accumulated_stats->tx_queue_max_dropped_messages);
 
+  dprintf(fd, "  Dropouts per stream (since startup)                     :");
+  for (int i = 0; i < BTA_AV_NUM_STRS; i++) {
+    dprintf(fd, " %s%zu", (i > 0) ? "/ " : "",
+            btif_a2dp_source_tx_dropouts(i + 1));
+  }
+  dprintf(fd, "\n");
+
   dprintf(
       fd,
       "  Last update time ago in ms (flushed/dropped)            : %llu / "
@@ -945,6 +1068,17 @@ void btif_a2dp_source_debug_dump(int fd) {
                     1000
               : 0);
 
+  dprintf(fd,
+          "  Media tick batching (max/current/max used/backoffs)     : %zu / "
+          "%zu / %zu / %zu\n",
+          btif_a2dp_source_cb.max_batch_ticks, btif_a2dp_source_cb.batch_ticks,
+          accumulated_stats->media_timer_max_batch_ticks,
+          accumulated_stats->media_timer_batch_backoffs);
+
+  dprintf(fd,
+          "  Encoder intervals in batched ticks                      : %zu\n",
+          accumulated_stats->media_timer_total_batched_intervals);
+
   //
   // TxQueue enqueue stats
   //
@@ -0,0 +1,208 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2017 Google, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#define LOG_TAG "bt_btif_a2dp_source_tx"
+
+#include "btif_a2dp_source_tx.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+
+#include "bt_common.h"
+#include "osi/include/allocator.h"
+#include "osi/include/fixed_queue.h"
+#include "osi/include/log.h"
+
+/* TX queue of one audio stream */
+typedef struct {
+  fixed_queue_t* queue;
+  /* Set while BTA AV has the stream started. Written on the BTU thread and
+   * read on the worker thread: the release store on start orders the flush
+   * before it ahead of any packet the worker queues once it sees the flag. */
+  std::atomic<bool> streaming;
+  size_t dropouts; /* Dropouts on this stream since init */
+} btif_a2dp_source_tx_stream_t;
+
+/* Indexed by BTA AV handle */
+static btif_a2dp_source_tx_stream_t tx_streams[BTA_AV_NUM_STRS];
+
+static btif_a2dp_source_tx_stream_t* btif_a2dp_source_tx_get_stream(
+    tBTA_AV_HNDL hndl) {
+  uint8_t index = (hndl & BTA_AV_HNDL_MSK) - 1;
+
+  if (index >= BTA_AV_NUM_STRS) {
+    LOG_ERROR(LOG_TAG, "%s: invalid handle 0x%x", __func__, hndl);
+    return NULL;
+  }
+  return &tx_streams[index];
+}
+
+static bool btif_a2dp_source_tx_stream_started(
+    const btif_a2dp_source_tx_stream_t* p_stream) {
+  return p_stream->streaming.load(std::memory_order_acquire);
+}
+
+static void btif_a2dp_source_tx_enqueue_stream(
+    btif_a2dp_source_tx_stream_t* p_stream, BT_HDR* p_buf, size_t frames_n,
+    size_t max_frames, btif_a2dp_source_tx_drops_t* p_drops) {
+  fixed_queue_t* queue = p_stream->queue;
+
+  // Check for TX queue overflow
+  // TODO: Using frames_n here is probably wrong: should be "+ 1" instead.
+  if (fixed_queue_length(queue) + frames_n > max_frames) {
+    LOG_WARN(LOG_TAG, "%s: TX queue %d buffer size now=%u adding=%u max=%u",
+             __func__, (int)(p_stream - tx_streams),
+             (uint32_t)fixed_queue_length(queue), (uint32_t)frames_n,
+             (uint32_t)max_frames);
+    p_stream->dropouts++;
+    p_drops->dropouts++;
+
+    // Flush all queued buffers of this stream
+    size_t drop_n = 0;
+    void* p_drop;
+    while ((p_drop = fixed_queue_try_dequeue(queue)) != NULL) {
+      osi_free(p_drop);
+      drop_n++;
+    }
+    p_drops->dropped_n += drop_n;
+    p_drops->max_dropped_n = std::max(drop_n, p_drops->max_dropped_n);
+  }
+
+  fixed_queue_enqueue(queue, p_buf);
+}
+
+void btif_a2dp_source_tx_init(void) {
+  for (int i = 0; i < BTA_AV_NUM_STRS; i++) {
+    btif_a2dp_source_tx_stream_t* p_stream = &tx_streams[i];
+    p_stream->queue = fixed_queue_new(SIZE_MAX);
+    p_stream->streaming.store(false);
+    p_stream->dropouts = 0;
+  }
+}
+
+void btif_a2dp_source_tx_cleanup(void) {
+  for (int i = 0; i < BTA_AV_NUM_STRS; i++) {
+    btif_a2dp_source_tx_stream_t* p_stream = &tx_streams[i];
+    p_stream->streaming.store(false);
+    fixed_queue_free(p_stream->queue, osi_free);
+    p_stream->queue = NULL;
+  }
+}
+
+bool btif_a2dp_source_tx_start_stream(tBTA_AV_HNDL hndl) {
+  btif_a2dp_source_tx_stream_t* p_stream = btif_a2dp_source_tx_get_stream(hndl);
+  if (p_stream == NULL) return false;
+
+  /* Don't send what was left over from the last time the stream ran */
+  fixed_queue_flush(p_stream->queue, osi_free);
+  p_stream->streaming.store(true, std::memory_order_release);
+  return true;
+}
+
+bool btif_a2dp_source_tx_stop_stream(tBTA_AV_HNDL hndl) {
+  btif_a2dp_source_tx_stream_t* p_stream = btif_a2dp_source_tx_get_stream(hndl);
+  if (p_stream == NULL) return false;
+
+  p_stream->streaming.store(false, std::memory_order_release);
+  fixed_queue_flush(p_stream->queue, osi_free);
+  return true;
+}
+
+bool btif_a2dp_source_tx_is_streaming(tBTA_AV_HNDL hndl) {
+  btif_a2dp_source_tx_stream_t* p_stream = btif_a2dp_source_tx_get_stream(hndl);
+  if (p_stream == NULL) return false;
+
+  return btif_a2dp_source_tx_stream_started(p_stream);
+}
+
+bool btif_a2dp_source_tx_is_first_stream(tBTA_AV_HNDL hndl) {
+  btif_a2dp_source_tx_stream_t* p_stream = btif_a2dp_source_tx_get_stream(hndl);
+  if (p_stream == NULL) return false;
+
+  for (btif_a2dp_source_tx_stream_t* p = tx_streams; p < p_stream; p++) {
+    if (btif_a2dp_source_tx_stream_started(p)) return false;
+  }
+  return true;
+}
+
+size_t btif_a2dp_source_tx_queue_length(void) {
+  size_t length = 0;
+
+  for (int i = 0; i < BTA_AV_NUM_STRS; i++) {
+    btif_a2dp_source_tx_stream_t* p_stream = &tx_streams[i];
+    if (!btif_a2dp_source_tx_stream_started(p_stream)) continue;
+    length = std::max(length, fixed_queue_length(p_stream->queue));
+  }
+  return length;
+}
+
+bool btif_a2dp_source_tx_enqueue(BT_HDR* p_buf, size_t frames_n,
+                                 size_t max_frames,
+                                 btif_a2dp_source_tx_drops_t* p_drops) {
+  memset(p_drops, 0, sizeof(*p_drops));
+
+  /* Every started stream but the last gets a copy, the last one |p_buf| */
+  btif_a2dp_source_tx_stream_t* p_last = NULL;
+  for (int i = 0; i < BTA_AV_NUM_STRS; i++) {
+    btif_a2dp_source_tx_stream_t* p_stream = &tx_streams[i];
+    if (!btif_a2dp_source_tx_stream_started(p_stream)) continue;
+    if (p_last != NULL) {
+      size_t copy_size = sizeof(BT_HDR) + p_buf->offset + p_buf->len;
+      BT_HDR* p_copy = (BT_HDR*)osi_malloc(copy_size);
+      memcpy(p_copy, p_buf, copy_size);
+      btif_a2dp_source_tx_enqueue_stream(p_last, p_copy, frames_n, max_frames,
+                                         p_drops);
+    }
+    p_last = p_stream;
+  }
+
+  if (p_last == NULL) {
+    osi_free(p_buf);
+    return false;
+  }
+  btif_a2dp_source_tx_enqueue_stream(p_last, p_buf, frames_n, max_frames,
+                                     p_drops);
+  return true;
+}
+
+BT_HDR* btif_a2dp_source_tx_readbuf(tBTA_AV_HNDL hndl) {
+  btif_a2dp_source_tx_stream_t* p_stream = btif_a2dp_source_tx_get_stream(hndl);
+  if (p_stream == NULL) return NULL;
+
+  return (BT_HDR*)fixed_queue_try_dequeue(p_stream->queue);
+}
+
+size_t btif_a2dp_source_tx_flush(void) {
+  size_t flushed_n = 0;
+
+  for (int i = 0; i < BTA_AV_NUM_STRS; i++) {
+    fixed_queue_t* queue = tx_streams[i].queue;
+    flushed_n += fixed_queue_length(queue);
+    fixed_queue_flush(queue, osi_free);
+  }
+  return flushed_n;
+}
+
+size_t btif_a2dp_source_tx_dropouts(tBTA_AV_HNDL hndl) {
+  btif_a2dp_source_tx_stream_t* p_stream = btif_a2dp_source_tx_get_stream(hndl);
+  if (p_stream == NULL) return 0;
+
+  return p_stream->dropouts;
+}
@@ -1171,7 +1171,8 @@ static void bte_av_sink_media_callback(tBTA_AV_EVT event,
     case BTA_AV_SINK_MEDIA_DATA_EVT: {
       btif_sm_state_t state = btif_sm_get_state(btif_av_cb.sm_handle);
       if ((state == BTIF_AV_STATE_STARTED) || (state == BTIF_AV_STATE_OPENED)) {
-        uint8_t queue_len = btif_a2dp_sink_enqueue_buf((BT_HDR*)p_data);
+        uint8_t queue_len = btif_a2dp_sink_enqueue_buf(
+            p_data->sink_data.p_pkt, p_data->sink_data.time_stamp);
         BTIF_TRACE_DEBUG("%s: packets in sink queue %d", __func__, queue_len);
       }
       break;
@@ -44,6 +44,7 @@
 #include "btif_gatt_util.h"
 #include "btif_storage.h"
 #include "osi/include/log.h"
+#include "osi/include/properties.h"
 #include "vendor_api.h"
 
 using base::Bind;
@@ -53,6 +54,12 @@ using RegisterCallback = BleScannerInterface::RegisterCallback;
 
 extern const btgatt_callbacks_t* bt_gatt_callbacks;
 
+// Window, in ms, in which a scan result repeating the last one delivered for
+// an advertiser is not reported again. 0 turns the host duplicate filter off.
+#define BTIF_SCAN_DUP_WINDOW_PROPERTY "persist.bluetooth.le_scan.dup_window_ms"
+// RSSI change, in dB, for which such a repeated result is still reported.
+#define BTIF_SCAN_DUP_RSSI_PROPERTY "persist.bluetooth.le_scan.dup_rssi_db"
+
 #define SCAN_CBACK_IN_JNI(P_CBACK, ...)                              \
   do {                                                               \
     if (bt_gatt_callbacks && bt_gatt_callbacks->scanner->P_CBACK) {  \
@@ -240,6 +247,33 @@ void bta_track_adv_event_cb(tBTM_BLE_TRACK_ADV_DATA* p_track_adv_data) {
   SCAN_CBACK_IN_JNI(track_adv_event_cb, Owned(btif_scan_track_cb));
 }
 
+// Sets the host duplicate filter of the observe scan from the properties. All
+// scanner clients take their results from that scan, so they share the filter.
+// Must be called on the BTA thread.
+void btif_scan_set_dup_filter() {
+  int32_t window_ms = osi_property_get_int32(BTIF_SCAN_DUP_WINDOW_PROPERTY, 0);
+  int32_t rssi_db = osi_property_get_int32(BTIF_SCAN_DUP_RSSI_PROPERTY, 5);
+  tBTM_BLE_DUP_FILTER_PARAMS params;
+
+  params.enable = window_ms > 0;
+  params.window_ms = params.enable ? window_ms : 0;
+  params.rssi_threshold =
+      (rssi_db < 0) ? 0 : (rssi_db > UINT8_MAX) ? UINT8_MAX : rssi_db;
+  BTM_BleSetDupFilter(BTM_BLE_DUP_FILTER_OBSERVE, &params);
+}
+
+// Logs what the duplicate filter of the observe scan did since the scan
+// started. Must be called on the BTA thread.
+void btif_scan_log_dup_filter_stats() {
+  tBTM_BLE_DUP_FILTER_STATS stats;
+
+  if (BTM_BleGetDupFilterStats(BTM_BLE_DUP_FILTER_OBSERVE, &stats) !=
+      BTM_SUCCESS)
+    return;
+  LOG_INFO(LOG_TAG, "%s: scan results delivered: %u, duplicates suppressed: %u",
+           __func__, stats.delivered, stats.suppressed);
+}
+
 class BleScannerInterfaceImpl : public BleScannerInterface {
   ~BleScannerInterfaceImpl(){};
 
@@ -262,12 +296,14 @@ class BleScannerInterfaceImpl : public BleScannerInterface {
     do_in_jni_thread(Bind(
         [](bool start) {
           if (!start) {
+            do_in_bta_thread(FROM_HERE, Bind(&btif_scan_log_dup_filter_stats));
             do_in_bta_thread(FROM_HERE,
                              Bind(&BTA_DmBleObserve, false, 0, nullptr));
             return;
           }
 
           btif_gattc_init_dev_cb();
+          do_in_bta_thread(FROM_HERE, Bind(&btif_scan_set_dup_filter));
           do_in_bta_thread(FROM_HERE,
                            Bind(&BTA_DmBleObserve, true, 0,
                                 (tBTA_DM_SEARCH_CBACK*)bta_scan_results_cb));
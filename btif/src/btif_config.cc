@@ -24,6 +24,7 @@
 #include <ctype.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
 #include <string>
@@ -56,10 +57,13 @@ static const char* TIME_STRING_FORMAT = "%Y-%m-%d %H:%M:%S";
 // TODO(armansito): Find a better way than searching by a hardcoded path.
 #if defined(OS_GENERIC)
 static const char* CONFIG_FILE_PATH = "bt_config.conf";
+static const char* CONFIG_JOURNAL_PATH = "bt_config.conf" CONFIG_JOURNAL_EXT;
 static const char* CONFIG_BACKUP_PATH = "bt_config.bak";
 static const char* CONFIG_LEGACY_FILE_PATH = "bt_config.xml";
 #else   // !defined(OS_GENERIC)
 static const char* CONFIG_FILE_PATH = "/data/misc/bluedroid/bt_config.conf";
+static const char* CONFIG_JOURNAL_PATH =
+    "/data/misc/bluedroid/bt_config.conf" CONFIG_JOURNAL_EXT;
 static const char* CONFIG_BACKUP_PATH = "/data/misc/bluedroid/bt_config.bak";
 static const char* CONFIG_LEGACY_FILE_PATH =
     "/data/misc/bluedroid/bt_config.xml";
@@ -70,9 +74,11 @@ static void timer_config_save_cb(void* data);
 static void btif_config_write(uint16_t event, char* p_param);
 static bool is_factory_reset(void);
 static void delete_config_files(void);
+static bool btif_config_is_paired(const config_t* config, const char* section);
 static void btif_config_remove_unpaired(config_t* config);
 static void btif_config_remove_restricted(config_t* config);
 static config_t* btif_config_open(const char* filename);
+static ino_t btif_config_file_inode(const char* filename);
 
 static enum ConfigSource {
   NOT_LOADED,
@@ -198,6 +204,15 @@ static future_t* init(void) {
     goto error;
   }
 
+  // Saves are journaled on top of the config file. Keep the file that loaded
+  // as the backup, or drop a file that didn't load so that the first save
+  // writes it in full. The backup is refreshed each time the journal is
+  // compacted, see btif_config_write().
+  if (btif_config_source == ORIGINAL)
+    config_save(config, CONFIG_BACKUP_PATH);
+  else
+    remove(CONFIG_FILE_PATH);
+
   LOG_EVENT_INT(BT_CONFIG_SOURCE_TAG_NUM, btif_config_source);
 
   return future_new_immediate(FUTURE_SUCCESS);
@@ -460,11 +475,32 @@ static void btif_config_write(UNUSED_ATTR uint16_t event,
   CHECK(config_timer != NULL);
 
   std::unique_lock<std::mutex> lock(config_lock);
-  rename(CONFIG_FILE_PATH, CONFIG_BACKUP_PATH);
-  config_t* config_paired = config_new_clone(config);
-  btif_config_remove_unpaired(config_paired);
-  config_save(config_paired, CONFIG_FILE_PATH);
-  config_free(config_paired);
+  ino_t inode = btif_config_file_inode(CONFIG_FILE_PATH);
+  if (!config_save_journal(config, CONFIG_FILE_PATH, btif_config_is_paired))
+    return;
+
+  // Compacting the journal replaces the config file. Save the same contents
+  // as the backup, so that it is never older than the last compaction.
+  if (btif_config_file_inode(CONFIG_FILE_PATH) != inode)
+    config_save(config, CONFIG_BACKUP_PATH);
+}
+
+// Returns the inode of |filename|, or 0 if it doesn't exist.
+static ino_t btif_config_file_inode(const char* filename) {
+  struct stat st;
+  if (stat(filename, &st) == -1) return 0;
+  return st.st_ino;
+}
+
+// Unpaired devices are only cached in memory and are not saved.
+static bool btif_config_is_paired(const config_t* conf, const char* section) {
+  return !string_is_bdaddr(section) ||
+         config_has_key(conf, section, "LinkKey") ||
+         config_has_key(conf, section, "LE_KEY_PENC") ||
+         config_has_key(conf, section, "LE_KEY_PID") ||
+         config_has_key(conf, section, "LE_KEY_PCSRK") ||
+         config_has_key(conf, section, "LE_KEY_LENC") ||
+         config_has_key(conf, section, "LE_KEY_LCSRK");
 }
 
 static void btif_config_remove_unpaired(config_t* conf) {
@@ -478,12 +514,7 @@ static void btif_config_remove_unpaired(config_t* conf) {
   while (snode != config_section_end(conf)) {
     const char* section = config_section_name(snode);
     if (string_is_bdaddr(section)) {
-      if (!config_has_key(conf, section, "LinkKey") &&
-          !config_has_key(conf, section, "LE_KEY_PENC") &&
-          !config_has_key(conf, section, "LE_KEY_PID") &&
-          !config_has_key(conf, section, "LE_KEY_PCSRK") &&
-          !config_has_key(conf, section, "LE_KEY_LENC") &&
-          !config_has_key(conf, section, "LE_KEY_LCSRK")) {
+      if (!btif_config_is_paired(conf, section)) {
         snode = config_section_next(snode);
         config_remove_section(conf, section);
         continue;
@@ -552,6 +583,7 @@ static bool is_factory_reset(void) {
 
 static void delete_config_files(void) {
   remove(CONFIG_FILE_PATH);
+  remove(CONFIG_JOURNAL_PATH);
   remove(CONFIG_BACKUP_PATH);
   osi_property_set("persist.bluetooth.factoryreset", "false");
 }
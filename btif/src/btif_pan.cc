@@ -41,10 +41,10 @@
 #include <stdio.h>
 #include <string.h>
 #include <sys/ioctl.h>
-#include <sys/poll.h>
 #include <sys/prctl.h>
 #include <sys/select.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
@@ -149,6 +149,7 @@ static void pan_disable() {
       btpan_tap_close(btpan_cb.tap_fd);
       btpan_cb.tap_fd = INVALID_FD;
     }
+    osi_free_and_reset((void**)&btpan_cb.congest_packet);
   }
 }
 
@@ -416,18 +417,20 @@ int btpan_tap_send(int tap_fd, const BD_ADDR src, const BD_ADDR dst,
     memcpy(&eth_hdr.h_dest, dst, ETH_ADDR_LEN);
     memcpy(&eth_hdr.h_src, src, ETH_ADDR_LEN);
     eth_hdr.h_proto = htons(proto);
-    char packet[TAP_MAX_PKT_WRITE_LEN + sizeof(tETH_HDR)];
-    memcpy(packet, &eth_hdr, sizeof(tETH_HDR));
     if (len > TAP_MAX_PKT_WRITE_LEN) {
       LOG_ERROR(LOG_TAG, "btpan_tap_send eth packet size:%d is exceeded limit!",
                 len);
       return -1;
     }
-    memcpy(packet + sizeof(tETH_HDR), buf, len);
 
-    /* Send data to network interface */
+    /* Send data to network interface, the payload straight from |buf| */
+    struct iovec iov[2];
+    iov[0].iov_base = &eth_hdr;
+    iov[0].iov_len = sizeof(tETH_HDR);
+    iov[1].iov_base = (void*)buf;
+    iov[1].iov_len = len;
     ssize_t ret;
-    OSI_NO_INTR(ret = write(tap_fd, packet, len + sizeof(tETH_HDR)));
+    OSI_NO_INTR(ret = writev(tap_fd, iov, 2));
     BTIF_TRACE_DEBUG("ret:%d", ret);
     return (int)ret;
   }
@@ -550,6 +553,9 @@ static inline bool should_forward(tETH_HDR* hdr) {
   return false;
 }
 
+// Hands |hdr| to the connection |eth_hdr| is addressed to. The buffer is
+// consumed unless FORWARD_CONGEST is returned, in which case the caller keeps
+// it to send once BNEP has room again.
 static int forward_bnep(tETH_HDR* eth_hdr, BT_HDR* hdr) {
   int broadcast = eth_hdr->h_dest[0] & 1;
 
@@ -562,11 +568,15 @@ static int forward_bnep(tETH_HDR* eth_hdr, BT_HDR* hdr) {
              0 ||
          memcmp(btpan_cb.conns[i].peer, eth_hdr->h_dest, sizeof(BD_ADDR)) ==
              0)) {
+      // BNEP frees the buffers it has no room for, so check beforehand.
+      tBNEP_STATUS status;
+      if (!broadcast && BNEP_GetStatus(handle, &status) == BNEP_SUCCESS &&
+          status.xmit_q_depth >= BNEP_MAX_XMITQ_DEPTH)
+        return FORWARD_CONGEST;
+
       int result = PAN_WriteBuf(handle, eth_hdr->h_dest, eth_hdr->h_src,
                                 ntohs(eth_hdr->h_proto), hdr, 0);
       switch (result) {
-        case PAN_Q_SIZE_EXCEEDED:
-          return FORWARD_CONGEST;
         case PAN_SUCCESS:
           return FORWARD_SUCCESS;
         default:
@@ -671,9 +681,7 @@ static void bta_pan_callback(tBTA_PAN_EVT event, tBTA_PAN* p_data) {
                         sizeof(tBTA_PAN), NULL);
 }
 
-#define IS_EXCEPTION(e) ((e) & (POLLHUP | POLLRDHUP | POLLERR | POLLNVAL))
 static void btu_exec_tap_fd_read(void* p_param) {
-  struct pollfd ufd;
   int fd = PTR_TO_INT(p_param);
 
   if (fd == INVALID_FD || fd != btpan_cb.tap_fd) return;
@@ -682,26 +690,27 @@ static void btu_exec_tap_fd_read(void* p_param) {
   // give other profiles a chance to run by limiting the amount of memory
   // PAN can use.
   for (int i = 0; i < PAN_BUF_MAX && btif_is_enabled() && btpan_cb.flow; i++) {
-    BT_HDR* buffer = (BT_HDR*)osi_malloc(PAN_BUF_SIZE);
-    buffer->offset = PAN_MINIMUM_OFFSET;
-    buffer->len = PAN_BUF_SIZE - sizeof(BT_HDR) - buffer->offset;
-
-    uint8_t* packet = (uint8_t*)buffer + sizeof(BT_HDR) + buffer->offset;
-
-    // If we don't have an undelivered packet left over, pull one from the TAP
-    // driver.
-    // We save it in the congest_packet right away in case we can't deliver it
-    // in this
-    // attempt.
-    if (!btpan_cb.congest_packet_size) {
+    // Send the frame BNEP had no room for last time before reading new ones.
+    BT_HDR* buffer = btpan_cb.congest_packet;
+    btpan_cb.congest_packet = NULL;
+
+    if (!buffer) {
+      // Pull the next frame from the TAP driver straight into the buffer
+      // handed to BNEP. The fd is non-blocking, so this stops at EAGAIN
+      // rather than polling after every frame.
+      buffer = (BT_HDR*)osi_malloc(PAN_BUF_SIZE);
+      buffer->offset = PAN_MINIMUM_OFFSET;
+      uint8_t* packet = (uint8_t*)(buffer + 1) + buffer->offset;
+
       ssize_t ret;
-      OSI_NO_INTR(ret = read(fd, btpan_cb.congest_packet,
-                             sizeof(btpan_cb.congest_packet)));
+      OSI_NO_INTR(ret = read(fd, packet,
+                             PAN_BUF_SIZE - sizeof(BT_HDR) - buffer->offset));
       switch (ret) {
         case -1:
+          osi_free(buffer);
+          if (errno == EAGAIN || errno == EWOULDBLOCK) goto drained;
           BTIF_TRACE_ERROR("%s unable to read from driver: %s", __func__,
                            strerror(errno));
-          osi_free(buffer);
           // add fd back to monitor thread to try it again later
           btsock_thread_add_fd(pan_pth, fd, 0, SOCK_THREAD_FD_RD, 0);
           return;
@@ -712,45 +721,36 @@ static void btu_exec_tap_fd_read(void* p_param) {
           btsock_thread_add_fd(pan_pth, fd, 0, SOCK_THREAD_FD_RD, 0);
           return;
         default:
-          btpan_cb.congest_packet_size = ret;
+          buffer->len = ret;
           break;
       }
-    }
 
-    memcpy(packet, btpan_cb.congest_packet,
-           MIN(btpan_cb.congest_packet_size, buffer->len));
-    buffer->len = MIN(btpan_cb.congest_packet_size, buffer->len);
-
-    if (buffer->len > sizeof(tETH_HDR) && should_forward((tETH_HDR*)packet)) {
-      // Extract the ethernet header from the buffer since the PAN_WriteBuf
-      // inside
-      // forward_bnep can't handle two pointers that point inside the same GKI
-      // buffer.
-      tETH_HDR hdr;
-      memcpy(&hdr, packet, sizeof(tETH_HDR));
+      if (buffer->len <= sizeof(tETH_HDR) ||
+          !should_forward((tETH_HDR*)packet)) {
+        BTIF_TRACE_WARNING("%s dropping packet of length %d", __func__,
+                           buffer->len);
+        osi_free(buffer);
+        continue;
+      }
 
-      // Skip the ethernet header.
+      // Skip the ethernet header, BNEP builds its own header in its place.
       buffer->len -= sizeof(tETH_HDR);
       buffer->offset += sizeof(tETH_HDR);
-      if (forward_bnep(&hdr, buffer) != FORWARD_CONGEST)
-        btpan_cb.congest_packet_size = 0;
-    } else {
-      BTIF_TRACE_WARNING("%s dropping packet of length %d", __func__,
-                         buffer->len);
-      btpan_cb.congest_packet_size = 0;
-      osi_free(buffer);
     }
 
-    // Bail out of the loop if reading from the TAP fd would block.
-    ufd.fd = fd;
-    ufd.events = POLLIN;
-    ufd.revents = 0;
-
-    int ret;
-    OSI_NO_INTR(ret = poll(&ufd, 1, 0));
-    if (ret <= 0 || IS_EXCEPTION(ufd.revents)) break;
+    // Copy the ethernet header out of the buffer since the PAN_WriteBuf
+    // inside forward_bnep can't handle two pointers that point inside the
+    // same buffer.
+    tETH_HDR hdr;
+    memcpy(&hdr, (uint8_t*)(buffer + 1) + buffer->offset - sizeof(tETH_HDR),
+           sizeof(tETH_HDR));
+    if (forward_bnep(&hdr, buffer) == FORWARD_CONGEST) {
+      btpan_cb.congest_packet = buffer;
+      break;
+    }
   }
 
+drained:
   if (btpan_cb.flow) {
     // add fd back to monitor thread when the flow is on
     btsock_thread_add_fd(pan_pth, fd, 0, SOCK_THREAD_FD_RD, 0);
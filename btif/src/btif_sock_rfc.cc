@@ -26,6 +26,7 @@
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include <mutex>
@@ -65,10 +66,11 @@
 // Maximum number of devices we can have an RFCOMM connection with.
 #define MAX_RFC_SESSION 7
 
+// Maximum number of queued buffers handed to the app socket in one call.
+#define MAX_RFC_SEND_IOV 16
+
 typedef struct {
   int outgoing_congest : 1;
-  int pending_sdp_request : 1;
-  int doing_sdp_request : 1;
   int server : 1;
   int connected : 1;
   int closing : 1;
@@ -95,12 +97,20 @@ typedef struct {
   int rfc_port_handle;
   int role;
   list_t* incoming_queue;
+  // SDP lookups are done one at a time, so these are guarded by |slot_lock|.
+  bool pending_sdp_request;
+  bool doing_sdp_request;
 } rfc_slot_t;
 
 static rfc_slot_t rfc_slots[MAX_RFC_CHANNEL];
 static uint32_t rfc_slot_id;
 static volatile int pth = -1;  // poll thread handle
+
+// |slot_lock| guards allocating and looking up slots: their ids and fds, and
+// the SDP request flags. Everything else in a slot is guarded by its own lock
+// in |rfc_slot_locks|. When both are held, the slot's lock is taken first.
 static std::recursive_mutex slot_lock;
+static std::recursive_mutex rfc_slot_locks[MAX_RFC_CHANNEL];
 static uid_set_t* uid_set = NULL;
 
 static rfc_slot_t* find_free_slot(void);
@@ -137,8 +147,9 @@ void btsock_rfc_cleanup(void) {
 
   BTA_JvDisable();
 
-  std::unique_lock<std::recursive_mutex> lock(slot_lock);
   for (size_t i = 0; i < ARRAY_SIZE(rfc_slots); ++i) {
+    std::unique_lock<std::recursive_mutex> lock(rfc_slot_locks[i]);
+    std::unique_lock<std::recursive_mutex> slots(slot_lock);
     if (rfc_slots[i].id) cleanup_rfc_slot(&rfc_slots[i]);
     list_free(rfc_slots[i].incoming_queue);
     rfc_slots[i].incoming_queue = NULL;
@@ -161,11 +172,35 @@ static rfc_slot_t* find_rfc_slot_by_id(uint32_t id) {
   return NULL;
 }
 
+static std::recursive_mutex& rfc_slot_lock(const rfc_slot_t* slot) {
+  return rfc_slot_locks[slot - rfc_slots];
+}
+
+// Finds the slot with |id| and takes its lock into |lock|. Returns NULL, with
+// |lock| left alone, if there is no such slot.
+static rfc_slot_t* lock_rfc_slot_by_id(
+    uint32_t id, std::unique_lock<std::recursive_mutex>* lock) {
+  rfc_slot_t* slot;
+  {
+    std::unique_lock<std::recursive_mutex> slots(slot_lock);
+    slot = find_rfc_slot_by_id(id);
+  }
+  if (!slot) return NULL;
+
+  // The slot may have been released while waiting for its lock.
+  std::unique_lock<std::recursive_mutex> slot_guard(rfc_slot_lock(slot));
+  std::unique_lock<std::recursive_mutex> slots(slot_lock);
+  if (slot->id != id) return NULL;
+
+  *lock = std::move(slot_guard);
+  return slot;
+}
+
 static rfc_slot_t* find_rfc_slot_by_pending_sdp(void) {
   uint32_t min_id = UINT32_MAX;
   int slot = -1;
   for (size_t i = 0; i < ARRAY_SIZE(rfc_slots); ++i)
-    if (rfc_slots[i].id && rfc_slots[i].f.pending_sdp_request &&
+    if (rfc_slots[i].id && rfc_slots[i].pending_sdp_request &&
         rfc_slots[i].id < min_id) {
       min_id = rfc_slots[i].id;
       slot = i;
@@ -176,7 +211,7 @@ static rfc_slot_t* find_rfc_slot_by_pending_sdp(void) {
 
 static bool is_requesting_sdp(void) {
   for (size_t i = 0; i < ARRAY_SIZE(rfc_slots); ++i)
-    if (rfc_slots[i].id && rfc_slots[i].f.doing_sdp_request) return true;
+    if (rfc_slots[i].id && rfc_slots[i].doing_sdp_request) return true;
   return false;
 }
 
@@ -193,6 +228,7 @@ static rfc_slot_t* alloc_rfc_slot(const bt_bdaddr_t* addr, const char* name,
   if (flags & BTSOCK_FLAG_AUTH_16_DIGIT)
     security |= BTM_SEC_IN_MIN_16_DIGIT_PIN;
 
+  std::unique_lock<std::recursive_mutex> lock(slot_lock);
   rfc_slot_t* slot = find_free_slot();
   if (!slot) {
     LOG_ERROR(LOG_TAG, "%s unable to find free RFCOMM slot.", __func__);
@@ -235,10 +271,12 @@ static rfc_slot_t* alloc_rfc_slot(const bt_bdaddr_t* addr, const char* name,
   return slot;
 }
 
-static rfc_slot_t* create_srv_accept_rfc_slot(rfc_slot_t* srv_rs,
-                                              const bt_bdaddr_t* addr,
-                                              int open_handle,
-                                              int new_listen_handle) {
+// Allocates the slot of a connection accepted by the server |srv_rs|, whose
+// lock the caller holds, and takes the lock of the new slot into
+// |accept_lock|.
+static rfc_slot_t* create_srv_accept_rfc_slot(
+    rfc_slot_t* srv_rs, const bt_bdaddr_t* addr, int open_handle,
+    int new_listen_handle, std::unique_lock<std::recursive_mutex>* accept_lock) {
   rfc_slot_t* accept_rs = alloc_rfc_slot(
       addr, srv_rs->service_name, srv_rs->service_uuid, srv_rs->scn, 0, false);
   if (!accept_rs) {
@@ -246,6 +284,9 @@ static rfc_slot_t* create_srv_accept_rfc_slot(rfc_slot_t* srv_rs,
     return NULL;
   }
 
+  *accept_lock =
+      std::unique_lock<std::recursive_mutex>(rfc_slot_lock(accept_rs));
+
   accept_rs->f.server = false;
   accept_rs->f.connected = true;
   accept_rs->security = srv_rs->security;
@@ -261,6 +302,7 @@ static rfc_slot_t* create_srv_accept_rfc_slot(rfc_slot_t* srv_rs,
   CHECK(accept_rs->rfc_port_handle != srv_rs->rfc_port_handle);
 
   // now swap the slot id
+  std::unique_lock<std::recursive_mutex> slots(slot_lock);
   uint32_t new_listen_id = accept_rs->id;
   accept_rs->id = srv_rs->id;
   srv_rs->id = new_listen_id;
@@ -300,14 +342,13 @@ bt_status_t btsock_rfc_listen(const char* service_name,
     }
   }
 
-  std::unique_lock<std::recursive_mutex> lock(slot_lock);
-
   rfc_slot_t* slot =
       alloc_rfc_slot(NULL, service_name, service_uuid, channel, flags, true);
   if (!slot) {
     LOG_ERROR(LOG_TAG, "%s unable to allocate RFCOMM slot.", __func__);
     return BT_STATUS_FAIL;
   }
+  std::unique_lock<std::recursive_mutex> lock(rfc_slot_lock(slot));
   APPL_TRACE_DEBUG("BTA_JvGetChannelId: service_name: %s - channel: %d",
                    service_name, channel);
   BTA_JvGetChannelId(BTA_JV_CONN_TYPE_RFCOMM, slot->id, channel);
@@ -342,14 +383,13 @@ bt_status_t btsock_rfc_connect(const bt_bdaddr_t* bd_addr,
   // be an assert.
   if (!is_init_done()) return BT_STATUS_NOT_READY;
 
-  std::unique_lock<std::recursive_mutex> lock(slot_lock);
-
   rfc_slot_t* slot =
       alloc_rfc_slot(bd_addr, NULL, service_uuid, channel, flags, false);
   if (!slot) {
     LOG_ERROR(LOG_TAG, "%s unable to allocate RFCOMM slot.", __func__);
     return BT_STATUS_FAIL;
   }
+  std::unique_lock<std::recursive_mutex> lock(rfc_slot_lock(slot));
 
   if (is_uuid_empty(service_uuid)) {
     tBTA_JV_STATUS ret =
@@ -372,13 +412,14 @@ bt_status_t btsock_rfc_connect(const bt_bdaddr_t* bd_addr,
     sdp_uuid.len = 16;
     memcpy(sdp_uuid.uu.uuid128, service_uuid, sizeof(sdp_uuid.uu.uuid128));
 
+    std::unique_lock<std::recursive_mutex> slots(slot_lock);
     if (!is_requesting_sdp()) {
       BTA_JvStartDiscovery((uint8_t*)bd_addr->address, 1, &sdp_uuid, slot->id);
-      slot->f.pending_sdp_request = false;
-      slot->f.doing_sdp_request = true;
+      slot->pending_sdp_request = false;
+      slot->doing_sdp_request = true;
     } else {
-      slot->f.pending_sdp_request = true;
-      slot->f.doing_sdp_request = false;
+      slot->pending_sdp_request = true;
+      slot->doing_sdp_request = false;
     }
   }
 
@@ -412,11 +453,11 @@ static void free_rfc_slot_scn(rfc_slot_t* slot) {
   slot->scn = 0;
 }
 
+// Releases |slot|, whose lock the caller holds.
 static void cleanup_rfc_slot(rfc_slot_t* slot) {
   if (slot->fd != INVALID_FD) {
     shutdown(slot->fd, SHUT_RDWR);
     close(slot->fd);
-    slot->fd = INVALID_FD;
   }
 
   if (slot->app_fd != INVALID_FD) {
@@ -439,8 +480,13 @@ static void cleanup_rfc_slot(rfc_slot_t* slot) {
 
   slot->rfc_port_handle = 0;
   memset(&slot->f, 0, sizeof(slot->f));
-  slot->id = 0;
   slot->scn_notified = false;
+
+  std::unique_lock<std::recursive_mutex> slots(slot_lock);
+  slot->pending_sdp_request = false;
+  slot->doing_sdp_request = false;
+  slot->fd = INVALID_FD;
+  slot->id = 0;
 }
 
 static bool send_app_scn(rfc_slot_t* slot) {
@@ -470,8 +516,8 @@ static bool send_app_connect_signal(int fd, const bt_bdaddr_t* addr,
 }
 
 static void on_cl_rfc_init(tBTA_JV_RFCOMM_CL_INIT* p_init, uint32_t id) {
-  std::unique_lock<std::recursive_mutex> lock(slot_lock);
-  rfc_slot_t* slot = find_rfc_slot_by_id(id);
+  std::unique_lock<std::recursive_mutex> lock;
+  rfc_slot_t* slot = lock_rfc_slot_by_id(id, &lock);
   if (!slot) return;
 
   if (p_init->status == BTA_JV_SUCCESS) {
@@ -483,8 +529,8 @@ static void on_cl_rfc_init(tBTA_JV_RFCOMM_CL_INIT* p_init, uint32_t id) {
 
 static void on_srv_rfc_listen_started(tBTA_JV_RFCOMM_START* p_start,
                                       uint32_t id) {
-  std::unique_lock<std::recursive_mutex> lock(slot_lock);
-  rfc_slot_t* slot = find_rfc_slot_by_id(id);
+  std::unique_lock<std::recursive_mutex> lock;
+  rfc_slot_t* slot = lock_rfc_slot_by_id(id, &lock);
   if (!slot) return;
 
   if (p_start->status == BTA_JV_SUCCESS) {
@@ -496,14 +542,15 @@ static void on_srv_rfc_listen_started(tBTA_JV_RFCOMM_START* p_start,
 
 static uint32_t on_srv_rfc_connect(tBTA_JV_RFCOMM_SRV_OPEN* p_open,
                                    uint32_t id) {
-  std::unique_lock<std::recursive_mutex> lock(slot_lock);
+  std::unique_lock<std::recursive_mutex> lock;
+  std::unique_lock<std::recursive_mutex> accept_lock;
   rfc_slot_t* accept_rs;
-  rfc_slot_t* srv_rs = find_rfc_slot_by_id(id);
+  rfc_slot_t* srv_rs = lock_rfc_slot_by_id(id, &lock);
   if (!srv_rs) return 0;
 
-  accept_rs =
-      create_srv_accept_rfc_slot(srv_rs, (const bt_bdaddr_t*)p_open->rem_bda,
-                                 p_open->handle, p_open->new_listen_handle);
+  accept_rs = create_srv_accept_rfc_slot(
+      srv_rs, (const bt_bdaddr_t*)p_open->rem_bda, p_open->handle,
+      p_open->new_listen_handle, &accept_lock);
   if (!accept_rs) return 0;
 
   // Start monitoring the socket.
@@ -519,8 +566,8 @@ static uint32_t on_srv_rfc_connect(tBTA_JV_RFCOMM_SRV_OPEN* p_open,
 }
 
 static void on_cli_rfc_connect(tBTA_JV_RFCOMM_OPEN* p_open, uint32_t id) {
-  std::unique_lock<std::recursive_mutex> lock(slot_lock);
-  rfc_slot_t* slot = find_rfc_slot_by_id(id);
+  std::unique_lock<std::recursive_mutex> lock;
+  rfc_slot_t* slot = lock_rfc_slot_by_id(id, &lock);
   if (!slot) return;
 
   if (p_open->status != BTA_JV_SUCCESS) {
@@ -541,10 +588,10 @@ static void on_cli_rfc_connect(tBTA_JV_RFCOMM_OPEN* p_open, uint32_t id) {
 
 static void on_rfc_close(UNUSED_ATTR tBTA_JV_RFCOMM_CLOSE* p_close,
                          uint32_t id) {
-  std::unique_lock<std::recursive_mutex> lock(slot_lock);
+  std::unique_lock<std::recursive_mutex> lock;
 
   // rfc_handle already closed when receiving rfcomm close event from stack.
-  rfc_slot_t* slot = find_rfc_slot_by_id(id);
+  rfc_slot_t* slot = lock_rfc_slot_by_id(id, &lock);
   if (slot) cleanup_rfc_slot(slot);
 }
 
@@ -556,9 +603,8 @@ static void on_rfc_write_done(tBTA_JV_RFCOMM_WRITE* p, uint32_t id) {
   }
 
   int app_uid = -1;
-  std::unique_lock<std::recursive_mutex> lock(slot_lock);
-
-  rfc_slot_t* slot = find_rfc_slot_by_id(id);
+  std::unique_lock<std::recursive_mutex> lock;
+  rfc_slot_t* slot = lock_rfc_slot_by_id(id, &lock);
   if (slot) {
     app_uid = slot->app_uid;
     if (!slot->f.outgoing_congest) {
@@ -571,9 +617,8 @@ static void on_rfc_write_done(tBTA_JV_RFCOMM_WRITE* p, uint32_t id) {
 }
 
 static void on_rfc_outgoing_congest(tBTA_JV_RFCOMM_CONG* p, uint32_t id) {
-  std::unique_lock<std::recursive_mutex> lock(slot_lock);
-
-  rfc_slot_t* slot = find_rfc_slot_by_id(id);
+  std::unique_lock<std::recursive_mutex> lock;
+  rfc_slot_t* slot = lock_rfc_slot_by_id(id, &lock);
   if (slot) {
     slot->f.outgoing_congest = p->cong ? 1 : 0;
     if (!slot->f.outgoing_congest)
@@ -636,8 +681,8 @@ static uint32_t rfcomm_cback(tBTA_JV_EVT event, tBTA_JV* p_data,
 static void jv_dm_cback(tBTA_JV_EVT event, tBTA_JV* p_data, uint32_t id) {
   switch (event) {
     case BTA_JV_GET_SCN_EVT: {
-      std::unique_lock<std::recursive_mutex> lock(slot_lock);
-      rfc_slot_t* rs = find_rfc_slot_by_id(id);
+      std::unique_lock<std::recursive_mutex> lock;
+      rfc_slot_t* rs = lock_rfc_slot_by_id(id, &lock);
       int new_scn = p_data->scn;
 
       if (rs && (new_scn != 0)) {
@@ -687,8 +732,8 @@ static void jv_dm_cback(tBTA_JV_EVT event, tBTA_JV* p_data, uint32_t id) {
       break;
     }
     case BTA_JV_CREATE_RECORD_EVT: {
-      std::unique_lock<std::recursive_mutex> lock(slot_lock);
-      rfc_slot_t* slot = find_rfc_slot_by_id(id);
+      std::unique_lock<std::recursive_mutex> lock;
+      rfc_slot_t* slot = lock_rfc_slot_by_id(id, &lock);
 
       if (slot && create_server_sdp_record(slot)) {
         // Start the rfcomm server after sdp & channel # assigned.
@@ -703,17 +748,23 @@ static void jv_dm_cback(tBTA_JV_EVT event, tBTA_JV* p_data, uint32_t id) {
     }
 
     case BTA_JV_DISCOVERY_COMP_EVT: {
-      std::unique_lock<std::recursive_mutex> lock(slot_lock);
-      rfc_slot_t* slot = find_rfc_slot_by_id(id);
+      std::unique_lock<std::recursive_mutex> lock;
+      rfc_slot_t* slot = lock_rfc_slot_by_id(id, &lock);
       if (p_data->disc_comp.status == BTA_JV_SUCCESS && p_data->disc_comp.scn) {
-        if (slot && slot->f.doing_sdp_request) {
+        bool doing_sdp_request = false;
+        if (slot) {
+          std::unique_lock<std::recursive_mutex> slots(slot_lock);
+          doing_sdp_request = slot->doing_sdp_request;
+          slot->doing_sdp_request = false;
+        }
+
+        if (doing_sdp_request) {
           // Establish the connection if we successfully looked up a channel
           // number to connect to.
           if (BTA_JvRfcommConnect(slot->security, slot->role,
                                   p_data->disc_comp.scn, slot->addr.address,
                                   rfcomm_cback, slot->id) == BTA_JV_SUCCESS) {
             slot->scn = p_data->disc_comp.scn;
-            slot->f.doing_sdp_request = false;
             if (!send_app_scn(slot)) cleanup_rfc_slot(slot);
           } else {
             cleanup_rfc_slot(slot);
@@ -730,7 +781,9 @@ static void jv_dm_cback(tBTA_JV_EVT event, tBTA_JV* p_data, uint32_t id) {
         cleanup_rfc_slot(slot);
       }
 
-      // Find the next slot that needs to perform an SDP request and service it.
+      // Find the next slot that needs to perform an SDP request and service
+      // it. Its address and UUID don't change while the request is pending.
+      std::unique_lock<std::recursive_mutex> slots(slot_lock);
       slot = find_rfc_slot_by_pending_sdp();
       if (slot) {
         tSDP_UUID sdp_uuid;
@@ -739,8 +792,8 @@ static void jv_dm_cback(tBTA_JV_EVT event, tBTA_JV* p_data, uint32_t id) {
                sizeof(sdp_uuid.uu.uuid128));
         BTA_JvStartDiscovery((uint8_t*)slot->addr.address, 1, &sdp_uuid,
                              slot->id);
-        slot->f.pending_sdp_request = false;
-        slot->f.doing_sdp_request = true;
+        slot->pending_sdp_request = false;
+        slot->doing_sdp_request = true;
       }
       break;
     }
@@ -758,48 +811,73 @@ typedef enum {
   SENT_ALL,
 } sent_status_t;
 
-static sent_status_t send_data_to_app(int fd, BT_HDR* p_buf) {
-  if (p_buf->len == 0) return SENT_ALL;
+// Sends as much of |slot->incoming_queue| as the app socket takes, gathering
+// up to MAX_RFC_SEND_IOV buffers per call. Buffers sent are freed.
+static sent_status_t send_data_to_app(rfc_slot_t* slot) {
+  list_t* queue = slot->incoming_queue;
+  sent_status_t status = SENT_NONE;
+
+  while (!list_is_empty(queue)) {
+    struct iovec iov[MAX_RFC_SEND_IOV];
+    int iovcnt = 0;
+    size_t len = 0;
+
+    for (const list_node_t* node = list_begin(queue);
+         node != list_end(queue) && iovcnt < MAX_RFC_SEND_IOV;
+         node = list_next(node)) {
+      BT_HDR* p_buf = (BT_HDR*)list_node(node);
+      iov[iovcnt].iov_base = p_buf->data + p_buf->offset;
+      iov[iovcnt++].iov_len = p_buf->len;
+      len += p_buf->len;
+    }
 
-  ssize_t sent;
-  OSI_NO_INTR(
-      sent = send(fd, p_buf->data + p_buf->offset, p_buf->len, MSG_DONTWAIT));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iovcnt;
 
-  if (sent == -1) {
-    if (errno == EAGAIN || errno == EWOULDBLOCK) return SENT_NONE;
-    LOG_ERROR(LOG_TAG, "%s error writing RFCOMM data back to app: %s", __func__,
-              strerror(errno));
-    return SENT_FAILED;
-  }
+    ssize_t sent = 0;
+    if (len) OSI_NO_INTR(sent = sendmsg(slot->fd, &msg, MSG_DONTWAIT));
+
+    if (sent == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) return status;
+      LOG_ERROR(LOG_TAG, "%s error writing RFCOMM data back to app: %s",
+                __func__, strerror(errno));
+      return SENT_FAILED;
+    }
 
-  if (sent == 0) return SENT_FAILED;
+    if (sent == 0 && len) return SENT_FAILED;
 
-  if (sent == p_buf->len) return SENT_ALL;
+    for (int i = 0; i < iovcnt; i++) {
+      BT_HDR* p_buf = (BT_HDR*)list_front(queue);
+      if ((size_t)sent < p_buf->len) {
+        p_buf->offset += sent;
+        p_buf->len -= sent;
+        return SENT_PARTIAL;
+      }
+      sent -= p_buf->len;
+      list_remove(queue, p_buf);
+    }
+    status = SENT_PARTIAL;
+  }
 
-  p_buf->offset += sent;
-  p_buf->len -= sent;
-  return SENT_PARTIAL;
+  return SENT_ALL;
 }
 
 static bool flush_incoming_que_on_wr_signal(rfc_slot_t* slot) {
-  while (!list_is_empty(slot->incoming_queue)) {
-    BT_HDR* p_buf = (BT_HDR*)list_front(slot->incoming_queue);
-    switch (send_data_to_app(slot->fd, p_buf)) {
-      case SENT_NONE:
-      case SENT_PARTIAL:
-        // monitor the fd to get callback when app is ready to receive data
-        btsock_thread_add_fd(pth, slot->fd, BTSOCK_RFCOMM, SOCK_THREAD_FD_WR,
-                             slot->id);
-        return true;
+  switch (send_data_to_app(slot)) {
+    case SENT_NONE:
+    case SENT_PARTIAL:
+      // monitor the fd to get callback when app is ready to receive data
+      btsock_thread_add_fd(pth, slot->fd, BTSOCK_RFCOMM, SOCK_THREAD_FD_WR,
+                           slot->id);
+      return true;
 
-      case SENT_ALL:
-        list_remove(slot->incoming_queue, p_buf);
-        break;
+    case SENT_ALL:
+      break;
 
-      case SENT_FAILED:
-        list_remove(slot->incoming_queue, p_buf);
-        return false;
-    }
+    case SENT_FAILED:
+      return false;
   }
 
   // app is ready to receive data, tell stack to start the data flow
@@ -813,8 +891,8 @@ static bool flush_incoming_que_on_wr_signal(rfc_slot_t* slot) {
 
 void btsock_rfc_signaled(UNUSED_ATTR int fd, int flags, uint32_t user_id) {
   bool need_close = false;
-  std::unique_lock<std::recursive_mutex> lock(slot_lock);
-  rfc_slot_t* slot = find_rfc_slot_by_id(user_id);
+  std::unique_lock<std::recursive_mutex> lock;
+  rfc_slot_t* slot = lock_rfc_slot_by_id(user_id, &lock);
   if (!slot) return;
 
   // Data available from app, tell stack we have outgoing data.
@@ -858,34 +936,33 @@ int bta_co_rfc_data_incoming(uint32_t id, BT_HDR* p_buf) {
   int app_uid = -1;
   uint64_t bytes_rx = 0;
   int ret = 0;
-  std::unique_lock<std::recursive_mutex> lock(slot_lock);
-  rfc_slot_t* slot = find_rfc_slot_by_id(id);
+  std::unique_lock<std::recursive_mutex> lock;
+  rfc_slot_t* slot = lock_rfc_slot_by_id(id, &lock);
   if (!slot) return 0;
 
   app_uid = slot->app_uid;
   bytes_rx = p_buf->len;
 
-  if (list_is_empty(slot->incoming_queue)) {
-    switch (send_data_to_app(slot->fd, p_buf)) {
+  // Buffers already queued go out first, when the app socket has room.
+  bool queue_was_empty = list_is_empty(slot->incoming_queue);
+  list_append(slot->incoming_queue, p_buf);
+
+  if (queue_was_empty) {
+    switch (send_data_to_app(slot)) {
       case SENT_NONE:
       case SENT_PARTIAL:
-        list_append(slot->incoming_queue, p_buf);
         btsock_thread_add_fd(pth, slot->fd, BTSOCK_RFCOMM, SOCK_THREAD_FD_WR,
                              slot->id);
         break;
 
       case SENT_ALL:
-        osi_free(p_buf);
         ret = 1;  // Enable data flow.
         break;
 
       case SENT_FAILED:
-        osi_free(p_buf);
         cleanup_rfc_slot(slot);
         break;
     }
-  } else {
-    list_append(slot->incoming_queue, p_buf);
   }
 
   uid_set_add_rx(uid_set, app_uid, bytes_rx);
@@ -895,8 +972,8 @@ int bta_co_rfc_data_incoming(uint32_t id, BT_HDR* p_buf) {
 
 int bta_co_rfc_data_outgoing_size(uint32_t id, int* size) {
   *size = 0;
-  std::unique_lock<std::recursive_mutex> lock(slot_lock);
-  rfc_slot_t* slot = find_rfc_slot_by_id(id);
+  std::unique_lock<std::recursive_mutex> lock;
+  rfc_slot_t* slot = lock_rfc_slot_by_id(id, &lock);
   if (!slot) return false;
 
   if (ioctl(slot->fd, FIONREAD, size) != 0) {
@@ -911,8 +988,8 @@ int bta_co_rfc_data_outgoing_size(uint32_t id, int* size) {
 }
 
 int bta_co_rfc_data_outgoing(uint32_t id, uint8_t* buf, uint16_t size) {
-  std::unique_lock<std::recursive_mutex> lock(slot_lock);
-  rfc_slot_t* slot = find_rfc_slot_by_id(id);
+  std::unique_lock<std::recursive_mutex> lock;
+  rfc_slot_t* slot = lock_rfc_slot_by_id(id, &lock);
   if (!slot) return false;
 
   ssize_t received;
@@ -927,3 +1004,25 @@ int bta_co_rfc_data_outgoing(uint32_t id, uint8_t* buf, uint16_t size) {
 
   return true;
 }
+
+int bta_co_rfc_data_outgoing_vec(uint32_t id, const struct iovec* iov,
+                                 int iovcnt) {
+  std::unique_lock<std::recursive_mutex> lock;
+  rfc_slot_t* slot = lock_rfc_slot_by_id(id, &lock);
+  if (!slot) return false;
+
+  ssize_t size = 0;
+  for (int i = 0; i < iovcnt; i++) size += iov[i].iov_len;
+
+  ssize_t received;
+  OSI_NO_INTR(received = readv(slot->fd, iov, iovcnt));
+
+  if (received != size) {
+    LOG_ERROR(LOG_TAG, "%s error receiving RFCOMM data from app: %s", __func__,
+              strerror(errno));
+    cleanup_rfc_slot(slot);
+    return false;
+  }
+
+  return true;
+}
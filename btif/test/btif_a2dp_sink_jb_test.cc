@@ -0,0 +1,259 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2017 Google, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include "btif/include/btif_a2dp_sink_jb.h"
+#include "osi/include/allocator.h"
+
+#define SAMPLE_RATE 44100
+#define PACKET_SAMPLES 128
+#define PACKET_US (PACKET_SAMPLES * 1000000LL / SAMPLE_RATE)
+
+// Decodes a packet to |num_samples| samples counting up from the value in
+// |layer_specific|, the same on both channels.
+static uint32_t fake_decode(tBT_SBC_HDR* p_msg, int16_t* pcm,
+                            uint32_t max_samples) {
+  uint32_t num_samples = p_msg->num_samples;
+  if (num_samples > max_samples) num_samples = max_samples;
+  for (uint32_t i = 0; i < num_samples; i++) {
+    pcm[i * 2] = (int16_t)(p_msg->layer_specific + i);
+    pcm[i * 2 + 1] = (int16_t)(p_msg->layer_specific + i);
+  }
+  return num_samples;
+}
+
+class BtifA2dpSinkJbTest : public ::testing::Test {
+ protected:
+  btif_a2dp_sink_jb_t* jb;
+
+  void SetUp() override {
+    jb = (btif_a2dp_sink_jb_t*)osi_malloc(sizeof(*jb));
+    btif_a2dp_sink_jb_init(jb, fake_decode);
+    btif_a2dp_sink_jb_start_stream(jb, SAMPLE_RATE);
+  }
+
+  void TearDown() override {
+    btif_a2dp_sink_jb_cleanup(jb);
+    osi_free(jb);
+  }
+
+  void Admit(uint32_t time_stamp, uint64_t arrival_us, uint16_t first_value,
+             uint32_t num_samples = PACKET_SAMPLES) {
+    tBT_SBC_HDR* p_msg = (tBT_SBC_HDR*)osi_calloc(sizeof(tBT_SBC_HDR));
+    p_msg->time_stamp = time_stamp;
+    p_msg->num_samples = num_samples;
+    p_msg->arrival_us = arrival_us;
+    p_msg->layer_specific = first_value;
+    btif_a2dp_sink_jb_admit_packet(jb, p_msg);
+  }
+
+  // Admits |count| packets whose timestamps advance by |ts_step|, arriving
+  // a packet's worth of time apart.
+  void AdmitSteady(size_t count, uint32_t ts_step) {
+    for (size_t i = 0; i < count; i++)
+      Admit(1000 + i * ts_step, i * PACKET_US, 0);
+  }
+
+  // Starts playout at |play_ts| with an empty FIFO.
+  void Play(uint32_t play_ts) {
+    jb->playing = true;
+    jb->play_ts = play_ts;
+    jb->pcm_len = 0;
+  }
+};
+
+TEST_F(BtifA2dpSinkJbTest, clock_counting_samples_is_trusted) {
+  AdmitSteady(4, PACKET_SAMPLES);
+  EXPECT_EQ(BTIF_A2DP_SINK_JB_CLOCK_UNKNOWN, jb->clock);
+
+  Admit(1000 + 4 * PACKET_SAMPLES, 4 * PACKET_US, 0);
+  EXPECT_EQ(BTIF_A2DP_SINK_JB_CLOCK_SAMPLES, jb->clock);
+}
+
+TEST_F(BtifA2dpSinkJbTest, clock_survives_lost_packet) {
+  Admit(0, 0, 0);
+  Admit(1 * PACKET_SAMPLES, 1 * PACKET_US, 0);
+  Admit(3 * PACKET_SAMPLES, 3 * PACKET_US, 0); /* one lost */
+  Admit(4 * PACKET_SAMPLES, 4 * PACKET_US, 0);
+  Admit(5 * PACKET_SAMPLES, 5 * PACKET_US, 0);
+
+  EXPECT_EQ(BTIF_A2DP_SINK_JB_CLOCK_SAMPLES, jb->clock);
+  EXPECT_EQ(5u, list_length(jb->packets));
+}
+
+TEST_F(BtifA2dpSinkJbTest, clock_counting_frames_plays_in_arrival_order) {
+  /* The timestamp advances by one per packet */
+  AdmitSteady(6, 1);
+
+  EXPECT_EQ(BTIF_A2DP_SINK_JB_CLOCK_ARRIVAL, jb->clock);
+  uint32_t expected_ts = 1000;
+  for (const list_node_t* node = list_begin(jb->packets);
+       node != list_end(jb->packets); node = list_next(node)) {
+    EXPECT_EQ(expected_ts, ((tBT_SBC_HDR*)list_node(node))->time_stamp);
+    expected_ts += PACKET_SAMPLES;
+  }
+  EXPECT_EQ(6 * PACKET_SAMPLES, btif_a2dp_sink_jb_depth(jb));
+}
+
+TEST_F(BtifA2dpSinkJbTest, clock_is_checked_again_for_next_stream) {
+  AdmitSteady(6, 1);
+  EXPECT_EQ(BTIF_A2DP_SINK_JB_CLOCK_ARRIVAL, jb->clock);
+
+  btif_a2dp_sink_jb_start_stream(jb, SAMPLE_RATE);
+  EXPECT_EQ(BTIF_A2DP_SINK_JB_CLOCK_UNKNOWN, jb->clock);
+  EXPECT_TRUE(list_is_empty(jb->packets));
+
+  AdmitSteady(6, PACKET_SAMPLES);
+  EXPECT_EQ(BTIF_A2DP_SINK_JB_CLOCK_SAMPLES, jb->clock);
+}
+
+TEST_F(BtifA2dpSinkJbTest, unknown_clock_does_not_play) {
+  /* Far more than the target depth, on a timeline not checked yet */
+  Admit(0, 0, 0, 15 * PACKET_SAMPLES);
+  Admit(15 * PACKET_SAMPLES, PACKET_US, 0, 15 * PACKET_SAMPLES);
+
+  EXPECT_EQ(0u, btif_a2dp_sink_jb_tick(jb));
+  EXPECT_FALSE(jb->playing);
+}
+
+TEST_F(BtifA2dpSinkJbTest, steady_arrival_has_no_jitter) {
+  AdmitSteady(40, PACKET_SAMPLES);
+
+  /* Rounding of the packet time leaves less than a microsecond */
+  EXPECT_LE(jb->jitter_us, 1);
+  EXPECT_EQ(2u * BTIF_A2DP_SINK_JB_TICK_MS, jb->target_ms);
+}
+
+TEST_F(BtifA2dpSinkJbTest, jitter_estimate_follows_transit_changes) {
+  /* Every other packet is 5 ms late, so each transit time differs from the
+   * previous one by 5 ms */
+  const int64_t delay_us = 5000;
+  for (int i = 0; i < 200; i++)
+    Admit(i * PACKET_SAMPLES, i * PACKET_US + (i % 2) * delay_us, 0);
+
+  EXPECT_NEAR(delay_us, jb->jitter_us, delay_us / 20);
+  EXPECT_NEAR(2 * BTIF_A2DP_SINK_JB_TICK_MS + 4 * delay_us / 1000,
+              jb->target_ms, 1);
+}
+
+TEST_F(BtifA2dpSinkJbTest, gap_is_concealed_with_silence) {
+  Admit(0, 0, 100);
+  Admit(2 * PACKET_SAMPLES, 2 * PACKET_US, 500); /* one missing */
+  Play(0);
+
+  EXPECT_TRUE(btif_a2dp_sink_jb_fill(jb, 3 * PACKET_SAMPLES));
+  EXPECT_EQ(3u * PACKET_SAMPLES, jb->pcm_len);
+  EXPECT_EQ(100, jb->pcm[0]);
+  EXPECT_EQ(100 + PACKET_SAMPLES - 1, jb->pcm[(PACKET_SAMPLES - 1) * 2]);
+  for (uint32_t i = PACKET_SAMPLES; i < 2 * PACKET_SAMPLES; i++)
+    EXPECT_EQ(0, jb->pcm[i * 2]);
+  EXPECT_EQ(500, jb->pcm[2 * PACKET_SAMPLES * 2]);
+  EXPECT_EQ((uint64_t)PACKET_SAMPLES, jb->stats.concealed_samples);
+  EXPECT_EQ(0u, jb->stats.late_packets);
+}
+
+TEST_F(BtifA2dpSinkJbTest, late_samples_are_trimmed) {
+  Admit(0, 0, 100);
+  /* Playout is already 32 samples into the packet */
+  Play(32);
+
+  EXPECT_TRUE(btif_a2dp_sink_jb_fill(jb, PACKET_SAMPLES - 32));
+  EXPECT_EQ((uint32_t)PACKET_SAMPLES - 32, jb->pcm_len);
+  EXPECT_EQ(100 + 32, jb->pcm[0]);
+  EXPECT_EQ(1u, jb->stats.late_packets);
+  EXPECT_TRUE(list_is_empty(jb->packets));
+}
+
+TEST_F(BtifA2dpSinkJbTest, packet_past_playout_is_dropped) {
+  Admit(0, 0, 100);
+  Admit(PACKET_SAMPLES, PACKET_US, 500);
+  /* The first packet is entirely behind the playout point */
+  Play(PACKET_SAMPLES);
+
+  EXPECT_TRUE(btif_a2dp_sink_jb_fill(jb, PACKET_SAMPLES));
+  EXPECT_EQ(500, jb->pcm[0]);
+  EXPECT_EQ(1u, jb->stats.late_packets);
+  EXPECT_EQ((uint64_t)0, jb->stats.concealed_samples);
+}
+
+TEST_F(BtifA2dpSinkJbTest, running_out_conceals_the_rest) {
+  Admit(0, 0, 100);
+  Play(0);
+
+  EXPECT_FALSE(btif_a2dp_sink_jb_fill(jb, 2 * PACKET_SAMPLES));
+  EXPECT_EQ(2u * PACKET_SAMPLES, jb->pcm_len);
+  EXPECT_EQ((uint64_t)PACKET_SAMPLES, jb->stats.concealed_samples);
+}
+
+TEST_F(BtifA2dpSinkJbTest, drift_follows_depth_within_bounds) {
+  EXPECT_EQ(0, btif_a2dp_sink_jb_drift_ppm(40, 40));
+  EXPECT_EQ(200, btif_a2dp_sink_jb_drift_ppm(50, 40));
+  EXPECT_EQ(-200, btif_a2dp_sink_jb_drift_ppm(30, 40));
+  EXPECT_EQ(2000, btif_a2dp_sink_jb_drift_ppm(1000, 40));
+  EXPECT_EQ(-2000, btif_a2dp_sink_jb_drift_ppm(0, 300));
+}
+
+TEST_F(BtifA2dpSinkJbTest, resample_at_unit_step_copies) {
+  int16_t in[10 * 2];
+  int16_t out[8 * 2];
+  for (int i = 0; i < 10 * 2; i++) in[i] = (int16_t)(i * 7);
+
+  uint64_t end = btif_a2dp_sink_jb_resample(in, out, 8, 0, 1ULL << 32);
+
+  EXPECT_EQ(8ULL << 32, end);
+  for (int i = 0; i < 8 * 2; i++) EXPECT_EQ(in[i], out[i]);
+}
+
+TEST_F(BtifA2dpSinkJbTest, resample_interpolates_between_samples) {
+  int16_t in[6 * 2];
+  int16_t out[8 * 2];
+  for (int i = 0; i < 6; i++) {
+    in[i * 2] = (int16_t)(i * 100);
+    in[i * 2 + 1] = (int16_t)(-i * 100);
+  }
+
+  /* Half a sample per step, starting a quarter of a sample in */
+  uint64_t end =
+      btif_a2dp_sink_jb_resample(in, out, 8, 1ULL << 30, 1ULL << 31);
+
+  EXPECT_EQ((1ULL << 30) + (8ULL << 31), end);
+  for (int i = 0; i < 8; i++) {
+    EXPECT_EQ(25 + i * 50, out[i * 2]);
+    EXPECT_EQ(-25 - i * 50, out[i * 2 + 1]);
+  }
+}
+
+TEST_F(BtifA2dpSinkJbTest, tick_consumes_at_corrected_rate) {
+  /* Buffer well past the target, so playout speeds up */
+  AdmitSteady(60, PACKET_SAMPLES);
+  ASSERT_EQ(BTIF_A2DP_SINK_JB_CLOCK_SAMPLES, jb->clock);
+  const uint32_t out_samples = SAMPLE_RATE * BTIF_A2DP_SINK_JB_TICK_MS / 1000;
+  const uint32_t start_ts =
+      ((tBT_SBC_HDR*)list_front(jb->packets))->time_stamp;
+
+  const int ticks = 4;
+  for (int i = 0; i < ticks; i++)
+    EXPECT_EQ(out_samples, btif_a2dp_sink_jb_tick(jb));
+
+  /* Playout moved further through the input than it played out */
+  uint64_t position = ((uint64_t)(jb->play_ts - start_ts) << 32) + jb->phase;
+  EXPECT_GT(jb->drift_ppm, 0);
+  EXPECT_GT(position, (uint64_t)ticks * out_samples << 32);
+  EXPECT_EQ((uint64_t)0, jb->stats.concealed_samples);
+}
@@ -0,0 +1,208 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2017 Google, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include "btif/include/btif_a2dp_source_tx.h"
+#include "osi/include/allocator.h"
+
+#define STREAM_1 (BTA_AV_CHNL_AUDIO | 1)
+#define STREAM_2 (BTA_AV_CHNL_AUDIO | 2)
+#define MAX_FRAMES 4
+
+class BtifA2dpSourceTxTest : public ::testing::Test {
+ protected:
+  void SetUp() override { btif_a2dp_source_tx_init(); }
+
+  void TearDown() override { btif_a2dp_source_tx_cleanup(); }
+
+  // Queues a packet of |frames_n| frames whose one payload byte is |value|.
+  bool Enqueue(uint8_t value, size_t frames_n = 1) {
+    BT_HDR* p_buf = (BT_HDR*)osi_malloc(sizeof(BT_HDR) + 2);
+    p_buf->offset = 1;
+    p_buf->len = 1;
+    p_buf->data[1] = value;
+    return btif_a2dp_source_tx_enqueue(p_buf, frames_n, MAX_FRAMES, &drops);
+  }
+
+  // Reads the next packet of stream |hndl| and returns its payload byte, or
+  // -1 if there is none.
+  int Read(tBTA_AV_HNDL hndl) {
+    BT_HDR* p_buf = btif_a2dp_source_tx_readbuf(hndl);
+    if (p_buf == NULL) return -1;
+    int value = p_buf->data[p_buf->offset];
+    osi_free(p_buf);
+    return value;
+  }
+
+  btif_a2dp_source_tx_drops_t drops;
+};
+
+TEST_F(BtifA2dpSourceTxTest, streams_start_stopped_and_empty) {
+  EXPECT_FALSE(btif_a2dp_source_tx_is_streaming(STREAM_1));
+  EXPECT_FALSE(btif_a2dp_source_tx_is_streaming(STREAM_2));
+  EXPECT_EQ(0u, btif_a2dp_source_tx_queue_length());
+  EXPECT_EQ(-1, Read(STREAM_1));
+
+  /* Nothing is queued without a started stream */
+  EXPECT_FALSE(Enqueue(1));
+  EXPECT_EQ(-1, Read(STREAM_1));
+}
+
+TEST_F(BtifA2dpSourceTxTest, invalid_handle) {
+  const tBTA_AV_HNDL hndl = BTA_AV_CHNL_AUDIO | (BTA_AV_NUM_STRS + 1);
+
+  EXPECT_FALSE(btif_a2dp_source_tx_start_stream(hndl));
+  EXPECT_FALSE(btif_a2dp_source_tx_stop_stream(hndl));
+  EXPECT_FALSE(btif_a2dp_source_tx_start_stream(BTA_AV_CHNL_AUDIO));
+  EXPECT_EQ(-1, Read(hndl));
+}
+
+TEST_F(BtifA2dpSourceTxTest, start_flushes_leftovers) {
+  ASSERT_TRUE(btif_a2dp_source_tx_start_stream(STREAM_1));
+  EXPECT_TRUE(Enqueue(1));
+  EXPECT_TRUE(Enqueue(2));
+
+  /* Restarting discards what the stream did not send */
+  ASSERT_TRUE(btif_a2dp_source_tx_start_stream(STREAM_1));
+  EXPECT_EQ(-1, Read(STREAM_1));
+
+  EXPECT_TRUE(Enqueue(3));
+  EXPECT_EQ(3, Read(STREAM_1));
+}
+
+TEST_F(BtifA2dpSourceTxTest, stop_flushes_and_stops_queueing) {
+  ASSERT_TRUE(btif_a2dp_source_tx_start_stream(STREAM_1));
+  EXPECT_TRUE(Enqueue(1));
+
+  ASSERT_TRUE(btif_a2dp_source_tx_stop_stream(STREAM_1));
+  EXPECT_FALSE(btif_a2dp_source_tx_is_streaming(STREAM_1));
+  EXPECT_EQ(-1, Read(STREAM_1));
+
+  EXPECT_FALSE(Enqueue(2));
+  EXPECT_EQ(-1, Read(STREAM_1));
+}
+
+TEST_F(BtifA2dpSourceTxTest, each_started_stream_gets_a_copy) {
+  ASSERT_TRUE(btif_a2dp_source_tx_start_stream(STREAM_1));
+  ASSERT_TRUE(btif_a2dp_source_tx_start_stream(STREAM_2));
+  EXPECT_TRUE(Enqueue(1));
+  EXPECT_TRUE(Enqueue(2));
+
+  BT_HDR* p_buf_1 = btif_a2dp_source_tx_readbuf(STREAM_1);
+  BT_HDR* p_buf_2 = btif_a2dp_source_tx_readbuf(STREAM_2);
+  ASSERT_NE(nullptr, p_buf_1);
+  ASSERT_NE(nullptr, p_buf_2);
+  EXPECT_NE(p_buf_1, p_buf_2);
+  EXPECT_EQ(1, p_buf_1->data[p_buf_1->offset]);
+  EXPECT_EQ(1, p_buf_2->data[p_buf_2->offset]);
+  osi_free(p_buf_1);
+  osi_free(p_buf_2);
+
+  EXPECT_EQ(2, Read(STREAM_1));
+  EXPECT_EQ(2, Read(STREAM_2));
+}
+
+TEST_F(BtifA2dpSourceTxTest, readbuf_reads_the_stream_asked_for) {
+  ASSERT_TRUE(btif_a2dp_source_tx_start_stream(STREAM_1));
+  EXPECT_TRUE(Enqueue(1));
+  ASSERT_TRUE(btif_a2dp_source_tx_start_stream(STREAM_2));
+  EXPECT_TRUE(Enqueue(2));
+
+  EXPECT_EQ(2, Read(STREAM_2));
+  EXPECT_EQ(-1, Read(STREAM_2));
+  EXPECT_EQ(1, Read(STREAM_1));
+  EXPECT_EQ(2, Read(STREAM_1));
+}
+
+TEST_F(BtifA2dpSourceTxTest, first_stream_is_the_lowest_started) {
+  ASSERT_TRUE(btif_a2dp_source_tx_start_stream(STREAM_2));
+  EXPECT_TRUE(btif_a2dp_source_tx_is_first_stream(STREAM_1));
+  EXPECT_TRUE(btif_a2dp_source_tx_is_first_stream(STREAM_2));
+
+  ASSERT_TRUE(btif_a2dp_source_tx_start_stream(STREAM_1));
+  EXPECT_TRUE(btif_a2dp_source_tx_is_first_stream(STREAM_1));
+  EXPECT_FALSE(btif_a2dp_source_tx_is_first_stream(STREAM_2));
+}
+
+TEST_F(BtifA2dpSourceTxTest, queue_length_follows_the_slowest_stream) {
+  ASSERT_TRUE(btif_a2dp_source_tx_start_stream(STREAM_1));
+  ASSERT_TRUE(btif_a2dp_source_tx_start_stream(STREAM_2));
+  EXPECT_TRUE(Enqueue(1));
+  EXPECT_TRUE(Enqueue(2));
+  EXPECT_TRUE(Enqueue(3));
+
+  EXPECT_EQ(1, Read(STREAM_1));
+  EXPECT_EQ(2, Read(STREAM_1));
+  EXPECT_EQ(3u, btif_a2dp_source_tx_queue_length());
+
+  /* A stopped stream's backlog no longer counts */
+  ASSERT_TRUE(btif_a2dp_source_tx_stop_stream(STREAM_2));
+  EXPECT_EQ(1u, btif_a2dp_source_tx_queue_length());
+}
+
+TEST_F(BtifA2dpSourceTxTest, overflow_drops_only_that_stream) {
+  ASSERT_TRUE(btif_a2dp_source_tx_start_stream(STREAM_1));
+  ASSERT_TRUE(btif_a2dp_source_tx_start_stream(STREAM_2));
+
+  /* Stream 1 keeps up, stream 2 does not */
+  for (uint8_t value = 1; value <= MAX_FRAMES; value++) {
+    EXPECT_TRUE(Enqueue(value));
+    EXPECT_EQ(0u, drops.dropouts);
+    EXPECT_EQ(value, Read(STREAM_1));
+  }
+
+  EXPECT_TRUE(Enqueue(MAX_FRAMES + 1));
+  EXPECT_EQ(1u, drops.dropouts);
+  EXPECT_EQ((size_t)MAX_FRAMES, drops.dropped_n);
+  EXPECT_EQ((size_t)MAX_FRAMES, drops.max_dropped_n);
+  EXPECT_EQ(0u, btif_a2dp_source_tx_dropouts(STREAM_1));
+  EXPECT_EQ(1u, btif_a2dp_source_tx_dropouts(STREAM_2));
+
+  EXPECT_EQ(MAX_FRAMES + 1, Read(STREAM_1));
+  EXPECT_EQ(MAX_FRAMES + 1, Read(STREAM_2));
+  EXPECT_EQ(-1, Read(STREAM_2));
+}
+
+TEST_F(BtifA2dpSourceTxTest, watermark_counts_frames) {
+  ASSERT_TRUE(btif_a2dp_source_tx_start_stream(STREAM_1));
+
+  EXPECT_TRUE(Enqueue(1, MAX_FRAMES));
+  EXPECT_EQ(0u, drops.dropouts);
+
+  /* One queued packet and |MAX_FRAMES| more frames don't fit */
+  EXPECT_TRUE(Enqueue(2, MAX_FRAMES));
+  EXPECT_EQ(1u, drops.dropouts);
+  EXPECT_EQ(2, Read(STREAM_1));
+}
+
+TEST_F(BtifA2dpSourceTxTest, flush_empties_every_stream) {
+  ASSERT_TRUE(btif_a2dp_source_tx_start_stream(STREAM_1));
+  ASSERT_TRUE(btif_a2dp_source_tx_start_stream(STREAM_2));
+  EXPECT_TRUE(Enqueue(1));
+  EXPECT_TRUE(Enqueue(2));
+
+  EXPECT_EQ(4u, btif_a2dp_source_tx_flush());
+  EXPECT_EQ(-1, Read(STREAM_1));
+  EXPECT_EQ(-1, Read(STREAM_2));
+
+  /* Both streams are still started */
+  EXPECT_TRUE(Enqueue(3));
+  EXPECT_EQ(3, Read(STREAM_1));
+  EXPECT_EQ(3, Read(STREAM_2));
+}
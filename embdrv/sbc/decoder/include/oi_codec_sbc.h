@@ -478,6 +478,23 @@ uint16_t OI_CODEC_SBC_CalculatePcmBytes(OI_CODEC_SBC_COMMON_CONTEXT* common);
  */
 OI_CHAR* OI_CODEC_Version(void);
 
+/**
+ * Enables or disables the SIMD kernels of the 8-subband synthesis filterbank.
+ * They are enabled by default and used when the CPU supports them; disabling
+ * them falls back to the scalar filterbank, e.g. for testing. Takes effect at
+ * the next call to OI_CODEC_SBC_DecoderReset().
+ *
+ * @param enable    TRUE to use the SIMD kernels when available
+ */
+void OI_CODEC_SBC_SetVectorKernels(OI_BOOL enable);
+
+/**
+ * Get the name of the synthesis kernels in use.
+ *
+ * @return  "scalar", or the instruction set of the SIMD kernels, e.g. "neon"
+ */
+const OI_CHAR* OI_CODEC_SBC_GetKernelName(void);
+
 /**
 @}
 
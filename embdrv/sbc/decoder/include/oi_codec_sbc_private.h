@@ -184,6 +184,16 @@ PRIVATE void cosineModulateSynth4(SBC_BUFFER_T* RESTRICT out,
 PRIVATE void SynthWindow40_int32_int32_symmetry_with_sum(
     int16_t* pcm, SBC_BUFFER_T buffer[80], OI_UINT strideShift);
 
+typedef void (*SYNTH_WINDOW)(int16_t* pcm, SBC_BUFFER_T const* RESTRICT buffer,
+                             OI_UINT strideShift);
+
+/* Selects the synthesis kernels, see OI_CODEC_SBC_SetVectorKernels() */
+PRIVATE void OI_SBC_SynthInit(void);
+
+/* Returns a SIMD replacement for SynthWindow80_generated() and sets |name|, or
+ * returns NULL if the CPU has no suitable instructions. */
+PRIVATE SYNTH_WINDOW OI_SBC_VectorSynthWindow80(const OI_CHAR** name);
+
 INLINE void dct3_4(int32_t* RESTRICT out, int32_t const* RESTRICT in);
 PRIVATE void analyze4_generated(SBC_BUFFER_T analysisBuffer[RESTRICT 40],
                                 int16_t* pcm, OI_UINT strideShift,
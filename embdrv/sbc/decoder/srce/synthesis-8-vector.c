@@ -0,0 +1,207 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2017 Google, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/**
+ @file
+
+ SIMD versions of SynthWindow80_generated(), the windowing step of the
+ 8-subband synthesis filterbank.
+
+ Output i of the generated code is a sum of 16x16-bit products, each shifted
+ by its own amount before being accumulated, so the kernels must apply the
+ shifts per product to stay bit-exact. Product j of output i reads
+ buffer[16 * (j / 2) + 4 + s] for even j and buffer[16 * (j / 2) + 12 - s]
+ for odd j, where s = min(i, 8 - i). Each tap j therefore reads 5 adjacent
+ samples that map onto the 8 outputs in mirrored order. The tables below list
+ the coefficient and shift of every (tap, output) pair, taken unchanged from
+ synthesis-8-generated.c. Output 0 has no product at tap 0, and output 4 has
+ products at even taps only; the missing pairs have a zero coefficient.
+
+ NEON applies the shifts with vshl, which shifts right for negative counts.
+ x86 needs AVX2 for per-lane shifts and is selected at runtime.
+ */
+
+#include "oi_codec_sbc_private.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SBC_SYNTH_NEON
+#elif (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define SBC_SYNTH_AVX2
+#endif
+
+#if defined(SBC_SYNTH_NEON) || defined(SBC_SYNTH_AVX2)
+
+#define SYNTH80_TAPS 10
+
+/* Coefficients of the products, by tap and output */
+static const int16_t synthCoef80[SYNTH80_TAPS][8] = {
+    {0, -3263, -10385, -16457, 10445, 16913, 11167, 9293},
+    {8235, 29293, 24995, 19083, 0, -8443, -10337, -6087},
+    {-23167, -5229, -309, -23641, -5297, 3687, 1917, 1247},
+    {26479, 30835, 9161, -29015, 0, -301, -30605, -2893},
+    {-17397, -27021, -23063, -12889, 22299, 15447, 8317, 23671},
+    {9399, 31633, 27561, 6145, 0, 10255, 9553, 18055},
+    {17397, 17319, 2309, 24211, 10603, -18233, 22117, 11537},
+    {26479, 26663, 12705, 23469, 0, 9405, 16383, 1747},
+    {23167, 4555, 6239, 21223, 9539, 1499, 7543, 685},
+    {8235, 12419, 9251, 26913, 0, 26189, 8603, 8721},
+};
+
+/* Shifts of the products: positive to the left, negative to the right */
+static const int32_t synthShift80[SYNTH80_TAPS][8] = {
+    {0, -5, -6, -6, -4, -5, -4, -3}, {-3, -5, -5, -5, 0, -7, -4, -2},
+    {-3, 0, 4, -2, 1, 1, 2, 3},      {-2, -3, -3, -4, 0, 5, -1, 3},
+    {1, 1, 1, 2, 2, 2, 3, 2},        {3, 1, 1, 3, 0, 2, 2, 1},
+    {1, 1, 3, -1, 0, -3, -4, -1},    {-2, -2, -1, -2, 0, -1, -2, 1},
+    {-3, -1, -3, -8, -4, -1, -3, 1}, {-3, -4, -4, -6, 0, -7, -6, -7},
+};
+
+/* Writes the 8 outputs, which are already clipped to 16 bits */
+INLINE void storeSynth80(int16_t* pcm, const int16_t* out,
+                         OI_UINT strideShift) {
+  OI_UINT i;
+
+  for (i = 0; i < 8; i++) {
+    pcm[i << strideShift] = out[i];
+  }
+}
+
+#endif
+
+#if defined(SBC_SYNTH_NEON)
+
+#define SYNTH80_KERNEL_NAME "neon"
+
+/* Accumulates one tap into |acc| */
+#define NEON_SYNTH_TAP(acc, samples, tap, half)                        \
+  (acc) = vaddq_s32(                                                   \
+      (acc), vshlq_s32(vmull_s16((samples),                            \
+                                 vld1_s16(synthCoef80[tap] + (half))), \
+                       vld1q_s32(synthShift80[tap] + (half))))
+
+static void SynthWindow80_neon(int16_t* pcm,
+                               SBC_BUFFER_T const* RESTRICT buffer,
+                               OI_UINT strideShift) {
+  int32x4_t lo = vdupq_n_s32(0);
+  int32x4_t hi = vdupq_n_s32(0);
+  int32x4_t round = vdupq_n_s32(0x7FFF);
+  int16_t out[8];
+  OI_UINT m;
+
+  for (m = 0; m < SYNTH80_TAPS / 2; m++) {
+    const SBC_BUFFER_T* even = buffer + 16 * m + 4;
+    const SBC_BUFFER_T* odd = buffer + 16 * m + 8;
+
+    /* Outputs 0..3 read even[0..3] and odd[4..1], outputs 4..7 read
+     * even[4..1] and odd[0..3]. */
+    NEON_SYNTH_TAP(lo, vld1_s16(even), 2 * m, 0);
+    NEON_SYNTH_TAP(hi, vrev64_s16(vld1_s16(even + 1)), 2 * m, 4);
+    NEON_SYNTH_TAP(lo, vrev64_s16(vld1_s16(odd + 1)), 2 * m + 1, 0);
+    NEON_SYNTH_TAP(hi, vld1_s16(odd), 2 * m + 1, 4);
+  }
+
+  /* Divide by 32768, rounding toward zero like the generated code */
+  lo = vaddq_s32(lo, vandq_s32(vshrq_n_s32(lo, 31), round));
+  hi = vaddq_s32(hi, vandq_s32(vshrq_n_s32(hi, 31), round));
+  lo = vshrq_n_s32(lo, 15);
+  hi = vshrq_n_s32(hi, 15);
+
+  vst1q_s16(out, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+  storeSynth80(pcm, out, strideShift);
+}
+
+PRIVATE SYNTH_WINDOW OI_SBC_VectorSynthWindow80(const OI_CHAR** name) {
+  *name = SYNTH80_KERNEL_NAME;
+  return SynthWindow80_neon;
+}
+
+#elif defined(SBC_SYNTH_AVX2)
+
+#define SYNTH80_KERNEL_NAME "avx2"
+
+/* Left shifts are folded into the coefficients, which is exact modulo 2^32 */
+static int32_t synthCoefShifted80[SYNTH80_TAPS][8];
+static int32_t synthRightShift80[SYNTH80_TAPS][8];
+
+/* Accumulates one tap into |acc|, |order| maps samples to outputs */
+#define AVX2_SYNTH_TAP(acc, samples, order, tap)                           \
+  do {                                                                     \
+    __m256i x_ = _mm256_permutevar8x32_epi32(                              \
+        _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(samples))), \
+        (order));                                                          \
+    x_ = _mm256_mullo_epi32(                                               \
+        x_, _mm256_loadu_si256((const __m256i*)synthCoefShifted80[tap]));  \
+    x_ = _mm256_srav_epi32(                                                \
+        x_, _mm256_loadu_si256((const __m256i*)synthRightShift80[tap]));   \
+    (acc) = _mm256_add_epi32((acc), x_);                                   \
+  } while (0)
+
+__attribute__((target("avx2"))) static void SynthWindow80_avx2(
+    int16_t* pcm, SBC_BUFFER_T const* RESTRICT buffer, OI_UINT strideShift) {
+  const __m256i evenOrder = _mm256_setr_epi32(0, 1, 2, 3, 4, 3, 2, 1);
+  const __m256i oddOrder = _mm256_setr_epi32(4, 3, 2, 1, 0, 1, 2, 3);
+  __m256i acc = _mm256_setzero_si256();
+  int16_t out[8];
+  OI_UINT m;
+
+  for (m = 0; m < SYNTH80_TAPS / 2; m++) {
+    AVX2_SYNTH_TAP(acc, buffer + 16 * m + 4, evenOrder, 2 * m);
+    AVX2_SYNTH_TAP(acc, buffer + 16 * m + 8, oddOrder, 2 * m + 1);
+  }
+
+  /* Divide by 32768, rounding toward zero like the generated code */
+  acc = _mm256_add_epi32(acc, _mm256_and_si256(_mm256_srai_epi32(acc, 31),
+                                               _mm256_set1_epi32(0x7FFF)));
+  acc = _mm256_srai_epi32(acc, 15);
+
+  _mm_storeu_si128((__m128i*)out,
+                   _mm_packs_epi32(_mm256_castsi256_si128(acc),
+                                   _mm256_extracti128_si256(acc, 1)));
+  storeSynth80(pcm, out, strideShift);
+}
+
+PRIVATE SYNTH_WINDOW OI_SBC_VectorSynthWindow80(const OI_CHAR** name) {
+  OI_UINT tap, i;
+
+  if (!__builtin_cpu_supports("avx2")) {
+    return NULL;
+  }
+
+  for (tap = 0; tap < SYNTH80_TAPS; tap++) {
+    for (i = 0; i < 8; i++) {
+      int32_t shift = synthShift80[tap][i];
+      synthCoefShifted80[tap][i] = synthCoef80[tap][i]
+                                   << (shift > 0 ? shift : 0);
+      synthRightShift80[tap][i] = shift < 0 ? -shift : 0;
+    }
+  }
+
+  *name = SYNTH80_KERNEL_NAME;
+  return SynthWindow80_avx2;
+}
+
+#else
+
+PRIVATE SYNTH_WINDOW OI_SBC_VectorSynthWindow80(const OI_CHAR** name) {
+  (void)name;
+  return NULL;
+}
+
+#endif
@@ -266,13 +266,36 @@ typedef void (*SYNTH_FRAME)(OI_CODEC_SBC_DECODER_CONTEXT* context, int16_t* pcm,
 #endif
 
 #ifndef SYNTH80
-#define SYNTH80 SynthWindow80_generated
+#define SYNTH80 synthWindow80
 #endif
 
 #ifndef SYNTH112
 #define SYNTH112 SynthWindow112_generated
 #endif
 
+static OI_BOOL vectorKernels = TRUE;
+static SYNTH_WINDOW synthWindow80 = SynthWindow80_generated;
+static const OI_CHAR* synthKernelName = "scalar";
+
+PRIVATE void OI_SBC_SynthInit(void) {
+  SYNTH_WINDOW window = NULL;
+  const OI_CHAR* name = NULL;
+
+  if (vectorKernels) {
+    window = OI_SBC_VectorSynthWindow80(&name);
+  }
+  if (window == NULL) {
+    window = SynthWindow80_generated;
+    name = "scalar";
+  }
+  synthWindow80 = window;
+  synthKernelName = name;
+}
+
+void OI_CODEC_SBC_SetVectorKernels(OI_BOOL enable) { vectorKernels = enable; }
+
+const OI_CHAR* OI_CODEC_SBC_GetKernelName(void) { return synthKernelName; }
+
 PRIVATE void OI_SBC_SynthFrame_80(OI_CODEC_SBC_DECODER_CONTEXT* context,
                                   int16_t* pcm, OI_UINT blkstart,
                                   OI_UINT blkcount) {
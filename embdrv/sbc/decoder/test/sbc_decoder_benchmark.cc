@@ -0,0 +1,101 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2017 Google, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <benchmark/benchmark.h>
+
+#include <string.h>
+#include <vector>
+
+#include "oi_codec_sbc.h"
+#include "oi_status.h"
+#include "sbc_encoder.h"
+
+// Number of distinct SBC frames cycled through, so the decoder doesn't see
+// the same input over and over.
+static const int SBC_FRAME_COUNT = 64;
+
+// Records SBC_FRAME_COUNT joint stereo frames of pseudo-random PCM.
+static std::vector<uint8_t> record_stream(int16_t num_subbands) {
+  SBC_ENC_PARAMS params;
+  memset(&params, 0, sizeof(params));
+  params.s16SamplingFreq = SBC_sf44100;
+  params.s16ChannelMode = SBC_JOINT_STEREO;
+  params.s16NumOfSubBands = num_subbands;
+  params.s16NumOfBlocks = SBC_BLOCK_3;
+  params.s16AllocationMethod = SBC_LOUDNESS;
+  params.u16BitRate = 328;
+  SBC_Encoder_Init(&params);
+
+  const int samples_per_frame = 2 * num_subbands * SBC_BLOCK_3;
+  int16_t pcm[2 * SUB_BANDS_8 * SBC_BLOCK_3];
+  uint8_t output[1024];
+  std::vector<uint8_t> stream;
+  uint32_t seed = 0x2545F491;
+  for (int i = 0; i < SBC_FRAME_COUNT; i++) {
+    for (int j = 0; j < samples_per_frame; j++) {
+      seed = seed * 1664525 + 1013904223;
+      pcm[j] = (int16_t)(seed >> 16);
+    }
+    uint32_t length = SBC_Encode(&params, pcm, output);
+    stream.insert(stream.end(), output, output + length);
+  }
+  return stream;
+}
+
+// Args: vector kernels enabled, number of subbands. Decodes 16-block joint
+// stereo frames into interleaved PCM, as the A2DP sink does.
+static void BM_SbcDecodeFrames(benchmark::State& state) {
+  OI_CODEC_SBC_SetVectorKernels(state.range(0) != 0);
+
+  std::vector<uint8_t> stream = record_stream(state.range(1));
+  OI_CODEC_SBC_DECODER_CONTEXT context;
+  OI_CODEC_SBC_CODEC_DATA_STEREO context_data;
+  OI_CODEC_SBC_DecoderReset(&context, context_data.data, sizeof(context_data),
+                            2, 2, FALSE);
+  state.SetLabel(OI_CODEC_SBC_GetKernelName());
+
+  const OI_BYTE* frame_data = stream.data();
+  uint32_t frame_bytes = stream.size();
+  int16_t pcm[SBC_MAX_CHANNELS * SBC_MAX_BANDS * SBC_MAX_BLOCKS];
+  while (state.KeepRunning()) {
+    if (frame_bytes == 0) {
+      frame_data = stream.data();
+      frame_bytes = stream.size();
+    }
+    uint32_t pcm_bytes = sizeof(pcm);
+    OI_STATUS status = OI_CODEC_SBC_DecodeFrame(&context, &frame_data,
+                                                &frame_bytes, pcm, &pcm_bytes);
+    if (!OI_SUCCESS(status)) {
+      state.SkipWithError("decoding failed");
+      break;
+    }
+    benchmark::DoNotOptimize(pcm[0]);
+  }
+
+  state.SetItemsProcessed(state.iterations());
+  OI_CODEC_SBC_SetVectorKernels(TRUE);
+}
+
+BENCHMARK(BM_SbcDecodeFrames)
+    ->ArgNames({"vector", "subbands"})
+    ->Args({0, SUB_BANDS_4})
+    ->Args({1, SUB_BANDS_4})
+    ->Args({0, SUB_BANDS_8})
+    ->Args({1, SUB_BANDS_8});
+
+BENCHMARK_MAIN();
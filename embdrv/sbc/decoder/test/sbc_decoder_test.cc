@@ -0,0 +1,161 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2017 Google, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+#include <vector>
+
+#include "oi_codec_sbc.h"
+#include "oi_status.h"
+#include "sbc_encoder.h"
+
+static const int kFramesPerRun = 200;
+
+typedef struct {
+  int16_t channel_mode;
+  int16_t num_subbands;
+  int16_t num_blocks;
+  int16_t allocation_method;
+  uint16_t bit_rate;
+  uint8_t pcm_stride;
+  uint64_t expected_hash;  // Output of the original scalar decoder
+} decoder_config_t;
+
+static const decoder_config_t kConfigs[] = {
+    {SBC_MONO, SUB_BANDS_4, SBC_BLOCK_3, SBC_LOUDNESS, 128, 1,
+     0x76b242e736193f9fULL},
+    {SBC_MONO, SUB_BANDS_8, SBC_BLOCK_1, SBC_SNR, 128, 1,
+     0xf1901092eac99a7bULL},
+    {SBC_DUAL, SUB_BANDS_8, SBC_BLOCK_2, SBC_LOUDNESS, 256, 2,
+     0x08cad394bac0b69bULL},
+    {SBC_STEREO, SUB_BANDS_4, SBC_BLOCK_0, SBC_SNR, 229, 2,
+     0xbc7e046ceea30e98ULL},
+    {SBC_STEREO, SUB_BANDS_8, SBC_BLOCK_3, SBC_LOUDNESS, 328, 2,
+     0xbcd6091273b3fae7ULL},
+    {SBC_JOINT_STEREO, SUB_BANDS_4, SBC_BLOCK_3, SBC_LOUDNESS, 229, 2,
+     0x6d813be721abbac7ULL},
+    {SBC_JOINT_STEREO, SUB_BANDS_8, SBC_BLOCK_3, SBC_LOUDNESS, 328, 2,
+     0x8c21296f3930f76dULL},
+    {SBC_JOINT_STEREO, SUB_BANDS_8, SBC_BLOCK_3, SBC_SNR, 512, 2,
+     0x3d9593a5f6da4c2fULL},
+};
+
+// Deterministic, integer-only test signal: a loud triangle wave per channel
+// plus pseudo-random noise, so that the synthesis output clips now and then.
+static void fill_pcm(int16_t* pcm, size_t samples, int channels,
+                     uint32_t* seed, uint32_t* phase) {
+  for (size_t i = 0; i < samples; i++) {
+    int channel = i % channels;
+    *seed = *seed * 1664525 + 1013904223;
+    phase[channel] += channel ? 1931 : 1187;
+    int32_t triangle = (int32_t)(phase[channel] & 0xFFFF) - 0x8000;
+    if (triangle < 0) triangle = -triangle;
+    int32_t sample = 2 * (triangle - 0x4000) + ((int16_t)(*seed >> 16) >> 2);
+    if (sample > INT16_MAX) sample = INT16_MAX;
+    if (sample < INT16_MIN) sample = INT16_MIN;
+    pcm[i] = (int16_t)sample;
+  }
+}
+
+// Encodes |kFramesPerRun| frames of the test signal into one SBC stream.
+static std::vector<uint8_t> encode_stream(const decoder_config_t& config) {
+  SBC_ENC_PARAMS params;
+  memset(&params, 0, sizeof(params));
+  params.s16SamplingFreq = SBC_sf44100;
+  params.s16ChannelMode = config.channel_mode;
+  params.s16NumOfSubBands = config.num_subbands;
+  params.s16NumOfBlocks = config.num_blocks;
+  params.s16AllocationMethod = config.allocation_method;
+  params.u16BitRate = config.bit_rate;
+  SBC_Encoder_Init(&params);
+
+  int channels = params.s16NumOfChannels;
+  size_t samples = channels * config.num_subbands * config.num_blocks;
+  int16_t pcm[SBC_MAX_NUM_OF_CHANNELS * SBC_MAX_NUM_OF_SUBBANDS *
+              SBC_MAX_NUM_OF_BLOCKS];
+  uint8_t output[1024];
+
+  std::vector<uint8_t> stream;
+  uint32_t seed = 0x12345678;
+  uint32_t phase[SBC_MAX_NUM_OF_CHANNELS] = {0, 0};
+  for (int frame = 0; frame < kFramesPerRun; frame++) {
+    fill_pcm(pcm, samples, channels, &seed, phase);
+    uint32_t length = SBC_Encode(&params, pcm, output);
+    stream.insert(stream.end(), output, output + length);
+  }
+  return stream;
+}
+
+// FNV-1a over the PCM decoded from |stream|.
+static uint64_t decode_and_hash(const decoder_config_t& config,
+                                const std::vector<uint8_t>& stream) {
+  OI_CODEC_SBC_DECODER_CONTEXT context;
+  OI_CODEC_SBC_CODEC_DATA_STEREO context_data;
+  EXPECT_EQ(OI_OK, OI_CODEC_SBC_DecoderReset(
+                       &context, context_data.data, sizeof(context_data), 2,
+                       config.pcm_stride, FALSE));
+
+  const OI_BYTE* frame_data = stream.data();
+  uint32_t frame_bytes = stream.size();
+  int16_t pcm[SBC_MAX_CHANNELS * SBC_MAX_BANDS * SBC_MAX_BLOCKS];
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  int frames = 0;
+  while (frame_bytes > 0) {
+    uint32_t pcm_bytes = sizeof(pcm);
+    OI_STATUS status = OI_CODEC_SBC_DecodeFrame(&context, &frame_data,
+                                                &frame_bytes, pcm, &pcm_bytes);
+    EXPECT_EQ(OI_OK, status);
+    if (status != OI_OK) break;
+    const uint8_t* bytes = (const uint8_t*)pcm;
+    for (uint32_t i = 0; i < pcm_bytes; i++) {
+      hash ^= bytes[i];
+      hash *= 0x100000001b3ULL;
+    }
+    frames++;
+  }
+  EXPECT_EQ(kFramesPerRun, frames);
+  return hash;
+}
+
+class SbcDecoderTest : public ::testing::Test {
+ protected:
+  virtual void TearDown() { OI_CODEC_SBC_SetVectorKernels(TRUE); }
+};
+
+TEST_F(SbcDecoderTest, test_scalar_bit_exact) {
+  OI_CODEC_SBC_SetVectorKernels(FALSE);
+  for (const decoder_config_t& config : kConfigs) {
+    EXPECT_EQ(config.expected_hash,
+              decode_and_hash(config, encode_stream(config)))
+        << "mode " << config.channel_mode << " subbands "
+        << config.num_subbands << " blocks " << config.num_blocks;
+  }
+  EXPECT_STREQ("scalar", OI_CODEC_SBC_GetKernelName());
+}
+
+TEST_F(SbcDecoderTest, test_vector_bit_exact) {
+  OI_CODEC_SBC_SetVectorKernels(TRUE);
+  for (const decoder_config_t& config : kConfigs) {
+    EXPECT_EQ(config.expected_hash,
+              decode_and_hash(config, encode_stream(config)))
+        << "mode " << config.channel_mode << " subbands "
+        << config.num_subbands << " blocks " << config.num_blocks
+        << " kernels " << OI_CODEC_SBC_GetKernelName();
+  }
+}
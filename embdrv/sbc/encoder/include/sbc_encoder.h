@@ -113,6 +113,16 @@
 #define SBC_IS_64_MULT_IN_WINDOW_ACCU FALSE
 #endif /*SBC_IS_64_MULT_IN_WINDOW_ACCU */
 
+/* Set SBC_VECTOR_WINDOW_ACCU to TRUE to perform the windowing of the analysis
+ * filter with SIMD kernels (SSE2 or NEON, selected from the target) instead
+ * of the unrolled scalar code. The output is bit-exact either way.
+ */
+/* CAUTION: It only applies if SBC_IS_64_MULT_IN_WINDOW_ACCU is FALSE and
+ * SBC_ARM_ASM_OPT is FALSE */
+#ifndef SBC_VECTOR_WINDOW_ACCU
+#define SBC_VECTOR_WINDOW_ACCU TRUE
+#endif /*SBC_VECTOR_WINDOW_ACCU */
+
 /* Set SBC_IS_64_MULT_IN_IDCT to TRUE to use 64 bits multiplication in the DCT
  * of Matrixing
  */
@@ -201,6 +211,15 @@ extern uint32_t SBC_Encode(SBC_ENC_PARAMS* strEncParams, int16_t* input,
                            uint8_t* output);
 extern void SBC_Encoder_Init(SBC_ENC_PARAMS* strEncParams);
 
+/* Enables or disables the vectorized analysis kernels. They are enabled by
+ * default when the target supports them; disabling them falls back to the
+ * scalar implementation, e.g. for testing. Takes effect at the next call to
+ * SBC_Encoder_Init(). */
+extern void SBC_Encoder_SetVectorKernels(bool enable);
+
+/* Returns the name of the analysis kernels in use, e.g. "sse2" or "scalar". */
+extern const char* SBC_Encoder_GetKernelName(void);
+
 #ifdef __cplusplus
 }
 #endif
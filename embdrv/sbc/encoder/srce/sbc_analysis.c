@@ -1187,6 +1187,220 @@ static int16_t* s16X =
 
 static int16_t ShiftCounter = 0;
 extern int16_t EncMaxShiftCounter;
+
+#if (SBC_VECTOR_WINDOW_ACCU == TRUE) && \
+    (SBC_IS_64_MULT_IN_WINDOW_ACCU == FALSE) && (SBC_ARM_ASM_OPT == FALSE)
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define SBC_WINDOW_KERNEL_NAME "sse2"
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SBC_WINDOW_KERNEL_NAME "neon"
+#endif
+#endif
+
+#if defined(SBC_WINDOW_KERNEL_NAME)
+/*
+ * The WINDOW_ACCU_x macros above compute, for every output k,
+ *
+ *    s32DCTY[k] = sum(j = 0..4) C[j][k] * s16X[ChOffset + 2 * NSB * j + k]
+ *
+ * where NSB is the number of subbands and C is the window with its
+ * symmetries folded back in. The tables below hold C by column, with a zero
+ * tap appended. SbcWindowTablesInit() interleaves each pair of rows
+ * (j, j + 1) so that a 16x16->32 bit multiply-add of two interleaved sample
+ * rows yields two taps at once. Every product and partial sum fits in 32
+ * bits, so the result is bit-exact with the scalar code.
+ */
+#define WIND_COLUMN(c0, c1, c2, c3, c4) \
+  { c0, c1, c2, c3, c4, 0 }
+
+static const int16_t as16WindowColumns4[SUB_BANDS_4 * 2][6] = {
+    WIND_COLUMN(0, WIND_4_SUBBANDS_0_1, WIND_4_SUBBANDS_0_2,
+                -WIND_4_SUBBANDS_0_2, -WIND_4_SUBBANDS_0_1),
+    WIND_COLUMN(WIND_4_SUBBANDS_1_0, WIND_4_SUBBANDS_1_1, WIND_4_SUBBANDS_1_2,
+                WIND_4_SUBBANDS_1_3, WIND_4_SUBBANDS_1_4),
+    WIND_COLUMN(WIND_4_SUBBANDS_2_0, WIND_4_SUBBANDS_2_1, WIND_4_SUBBANDS_2_2,
+                WIND_4_SUBBANDS_2_3, WIND_4_SUBBANDS_2_4),
+    WIND_COLUMN(WIND_4_SUBBANDS_3_0, WIND_4_SUBBANDS_3_1, WIND_4_SUBBANDS_3_2,
+                WIND_4_SUBBANDS_3_3, WIND_4_SUBBANDS_3_4),
+    WIND_COLUMN(WIND_4_SUBBANDS_4_0, WIND_4_SUBBANDS_4_1, WIND_4_SUBBANDS_4_2,
+                WIND_4_SUBBANDS_4_1, WIND_4_SUBBANDS_4_0),
+    WIND_COLUMN(WIND_4_SUBBANDS_3_4, WIND_4_SUBBANDS_3_3, WIND_4_SUBBANDS_3_2,
+                WIND_4_SUBBANDS_3_1, WIND_4_SUBBANDS_3_0),
+    WIND_COLUMN(WIND_4_SUBBANDS_2_4, WIND_4_SUBBANDS_2_3, WIND_4_SUBBANDS_2_2,
+                WIND_4_SUBBANDS_2_1, WIND_4_SUBBANDS_2_0),
+    WIND_COLUMN(WIND_4_SUBBANDS_1_4, WIND_4_SUBBANDS_1_3, WIND_4_SUBBANDS_1_2,
+                WIND_4_SUBBANDS_1_1, WIND_4_SUBBANDS_1_0),
+};
+
+static const int16_t as16WindowColumns8[SUB_BANDS_8 * 2][6] = {
+    WIND_COLUMN(0, WIND_8_SUBBANDS_0_1, WIND_8_SUBBANDS_0_2,
+                -WIND_8_SUBBANDS_0_2, -WIND_8_SUBBANDS_0_1),
+    WIND_COLUMN(WIND_8_SUBBANDS_1_0, WIND_8_SUBBANDS_1_1, WIND_8_SUBBANDS_1_2,
+                WIND_8_SUBBANDS_1_3, WIND_8_SUBBANDS_1_4),
+    WIND_COLUMN(WIND_8_SUBBANDS_2_0, WIND_8_SUBBANDS_2_1, WIND_8_SUBBANDS_2_2,
+                WIND_8_SUBBANDS_2_3, WIND_8_SUBBANDS_2_4),
+    WIND_COLUMN(WIND_8_SUBBANDS_3_0, WIND_8_SUBBANDS_3_1, WIND_8_SUBBANDS_3_2,
+                WIND_8_SUBBANDS_3_3, WIND_8_SUBBANDS_3_4),
+    WIND_COLUMN(WIND_8_SUBBANDS_4_0, WIND_8_SUBBANDS_4_1, WIND_8_SUBBANDS_4_2,
+                WIND_8_SUBBANDS_4_3, WIND_8_SUBBANDS_4_4),
+    WIND_COLUMN(WIND_8_SUBBANDS_5_0, WIND_8_SUBBANDS_5_1, WIND_8_SUBBANDS_5_2,
+                WIND_8_SUBBANDS_5_3, WIND_8_SUBBANDS_5_4),
+    WIND_COLUMN(WIND_8_SUBBANDS_6_0, WIND_8_SUBBANDS_6_1, WIND_8_SUBBANDS_6_2,
+                WIND_8_SUBBANDS_6_3, WIND_8_SUBBANDS_6_4),
+    WIND_COLUMN(WIND_8_SUBBANDS_7_0, WIND_8_SUBBANDS_7_1, WIND_8_SUBBANDS_7_2,
+                WIND_8_SUBBANDS_7_3, WIND_8_SUBBANDS_7_4),
+    WIND_COLUMN(WIND_8_SUBBANDS_8_0, WIND_8_SUBBANDS_8_1, WIND_8_SUBBANDS_8_2,
+                WIND_8_SUBBANDS_8_1, WIND_8_SUBBANDS_8_0),
+    WIND_COLUMN(WIND_8_SUBBANDS_7_4, WIND_8_SUBBANDS_7_3, WIND_8_SUBBANDS_7_2,
+                WIND_8_SUBBANDS_7_1, WIND_8_SUBBANDS_7_0),
+    WIND_COLUMN(WIND_8_SUBBANDS_6_4, WIND_8_SUBBANDS_6_3, WIND_8_SUBBANDS_6_2,
+                WIND_8_SUBBANDS_6_1, WIND_8_SUBBANDS_6_0),
+    WIND_COLUMN(WIND_8_SUBBANDS_5_4, WIND_8_SUBBANDS_5_3, WIND_8_SUBBANDS_5_2,
+                WIND_8_SUBBANDS_5_1, WIND_8_SUBBANDS_5_0),
+    WIND_COLUMN(WIND_8_SUBBANDS_4_4, WIND_8_SUBBANDS_4_3, WIND_8_SUBBANDS_4_2,
+                WIND_8_SUBBANDS_4_1, WIND_8_SUBBANDS_4_0),
+    WIND_COLUMN(WIND_8_SUBBANDS_3_4, WIND_8_SUBBANDS_3_3, WIND_8_SUBBANDS_3_2,
+                WIND_8_SUBBANDS_3_1, WIND_8_SUBBANDS_3_0),
+    WIND_COLUMN(WIND_8_SUBBANDS_2_4, WIND_8_SUBBANDS_2_3, WIND_8_SUBBANDS_2_2,
+                WIND_8_SUBBANDS_2_1, WIND_8_SUBBANDS_2_0),
+    WIND_COLUMN(WIND_8_SUBBANDS_1_4, WIND_8_SUBBANDS_1_3, WIND_8_SUBBANDS_1_2,
+                WIND_8_SUBBANDS_1_1, WIND_8_SUBBANDS_1_0),
+};
+
+/* Kernel layout: [pair][k * 2 + (j & 1)], built once from the columns */
+static int16_t as16WindowPairs4[3][SUB_BANDS_4 * 2 * 2];
+static int16_t as16WindowPairs8[3][SUB_BANDS_8 * 2 * 2];
+static bool bVectorKernels = TRUE;
+static bool bUseVectorKernels = FALSE;
+
+static void SbcWindowTablesInit(void) {
+  int32_t k, pair;
+  for (pair = 0; pair < 3; pair++) {
+    for (k = 0; k < SUB_BANDS_4 * 2; k++) {
+      as16WindowPairs4[pair][k * 2] = as16WindowColumns4[k][pair * 2];
+      as16WindowPairs4[pair][k * 2 + 1] = as16WindowColumns4[k][pair * 2 + 1];
+    }
+    for (k = 0; k < SUB_BANDS_8 * 2; k++) {
+      as16WindowPairs8[pair][k * 2] = as16WindowColumns8[k][pair * 2];
+      as16WindowPairs8[pair][k * 2 + 1] = as16WindowColumns8[k][pair * 2 + 1];
+    }
+  }
+}
+
+#if defined(__SSE2__)
+/* Accumulates the taps of rows (j, j + 1) for 8 consecutive outputs */
+#define SBC_SSE2_ACCU_8(acc_lo, acc_hi, row0, row1, coeffs)                   \
+  {                                                                           \
+    (acc_lo) = _mm_add_epi32(                                                 \
+        (acc_lo), _mm_madd_epi16(_mm_unpacklo_epi16((row0), (row1)),          \
+                                 _mm_loadu_si128((const __m128i*)(coeffs)))); \
+    (acc_hi) = _mm_add_epi32(                                                 \
+        (acc_hi),                                                             \
+        _mm_madd_epi16(_mm_unpackhi_epi16((row0), (row1)),                    \
+                       _mm_loadu_si128((const __m128i*)((coeffs) + 8))));     \
+  }
+
+static void SbcWindowAccu4(const int16_t* ps16X, int32_t* ps32DCTY) {
+  __m128i acc_lo = _mm_setzero_si128(), acc_hi = _mm_setzero_si128();
+  const __m128i zero = _mm_setzero_si128();
+  int32_t pair;
+  for (pair = 0; pair < 3; pair++) {
+    const int16_t* ps16Row = ps16X + pair * 2 * (SUB_BANDS_4 * 2);
+    __m128i row0 = _mm_loadu_si128((const __m128i*)ps16Row);
+    __m128i row1 = (pair < 2) ? _mm_loadu_si128((const __m128i*)(
+                                    ps16Row + SUB_BANDS_4 * 2))
+                              : zero;
+    SBC_SSE2_ACCU_8(acc_lo, acc_hi, row0, row1, as16WindowPairs4[pair]);
+  }
+  _mm_storeu_si128((__m128i*)ps32DCTY, acc_lo);
+  _mm_storeu_si128((__m128i*)(ps32DCTY + 4), acc_hi);
+}
+
+static void SbcWindowAccu8(const int16_t* ps16X, int32_t* ps32DCTY) {
+  __m128i acc0 = _mm_setzero_si128(), acc1 = _mm_setzero_si128();
+  __m128i acc2 = _mm_setzero_si128(), acc3 = _mm_setzero_si128();
+  const __m128i zero = _mm_setzero_si128();
+  int32_t pair;
+  for (pair = 0; pair < 3; pair++) {
+    const int16_t* ps16Row = ps16X + pair * 2 * (SUB_BANDS_8 * 2);
+    const int16_t* ps16Coeffs = as16WindowPairs8[pair];
+    __m128i row0_lo = _mm_loadu_si128((const __m128i*)ps16Row);
+    __m128i row0_hi = _mm_loadu_si128((const __m128i*)(ps16Row + 8));
+    __m128i row1_lo = zero, row1_hi = zero;
+    if (pair < 2) {
+      row1_lo = _mm_loadu_si128((const __m128i*)(ps16Row + SUB_BANDS_8 * 2));
+      row1_hi =
+          _mm_loadu_si128((const __m128i*)(ps16Row + SUB_BANDS_8 * 2 + 8));
+    }
+    SBC_SSE2_ACCU_8(acc0, acc1, row0_lo, row1_lo, ps16Coeffs);
+    SBC_SSE2_ACCU_8(acc2, acc3, row0_hi, row1_hi, ps16Coeffs + 16);
+  }
+  _mm_storeu_si128((__m128i*)ps32DCTY, acc0);
+  _mm_storeu_si128((__m128i*)(ps32DCTY + 4), acc1);
+  _mm_storeu_si128((__m128i*)(ps32DCTY + 8), acc2);
+  _mm_storeu_si128((__m128i*)(ps32DCTY + 12), acc3);
+}
+#else
+/* Accumulates the taps of rows (j, j + 1) for 4 consecutive outputs */
+static inline int32x4_t SbcNeonAccu4(int32x4_t acc, const int16_t* ps16Row0,
+                                     const int16_t* ps16Row1,
+                                     const int16_t* ps16Coeffs) {
+  int16x4x2_t coeffs = vld2_s16(ps16Coeffs);
+  acc = vmlal_s16(acc, vld1_s16(ps16Row0), coeffs.val[0]);
+  if (ps16Row1 != NULL) acc = vmlal_s16(acc, vld1_s16(ps16Row1), coeffs.val[1]);
+  return acc;
+}
+
+static void SbcWindowAccu4(const int16_t* ps16X, int32_t* ps32DCTY) {
+  int32x4_t acc_lo = vdupq_n_s32(0), acc_hi = vdupq_n_s32(0);
+  int32_t pair;
+  for (pair = 0; pair < 3; pair++) {
+    const int16_t* ps16Row0 = ps16X + pair * 2 * (SUB_BANDS_4 * 2);
+    const int16_t* ps16Row1 =
+        (pair < 2) ? ps16Row0 + SUB_BANDS_4 * 2 : NULL;
+    acc_lo = SbcNeonAccu4(acc_lo, ps16Row0, ps16Row1, as16WindowPairs4[pair]);
+    acc_hi = SbcNeonAccu4(acc_hi, ps16Row0 + 4, ps16Row1 ? ps16Row1 + 4 : NULL,
+                          as16WindowPairs4[pair] + 8);
+  }
+  vst1q_s32(ps32DCTY, acc_lo);
+  vst1q_s32(ps32DCTY + 4, acc_hi);
+}
+
+static void SbcWindowAccu8(const int16_t* ps16X, int32_t* ps32DCTY) {
+  int32x4_t acc[4];
+  int32_t pair, q;
+  for (q = 0; q < 4; q++) acc[q] = vdupq_n_s32(0);
+  for (pair = 0; pair < 3; pair++) {
+    const int16_t* ps16Row0 = ps16X + pair * 2 * (SUB_BANDS_8 * 2);
+    const int16_t* ps16Row1 =
+        (pair < 2) ? ps16Row0 + SUB_BANDS_8 * 2 : NULL;
+    for (q = 0; q < 4; q++) {
+      acc[q] = SbcNeonAccu4(acc[q], ps16Row0 + q * 4,
+                            ps16Row1 ? ps16Row1 + q * 4 : NULL,
+                            as16WindowPairs8[pair] + q * 8);
+    }
+  }
+  for (q = 0; q < 4; q++) vst1q_s32(ps32DCTY + q * 4, acc[q]);
+}
+#endif
+#endif /* SBC_WINDOW_KERNEL_NAME */
+
+void SBC_Encoder_SetVectorKernels(bool enable) {
+#if defined(SBC_WINDOW_KERNEL_NAME)
+  bVectorKernels = enable;
+#else
+  (void)enable;
+#endif
+}
+
+const char* SBC_Encoder_GetKernelName(void) {
+#if defined(SBC_WINDOW_KERNEL_NAME)
+  if (bUseVectorKernels) return SBC_WINDOW_KERNEL_NAME;
+#endif
+  return "scalar";
+}
 /****************************************************************************
 * SbcAnalysisFilter - performs Analysis of the input audio stream
 *
@@ -1257,7 +1471,12 @@ void SbcAnalysisFilter4(SBC_ENC_PARAMS* pstrEncParams, int16_t* input) {
     for (s32Ch = 0; s32Ch < s32NumOfChannels; s32Ch++) {
       ChOffset = s32Ch * Offset2 + Offset;
 
-      WINDOW_PARTIAL_4
+#if defined(SBC_WINDOW_KERNEL_NAME)
+      if (bUseVectorKernels)
+        SbcWindowAccu4(s16X + ChOffset, s32DCTY);
+      else
+#endif
+        WINDOW_PARTIAL_4
 
       SBC_FastIDCT4(s32DCTY, ps32SbBuf);
 
@@ -1370,7 +1589,12 @@ void SbcAnalysisFilter8(SBC_ENC_PARAMS* pstrEncParams, int16_t* input) {
     for (s32Ch = 0; s32Ch < s32NumOfChannels; s32Ch++) {
       ChOffset = s32Ch * Offset2 + Offset;
 
-      WINDOW_PARTIAL_8
+#if defined(SBC_WINDOW_KERNEL_NAME)
+      if (bUseVectorKernels)
+        SbcWindowAccu8(s16X + ChOffset, s32DCTY);
+      else
+#endif
+        WINDOW_PARTIAL_8
 
       SBC_FastIDCT8(s32DCTY, ps32SbBuf);
 
@@ -1397,4 +1621,8 @@ void SbcAnalysisFilter8(SBC_ENC_PARAMS* pstrEncParams, int16_t* input) {
 void SbcAnalysisInit(void) {
   memset(s16X, 0, ENC_VX_BUFFER_SIZE * sizeof(int16_t));
   ShiftCounter = 0;
+#if defined(SBC_WINDOW_KERNEL_NAME)
+  if (bVectorKernels && !bUseVectorKernels) SbcWindowTablesInit();
+  bUseVectorKernels = bVectorKernels;
+#endif
 }
@@ -0,0 +1,73 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2017 Google, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <benchmark/benchmark.h>
+
+#include <string.h>
+
+#include "sbc_encoder.h"
+
+// Number of distinct PCM frames cycled through, so the encoder doesn't see
+// the same input over and over.
+static const int PCM_FRAME_COUNT = 64;
+
+// Args: vector kernels enabled, number of subbands. Encodes 16-block joint
+// stereo frames at 44.1 kHz, the configuration A2DP sources use by default.
+static void BM_SbcEncodeFrames(benchmark::State& state) {
+  SBC_Encoder_SetVectorKernels(state.range(0) != 0);
+
+  SBC_ENC_PARAMS params;
+  memset(&params, 0, sizeof(params));
+  params.s16SamplingFreq = SBC_sf44100;
+  params.s16ChannelMode = SBC_JOINT_STEREO;
+  params.s16NumOfSubBands = state.range(1);
+  params.s16NumOfBlocks = SBC_BLOCK_3;
+  params.s16AllocationMethod = SBC_LOUDNESS;
+  params.u16BitRate = 328;
+  SBC_Encoder_Init(&params);
+  state.SetLabel(SBC_Encoder_GetKernelName());
+
+  const int samples_per_frame = 2 * params.s16NumOfSubBands * SBC_BLOCK_3;
+  static int16_t pcm[PCM_FRAME_COUNT][2 * SUB_BANDS_8 * SBC_BLOCK_3];
+  uint32_t seed = 0x2545F491;
+  for (int i = 0; i < PCM_FRAME_COUNT; i++) {
+    for (int j = 0; j < samples_per_frame; j++) {
+      seed = seed * 1664525 + 1013904223;
+      pcm[i][j] = (int16_t)(seed >> 16);
+    }
+  }
+
+  uint8_t output[1024];
+  int frame = 0;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(SBC_Encode(&params, pcm[frame], output));
+    frame = (frame + 1) % PCM_FRAME_COUNT;
+  }
+
+  state.SetItemsProcessed(state.iterations());
+  SBC_Encoder_SetVectorKernels(true);
+}
+
+BENCHMARK(BM_SbcEncodeFrames)
+    ->ArgNames({"vector", "subbands"})
+    ->Args({0, SUB_BANDS_4})
+    ->Args({1, SUB_BANDS_4})
+    ->Args({0, SUB_BANDS_8})
+    ->Args({1, SUB_BANDS_8});
+
+BENCHMARK_MAIN();
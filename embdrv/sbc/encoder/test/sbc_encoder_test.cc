@@ -0,0 +1,123 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2017 Google, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include "sbc_encoder.h"
+
+static const int kFramesPerRun = 200;
+
+typedef struct {
+  int16_t channel_mode;
+  int16_t num_subbands;
+  int16_t num_blocks;
+  int16_t allocation_method;
+  uint16_t bit_rate;
+  uint64_t expected_hash;  // Output of the original scalar encoder
+} encoder_config_t;
+
+static const encoder_config_t kConfigs[] = {
+    {SBC_MONO, SUB_BANDS_4, SBC_BLOCK_3, SBC_LOUDNESS, 128,
+     0x23ee8e1c46e84a58ULL},
+    {SBC_MONO, SUB_BANDS_8, SBC_BLOCK_1, SBC_SNR, 128, 0x818a5fce1a12d5c2ULL},
+    {SBC_DUAL, SUB_BANDS_8, SBC_BLOCK_2, SBC_LOUDNESS, 256,
+     0xd3e2a62d3236f169ULL},
+    {SBC_STEREO, SUB_BANDS_4, SBC_BLOCK_0, SBC_SNR, 229, 0xbe5e03be8d8fb1ffULL},
+    {SBC_STEREO, SUB_BANDS_8, SBC_BLOCK_3, SBC_LOUDNESS, 328,
+     0x1941d189ad97ee2dULL},
+    {SBC_JOINT_STEREO, SUB_BANDS_4, SBC_BLOCK_3, SBC_LOUDNESS, 229,
+     0xe0fa1de1f965f3d9ULL},
+    {SBC_JOINT_STEREO, SUB_BANDS_8, SBC_BLOCK_3, SBC_LOUDNESS, 328,
+     0xff370494c02ff87dULL},
+    {SBC_JOINT_STEREO, SUB_BANDS_8, SBC_BLOCK_3, SBC_SNR, 512,
+     0xd9a2a1474cba6df9ULL},
+};
+
+// Deterministic, integer-only test signal: a triangle wave per channel plus
+// pseudo-random noise, so that every subband carries energy and the bit
+// allocation varies from frame to frame.
+static void fill_pcm(int16_t* pcm, size_t samples, int channels,
+                     uint32_t* seed, uint32_t* phase) {
+  for (size_t i = 0; i < samples; i++) {
+    int channel = i % channels;
+    *seed = *seed * 1664525 + 1013904223;
+    phase[channel] += channel ? 1931 : 1187;
+    int32_t triangle = (int32_t)(phase[channel] & 0xFFFF) - 0x8000;
+    if (triangle < 0) triangle = -triangle;
+    pcm[i] = (int16_t)((triangle - 0x4000) + ((int16_t)(*seed >> 16) >> 3));
+  }
+}
+
+// FNV-1a over every encoded frame.
+static uint64_t encode_and_hash(const encoder_config_t& config) {
+  SBC_ENC_PARAMS params;
+  memset(&params, 0, sizeof(params));
+  params.s16SamplingFreq = SBC_sf44100;
+  params.s16ChannelMode = config.channel_mode;
+  params.s16NumOfSubBands = config.num_subbands;
+  params.s16NumOfBlocks = config.num_blocks;
+  params.s16AllocationMethod = config.allocation_method;
+  params.u16BitRate = config.bit_rate;
+  SBC_Encoder_Init(&params);
+
+  int channels = params.s16NumOfChannels;
+  size_t samples = channels * config.num_subbands * config.num_blocks;
+  int16_t pcm[SBC_MAX_NUM_OF_CHANNELS * SBC_MAX_NUM_OF_SUBBANDS *
+              SBC_MAX_NUM_OF_BLOCKS];
+  uint8_t output[1024];
+
+  uint32_t seed = 0x12345678;
+  uint32_t phase[SBC_MAX_NUM_OF_CHANNELS] = {0, 0};
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (int frame = 0; frame < kFramesPerRun; frame++) {
+    fill_pcm(pcm, samples, channels, &seed, phase);
+    uint32_t length = SBC_Encode(&params, pcm, output);
+    for (uint32_t i = 0; i < length; i++) {
+      hash ^= output[i];
+      hash *= 0x100000001b3ULL;
+    }
+  }
+  return hash;
+}
+
+class SbcEncoderTest : public ::testing::Test {
+ protected:
+  virtual void TearDown() { SBC_Encoder_SetVectorKernels(true); }
+};
+
+TEST_F(SbcEncoderTest, test_scalar_bit_exact) {
+  SBC_Encoder_SetVectorKernels(false);
+  for (const encoder_config_t& config : kConfigs) {
+    EXPECT_EQ(config.expected_hash, encode_and_hash(config))
+        << "mode " << config.channel_mode << " subbands "
+        << config.num_subbands << " blocks " << config.num_blocks;
+  }
+  EXPECT_STREQ("scalar", SBC_Encoder_GetKernelName());
+}
+
+TEST_F(SbcEncoderTest, test_vector_bit_exact) {
+  SBC_Encoder_SetVectorKernels(true);
+  for (const encoder_config_t& config : kConfigs) {
+    EXPECT_EQ(config.expected_hash, encode_and_hash(config))
+        << "mode " << config.channel_mode << " subbands "
+        << config.num_subbands << " blocks " << config.num_blocks
+        << " kernels " << SBC_Encoder_GetKernelName();
+  }
+}
@@ -53,7 +53,10 @@ static void init(const packet_fragmenter_callbacks_t* result_callbacks) {
   callbacks = result_callbacks;
 }
 
-static void cleanup() { partial_packets.clear(); }
+static void cleanup() {
+  for (auto& entry : partial_packets) buffer_allocator->free(entry.second);
+  partial_packets.clear();
+}
 
 static void fragment_and_dispatch(BT_HDR* packet) {
   CHECK(packet != NULL);
@@ -117,6 +120,11 @@ static bool check_uint16_overflow(uint16_t a, uint16_t b) {
   return (UINT16_MAX - a) < b;
 }
 
+// Multi-fragment L2CAP PDUs are reassembled by copying each continuation
+// into one buffer sized for the whole PDU. Chaining the fragments instead
+// would not save that copy: every consumer above, starting with
+// l2c_rcv_acl_data(), parses the PDU from contiguous memory, so a chain
+// would be linearized before its first use.
 static void reassemble_and_dispatch(UNUSED_ATTR BT_HDR* packet) {
   if ((packet->event & MSG_EVT_MASK) == MSG_HC_TO_STACK_HCI_ACL) {
     uint8_t* stream = packet->data;
@@ -214,7 +222,8 @@ static void reassemble_and_dispatch(UNUSED_ATTR BT_HDR* packet) {
                  "%s got packet which would exceed expected length of %d. "
                  "Truncating.",
                  __func__, partial_packet->len);
-        packet->len = partial_packet->len - partial_packet->offset;
+        packet->len =
+            packet->offset + (partial_packet->len - partial_packet->offset);
         projected_offset = partial_packet->len;
       }
 
@@ -32,7 +32,7 @@
 DECLARE_TEST_MODES(init, set_data_sizes, no_fragmentation, fragmentation,
                    ble_no_fragmentation, ble_fragmentation,
                    non_acl_passthrough_fragmentation, no_reassembly, reassembly,
-                   non_acl_passthrough_reassembly);
+                   reassembly_restart, non_acl_passthrough_reassembly);
 
 #define LOCAL_BLE_CONTROLLER_ID 1
 
@@ -248,6 +248,11 @@ DURING(reassembly) AT_CALL(0) {
   return;
 }
 
+DURING(reassembly_restart) AT_CALL(0) {
+  expect_packet_reassembled(MSG_HC_TO_STACK_HCI_ACL, packet, sample_data);
+  return;
+}
+
 DURING(non_acl_passthrough_reassembly) AT_CALL(0) {
   expect_packet_reassembled(MSG_HC_TO_STACK_HCI_EVT, packet, sample_data);
   return;
@@ -386,6 +391,30 @@ TEST_F(PacketFragmenterTest, test_reassembly_necessary) {
   EXPECT_CALL_COUNT(reassembled_callback, 1);
 }
 
+TEST_F(PacketFragmenterTest, test_reassembly_restart) {
+  reset_for(reassembly_restart);
+
+  // Send only the first fragment of a PDU; the next start packet supersedes
+  // it and the unfinished PDU must be dropped.
+  BT_HDR* packet = (BT_HDR*)osi_malloc(38 + 4 + sizeof(BT_HDR));
+  packet->len = 38 + 4;
+  packet->offset = 0;
+  packet->event = MSG_HC_TO_STACK_HCI_ACL;
+  packet->layer_specific = 0;
+  uint8_t* packet_data = packet->data;
+  UINT16_TO_STREAM(packet_data, test_handle_start);
+  UINT16_TO_STREAM(packet_data, 38);
+  UINT16_TO_STREAM(packet_data, 200);
+  memset(packet_data, 0, 36);
+  fragmenter->reassemble_and_dispatch(packet);
+
+  manufacture_packet_and_then_reassemble(MSG_HC_TO_STACK_HCI_ACL, 42,
+                                         sample_data);
+
+  EXPECT_EQ(strlen(sample_data), data_size_sum);
+  EXPECT_CALL_COUNT(reassembled_callback, 1);
+}
+
 TEST_F(PacketFragmenterTest, test_non_acl_passthrough_reasseembly) {
   reset_for(non_acl_passthrough_reassembly);
   manufacture_packet_and_then_reassemble(MSG_HC_TO_STACK_HCI_EVT, 42,
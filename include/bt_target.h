@@ -322,7 +322,9 @@
 #define BTM_SCO_DATA_SIZE_MAX 240
 #endif
 
-/* The size in bytes of the BTM inquiry database. */
+/* The maximum number of devices in the BTM inquiry database. Entries are
+ * allocated as responses arrive, so a large limit only costs memory where
+ * many devices are around. Must be below 0xFFFF. */
 #ifndef BTM_INQ_DB_SIZE
 #define BTM_INQ_DB_SIZE 40
 #endif
@@ -500,6 +502,12 @@
 #define SC_MODE_INCLUDED TRUE
 #endif
 
+/* The number of advertisers remembered by the LE advertising report
+ * duplicate filter. The least recently heard one is forgotten first. */
+#ifndef BTM_BLE_DUP_FILTER_CACHE_SIZE
+#define BTM_BLE_DUP_FILTER_CACHE_SIZE 256
+#endif
+
 /* Used for conformance testing ONLY */
 #ifndef BTM_BLE_CONFORMANCE_TESTING
 #define BTM_BLE_CONFORMANCE_TESTING FALSE
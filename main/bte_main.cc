@@ -69,6 +69,13 @@
 #endif  // defined(OS_GENERIC)
 #endif  // BT_BLE_STACK_CONF_FILE
 
+/* Depth of the lock-free ring carrying HCI events and ACL data to the BTU
+ * task. Producers (the HCI thread) block once this many messages are
+ * pending. */
+#ifndef BTU_HCI_MSG_QUEUE_SIZE
+#define BTU_HCI_MSG_QUEUE_SIZE 1024
+#endif
+
 /******************************************************************************
  *  Variables
  *****************************************************************************/
@@ -105,7 +112,8 @@ void bte_main_boot_entry(void) {
     return;
   }
 
-  btu_hci_msg_queue = fixed_queue_new(SIZE_MAX);
+  btu_hci_msg_queue = fixed_queue_new_with_mode(BTU_HCI_MSG_QUEUE_SIZE,
+                                                FIXED_QUEUE_MODE_RING_MPSC);
   if (btu_hci_msg_queue == NULL) {
     LOG_ERROR(LOG_TAG, "%s unable to allocate hci message queue.", __func__);
     return;
@@ -109,6 +109,12 @@ void alarm_unregister_processing_queue(fixed_queue_t* queue);
 // TODO: Remove this function once PM timers can be re-factored
 period_ms_t alarm_get_remaining_ms(const alarm_t* alarm);
 
+// Allows one-shot alarms due within |slack_ms| of an expiring alarm to be
+// dispatched together with it, trading up to |slack_ms| of early firing for
+// fewer timer wakeups. Periodic alarms are never fired early. The default
+// slack is 0, which disables coalescing.
+void alarm_set_coalescing_slack(period_ms_t slack_ms);
+
 // Cleanup the alarm internal state.
 // This function should be called by the OSI module cleanup during
 // graceful shutdown.
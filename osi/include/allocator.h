@@ -41,13 +41,20 @@ void* osi_malloc(size_t size);
 void* osi_calloc(size_t size);
 void osi_free(void* ptr);
 
+// Allocate a packet buffer of |size| bytes from the size-class pools in
+// pool_allocator.h, falling back to the regular heap if no class fits or the
+// matching class is exhausted. |osi_pool_calloc| zero-fills the buffer. The
+// result is released with |osi_free| like any other allocation.
+void* osi_pool_malloc(size_t size);
+void* osi_pool_calloc(size_t size);
+
 // Free a buffer that was previously allocated with function |osi_malloc|
 // or |osi_calloc| and reset the pointer to that buffer to NULL.
 // |p_ptr| is a pointer to the buffer pointer to be reset.
 // |p_ptr| cannot be NULL.
 void osi_free_and_reset(void** p_ptr);
 
-// Dump allocation-related statistics and debug info to the |fd| file
-// descriptor.
+// Dump allocation-related statistics, including buffer pool usage, and debug
+// info to the |fd| file descriptor.
 // The information is in user-readable text format. The |fd| must be valid.
 void osi_allocator_debug_dump(int fd);
@@ -22,9 +22,19 @@
 // a section.
 #define CONFIG_DEFAULT_SECTION "Global"
 
+// Appended to a config file name to name its journal. See
+// |config_save_journal|.
+#define CONFIG_JOURNAL_EXT ".journal"
+
 typedef struct config_t config_t;
 typedef struct config_section_node_t config_section_node_t;
 
+// Returns true if |section| of |config| is to be written out by
+// |config_save_journal|. The result must only depend on the keys and values
+// of |section|.
+typedef bool (*config_section_filter_t)(const config_t* config,
+                                        const char* section);
+
 // Creates a new config object with no entries (i.e. not backed by a file).
 // This function returns a config object or NULL on error. Clients must call
 // |config_free| on the returned handle when it is no longer required.
@@ -34,7 +44,8 @@ config_t* config_new_empty(void);
 // was a problem loading the file or allocating memory, this function returns
 // NULL. Clients must call |config_free| on the returned handle when it is no
 // longer required. |filename| must not be NULL and must point to a readable
-// file on the filesystem.
+// file on the filesystem. Changes saved to the journal of |filename| by
+// |config_save_journal| are applied on top of it.
 config_t* config_new(const char* filename);
 
 // Clones |src|, including all of it's sections, keys, and values.
@@ -146,5 +157,22 @@ const char* config_section_name(const config_section_node_t* iter);
 // The config module does not preserve comments or formatting so if a config
 // file was opened with |config_new| and subsequently overwritten with
 // |config_save|, all comments and special formatting in the original file will
-// be lost. Neither |config| nor |filename| may be NULL.
+// be lost. The file starts with a generation number, one more than that of
+// the file or journal it replaces. Any journal of |filename| is removed;
+// returns false if that fails, even though |filename| was written. Neither
+// |config| nor |filename| may be NULL.
 bool config_save(const config_t* config, const char* filename);
+
+// Saves the changes made to |config| since it was loaded from, or last saved
+// to, |filename|. Only the sections that changed are written: they are
+// appended to the journal of |filename| (|filename| followed by
+// |CONFIG_JOURNAL_EXT|), which |config_new| replays. The journal starts with
+// the generation number of |filename|, and is ignored on load when it does
+// not match. When |filename| does not exist yet, the journal belongs to
+// another generation, or it has grown larger than |filename|, the journal is
+// compacted instead: |config| is written in full as with |config_save|. If
+// |filter| is not NULL, only the sections it accepts are saved; the others
+// are saved as removed. Returns true on success. Neither |config| nor
+// |filename| may be NULL.
+bool config_save_journal(config_t* config, const char* filename,
+                         config_section_filter_t filter);
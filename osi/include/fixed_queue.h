@@ -30,12 +30,38 @@ typedef struct reactor_t reactor_t;
 typedef void (*fixed_queue_free_cb)(void* data);
 typedef void (*fixed_queue_cb)(fixed_queue_t* queue, void* context);
 
+// Storage backends a fixed queue can be created with.
+typedef enum {
+  // Mutex-protected list. Supports every operation in this header.
+  FIXED_QUEUE_MODE_LOCKED,
+  // Bounded lock-free ring buffer with a single producer thread and a single
+  // consumer thread.
+  FIXED_QUEUE_MODE_RING_SPSC,
+  // Bounded lock-free ring buffer with any number of producer threads and a
+  // single consumer thread.
+  FIXED_QUEUE_MODE_RING_MPSC,
+} fixed_queue_mode_t;
+
 // Creates a new fixed queue with the given |capacity|. If more elements than
 // |capacity| are added to the queue, the caller is blocked until space is
 // made available in the queue. Returns NULL on failure. The caller must free
 // the returned queue with |fixed_queue_free|.
 fixed_queue_t* fixed_queue_new(size_t capacity);
 
+// Creates a new fixed queue with the given |capacity| and storage |mode|.
+// |fixed_queue_new| is equivalent to calling this with
+// |FIXED_QUEUE_MODE_LOCKED|.
+//
+// Ring modes preallocate |capacity| slots, so |capacity| must be non-zero and
+// reasonably small. Enqueue and dequeue neither lock nor allocate, and the
+// dequeue file descriptor is only signalled when the queue goes from empty to
+// non-empty rather than once per element. In exchange, all dequeue and peek
+// operations must come from a single consumer thread, and
+// |fixed_queue_try_remove_from_queue|, |fixed_queue_get_list| and
+// |fixed_queue_get_enqueue_fd| are not supported. Returns NULL on failure.
+fixed_queue_t* fixed_queue_new_with_mode(size_t capacity,
+                                         fixed_queue_mode_t mode);
+
 // Frees a queue and (optionally) the enqueued elements.
 // |queue| is the queue to free. If the |free_cb| callback is not null,
 // it is called on each queue element to free it.
@@ -81,6 +107,13 @@ bool fixed_queue_try_enqueue(fixed_queue_t* queue, void* data);
 // immediately. Otherwise, the next element in the queue is returned.
 void* fixed_queue_try_dequeue(fixed_queue_t* queue);
 
+// Dequeues up to |max_count| elements from |queue| into |out|, in queue order.
+// This function will never block the caller. Returns the number of elements
+// dequeued, which is 0 if |queue| is empty or NULL. |out| may not be NULL and
+// must have room for |max_count| elements.
+size_t fixed_queue_dequeue_batch(fixed_queue_t* queue, void** out,
+                                 size_t max_count);
+
 // Returns the first element from |queue|, if present, without dequeuing it.
 // This function will never block the caller. Returns NULL if there are no
 // elements in the queue or |queue| is NULL.
@@ -95,11 +128,12 @@ void* fixed_queue_try_peek_last(fixed_queue_t* queue);
 // function will never block the caller. If the queue is empty or NULL, this
 // function returns NULL immediately. |data| may not be NULL. If the |data|
 // element is found in the queue, a pointer to the removed data is returned,
-// otherwise NULL.
+// otherwise NULL. Not supported by ring mode queues.
 void* fixed_queue_try_remove_from_queue(fixed_queue_t* queue, void* data);
 
 // Returns the iterateable list with all entries in the |queue|. This function
-// will never block the caller. |queue| may not be NULL.
+// will never block the caller. |queue| may not be NULL and may not be a ring
+// mode queue.
 //
 // NOTE: The return result of this function is not thread safe: the list could
 // be modified by another thread, and the result would be unpredictable.
@@ -111,7 +145,7 @@ list_t* fixed_queue_get_list(fixed_queue_t* queue);
 // operation on the fd: select(2). If |select| indicates that the file
 // descriptor is readable, the caller may call |fixed_queue_enqueue| without
 // blocking. The caller must not close the returned file descriptor. |queue|
-// may not be NULL.
+// may not be NULL and may not be a ring mode queue.
 int fixed_queue_get_enqueue_fd(const fixed_queue_t* queue);
 
 // This function returns a valid file descriptor. Callers may perform one
@@ -0,0 +1,64 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2017 Google, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Size-class pool backing |osi_pool_malloc| and |osi_pool_calloc|. Blocks are
+// carved on demand out of a single reserved address range, so ownership of a
+// pointer can be decided with a range check, and freed blocks are recycled
+// through small per-thread caches before going back to a shared free list.
+//
+// Callers normally go through allocator.h; these functions operate on raw
+// block sizes, i.e. after |allocation_tracker_resize_for_canary|.
+
+typedef struct {
+  size_t block_size;     // Usable bytes per block
+  size_t capacity;       // Maximum number of blocks in this class
+  uint64_t hits;         // Allocations served by this class
+  uint64_t misses;       // Allocations that fell back to malloc
+  size_t in_use;         // Blocks currently handed out
+  size_t high_water;     // Largest value |in_use| has reached
+  size_t carved;         // Blocks carved out of the reserved range so far
+} pool_allocator_class_stats_t;
+
+// Number of size classes managed by the pool.
+size_t pool_allocator_class_count(void);
+
+// Returns a block of at least |size| bytes, or NULL if |size| is larger than
+// the biggest class or the matching class is exhausted. The contents of the
+// block are undefined.
+void* pool_allocator_alloc(size_t size);
+
+// Returns true if |ptr| was returned by |pool_allocator_alloc|.
+bool pool_allocator_owns(const void* ptr);
+
+// Returns a block obtained from |pool_allocator_alloc| to the pool. |ptr| may
+// not be NULL.
+void pool_allocator_free(void* ptr);
+
+// Copies the statistics of class |index| into |stats|. |index| must be less
+// than |pool_allocator_class_count| and |stats| may not be NULL.
+void pool_allocator_get_class_stats(size_t index,
+                                    pool_allocator_class_stats_t* stats);
+
+// Dumps per-class statistics in user-readable text format to |fd|.
+void pool_allocator_debug_dump(int fd);
@@ -0,0 +1,107 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2017 Google, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Single-producer, single-consumer byte ring that lives in a memfd mapping
+// and can be shared with another process. The read and write positions are
+// kept in the mapping itself, so neither side needs a system call to move
+// data. A side that runs out of data (or space) waits on an eventfd that the
+// other side only signals while somebody is actually waiting.
+//
+// One process creates the ring with |shm_ring_new| and hands it to its peer
+// over a connected UNIX socket with |shm_ring_send|. The peer maps it with
+// |shm_ring_receive| and reports back with |shm_ring_send_ack|, which the
+// creator picks up with |shm_ring_receive_ack|.
+//
+// Exactly one thread may write and one thread may read at any time; the
+// reader and the writer may be in different processes.
+
+typedef struct shm_ring_t shm_ring_t;
+
+typedef enum {
+  SHM_RING_READY,    // Data (or space) is available
+  SHM_RING_TIMEOUT,  // Nothing became available before the timeout
+  SHM_RING_HANGUP,   // The peer closed |hangup_fd|
+  SHM_RING_ERROR,    // The ring is unusable, e.g. the peer corrupted it
+} shm_ring_wait_result_t;
+
+typedef enum {
+  SHM_RING_ACK_ACCEPTED,  // The peer mapped the ring and will use it
+  SHM_RING_ACK_DECLINED,  // The peer will keep using the socket
+  SHM_RING_ACK_NONE,      // The socket carries something else; left unread
+  SHM_RING_ACK_PENDING,   // Nothing has arrived yet
+} shm_ring_ack_t;
+
+// Creates a ring that holds up to |capacity| bytes. Returns NULL if shared
+// memory isn't available on this system. The result must be freed with
+// |shm_ring_free|.
+shm_ring_t* shm_ring_new(size_t capacity);
+
+// Unmaps |ring| and closes its file descriptors. Safe to call with NULL.
+void shm_ring_free(shm_ring_t* ring);
+
+// Returns the number of bytes |ring| can hold.
+size_t shm_ring_capacity(const shm_ring_t* ring);
+
+// Returns the number of bytes that can currently be read from |ring|.
+size_t shm_ring_bytes_readable(const shm_ring_t* ring);
+
+// Returns the number of bytes that can currently be written to |ring|.
+size_t shm_ring_bytes_writable(const shm_ring_t* ring);
+
+// Copies up to |length| bytes from |p| into |ring| without blocking and
+// returns the number of bytes copied.
+size_t shm_ring_write(shm_ring_t* ring, const uint8_t* p, size_t length);
+
+// Copies up to |length| bytes from |ring| into |p| without blocking and
+// returns the number of bytes copied.
+size_t shm_ring_read(shm_ring_t* ring, uint8_t* p, size_t length);
+
+// Discards everything that can currently be read from |ring| and returns
+// the number of bytes dropped. Must be called by the reader.
+size_t shm_ring_flush(shm_ring_t* ring);
+
+// Waits up to |timeout_ms| milliseconds for |ring| to become readable
+// (respectively writable). If |hangup_fd| isn't -1, the wait also ends with
+// |SHM_RING_HANGUP| when that file descriptor is hung up, which lets callers
+// keep using the socket the ring was exchanged over to detect a dead peer.
+shm_ring_wait_result_t shm_ring_wait_readable(shm_ring_t* ring,
+                                              int timeout_ms, int hangup_fd);
+shm_ring_wait_result_t shm_ring_wait_writable(shm_ring_t* ring,
+                                              int timeout_ms, int hangup_fd);
+
+// Sends |ring| to the peer of the connected UNIX socket |socket_fd|. Returns
+// true if the whole offer was sent.
+bool shm_ring_send(int socket_fd, const shm_ring_t* ring);
+
+// Receives a ring sent with |shm_ring_send| on |socket_fd|, waiting up to
+// |timeout_ms| milliseconds for it. Returns NULL if no valid offer arrived.
+// The result must be freed with |shm_ring_free|.
+shm_ring_t* shm_ring_receive(int socket_fd, int timeout_ms);
+
+// Tells the peer whether the ring received on |socket_fd| will be used.
+bool shm_ring_send_ack(int socket_fd, bool accepted);
+
+// Checks, without blocking, for the reply sent by |shm_ring_send_ack|. The
+// reply is only consumed when it is recognized.
+shm_ring_ack_t shm_ring_receive_ack(int socket_fd);
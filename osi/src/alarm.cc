@@ -34,11 +34,11 @@
 
 #include <hardware/bluetooth.h>
 
+#include <atomic>
 #include <mutex>
 
 #include "osi/include/allocator.h"
 #include "osi/include/fixed_queue.h"
-#include "osi/include/list.h"
 #include "osi/include/log.h"
 #include "osi/include/osi.h"
 #include "osi/include/semaphore.h"
@@ -85,8 +85,25 @@ struct alarm_t {
   alarm_callback_t callback;
   void* data;
   alarm_stats_t stats;
+  size_t heap_index;  // Position in |alarms|, or ALARM_NOT_PENDING
+  uint64_t sequence;  // Orders alarms with the same deadline
 };
 
+// Pending alarms, kept as a 4-ary min-heap ordered by deadline and then by
+// scheduling order. Each alarm records its own position, so insertion and
+// cancellation are O(log n) and the earliest deadline is always at index 0.
+typedef struct {
+  alarm_t** entries;
+  size_t size;
+  size_t capacity;
+  size_t peak_size;
+  uint64_t next_sequence;
+} alarm_heap_t;
+
+#define ALARM_HEAP_ARITY 4
+#define ALARM_HEAP_INITIAL_CAPACITY 32
+#define ALARM_NOT_PENDING SIZE_MAX
+
 // If the next wakeup time is less than this threshold, we should acquire
 // a wakelock instead of setting a wake alarm so we're not bouncing in
 // and out of suspend frequently. This value is externally visible to allow
@@ -102,9 +119,9 @@ static const clockid_t CLOCK_ID_ALARM = CLOCK_BOOTTIME_ALARM;
 
 // This mutex ensures that the |alarm_set|, |alarm_cancel|, and alarm callback
 // functions execute serially and not concurrently. As a result, this mutex
-// also protects the |alarms| list.
+// also protects the |alarms| heap.
 static std::mutex alarms_mutex;
-static list_t* alarms;
+static alarm_heap_t* alarms;
 static timer_t timer;
 static timer_t wakeup_timer;
 static bool timer_set;
@@ -118,6 +135,29 @@ static semaphore_t* alarm_expired;
 static thread_t* default_callback_thread;
 static fixed_queue_t* default_callback_queue;
 
+// Maximum number of expired alarms serviced per processing queue wakeup.
+// Anything left keeps the queue readable for the next reactor iteration.
+static const size_t ALARM_QUEUE_BATCH_MAX = 8;
+
+// Processing queue wakeups and the alarms serviced by them, across all
+// processing queues.
+static std::atomic<uint64_t> alarm_queue_wakeups;
+static std::atomic<uint64_t> alarm_queue_dispatched;
+
+// One-shot alarms due within this many milliseconds of an expiring alarm are
+// dispatched together with it, saving a separate timer wakeup. Periodic
+// alarms are never fired early.
+static period_ms_t coalescing_slack_ms = 0;
+
+// Deadline |timer| is currently armed for, or 0 if it is disarmed.
+static period_ms_t armed_deadline;
+
+// Dispatcher and timer statistics. Guarded by |alarms_mutex|.
+static uint64_t dispatcher_wakeups;
+static uint64_t coalesced_count;
+static uint64_t timer_rearm_count;
+static uint64_t timer_rearm_skipped_count;
+
 static alarm_t* alarm_new_internal(const char* name, bool is_periodic);
 static bool lazy_initialize(void);
 static period_ms_t now(void);
@@ -129,6 +169,12 @@ static void remove_pending_alarm(alarm_t* alarm);
 static void schedule_next_instance(alarm_t* alarm);
 static void reschedule_root_alarm(void);
 static void alarm_queue_ready(fixed_queue_t* queue, void* context);
+static bool alarm_dispatch_one(fixed_queue_t* queue);
+static alarm_heap_t* alarm_heap_new(void);
+static void alarm_heap_free(alarm_heap_t* heap);
+static alarm_t* alarm_heap_front(const alarm_heap_t* heap);
+static void alarm_heap_push(alarm_heap_t* heap, alarm_t* alarm);
+static void alarm_heap_remove(alarm_heap_t* heap, alarm_t* alarm);
 static void timer_callback(void* data);
 static void callback_dispatch(void* context);
 static bool timer_create_internal(const clockid_t clock_id, timer_t* timer);
@@ -159,6 +205,7 @@ static alarm_t* alarm_new_internal(const char* name, bool is_periodic) {
 
   ret->callback_mutex = new std::recursive_mutex;
   ret->is_periodic = is_periodic;
+  ret->heap_index = ALARM_NOT_PENDING;
   ret->stats.name = osi_strdup(name);
   // NOTE: The stats were reset by osi_calloc() above
 
@@ -232,8 +279,7 @@ void alarm_cancel(alarm_t* alarm) {
 // Internal implementation of canceling an alarm.
 // The caller must hold the |alarms_mutex|
 static void alarm_cancel_internal(alarm_t* alarm) {
-  bool needs_reschedule =
-      (!list_is_empty(alarms) && list_front(alarms) == alarm);
+  bool needs_reschedule = (alarm_heap_front(alarms) == alarm);
 
   remove_pending_alarm(alarm);
 
@@ -273,10 +319,15 @@ void alarm_cleanup(void) {
   semaphore_free(alarm_expired);
   alarm_expired = NULL;
 
-  list_free(alarms);
+  alarm_heap_free(alarms);
   alarms = NULL;
 }
 
+void alarm_set_coalescing_slack(period_ms_t slack_ms) {
+  std::lock_guard<std::mutex> lock(alarms_mutex);
+  coalescing_slack_ms = slack_ms;
+}
+
 static bool lazy_initialize(void) {
   CHECK(alarms == NULL);
 
@@ -287,9 +338,9 @@ static bool lazy_initialize(void) {
 
   std::lock_guard<std::mutex> lock(alarms_mutex);
 
-  alarms = list_new(NULL);
+  alarms = alarm_heap_new();
   if (!alarms) {
-    LOG_ERROR(LOG_TAG, "%s unable to allocate alarm list.", __func__);
+    LOG_ERROR(LOG_TAG, "%s unable to allocate alarm heap.", __func__);
     goto error;
   }
 
@@ -350,7 +401,7 @@ error:
 
   if (timer_initialized) timer_delete(timer);
 
-  list_free(alarms);
+  alarm_heap_free(alarms);
   alarms = NULL;
 
   return false;
@@ -369,10 +420,10 @@ static period_ms_t now(void) {
   return (ts.tv_sec * 1000LL) + (ts.tv_nsec / 1000000LL);
 }
 
-// Remove alarm from internal alarm list and the processing queue
+// Remove alarm from internal alarm heap and the processing queue
 // The caller must hold the |alarms_mutex|
 static void remove_pending_alarm(alarm_t* alarm) {
-  list_remove(alarms, alarm);
+  if (alarm->heap_index != ALARM_NOT_PENDING) alarm_heap_remove(alarms, alarm);
   while (fixed_queue_try_remove_from_queue(alarm->queue, alarm) != NULL) {
     // Remove all repeated alarm instances from the queue.
     // NOTE: We are defensive here - we shouldn't have repeated alarm instances
@@ -381,10 +432,9 @@ static void remove_pending_alarm(alarm_t* alarm) {
 
 // Must be called with |alarms_mutex| held
 static void schedule_next_instance(alarm_t* alarm) {
-  // If the alarm is currently set and it's at the start of the list,
+  // If the alarm is currently set and it's at the top of the heap,
   // we'll need to re-schedule since we've adjusted the earliest deadline.
-  bool needs_reschedule =
-      (!list_is_empty(alarms) && list_front(alarms) == alarm);
+  bool needs_reschedule = (alarm_heap_front(alarms) == alarm);
   if (alarm->callback) remove_pending_alarm(alarm);
 
   // Calculate the next deadline for this alarm
@@ -394,26 +444,11 @@ static void schedule_next_instance(alarm_t* alarm) {
     ms_into_period = ((just_now - alarm->creation_time) % alarm->period);
   alarm->deadline = just_now + (alarm->period - ms_into_period);
 
-  // Add it into the timer list sorted by deadline (earliest deadline first).
-  if (list_is_empty(alarms) ||
-      ((alarm_t*)list_front(alarms))->deadline > alarm->deadline) {
-    list_prepend(alarms, alarm);
-  } else {
-    for (list_node_t* node = list_begin(alarms); node != list_end(alarms);
-         node = list_next(node)) {
-      list_node_t* next = list_next(node);
-      if (next == list_end(alarms) ||
-          ((alarm_t*)list_node(next))->deadline > alarm->deadline) {
-        list_insert_after(alarms, node, alarm);
-        break;
-      }
-    }
-  }
+  alarm_heap_push(alarms, alarm);
 
   // If the new alarm has the earliest deadline, we need to re-evaluate our
   // schedule.
-  if (needs_reschedule ||
-      (!list_is_empty(alarms) && list_front(alarms) == alarm)) {
+  if (needs_reschedule || alarm_heap_front(alarms) == alarm) {
     reschedule_root_alarm();
   }
 }
@@ -430,9 +465,17 @@ static void reschedule_root_alarm(void) {
   struct itimerspec timer_time;
   memset(&timer_time, 0, sizeof(timer_time));
 
-  if (list_is_empty(alarms)) goto done;
+  next = alarm_heap_front(alarms);
+  if (next == NULL) goto done;
+
+  // The wake lock timer is still armed for this exact deadline and it hasn't
+  // passed yet, so re-arming it would be a no-op.
+  if (timer_set && next->deadline == armed_deadline &&
+      next->deadline > now()) {
+    timer_rearm_skipped_count++;
+    return;
+  }
 
-  next = static_cast<alarm_t*>(list_front(alarms));
   next_expiration = next->deadline - now();
   if (next_expiration < TIMER_INTERVAL_FOR_WAKELOCK_IN_MS) {
     if (!timer_set) {
@@ -476,8 +519,10 @@ static void reschedule_root_alarm(void) {
   }
 
 done:
+  timer_rearm_count++;
   timer_set =
       timer_time.it_value.tv_sec != 0 || timer_time.it_value.tv_nsec != 0;
+  armed_deadline = timer_set ? next->deadline : 0;
   if (timer_was_set && !timer_set) {
     wakelock_release();
   }
@@ -523,25 +568,44 @@ void alarm_unregister_processing_queue(fixed_queue_t* queue) {
 
   fixed_queue_unregister_dequeue(queue);
 
-  // Cancel all alarms that are using this queue
+  // Cancel all alarms that are using this queue. Cancelling reorders the
+  // heap, so collect the matching alarms first.
   std::lock_guard<std::mutex> lock(alarms_mutex);
-  for (list_node_t* node = list_begin(alarms); node != list_end(alarms);) {
-    alarm_t* alarm = (alarm_t*)list_node(node);
-    node = list_next(node);
+  if (alarms->size == 0) return;
+
+  alarm_t** matching =
+      static_cast<alarm_t**>(osi_malloc(alarms->size * sizeof(alarm_t*)));
+  size_t count = 0;
+  for (size_t i = 0; i < alarms->size; i++) {
     // TODO: Each module is responsible for tearing down its alarms; currently,
     // this is not the case. In the future, this check should be replaced by
     // an assert.
-    if (alarm->queue == queue) alarm_cancel_internal(alarm);
+    alarm_t* alarm = alarms->entries[i];
+    if (alarm->queue == queue) matching[count++] = alarm;
   }
+  for (size_t i = 0; i < count; i++) alarm_cancel_internal(matching[i]);
+  osi_free(matching);
 }
 
 static void alarm_queue_ready(fixed_queue_t* queue, UNUSED_ATTR void* context) {
   CHECK(queue != NULL);
 
+  // Alarms are dequeued one at a time, each under |alarms_mutex|, so that
+  // |alarm_cancel| can still pull a not yet serviced alarm off the queue.
+  size_t count = 0;
+  while (count < ALARM_QUEUE_BATCH_MAX && alarm_dispatch_one(queue)) count++;
+
+  alarm_queue_wakeups.fetch_add(1, std::memory_order_relaxed);
+  alarm_queue_dispatched.fetch_add(count, std::memory_order_relaxed);
+}
+
+// Services the alarm at the front of |queue|. Returns false if the queue was
+// empty.
+static bool alarm_dispatch_one(fixed_queue_t* queue) {
   std::unique_lock<std::mutex> lock(alarms_mutex);
   alarm_t* alarm = (alarm_t*)fixed_queue_try_dequeue(queue);
   if (alarm == NULL) {
-    return;  // The alarm was probably canceled
+    return false;  // The alarm was probably canceled
   }
 
   //
@@ -574,6 +638,7 @@ static void alarm_queue_ready(fixed_queue_t* queue, UNUSED_ATTR void* context) {
   CHECK(t1 >= t0);
   period_ms_t delta = t1 - t0;
   update_scheduling_stats(&alarm->stats, t0, deadline, delta);
+  return true;
 }
 
 // Callback function for wake alarms and our posix timer
@@ -591,28 +656,37 @@ static void callback_dispatch(UNUSED_ATTR void* context) {
     if (!dispatcher_thread_active) break;
 
     std::lock_guard<std::mutex> lock(alarms_mutex);
-    alarm_t* alarm;
-
-    // Take into account that the alarm may get cancelled before we get to it.
-    // We're done here if there are no alarms or the alarm at the front is in
-    // the future. Exit right away since there's nothing left to do.
-    if (list_is_empty(alarms) ||
-        (alarm = static_cast<alarm_t*>(list_front(alarms)))->deadline > now()) {
-      reschedule_root_alarm();
-      continue;
-    }
+    dispatcher_wakeups++;
+
+    // Take into account that alarms may get cancelled before we get to them.
+    // Dispatch every alarm that has expired, plus one-shot alarms due within
+    // the coalescing slack. Each pending alarm is visited at most once so
+    // that zero-period alarms can't keep us here.
+    period_ms_t just_now = now();
+    size_t budget = alarms->size;
+    while (budget-- > 0) {
+      alarm_t* alarm = alarm_heap_front(alarms);
+      if (alarm == NULL) break;
+      if (alarm->deadline > just_now) {
+        if (alarm->is_periodic ||
+            alarm->deadline > just_now + coalescing_slack_ms)
+          break;
+        coalesced_count++;
+      }
 
-    list_remove(alarms, alarm);
+      alarm_heap_remove(alarms, alarm);
+
+      if (alarm->is_periodic) {
+        alarm->prev_deadline = alarm->deadline;
+        schedule_next_instance(alarm);
+        alarm->stats.rescheduled_count++;
+      }
 
-    if (alarm->is_periodic) {
-      alarm->prev_deadline = alarm->deadline;
-      schedule_next_instance(alarm);
-      alarm->stats.rescheduled_count++;
+      // Enqueue the alarm for processing
+      fixed_queue_enqueue(alarm->queue, alarm);
     }
-    reschedule_root_alarm();
 
-    // Enqueue the alarm for processing
-    fixed_queue_enqueue(alarm->queue, alarm);
+    reschedule_root_alarm();
   }
 
   LOG_DEBUG(LOG_TAG, "%s Callback thread exited", __func__);
@@ -693,12 +767,29 @@ void alarm_debug_dump(int fd) {
 
   period_ms_t just_now = now();
 
-  dprintf(fd, "  Total Alarms: %zu\n\n", list_length(alarms));
+  dprintf(fd, "  Total Alarms: %zu\n", alarms->size);
+  dprintf(fd, "%-51s: %zu / %zu / %zu\n",
+          "  Heap occupancy (pending/peak/capacity)", alarms->size,
+          alarms->peak_size, alarms->capacity);
+  dprintf(fd, "%-51s: %llu / %llu / %llu\n",
+          "  Timer (wakeups/rearms/skipped rearms)",
+          (unsigned long long)dispatcher_wakeups,
+          (unsigned long long)timer_rearm_count,
+          (unsigned long long)timer_rearm_skipped_count);
+  dprintf(fd, "%-51s: %llu / %llu\n", "  Coalescing (slack ms/coalesced)",
+          (unsigned long long)coalescing_slack_ms,
+          (unsigned long long)coalesced_count);
+
+  uint64_t wakeups = alarm_queue_wakeups.load(std::memory_order_relaxed);
+  uint64_t dispatched = alarm_queue_dispatched.load(std::memory_order_relaxed);
+  dprintf(fd, "%-51s: %llu / %llu / %.2f\n\n",
+          "  Queue dispatch (wakeups/alarms/avg batch)",
+          (unsigned long long)wakeups, (unsigned long long)dispatched,
+          wakeups ? (double)dispatched / wakeups : 0.0);
 
   // Dump info for each alarm
-  for (list_node_t* node = list_begin(alarms); node != list_end(alarms);
-       node = list_next(node)) {
-    alarm_t* alarm = (alarm_t*)list_node(node);
+  for (size_t i = 0; i < alarms->size; i++) {
+    alarm_t* alarm = alarms->entries[i];
     alarm_stats_t* stats = &alarm->stats;
 
     dprintf(fd, "  Alarm : %s (%s)\n", stats->name,
@@ -731,3 +822,111 @@ void alarm_debug_dump(int fd) {
     dprintf(fd, "\n");
   }
 }
+
+static alarm_heap_t* alarm_heap_new(void) {
+  alarm_heap_t* heap =
+      static_cast<alarm_heap_t*>(osi_calloc(sizeof(alarm_heap_t)));
+  heap->capacity = ALARM_HEAP_INITIAL_CAPACITY;
+  heap->entries =
+      static_cast<alarm_t**>(osi_calloc(heap->capacity * sizeof(alarm_t*)));
+  return heap;
+}
+
+static void alarm_heap_free(alarm_heap_t* heap) {
+  if (!heap) return;
+
+  for (size_t i = 0; i < heap->size; i++)
+    heap->entries[i]->heap_index = ALARM_NOT_PENDING;
+  osi_free(heap->entries);
+  osi_free(heap);
+}
+
+static alarm_t* alarm_heap_front(const alarm_heap_t* heap) {
+  return (heap->size == 0) ? NULL : heap->entries[0];
+}
+
+static bool alarm_heap_less(const alarm_t* a, const alarm_t* b) {
+  if (a->deadline != b->deadline) return a->deadline < b->deadline;
+  return a->sequence < b->sequence;
+}
+
+static void alarm_heap_place(alarm_heap_t* heap, size_t index,
+                             alarm_t* alarm) {
+  heap->entries[index] = alarm;
+  alarm->heap_index = index;
+}
+
+static void alarm_heap_sift_up(alarm_heap_t* heap, size_t index) {
+  alarm_t* alarm = heap->entries[index];
+  while (index > 0) {
+    size_t parent = (index - 1) / ALARM_HEAP_ARITY;
+    if (!alarm_heap_less(alarm, heap->entries[parent])) break;
+    alarm_heap_place(heap, index, heap->entries[parent]);
+    index = parent;
+  }
+  alarm_heap_place(heap, index, alarm);
+}
+
+static void alarm_heap_sift_down(alarm_heap_t* heap, size_t index) {
+  alarm_t* alarm = heap->entries[index];
+  for (;;) {
+    size_t first_child = index * ALARM_HEAP_ARITY + 1;
+    if (first_child >= heap->size) break;
+
+    size_t last_child = first_child + ALARM_HEAP_ARITY;
+    if (last_child > heap->size) last_child = heap->size;
+
+    size_t smallest = first_child;
+    for (size_t child = first_child + 1; child < last_child; child++) {
+      if (alarm_heap_less(heap->entries[child], heap->entries[smallest]))
+        smallest = child;
+    }
+
+    if (!alarm_heap_less(heap->entries[smallest], alarm)) break;
+    alarm_heap_place(heap, index, heap->entries[smallest]);
+    index = smallest;
+  }
+  alarm_heap_place(heap, index, alarm);
+}
+
+static void alarm_heap_push(alarm_heap_t* heap, alarm_t* alarm) {
+  CHECK(alarm->heap_index == ALARM_NOT_PENDING);
+
+  if (heap->size == heap->capacity) {
+    size_t capacity = heap->capacity * 2;
+    alarm_t** entries =
+        static_cast<alarm_t**>(osi_malloc(capacity * sizeof(alarm_t*)));
+    memcpy(entries, heap->entries, heap->size * sizeof(alarm_t*));
+    osi_free(heap->entries);
+    heap->entries = entries;
+    heap->capacity = capacity;
+  }
+
+  alarm->sequence = heap->next_sequence++;
+  heap->entries[heap->size] = alarm;
+  alarm->heap_index = heap->size;
+  heap->size++;
+  if (heap->size > heap->peak_size) heap->peak_size = heap->size;
+
+  alarm_heap_sift_up(heap, alarm->heap_index);
+}
+
+static void alarm_heap_remove(alarm_heap_t* heap, alarm_t* alarm) {
+  size_t index = alarm->heap_index;
+  CHECK(index < heap->size && heap->entries[index] == alarm);
+
+  alarm->heap_index = ALARM_NOT_PENDING;
+  heap->size--;
+  if (index == heap->size) return;
+
+  // Move the last entry into the hole and restore the heap property in
+  // whichever direction it is violated.
+  alarm_heap_place(heap, index, heap->entries[heap->size]);
+  if (index > 0 &&
+      alarm_heap_less(heap->entries[index],
+                      heap->entries[(index - 1) / ALARM_HEAP_ARITY])) {
+    alarm_heap_sift_up(heap, index);
+  } else {
+    alarm_heap_sift_down(heap, index);
+  }
+}
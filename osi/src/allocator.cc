@@ -21,6 +21,7 @@
 
 #include "osi/include/allocation_tracker.h"
 #include "osi/include/allocator.h"
+#include "osi/include/pool_allocator.h"
 
 static const allocator_id_t alloc_allocator_id = 42;
 
@@ -69,8 +70,31 @@ void* osi_calloc(size_t size) {
   return allocation_tracker_notify_alloc(alloc_allocator_id, ptr, size);
 }
 
+void* osi_pool_malloc(size_t size) {
+  size_t real_size = allocation_tracker_resize_for_canary(size);
+  void* ptr = pool_allocator_alloc(real_size);
+  if (!ptr) ptr = malloc(real_size);
+  CHECK(ptr);
+  return allocation_tracker_notify_alloc(alloc_allocator_id, ptr, size);
+}
+
+void* osi_pool_calloc(size_t size) {
+  size_t real_size = allocation_tracker_resize_for_canary(size);
+  void* ptr = pool_allocator_alloc(real_size);
+  if (ptr)
+    memset(ptr, 0, real_size);
+  else
+    ptr = calloc(1, real_size);
+  CHECK(ptr);
+  return allocation_tracker_notify_alloc(alloc_allocator_id, ptr, size);
+}
+
 void osi_free(void* ptr) {
-  free(allocation_tracker_notify_free(alloc_allocator_id, ptr));
+  void* real_ptr = allocation_tracker_notify_free(alloc_allocator_id, ptr);
+  if (pool_allocator_owns(real_ptr))
+    pool_allocator_free(real_ptr);
+  else
+    free(real_ptr);
 }
 
 void osi_free_and_reset(void** p_ptr) {
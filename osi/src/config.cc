@@ -24,6 +24,7 @@
 #include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <libgen.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -31,32 +32,85 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <unordered_map>
+
 #include "osi/include/allocator.h"
 #include "osi/include/list.h"
 #include "osi/include/log.h"
 
+// Ends each save appended to a journal.
+#define CONFIG_JOURNAL_COMMIT "#commit"
+// Starts a file written in full, and each journal, followed by the generation
+// number of the file. A journal only applies to the file of its generation.
+#define CONFIG_GENERATION "#generation "
+
 typedef struct {
   char* key;
   char* value;
 } entry_t;
 
+// Hashes and compares names in place, so lookups don't copy the name.
+struct config_name_hash {
+  size_t operator()(const char* name) const {
+    size_t hash = 2166136261u;
+    while (*name) hash = (hash ^ (uint8_t)*name++) * 16777619u;
+    return hash;
+  }
+};
+
+struct config_name_equal {
+  bool operator()(const char* a, const char* b) const {
+    return !strcmp(a, b);
+  }
+};
+
+// Keyed by |entry_t::key|.
+typedef std::unordered_map<const char*, entry_t*, config_name_hash,
+                           config_name_equal>
+    entry_index_t;
+
 typedef struct {
   char* name;
   list_t* entries;
+  entry_index_t* entry_index;
+  bool dirty;  // changed since the last save
+  bool saved;  // written out by the last save
 } section_t;
 
+// Keyed by |section_t::name|.
+typedef std::unordered_map<const char*, section_t*, config_name_hash,
+                           config_name_equal>
+    section_index_t;
+
 struct config_t {
+  // Sections in insertion order, indexed by name.
   list_t* sections;
+  section_index_t* section_index;
+  // Names of saved sections removed since the last save.
+  list_t* removed_sections;
+  // Set when the journal can't be appended to, e.g. it holds an incomplete
+  // save or |config| wasn't loaded from the file; the next save rewrites the
+  // file instead.
+  bool journal_invalid;
 };
 
 // Empty definition; this type is aliased to list_node_t.
 struct config_section_iter_t {};
 
 static bool config_parse(FILE* fp, config_t* config);
+static bool config_read_generation(const char* filename, uint64_t* generation);
+static void config_load_journal(config_t* config, const char* filename);
+static bool config_append_journal(config_t* config, const char* filename,
+                                  config_section_filter_t filter);
+static bool config_write(const config_t* config, const char* filename,
+                         config_section_filter_t filter);
+static void config_mark_saved(config_t* config,
+                              config_section_filter_t filter);
 
 static section_t* section_new(const char* name);
 static void section_free(void* ptr);
 static section_t* section_find(const config_t* config, const char* section);
+static section_t* section_find_or_add(config_t* config, const char* section);
 
 static entry_t* entry_new(const char* key, const char* value);
 static void entry_free(void* ptr);
@@ -72,6 +126,15 @@ config_t* config_new_empty(void) {
     goto error;
   }
 
+  config->removed_sections = list_new(osi_free);
+  if (!config->removed_sections) {
+    LOG_ERROR(LOG_TAG, "%s unable to allocate list for removed sections.",
+              __func__);
+    goto error;
+  }
+
+  config->section_index = new section_index_t();
+  config->journal_invalid = true;
   return config;
 
 error:;
@@ -99,6 +162,12 @@ config_t* config_new(const char* filename) {
   }
 
   fclose(fp);
+
+  if (config) {
+    config->journal_invalid = false;
+    config_load_journal(config, filename);
+    config_mark_saved(config, NULL);
+  }
   return config;
 }
 
@@ -129,6 +198,8 @@ void config_free(config_t* config) {
   if (!config) return;
 
   list_free(config->sections);
+  list_free(config->removed_sections);
+  delete config->section_index;
   osi_free(config);
 }
 
@@ -211,29 +282,24 @@ void config_set_bool(config_t* config, const char* section, const char* key,
 
 void config_set_string(config_t* config, const char* section, const char* key,
                        const char* value) {
-  section_t* sec = section_find(config, section);
-  if (!sec) {
-    sec = section_new(section);
-    if (sec)
-      list_append(config->sections, sec);
-    else {
-      LOG_ERROR(LOG_TAG,"%s: Unable to allocate memory for section", __func__);
-    }
-  }
+  section_t* sec = section_find_or_add(config, section);
 
   if (sec) {
-    for (const list_node_t* node = list_begin(sec->entries);
-         node != list_end(sec->entries); node = list_next(node)) {
-      entry_t* entry = static_cast<entry_t*>(list_node(node));
-      if (!strcmp(entry->key, key)) {
-        osi_free(entry->value);
-        entry->value = osi_strdup(value);
-        return;
-      }
+    entry_index_t::iterator it = sec->entry_index->find(key);
+    if (it != sec->entry_index->end()) {
+      entry_t* entry = it->second;
+      if (!strcmp(entry->value, value)) return;
+
+      osi_free(entry->value);
+      entry->value = osi_strdup(value);
+      sec->dirty = true;
+      return;
     }
 
     entry_t* entry = entry_new(key, value);
     list_append(sec->entries, entry);
+    (*sec->entry_index)[entry->key] = entry;
+    sec->dirty = true;
   }
 }
 
@@ -244,6 +310,9 @@ bool config_remove_section(config_t* config, const char* section) {
   section_t* sec = section_find(config, section);
   if (!sec) return false;
 
+  if (sec->saved)
+    list_append(config->removed_sections, osi_strdup(sec->name));
+  config->section_index->erase(sec->name);
   return list_remove(config->sections, sec);
 }
 
@@ -256,6 +325,8 @@ bool config_remove_key(config_t* config, const char* section, const char* key) {
   entry_t* entry = entry_find(config, section, key);
   if (!sec || !entry) return false;
 
+  sec->entry_index->erase(entry->key);
+  sec->dirty = true;
   return list_remove(sec->entries, entry);
 }
 
@@ -287,6 +358,139 @@ bool config_save(const config_t* config, const char* filename) {
   CHECK(filename != NULL);
   CHECK(*filename != '\0');
 
+  return config_write(config, filename, NULL);
+}
+
+bool config_save_journal(config_t* config, const char* filename,
+                         config_section_filter_t filter) {
+  CHECK(config != NULL);
+  CHECK(filename != NULL);
+  CHECK(*filename != '\0');
+
+  bool ret = config_append_journal(config, filename, filter);
+  if (!ret) ret = config_write(config, filename, filter);
+
+  if (ret) {
+    config_mark_saved(config, filter);
+    config->journal_invalid = false;
+  } else {
+    config->journal_invalid = true;
+  }
+  return ret;
+}
+
+static char* config_journal_filename(const char* filename) {
+  const int len = strlen(filename) + strlen(CONFIG_JOURNAL_EXT) + 1;
+  char* journal_filename = static_cast<char*>(osi_calloc(len));
+  snprintf(journal_filename, len, "%s%s", filename, CONFIG_JOURNAL_EXT);
+  return journal_filename;
+}
+
+static bool config_write_section(FILE* fp, const section_t* section,
+                                 bool with_entries) {
+  if (fprintf(fp, "[%s]\n", section->name) < 0) return false;
+  if (!with_entries) return true;
+
+  for (const list_node_t* enode = list_begin(section->entries);
+       enode != list_end(section->entries); enode = list_next(enode)) {
+    const entry_t* entry = (const entry_t*)list_node(enode);
+    if (fprintf(fp, "%s = %s\n", entry->key, entry->value) < 0) return false;
+  }
+  return true;
+}
+
+// Appends the sections changed since the last save to the journal of
+// |filename|. Each save is one batch: a section header followed by the full
+// contents of the section, which replace the previous ones on replay (a
+// header alone removes the section), ended by |CONFIG_JOURNAL_COMMIT|.
+// Returns false if the journal should be compacted instead, or on error.
+static bool config_append_journal(config_t* config, const char* filename,
+                                  config_section_filter_t filter) {
+  struct stat file_st;
+  struct stat journal_st;
+  bool changed = !list_is_empty(config->removed_sections);
+
+  if (config->journal_invalid || stat(filename, &file_st) == -1) return false;
+
+  for (const list_node_t* node = list_begin(config->sections);
+       node != list_end(config->sections) && !changed; node = list_next(node))
+    changed = static_cast<const section_t*>(list_node(node))->dirty;
+  if (!changed) return true;
+
+  char* journal_filename = config_journal_filename(filename);
+  FILE* fp = fopen(journal_filename, "at");
+  if (!fp) {
+    LOG_ERROR(LOG_TAG, "%s unable to open journal '%s': %s", __func__,
+              journal_filename, strerror(errno));
+    osi_free(journal_filename);
+    return false;
+  }
+
+  // Compact once the journal has outgrown the file it applies to.
+  if (fstat(fileno(fp), &journal_st) == -1 ||
+      journal_st.st_size >= file_st.st_size) {
+    fclose(fp);
+    osi_free(journal_filename);
+    return false;
+  }
+
+  // Start a new journal on the generation of the file, or compact if the one
+  // there was started on another generation.
+  uint64_t file_generation = 0;
+  uint64_t journal_generation = 0;
+  bool success = true;
+  config_read_generation(filename, &file_generation);
+  if (journal_st.st_size == 0) {
+    if (chmod(journal_filename, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP) == -1) {
+      LOG_WARN(LOG_TAG, "%s unable to change file permissions '%s': %s",
+               __func__, journal_filename, strerror(errno));
+    }
+    success = fprintf(fp, CONFIG_GENERATION "%" PRIu64 "\n",
+                      file_generation) >= 0;
+  } else if (!config_read_generation(journal_filename, &journal_generation) ||
+             journal_generation != file_generation) {
+    LOG_WARN(LOG_TAG, "%s journal '%s' is not of the generation of '%s'",
+             __func__, journal_filename, filename);
+    fclose(fp);
+    osi_free(journal_filename);
+    return false;
+  }
+
+  for (const list_node_t* node = list_begin(config->removed_sections);
+       node != list_end(config->removed_sections) && success;
+       node = list_next(node)) {
+    success = fprintf(fp, "[%s]\n", (const char*)list_node(node)) >= 0;
+  }
+
+  for (const list_node_t* node = list_begin(config->sections);
+       node != list_end(config->sections) && success; node = list_next(node)) {
+    const section_t* section = (const section_t*)list_node(node);
+    if (!section->dirty) continue;
+
+    if (!filter || filter(config, section->name))
+      success = config_write_section(fp, section, true);
+    else if (section->saved)
+      success = config_write_section(fp, section, false);
+  }
+
+  if (success) success = fprintf(fp, "%s\n", CONFIG_JOURNAL_COMMIT) >= 0;
+  if (success) success = fflush(fp) != EOF;
+  if (success && fsync(fileno(fp)) < 0) {
+    LOG_WARN(LOG_TAG, "%s unable to fsync journal '%s': %s", __func__,
+             journal_filename, strerror(errno));
+  }
+  if (fclose(fp) == EOF) success = false;
+
+  if (!success) {
+    LOG_ERROR(LOG_TAG, "%s unable to write to journal '%s': %s", __func__,
+              journal_filename, strerror(errno));
+  }
+  osi_free(journal_filename);
+  return success;
+}
+
+static bool config_write(const config_t* config, const char* filename,
+                         config_section_filter_t filter) {
   // Steps to ensure content of config file gets to disk:
   //
   // 1) Open and write to temp file (e.g. bt_config.conf.new).
@@ -297,6 +501,11 @@ bool config_save(const config_t* config, const char* filename) {
   //    This ensures directory entries are up-to-date.
   int dir_fd = -1;
   FILE* fp = NULL;
+  bool first_section = true;
+  bool journal_removed = true;
+  uint64_t generation = 0;
+  uint64_t journal_generation = 0;
+  char* journal_filename = config_journal_filename(filename);
 
   // Build temp config file based on config file (e.g. bt_config.conf.new).
   static const char* temp_file_ext = ".new";
@@ -328,32 +537,35 @@ bool config_save(const config_t* config, const char* filename) {
     goto error;
   }
 
+  // Number the file past both the file and the journal it replaces, so that
+  // a journal left behind never matches it.
+  config_read_generation(filename, &generation);
+  if (config_read_generation(journal_filename, &journal_generation) &&
+      journal_generation > generation)
+    generation = journal_generation;
+  if (fprintf(fp, CONFIG_GENERATION "%" PRIu64 "\n", generation + 1) < 0) {
+    LOG_ERROR(LOG_TAG, "%s unable to write to file '%s': %s", __func__,
+              temp_filename, strerror(errno));
+    goto error;
+  }
+
   for (const list_node_t* node = list_begin(config->sections);
        node != list_end(config->sections); node = list_next(node)) {
     const section_t* section = (const section_t*)list_node(node);
-    if (fprintf(fp, "[%s]\n", section->name) < 0) {
+    if (filter && !filter(config, section->name)) continue;
+
+    // Only add a separating newline between sections.
+    if (!first_section && fputc('\n', fp) == EOF) {
       LOG_ERROR(LOG_TAG, "%s unable to write to file '%s': %s", __func__,
                 temp_filename, strerror(errno));
       goto error;
     }
+    first_section = false;
 
-    for (const list_node_t* enode = list_begin(section->entries);
-         enode != list_end(section->entries); enode = list_next(enode)) {
-      const entry_t* entry = (const entry_t*)list_node(enode);
-      if (fprintf(fp, "%s = %s\n", entry->key, entry->value) < 0) {
-        LOG_ERROR(LOG_TAG, "%s unable to write to file '%s': %s", __func__,
-                  temp_filename, strerror(errno));
-        goto error;
-      }
-    }
-
-    // Only add a separating newline if there are more sections.
-    if (list_next(node) != list_end(config->sections)) {
-      if (fputc('\n', fp) == EOF) {
-        LOG_ERROR(LOG_TAG, "%s unable to write to file '%s': %s", __func__,
-                  temp_filename, strerror(errno));
-        goto error;
-      }
+    if (!config_write_section(fp, section, true)) {
+      LOG_ERROR(LOG_TAG, "%s unable to write to file '%s': %s", __func__,
+                temp_filename, strerror(errno));
+      goto error;
     }
   }
 
@@ -385,6 +597,14 @@ bool config_save(const config_t* config, const char* filename) {
     goto error;
   }
 
+  // A journal left next to the file applies to its previous contents. It is
+  // ignored now that the generations differ, but must not be appended to.
+  if (unlink(journal_filename) == -1 && errno != ENOENT) {
+    LOG_ERROR(LOG_TAG, "%s unable to remove journal '%s': %s", __func__,
+              journal_filename, strerror(errno));
+    journal_removed = false;
+  }
+
   // This should ensure the directory is updated as well.
   if (fsync(dir_fd) < 0) {
     LOG_WARN(LOG_TAG, "%s unable to fsync dir '%s': %s", __func__,
@@ -397,9 +617,10 @@ bool config_save(const config_t* config, const char* filename) {
     goto error;
   }
 
+  osi_free(journal_filename);
   osi_free(temp_filename);
   osi_free(temp_dirname);
-  return true;
+  return journal_removed;
 
 error:
   // This indicates there is a write issue.  Unlink as partial data is not
@@ -407,11 +628,29 @@ error:
   unlink(temp_filename);
   if (fp) fclose(fp);
   if (dir_fd != -1) close(dir_fd);
+  osi_free(journal_filename);
   osi_free(temp_filename);
   osi_free(temp_dirname);
   return false;
 }
 
+// Reads the generation number on the first line of |filename| into
+// |generation|. Returns false, leaving |generation| unchanged, if the file
+// can't be read or doesn't start with one.
+static bool config_read_generation(const char* filename, uint64_t* generation) {
+  FILE* fp = fopen(filename, "rt");
+  if (!fp) return false;
+
+  char line[64];
+  uint64_t value;
+  bool found = fgets(line, sizeof(line), fp) &&
+               sscanf(line, CONFIG_GENERATION "%" SCNu64, &value) == 1;
+  fclose(fp);
+
+  if (found) *generation = value;
+  return found;
+}
+
 static char* trim(char* str) {
   while (isspace(*str)) ++str;
 
@@ -464,11 +703,130 @@ static bool config_parse(FILE* fp, config_t* config) {
   return true;
 }
 
+// Applies one batch read from the journal: every section in |batch|
+// replaces the section of the same name in |config|, keeping its position.
+static void config_apply_journal_batch(config_t* config,
+                                       const config_t* batch) {
+  for (const list_node_t* node = list_begin(batch->sections);
+       node != list_end(batch->sections); node = list_next(node)) {
+    const section_t* sec = (const section_t*)list_node(node);
+
+    if (list_is_empty(sec->entries)) {
+      config_remove_section(config, sec->name);
+      continue;
+    }
+
+    section_t* target = section_find(config, sec->name);
+    if (target) {
+      target->entry_index->clear();
+      list_clear(target->entries);
+    }
+
+    for (const list_node_t* enode = list_begin(sec->entries);
+         enode != list_end(sec->entries); enode = list_next(enode)) {
+      const entry_t* entry = (const entry_t*)list_node(enode);
+      config_set_string(config, sec->name, entry->key, entry->value);
+    }
+  }
+}
+
+static void config_load_journal(config_t* config, const char* filename) {
+  char* journal_filename = config_journal_filename(filename);
+  FILE* fp = fopen(journal_filename, "rt");
+  if (!fp) {
+    osi_free(journal_filename);
+    return;
+  }
+
+  // A journal of another generation was left by a save that rewrote the file
+  // but could not remove it.
+  uint64_t file_generation = 0;
+  uint64_t journal_generation;
+  config_read_generation(filename, &file_generation);
+  if (!config_read_generation(journal_filename, &journal_generation) ||
+      journal_generation != file_generation) {
+    LOG_WARN(LOG_TAG, "%s ignoring journal '%s' of another generation",
+             __func__, journal_filename);
+    config->journal_invalid = true;
+    fclose(fp);
+    osi_free(journal_filename);
+    return;
+  }
+
+  config_t* batch = config_new_empty();
+  bool complete = true;
+  char line[1024];
+  char section[1024];
+  strcpy(section, CONFIG_DEFAULT_SECTION);
+
+  while (fgets(line, sizeof(line), fp)) {
+    char* line_ptr = trim(line);
+
+    if (!strcmp(line_ptr, CONFIG_JOURNAL_COMMIT)) {
+      config_apply_journal_batch(config, batch);
+      config_free(batch);
+      batch = config_new_empty();
+      continue;
+    }
+
+    // Skip blank and comment lines.
+    if (*line_ptr == '\0' || *line_ptr == '#') continue;
+
+    if (*line_ptr == '[') {
+      size_t len = strlen(line_ptr);
+      if (line_ptr[len - 1] != ']') {
+        complete = false;
+        break;
+      }
+      strncpy(section, line_ptr + 1, len - 2);
+      section[len - 2] = '\0';
+      section_find_or_add(batch, section);
+    } else {
+      char* split = strchr(line_ptr, '=');
+      if (!split) {
+        complete = false;
+        break;
+      }
+
+      *split = '\0';
+      config_set_string(batch, section, trim(line_ptr), trim(split + 1));
+    }
+  }
+
+  // A save interrupted part way leaves a batch without its commit line.
+  if (!complete || !list_is_empty(batch->sections)) {
+    LOG_WARN(LOG_TAG, "%s ignoring incomplete save at the end of '%s'",
+             __func__, journal_filename);
+    config->journal_invalid = true;
+  }
+
+  config_free(batch);
+  fclose(fp);
+  osi_free(journal_filename);
+}
+
+// Marks the contents of |config| as matching what is on disk.
+static void config_mark_saved(config_t* config,
+                              config_section_filter_t filter) {
+  for (const list_node_t* node = list_begin(config->sections);
+       node != list_end(config->sections); node = list_next(node)) {
+    section_t* sec = static_cast<section_t*>(list_node(node));
+    if (sec->dirty || filter == NULL) {
+      sec->saved = !filter || filter(config, sec->name);
+      sec->dirty = false;
+    }
+  }
+
+  list_clear(config->removed_sections);
+}
+
 static section_t* section_new(const char* name) {
   section_t* section = static_cast<section_t*>(osi_calloc(sizeof(section_t)));
 
   section->name = osi_strdup(name);
   section->entries = list_new(entry_free);
+  section->entry_index = new entry_index_t();
+  section->dirty = true;
   return section;
 }
 
@@ -478,17 +836,30 @@ static void section_free(void* ptr) {
   section_t* section = static_cast<section_t*>(ptr);
   osi_free(section->name);
   list_free(section->entries);
+  delete section->entry_index;
   osi_free(section);
 }
 
 static section_t* section_find(const config_t* config, const char* section) {
-  for (const list_node_t* node = list_begin(config->sections);
-       node != list_end(config->sections); node = list_next(node)) {
-    section_t* sec = static_cast<section_t*>(list_node(node));
-    if (!strcmp(sec->name, section)) return sec;
+  section_index_t::const_iterator it = config->section_index->find(section);
+  if (it == config->section_index->end()) return NULL;
+
+  return it->second;
+}
+
+static section_t* section_find_or_add(config_t* config, const char* section) {
+  section_t* sec = section_find(config, section);
+  if (sec) return sec;
+
+  sec = section_new(section);
+  if (!sec) {
+    LOG_ERROR(LOG_TAG, "%s: Unable to allocate memory for section", __func__);
+    return NULL;
   }
 
-  return NULL;
+  list_append(config->sections, sec);
+  (*config->section_index)[sec->name] = sec;
+  return sec;
 }
 
 static entry_t* entry_new(const char* key, const char* value) {
@@ -513,11 +884,8 @@ static entry_t* entry_find(const config_t* config, const char* section,
   section_t* sec = section_find(config, section);
   if (!sec) return NULL;
 
-  for (const list_node_t* node = list_begin(sec->entries);
-       node != list_end(sec->entries); node = list_next(node)) {
-    entry_t* entry = static_cast<entry_t*>(list_node(node));
-    if (!strcmp(entry->key, key)) return entry;
-  }
+  entry_index_t::const_iterator it = sec->entry_index->find(key);
+  if (it == sec->entry_index->end()) return NULL;
 
-  return NULL;
+  return it->second;
 }
@@ -16,18 +16,66 @@
  *
  ******************************************************************************/
 
+#define LOG_TAG "bt_osi_fixed_queue"
+
 #include <base/logging.h>
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
 #include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
+#include <atomic>
+#include <condition_variable>
 #include <mutex>
 
 #include "osi/include/allocator.h"
 #include "osi/include/fixed_queue.h"
 #include "osi/include/list.h"
+#include "osi/include/log.h"
 #include "osi/include/osi.h"
 #include "osi/include/reactor.h"
 #include "osi/include/semaphore.h"
 
+// Upper bound on the number of preallocated slots of a ring mode queue.
+#define FIXED_QUEUE_RING_MAX_CAPACITY (1 << 20)
+
+// Padding used to keep the producer and consumer cursors of a ring on
+// separate cache lines.
+#define RING_CACHE_LINE_SIZE 64
+
+typedef struct {
+  // Holds the ring position this cell expects to be written at next. A cell
+  // at index |pos % size| is free for position |pos| when |sequence == pos|
+  // and carries published data when |sequence == pos + 1|.
+  std::atomic<size_t> sequence;
+  void* data;
+} ring_cell_t;
+
+typedef struct ring_t {
+  ring_cell_t* cells;
+  size_t size;
+  bool multi_producer;
+
+  uint8_t pad0[RING_CACHE_LINE_SIZE];
+  std::atomic<size_t> enqueue_pos;
+  uint8_t pad1[RING_CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> dequeue_pos;
+  uint8_t pad2[RING_CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+
+  // Non-semaphore eventfd that is readable while the ring holds elements.
+  // |signaled| is set while the eventfd holds, or is about to hold, a wakeup
+  // token, so producers only write to it on the empty -> non-empty edge.
+  std::atomic_bool signaled;
+  int dequeue_fd;
+
+  // Slow path for producers that find the ring full.
+  std::mutex full_mutex;
+  std::condition_variable not_full;
+  std::atomic<size_t> blocked_producers;
+} ring_t;
+
 typedef struct fixed_queue_t {
   list_t* list;
   semaphore_t* enqueue_sem;
@@ -35,12 +83,25 @@ typedef struct fixed_queue_t {
   std::mutex* mutex;
   size_t capacity;
 
+  // Only set for ring mode queues, in which case none of the fields above
+  // except |capacity| are used.
+  ring_t* ring;
+
   reactor_object_t* dequeue_object;
   fixed_queue_cb dequeue_ready;
   void* dequeue_context;
 } fixed_queue_t;
 
 static void internal_dequeue_ready(void* context);
+static ring_t* ring_new(size_t capacity, bool multi_producer);
+static void ring_free(ring_t* ring, fixed_queue_free_cb free_cb);
+static bool ring_try_push(ring_t* ring, void* data);
+static void ring_push(ring_t* ring, void* data);
+static void* ring_try_pop(ring_t* ring);
+static void* ring_pop(ring_t* ring);
+static void* ring_peek_first(ring_t* ring);
+static void* ring_peek_last(ring_t* ring);
+static size_t ring_length(ring_t* ring);
 
 fixed_queue_t* fixed_queue_new(size_t capacity) {
   fixed_queue_t* ret =
@@ -65,11 +126,37 @@ error:
   return NULL;
 }
 
+fixed_queue_t* fixed_queue_new_with_mode(size_t capacity,
+                                         fixed_queue_mode_t mode) {
+  if (mode == FIXED_QUEUE_MODE_LOCKED) return fixed_queue_new(capacity);
+
+  if (capacity == 0 || capacity > FIXED_QUEUE_RING_MAX_CAPACITY) {
+    LOG_ERROR(LOG_TAG, "%s invalid ring queue capacity %zu", __func__,
+              capacity);
+    return NULL;
+  }
+
+  ring_t* ring = ring_new(capacity, mode == FIXED_QUEUE_MODE_RING_MPSC);
+  if (!ring) return NULL;
+
+  fixed_queue_t* ret =
+      static_cast<fixed_queue_t*>(osi_calloc(sizeof(fixed_queue_t)));
+  ret->capacity = capacity;
+  ret->ring = ring;
+  return ret;
+}
+
 void fixed_queue_free(fixed_queue_t* queue, fixed_queue_free_cb free_cb) {
   if (!queue) return;
 
   fixed_queue_unregister_dequeue(queue);
 
+  if (queue->ring) {
+    ring_free(queue->ring, free_cb);
+    osi_free(queue);
+    return;
+  }
+
   if (free_cb)
     for (const list_node_t* node = list_begin(queue->list);
          node != list_end(queue->list); node = list_next(node))
@@ -95,6 +182,7 @@ void fixed_queue_flush(fixed_queue_t* queue, fixed_queue_free_cb free_cb) {
 
 bool fixed_queue_is_empty(fixed_queue_t* queue) {
   if (queue == NULL) return true;
+  if (queue->ring) return ring_length(queue->ring) == 0;
 
   std::lock_guard<std::mutex> lock(*queue->mutex);
   return list_is_empty(queue->list);
@@ -102,6 +190,7 @@ bool fixed_queue_is_empty(fixed_queue_t* queue) {
 
 size_t fixed_queue_length(fixed_queue_t* queue) {
   if (queue == NULL) return 0;
+  if (queue->ring) return ring_length(queue->ring);
 
   std::lock_guard<std::mutex> lock(*queue->mutex);
   return list_length(queue->list);
@@ -117,6 +206,11 @@ void fixed_queue_enqueue(fixed_queue_t* queue, void* data) {
   CHECK(queue != NULL);
   CHECK(data != NULL);
 
+  if (queue->ring) {
+    ring_push(queue->ring, data);
+    return;
+  }
+
   semaphore_wait(queue->enqueue_sem);
 
   {
@@ -130,6 +224,8 @@ void fixed_queue_enqueue(fixed_queue_t* queue, void* data) {
 void* fixed_queue_dequeue(fixed_queue_t* queue) {
   CHECK(queue != NULL);
 
+  if (queue->ring) return ring_pop(queue->ring);
+
   semaphore_wait(queue->dequeue_sem);
 
   void* ret = NULL;
@@ -148,6 +244,8 @@ bool fixed_queue_try_enqueue(fixed_queue_t* queue, void* data) {
   CHECK(queue != NULL);
   CHECK(data != NULL);
 
+  if (queue->ring) return ring_try_push(queue->ring, data);
+
   if (!semaphore_try_wait(queue->enqueue_sem)) return false;
 
   {
@@ -162,6 +260,8 @@ bool fixed_queue_try_enqueue(fixed_queue_t* queue, void* data) {
 void* fixed_queue_try_dequeue(fixed_queue_t* queue) {
   if (queue == NULL) return NULL;
 
+  if (queue->ring) return ring_try_pop(queue->ring);
+
   if (!semaphore_try_wait(queue->dequeue_sem)) return NULL;
 
   void* ret = NULL;
@@ -176,8 +276,38 @@ void* fixed_queue_try_dequeue(fixed_queue_t* queue) {
   return ret;
 }
 
+size_t fixed_queue_dequeue_batch(fixed_queue_t* queue, void** out,
+                                 size_t max_count) {
+  CHECK(out != NULL);
+  if (queue == NULL) return 0;
+
+  size_t count = 0;
+  if (queue->ring) {
+    while (count < max_count) {
+      void* data = ring_try_pop(queue->ring);
+      if (data == NULL) break;
+      out[count++] = data;
+    }
+    return count;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(*queue->mutex);
+    while (count < max_count && semaphore_try_wait(queue->dequeue_sem)) {
+      void* data = list_front(queue->list);
+      list_remove(queue->list, data);
+      out[count++] = data;
+    }
+  }
+
+  for (size_t i = 0; i < count; i++) semaphore_post(queue->enqueue_sem);
+
+  return count;
+}
+
 void* fixed_queue_try_peek_first(fixed_queue_t* queue) {
   if (queue == NULL) return NULL;
+  if (queue->ring) return ring_peek_first(queue->ring);
 
   std::lock_guard<std::mutex> lock(*queue->mutex);
   return list_is_empty(queue->list) ? NULL : list_front(queue->list);
@@ -185,6 +315,7 @@ void* fixed_queue_try_peek_first(fixed_queue_t* queue) {
 
 void* fixed_queue_try_peek_last(fixed_queue_t* queue) {
   if (queue == NULL) return NULL;
+  if (queue->ring) return ring_peek_last(queue->ring);
 
   std::lock_guard<std::mutex> lock(*queue->mutex);
   return list_is_empty(queue->list) ? NULL : list_back(queue->list);
@@ -192,6 +323,7 @@ void* fixed_queue_try_peek_last(fixed_queue_t* queue) {
 
 void* fixed_queue_try_remove_from_queue(fixed_queue_t* queue, void* data) {
   if (queue == NULL) return NULL;
+  CHECK(queue->ring == NULL);
 
   bool removed = false;
   {
@@ -212,6 +344,7 @@ void* fixed_queue_try_remove_from_queue(fixed_queue_t* queue, void* data) {
 
 list_t* fixed_queue_get_list(fixed_queue_t* queue) {
   CHECK(queue != NULL);
+  CHECK(queue->ring == NULL);
 
   // NOTE: Using the list in this way is not thread-safe.
   // Using this list in any context where threads can call other functions
@@ -221,11 +354,13 @@ list_t* fixed_queue_get_list(fixed_queue_t* queue) {
 
 int fixed_queue_get_dequeue_fd(const fixed_queue_t* queue) {
   CHECK(queue != NULL);
+  if (queue->ring) return queue->ring->dequeue_fd;
   return semaphore_get_fd(queue->dequeue_sem);
 }
 
 int fixed_queue_get_enqueue_fd(const fixed_queue_t* queue) {
   CHECK(queue != NULL);
+  CHECK(queue->ring == NULL);
   return semaphore_get_fd(queue->enqueue_sem);
 }
 
@@ -260,3 +395,162 @@ static void internal_dequeue_ready(void* context) {
   fixed_queue_t* queue = static_cast<fixed_queue_t*>(context);
   queue->dequeue_ready(queue, queue->dequeue_context);
 }
+
+static ring_t* ring_new(size_t capacity, bool multi_producer) {
+  int fd = eventfd(0, EFD_NONBLOCK);
+  if (fd == INVALID_FD) {
+    LOG_ERROR(LOG_TAG, "%s unable to create eventfd: %s", __func__,
+              strerror(errno));
+    return NULL;
+  }
+
+  ring_t* ring = new ring_t;
+  ring->cells = new ring_cell_t[capacity];
+  for (size_t i = 0; i < capacity; i++) {
+    ring->cells[i].sequence.store(i, std::memory_order_relaxed);
+    ring->cells[i].data = NULL;
+  }
+  ring->size = capacity;
+  ring->multi_producer = multi_producer;
+  ring->enqueue_pos.store(0, std::memory_order_relaxed);
+  ring->dequeue_pos.store(0, std::memory_order_relaxed);
+  ring->signaled.store(false, std::memory_order_relaxed);
+  ring->dequeue_fd = fd;
+  ring->blocked_producers.store(0, std::memory_order_relaxed);
+  return ring;
+}
+
+static void ring_free(ring_t* ring, fixed_queue_free_cb free_cb) {
+  if (free_cb) {
+    size_t end = ring->enqueue_pos.load(std::memory_order_acquire);
+    for (size_t pos = ring->dequeue_pos.load(std::memory_order_relaxed);
+         pos != end; pos++) {
+      ring_cell_t* cell = &ring->cells[pos % ring->size];
+      if (cell->sequence.load(std::memory_order_acquire) == pos + 1)
+        free_cb(cell->data);
+    }
+  }
+
+  close(ring->dequeue_fd);
+  delete[] ring->cells;
+  delete ring;
+}
+
+// Makes |dequeue_fd| readable unless a producer already did so. Must be
+// called after the caller's slot has been reserved.
+static void ring_signal(ring_t* ring) {
+  if (ring->signaled.exchange(true)) return;
+  eventfd_write(ring->dequeue_fd, 1);
+}
+
+static bool ring_try_push(ring_t* ring, void* data) {
+  size_t pos = ring->enqueue_pos.load(std::memory_order_relaxed);
+  ring_cell_t* cell;
+  for (;;) {
+    cell = &ring->cells[pos % ring->size];
+    size_t seq = cell->sequence.load(std::memory_order_acquire);
+    intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+    if (diff == 0) {
+      if (!ring->multi_producer) {
+        ring->enqueue_pos.store(pos + 1);
+        break;
+      }
+      if (ring->enqueue_pos.compare_exchange_weak(pos, pos + 1)) break;
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = ring->enqueue_pos.load(std::memory_order_relaxed);
+    }
+  }
+
+  // Signal before publishing so that a readable |dequeue_fd| always implies
+  // that at least one slot has been reserved; the consumer waits out the
+  // short window between reservation and publication.
+  ring_signal(ring);
+
+  cell->data = data;
+  cell->sequence.store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+static void ring_push(ring_t* ring, void* data) {
+  if (ring_try_push(ring, data)) return;
+
+  std::unique_lock<std::mutex> lock(ring->full_mutex);
+  ring->blocked_producers++;
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  while (!ring_try_push(ring, data)) ring->not_full.wait(lock);
+  ring->blocked_producers--;
+}
+
+static void* ring_try_pop(ring_t* ring) {
+  size_t pos = ring->dequeue_pos.load(std::memory_order_relaxed);
+  ring_cell_t* cell = &ring->cells[pos % ring->size];
+
+  while (cell->sequence.load(std::memory_order_acquire) != pos + 1) {
+    // Nothing reserved past |pos| means the ring is empty. Otherwise a
+    // producer is between reserving the slot and publishing into it.
+    if (ring->enqueue_pos.load() == pos) return NULL;
+    sched_yield();
+  }
+
+  void* data = cell->data;
+  ring->dequeue_pos.store(pos + 1);
+  cell->sequence.store(pos + ring->size, std::memory_order_release);
+
+  // The ring just became empty: consume the wakeup token, then re-check for
+  // a producer that reserved a slot while |signaled| was still set.
+  if (ring->enqueue_pos.load() == pos + 1) {
+    eventfd_t value;
+    eventfd_read(ring->dequeue_fd, &value);
+    ring->signaled.store(false);
+    if (ring->enqueue_pos.load() != pos + 1) {
+      ring->signaled.store(true);
+      eventfd_write(ring->dequeue_fd, 1);
+    }
+  }
+
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (ring->blocked_producers.load(std::memory_order_relaxed) > 0) {
+    std::lock_guard<std::mutex> lock(ring->full_mutex);
+    ring->not_full.notify_all();
+  }
+
+  return data;
+}
+
+static void* ring_pop(ring_t* ring) {
+  for (;;) {
+    void* data = ring_try_pop(ring);
+    if (data) return data;
+
+    struct pollfd pfd;
+    pfd.fd = ring->dequeue_fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    int ret;
+    OSI_NO_INTR(ret = poll(&pfd, 1, -1));
+  }
+}
+
+static void* ring_peek_first(ring_t* ring) {
+  size_t pos = ring->dequeue_pos.load(std::memory_order_relaxed);
+  ring_cell_t* cell = &ring->cells[pos % ring->size];
+  if (cell->sequence.load(std::memory_order_acquire) != pos + 1) return NULL;
+  return cell->data;
+}
+
+static void* ring_peek_last(ring_t* ring) {
+  size_t end = ring->enqueue_pos.load();
+  if (end == ring->dequeue_pos.load(std::memory_order_relaxed)) return NULL;
+
+  ring_cell_t* cell = &ring->cells[(end - 1) % ring->size];
+  if (cell->sequence.load(std::memory_order_acquire) != end) return NULL;
+  return cell->data;
+}
+
+static size_t ring_length(ring_t* ring) {
+  size_t dequeue_pos = ring->dequeue_pos.load();
+  size_t enqueue_pos = ring->enqueue_pos.load();
+  return enqueue_pos - dequeue_pos;
+}
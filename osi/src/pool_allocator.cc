@@ -0,0 +1,278 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2017 Google, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#define LOG_TAG "bt_osi_pool_allocator"
+
+#include "osi/include/pool_allocator.h"
+
+#include <base/logging.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <atomic>
+#include <mutex>
+
+#include "osi/include/log.h"
+#include "osi/include/osi.h"
+
+// Blocks a thread keeps cached per class before handing half of them back
+// to the shared free list, and how many it grabs at once when empty.
+#define POOL_THREAD_CACHE_MAX 16
+#define POOL_THREAD_CACHE_REFILL 8
+
+typedef struct {
+  size_t block_size;
+  size_t capacity;
+} pool_class_config_t;
+
+// Every class keeps 16 bytes of slack on top of the packet size it targets,
+// so that it still fits when the allocation tracker adds its canaries.
+static const pool_class_config_t class_config[] = {
+    // HCI commands and events (255 parameter bytes + headers + BT_HDR)
+    {288, 1024},
+    // BT_SMALL_BUFFER_SIZE: L2CAP, RFCOMM and AVDTP signalling
+    {688, 512},
+    // Controller sized ACL packets and AVDTP media packets
+    {1104, 512},
+    // L2CAP_MTU_SIZE SDUs with L2CAP_MIN_OFFSET headroom
+    {1744, 256},
+    // BT_DEFAULT_BUFFER_SIZE: RFCOMM data, ERTM segments and reassembly
+    {4144, 256},
+};
+
+#define POOL_CLASS_COUNT ARRAY_SIZE(class_config)
+
+typedef struct pool_block_t {
+  struct pool_block_t* next;
+} pool_block_t;
+
+typedef struct {
+  // Start of this class in the reserved range.
+  uint8_t* base;
+
+  std::mutex lock;
+  pool_block_t* free_list;  // Guarded by |lock|
+  size_t carved;            // Guarded by |lock|
+
+  std::atomic<uint64_t> hits;
+  std::atomic<uint64_t> misses;
+  std::atomic<size_t> in_use;
+  std::atomic<size_t> high_water;
+} pool_class_t;
+
+typedef struct {
+  pool_block_t* head;
+  size_t count;
+} thread_cache_bucket_t;
+
+// Per-thread free lists. Blocks freed on one thread are cached there even if
+// they were allocated elsewhere; whatever is left is handed back to the
+// shared free lists when the thread exits.
+class PoolThreadCache {
+ public:
+  ~PoolThreadCache();
+  thread_cache_bucket_t buckets[POOL_CLASS_COUNT] = {};
+};
+
+static pool_class_t classes[POOL_CLASS_COUNT];
+static std::once_flag region_once;
+static std::atomic<uint8_t*> region_base;
+static size_t region_size;
+static thread_local PoolThreadCache thread_cache;
+
+static void reserve_region(void);
+static size_t class_for_size(size_t size);
+static size_t class_for_ptr(const void* ptr);
+static void refill_bucket(size_t index, thread_cache_bucket_t* bucket);
+static void drain_bucket(size_t index, thread_cache_bucket_t* bucket,
+                         size_t count);
+
+size_t pool_allocator_class_count(void) { return POOL_CLASS_COUNT; }
+
+void* pool_allocator_alloc(size_t size) {
+  size_t index = class_for_size(size);
+  if (index == POOL_CLASS_COUNT) return NULL;
+
+  pool_class_t* pool_class = &classes[index];
+  thread_cache_bucket_t* bucket = &thread_cache.buckets[index];
+  if (!bucket->head) refill_bucket(index, bucket);
+  if (!bucket->head) {
+    pool_class->misses.fetch_add(1, std::memory_order_relaxed);
+    return NULL;
+  }
+
+  pool_block_t* block = bucket->head;
+  bucket->head = block->next;
+  bucket->count--;
+
+  pool_class->hits.fetch_add(1, std::memory_order_relaxed);
+  size_t in_use =
+      pool_class->in_use.fetch_add(1, std::memory_order_relaxed) + 1;
+  size_t high_water = pool_class->high_water.load(std::memory_order_relaxed);
+  while (in_use > high_water &&
+         !pool_class->high_water.compare_exchange_weak(
+             high_water, in_use, std::memory_order_relaxed)) {
+  }
+
+  return block;
+}
+
+bool pool_allocator_owns(const void* ptr) {
+  const uint8_t* base = region_base.load(std::memory_order_acquire);
+  if (!base || !ptr) return false;
+  const uint8_t* p = static_cast<const uint8_t*>(ptr);
+  return p >= base && p < base + region_size;
+}
+
+void pool_allocator_free(void* ptr) {
+  CHECK(ptr != NULL);
+  CHECK(pool_allocator_owns(ptr));
+
+  size_t index = class_for_ptr(ptr);
+  pool_class_t* pool_class = &classes[index];
+  thread_cache_bucket_t* bucket = &thread_cache.buckets[index];
+
+  pool_block_t* block = static_cast<pool_block_t*>(ptr);
+  block->next = bucket->head;
+  bucket->head = block;
+  bucket->count++;
+  pool_class->in_use.fetch_sub(1, std::memory_order_relaxed);
+
+  if (bucket->count > POOL_THREAD_CACHE_MAX)
+    drain_bucket(index, bucket, POOL_THREAD_CACHE_MAX / 2);
+}
+
+void pool_allocator_get_class_stats(size_t index,
+                                    pool_allocator_class_stats_t* stats) {
+  CHECK(index < POOL_CLASS_COUNT);
+  CHECK(stats != NULL);
+
+  pool_class_t* pool_class = &classes[index];
+  stats->block_size = class_config[index].block_size;
+  stats->capacity = class_config[index].capacity;
+  stats->hits = pool_class->hits.load(std::memory_order_relaxed);
+  stats->misses = pool_class->misses.load(std::memory_order_relaxed);
+  stats->in_use = pool_class->in_use.load(std::memory_order_relaxed);
+  stats->high_water = pool_class->high_water.load(std::memory_order_relaxed);
+
+  std::lock_guard<std::mutex> lock(pool_class->lock);
+  stats->carved = pool_class->carved;
+}
+
+void pool_allocator_debug_dump(int fd) {
+  dprintf(fd, "\nBluetooth Buffer Pool Statistics:\n");
+  dprintf(fd, "  %10s %12s %10s %8s %8s %8s %8s\n", "Block size", "Hits",
+          "Misses", "In use", "Peak", "Carved", "Capacity");
+
+  for (size_t i = 0; i < POOL_CLASS_COUNT; i++) {
+    pool_allocator_class_stats_t stats;
+    pool_allocator_get_class_stats(i, &stats);
+    dprintf(fd, "  %10zu %12llu %10llu %8zu %8zu %8zu %8zu\n",
+            stats.block_size, (unsigned long long)stats.hits,
+            (unsigned long long)stats.misses, stats.in_use, stats.high_water,
+            stats.carved, stats.capacity);
+  }
+}
+
+PoolThreadCache::~PoolThreadCache() {
+  for (size_t i = 0; i < POOL_CLASS_COUNT; i++) {
+    if (buckets[i].count) drain_bucket(i, &buckets[i], buckets[i].count);
+  }
+}
+
+// Reserves the address range for all classes up front. Pages are only
+// committed once blocks are carved out of them.
+static void reserve_region(void) {
+  size_t size = 0;
+  for (size_t i = 0; i < POOL_CLASS_COUNT; i++)
+    size += class_config[i].block_size * class_config[i].capacity;
+
+  void* base = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (base == MAP_FAILED) {
+    LOG_ERROR(LOG_TAG, "%s unable to reserve %zu bytes: %s", __func__, size,
+              strerror(errno));
+    return;
+  }
+
+  uint8_t* class_base = static_cast<uint8_t*>(base);
+  for (size_t i = 0; i < POOL_CLASS_COUNT; i++) {
+    classes[i].base = class_base;
+    class_base += class_config[i].block_size * class_config[i].capacity;
+  }
+
+  region_size = size;
+  region_base.store(static_cast<uint8_t*>(base), std::memory_order_release);
+}
+
+static size_t class_for_size(size_t size) {
+  for (size_t i = 0; i < POOL_CLASS_COUNT; i++) {
+    if (size <= class_config[i].block_size) return i;
+  }
+  return POOL_CLASS_COUNT;
+}
+
+static size_t class_for_ptr(const void* ptr) {
+  const uint8_t* p = static_cast<const uint8_t*>(ptr);
+  size_t index = 0;
+  while (index + 1 < POOL_CLASS_COUNT && p >= classes[index + 1].base) index++;
+  return index;
+}
+
+static void refill_bucket(size_t index, thread_cache_bucket_t* bucket) {
+  std::call_once(region_once, reserve_region);
+  if (!region_base.load(std::memory_order_acquire)) return;
+
+  pool_class_t* pool_class = &classes[index];
+  const pool_class_config_t* config = &class_config[index];
+
+  std::lock_guard<std::mutex> lock(pool_class->lock);
+  while (bucket->count < POOL_THREAD_CACHE_REFILL) {
+    pool_block_t* block = pool_class->free_list;
+    if (block) {
+      pool_class->free_list = block->next;
+    } else if (pool_class->carved < config->capacity) {
+      block = reinterpret_cast<pool_block_t*>(
+          pool_class->base + pool_class->carved * config->block_size);
+      pool_class->carved++;
+    } else {
+      break;
+    }
+
+    block->next = bucket->head;
+    bucket->head = block;
+    bucket->count++;
+  }
+}
+
+static void drain_bucket(size_t index, thread_cache_bucket_t* bucket,
+                         size_t count) {
+  pool_class_t* pool_class = &classes[index];
+
+  std::lock_guard<std::mutex> lock(pool_class->lock);
+  for (size_t i = 0; i < count && bucket->head; i++) {
+    pool_block_t* block = bucket->head;
+    bucket->head = block->next;
+    bucket->count--;
+
+    block->next = pool_class->free_list;
+    pool_class->free_list = block;
+  }
+}
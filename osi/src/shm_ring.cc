@@ -0,0 +1,521 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2017 Google, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#define LOG_TAG "bt_osi_shm_ring"
+
+#include "osi/include/shm_ring.h"
+
+#include <base/logging.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+
+#include "osi/include/allocator.h"
+#include "osi/include/log.h"
+#include "osi/include/osi.h"
+#include "osi/include/time.h"
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+
+#define SHM_RING_MAGIC 0x52534942      // "BISR"
+#define SHM_RING_ACK_MAGIC 0x4B534942  // "BISK"
+#define SHM_RING_VERSION 1
+
+// The positions live in the first page of the mapping, the data after it.
+#define SHM_RING_HEADER_SIZE 4096
+#define SHM_RING_MAX_SIZE (1U << 24)
+#define SHM_RING_CACHE_LINE 64
+
+#define SHM_RING_FD_COUNT 3
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2,
+              "shared memory positions must be lock-free atomics");
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t size;      // Size of the data area, a power of two
+  uint32_t capacity;  // Maximum number of bytes held, at most |size|
+
+  // Total number of bytes written, wrapping at 2^32; owned by the writer.
+  alignas(SHM_RING_CACHE_LINE) std::atomic<uint32_t> head;
+  std::atomic<uint32_t> reader_waiting;
+
+  // Total number of bytes read, wrapping at 2^32; owned by the reader.
+  alignas(SHM_RING_CACHE_LINE) std::atomic<uint32_t> tail;
+  std::atomic<uint32_t> writer_waiting;
+} shm_ring_header_t;
+
+static_assert(sizeof(shm_ring_header_t) <= SHM_RING_HEADER_SIZE,
+              "shm_ring_header_t must fit in the header page");
+
+// Message sent along with the file descriptors of a ring.
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t capacity;
+} shm_ring_offer_t;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t accepted;
+} shm_ring_ack_msg_t;
+
+struct shm_ring_t {
+  int mem_fd;
+  int data_fd;   // Signalled by the writer when data becomes available
+  int space_fd;  // Signalled by the reader when space becomes available
+  size_t map_size;
+  shm_ring_header_t* header;
+  uint8_t* data;
+
+  // Private copies of the geometry, so a misbehaving peer can't make us
+  // access memory outside the mapping.
+  uint32_t size;
+  uint32_t capacity;
+};
+
+static void close_fds(int* fds, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    if (fds[i] != INVALID_FD) close(fds[i]);
+  }
+}
+
+// Maps the ring described by |fds| and takes ownership of the descriptors.
+// With |create| the mapping is initialized for |capacity| bytes, otherwise
+// it is validated against what its creator wrote.
+static shm_ring_t* shm_ring_map(int fds[SHM_RING_FD_COUNT], bool create,
+                                uint32_t capacity) {
+  struct stat st;
+  if (fstat(fds[0], &st) < 0 || st.st_size <= SHM_RING_HEADER_SIZE ||
+      st.st_size > SHM_RING_HEADER_SIZE + SHM_RING_MAX_SIZE) {
+    LOG_ERROR(LOG_TAG, "%s unexpected shared memory size", __func__);
+    close_fds(fds, SHM_RING_FD_COUNT);
+    return NULL;
+  }
+
+  size_t map_size = st.st_size;
+  void* base =
+      mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+  if (base == MAP_FAILED) {
+    LOG_ERROR(LOG_TAG, "%s unable to map shared memory: %s", __func__,
+              strerror(errno));
+    close_fds(fds, SHM_RING_FD_COUNT);
+    return NULL;
+  }
+
+  shm_ring_header_t* header = static_cast<shm_ring_header_t*>(base);
+  uint32_t size = map_size - SHM_RING_HEADER_SIZE;
+  if (create) {
+    header->version = SHM_RING_VERSION;
+    header->size = size;
+    header->capacity = capacity;
+    header->head.store(0, std::memory_order_relaxed);
+    header->tail.store(0, std::memory_order_relaxed);
+    header->reader_waiting.store(0, std::memory_order_relaxed);
+    header->writer_waiting.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = SHM_RING_MAGIC;
+  } else {
+    capacity = header->capacity;
+    if (header->magic != SHM_RING_MAGIC ||
+        header->version != SHM_RING_VERSION || header->size != size ||
+        (size & (size - 1)) != 0 || capacity == 0 || capacity > size) {
+      LOG_ERROR(LOG_TAG, "%s invalid ring header", __func__);
+      munmap(base, map_size);
+      close_fds(fds, SHM_RING_FD_COUNT);
+      return NULL;
+    }
+  }
+
+  shm_ring_t* ring =
+      static_cast<shm_ring_t*>(osi_calloc(sizeof(shm_ring_t)));
+  ring->mem_fd = fds[0];
+  ring->data_fd = fds[1];
+  ring->space_fd = fds[2];
+  ring->map_size = map_size;
+  ring->header = header;
+  ring->data = static_cast<uint8_t*>(base) + SHM_RING_HEADER_SIZE;
+  ring->size = size;
+  ring->capacity = capacity;
+  return ring;
+}
+
+shm_ring_t* shm_ring_new(size_t capacity) {
+  CHECK(capacity > 0);
+
+  if (capacity > SHM_RING_MAX_SIZE) return NULL;
+
+  uint32_t size = 1;
+  while (size < capacity) size <<= 1;
+
+  int fds[SHM_RING_FD_COUNT] = {INVALID_FD, INVALID_FD, INVALID_FD};
+#if defined(__NR_memfd_create)
+  fds[0] = syscall(__NR_memfd_create, "bt_shm_ring",
+                   MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#else
+  errno = ENOSYS;
+#endif
+  if (fds[0] == INVALID_FD) {
+    LOG_WARN(LOG_TAG, "%s unable to create shared memory: %s", __func__,
+             strerror(errno));
+    return NULL;
+  }
+
+  if (ftruncate(fds[0], SHM_RING_HEADER_SIZE + size) < 0) {
+    LOG_ERROR(LOG_TAG, "%s unable to size shared memory: %s", __func__,
+              strerror(errno));
+    close_fds(fds, SHM_RING_FD_COUNT);
+    return NULL;
+  }
+
+#if defined(F_ADD_SEALS)
+  // Keep the peer from shrinking the mapping under our feet.
+  if (fcntl(fds[0], F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) <
+      0) {
+    LOG_WARN(LOG_TAG, "%s unable to seal shared memory: %s", __func__,
+             strerror(errno));
+  }
+#endif
+
+  fds[1] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  fds[2] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (fds[1] == INVALID_FD || fds[2] == INVALID_FD) {
+    LOG_ERROR(LOG_TAG, "%s unable to create eventfd: %s", __func__,
+              strerror(errno));
+    close_fds(fds, SHM_RING_FD_COUNT);
+    return NULL;
+  }
+
+  return shm_ring_map(fds, true, capacity);
+}
+
+void shm_ring_free(shm_ring_t* ring) {
+  if (ring == NULL) return;
+
+  munmap(ring->header, ring->map_size);
+  int fds[SHM_RING_FD_COUNT] = {ring->mem_fd, ring->data_fd, ring->space_fd};
+  close_fds(fds, SHM_RING_FD_COUNT);
+  osi_free(ring);
+}
+
+size_t shm_ring_capacity(const shm_ring_t* ring) {
+  CHECK(ring != NULL);
+  return ring->capacity;
+}
+
+// Number of bytes in the ring, or more than |capacity| if the peer has
+// corrupted the positions.
+static uint32_t shm_ring_used(const shm_ring_t* ring) {
+  return ring->header->head.load(std::memory_order_acquire) -
+         ring->header->tail.load(std::memory_order_acquire);
+}
+
+size_t shm_ring_bytes_readable(const shm_ring_t* ring) {
+  CHECK(ring != NULL);
+
+  uint32_t used = shm_ring_used(ring);
+  return (used <= ring->capacity) ? used : 0;
+}
+
+size_t shm_ring_bytes_writable(const shm_ring_t* ring) {
+  CHECK(ring != NULL);
+
+  uint32_t used = shm_ring_used(ring);
+  return (used <= ring->capacity) ? ring->capacity - used : 0;
+}
+
+// Wakes up the peer if it's blocked in |shm_ring_wait|. The caller has just
+// published a new position; the fence orders that store before the load of
+// the waiting flag, pairing with the fence in |shm_ring_wait|.
+static void shm_ring_wake(std::atomic<uint32_t>* waiting, int event_fd) {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (waiting->load(std::memory_order_relaxed) == 0) return;
+
+  uint64_t value = 1;
+  ssize_t ret;
+  OSI_NO_INTR(ret = write(event_fd, &value, sizeof(value)));
+  if (ret < 0 && errno != EAGAIN) {
+    LOG_ERROR(LOG_TAG, "%s unable to signal peer: %s", __func__,
+              strerror(errno));
+  }
+}
+
+size_t shm_ring_write(shm_ring_t* ring, const uint8_t* p, size_t length) {
+  CHECK(ring != NULL);
+  CHECK(p != NULL);
+
+  size_t writable = shm_ring_bytes_writable(ring);
+  if (length > writable) length = writable;
+  if (length == 0) return 0;
+
+  uint32_t head = ring->header->head.load(std::memory_order_relaxed);
+  size_t index = head & (ring->size - 1);
+  size_t first = std::min(length, (size_t)ring->size - index);
+  memcpy(ring->data + index, p, first);
+  memcpy(ring->data, p + first, length - first);
+
+  ring->header->head.store(head + length, std::memory_order_release);
+  shm_ring_wake(&ring->header->reader_waiting, ring->data_fd);
+  return length;
+}
+
+size_t shm_ring_read(shm_ring_t* ring, uint8_t* p, size_t length) {
+  CHECK(ring != NULL);
+  CHECK(p != NULL);
+
+  size_t readable = shm_ring_bytes_readable(ring);
+  if (length > readable) length = readable;
+  if (length == 0) return 0;
+
+  uint32_t tail = ring->header->tail.load(std::memory_order_relaxed);
+  size_t index = tail & (ring->size - 1);
+  size_t first = std::min(length, (size_t)ring->size - index);
+  memcpy(p, ring->data + index, first);
+  memcpy(p + first, ring->data, length - first);
+
+  ring->header->tail.store(tail + length, std::memory_order_release);
+  shm_ring_wake(&ring->header->writer_waiting, ring->space_fd);
+  return length;
+}
+
+size_t shm_ring_flush(shm_ring_t* ring) {
+  CHECK(ring != NULL);
+
+  size_t readable = shm_ring_bytes_readable(ring);
+  if (readable == 0) return 0;
+
+  uint32_t tail = ring->header->tail.load(std::memory_order_relaxed);
+  ring->header->tail.store(tail + readable, std::memory_order_release);
+  shm_ring_wake(&ring->header->writer_waiting, ring->space_fd);
+  return readable;
+}
+
+static shm_ring_wait_result_t shm_ring_wait(shm_ring_t* ring, bool for_read,
+                                            int timeout_ms, int hangup_fd) {
+  std::atomic<uint32_t>* waiting = for_read ? &ring->header->reader_waiting
+                                            : &ring->header->writer_waiting;
+  int event_fd = for_read ? ring->data_fd : ring->space_fd;
+  uint64_t deadline_us = time_get_os_boottime_us() + timeout_ms * 1000LL;
+
+  while (true) {
+    // Announce the wait before looking at the positions, so a peer that
+    // moves them after our check is guaranteed to see the flag.
+    waiting->store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    uint32_t used = shm_ring_used(ring);
+    if (used > ring->capacity) {
+      waiting->store(0, std::memory_order_relaxed);
+      LOG_ERROR(LOG_TAG, "%s ring positions are corrupted", __func__);
+      return SHM_RING_ERROR;
+    }
+    if (for_read ? (used > 0) : (used < ring->capacity)) {
+      waiting->store(0, std::memory_order_relaxed);
+      return SHM_RING_READY;
+    }
+
+    uint64_t now_us = time_get_os_boottime_us();
+    if (now_us >= deadline_us) {
+      waiting->store(0, std::memory_order_relaxed);
+      return SHM_RING_TIMEOUT;
+    }
+
+    struct pollfd pfds[2];
+    pfds[0].fd = event_fd;
+    pfds[0].events = POLLIN;
+    pfds[0].revents = 0;
+    pfds[1].fd = hangup_fd;
+    pfds[1].events = 0;
+    pfds[1].revents = 0;
+    int poll_ms = (deadline_us - now_us + 999) / 1000;
+    int ret;
+    OSI_NO_INTR(ret = poll(pfds, (hangup_fd == INVALID_FD) ? 1 : 2, poll_ms));
+    waiting->store(0, std::memory_order_relaxed);
+
+    if (ret < 0) {
+      LOG_ERROR(LOG_TAG, "%s poll failed: %s", __func__, strerror(errno));
+      return SHM_RING_ERROR;
+    }
+
+    if (pfds[0].revents & POLLIN) {
+      uint64_t value;
+      OSI_NO_INTR(ret = read(event_fd, &value, sizeof(value)));
+    }
+
+    if (pfds[1].revents & (POLLHUP | POLLERR | POLLNVAL)) {
+      return SHM_RING_HANGUP;
+    }
+  }
+}
+
+shm_ring_wait_result_t shm_ring_wait_readable(shm_ring_t* ring,
+                                              int timeout_ms, int hangup_fd) {
+  CHECK(ring != NULL);
+  return shm_ring_wait(ring, true, timeout_ms, hangup_fd);
+}
+
+shm_ring_wait_result_t shm_ring_wait_writable(shm_ring_t* ring,
+                                              int timeout_ms, int hangup_fd) {
+  CHECK(ring != NULL);
+  return shm_ring_wait(ring, false, timeout_ms, hangup_fd);
+}
+
+bool shm_ring_send(int socket_fd, const shm_ring_t* ring) {
+  CHECK(ring != NULL);
+
+  shm_ring_offer_t offer;
+  offer.magic = SHM_RING_MAGIC;
+  offer.version = SHM_RING_VERSION;
+  offer.capacity = ring->capacity;
+
+  struct iovec iov;
+  iov.iov_base = &offer;
+  iov.iov_len = sizeof(offer);
+
+  char control[CMSG_SPACE(sizeof(int) * SHM_RING_FD_COUNT)];
+  memset(control, 0, sizeof(control));
+
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int) * SHM_RING_FD_COUNT);
+  int fds[SHM_RING_FD_COUNT] = {ring->mem_fd, ring->data_fd, ring->space_fd};
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+  ssize_t ret;
+  OSI_NO_INTR(ret = sendmsg(socket_fd, &msg, MSG_NOSIGNAL));
+  if (ret != (ssize_t)sizeof(offer)) {
+    LOG_ERROR(LOG_TAG, "%s unable to send ring: %s", __func__,
+              (ret < 0) ? strerror(errno) : "short write");
+    return false;
+  }
+  return true;
+}
+
+shm_ring_t* shm_ring_receive(int socket_fd, int timeout_ms) {
+  struct pollfd pfd;
+  pfd.fd = socket_fd;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+
+  int ret;
+  OSI_NO_INTR(ret = poll(&pfd, 1, timeout_ms));
+  if (ret <= 0 || !(pfd.revents & POLLIN)) return NULL;
+
+  shm_ring_offer_t offer;
+  struct iovec iov;
+  iov.iov_base = &offer;
+  iov.iov_len = sizeof(offer);
+
+  char control[CMSG_SPACE(sizeof(int) * SHM_RING_FD_COUNT)];
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  ssize_t length;
+  OSI_NO_INTR(length = recvmsg(socket_fd, &msg, MSG_CMSG_CLOEXEC));
+
+  int fds[SHM_RING_FD_COUNT] = {INVALID_FD, INVALID_FD, INVALID_FD};
+  size_t fd_count = 0;
+  for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+       cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+      continue;
+    size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    int* received = reinterpret_cast<int*>(CMSG_DATA(cmsg));
+    for (size_t i = 0; i < count; i++) {
+      if (fd_count < SHM_RING_FD_COUNT) {
+        fds[fd_count++] = received[i];
+      } else {
+        close(received[i]);
+      }
+    }
+  }
+
+  if (length != (ssize_t)sizeof(offer) || fd_count != SHM_RING_FD_COUNT ||
+      (msg.msg_flags & MSG_CTRUNC) || offer.magic != SHM_RING_MAGIC ||
+      offer.version != SHM_RING_VERSION) {
+    LOG_ERROR(LOG_TAG, "%s invalid ring offer", __func__);
+    close_fds(fds, SHM_RING_FD_COUNT);
+    return NULL;
+  }
+
+  shm_ring_t* ring = shm_ring_map(fds, false, 0);
+  if (ring != NULL && ring->capacity != offer.capacity) {
+    LOG_ERROR(LOG_TAG, "%s ring capacity mismatch", __func__);
+    shm_ring_free(ring);
+    return NULL;
+  }
+  return ring;
+}
+
+bool shm_ring_send_ack(int socket_fd, bool accepted) {
+  shm_ring_ack_msg_t ack;
+  ack.magic = SHM_RING_ACK_MAGIC;
+  ack.accepted = accepted ? 1 : 0;
+
+  ssize_t ret;
+  OSI_NO_INTR(ret = send(socket_fd, &ack, sizeof(ack), MSG_NOSIGNAL));
+  return ret == (ssize_t)sizeof(ack);
+}
+
+shm_ring_ack_t shm_ring_receive_ack(int socket_fd) {
+  shm_ring_ack_msg_t ack;
+  ssize_t length;
+  OSI_NO_INTR(length = recv(socket_fd, &ack, sizeof(ack),
+                            MSG_PEEK | MSG_DONTWAIT));
+  if (length < 0) {
+    return (errno == EAGAIN || errno == EWOULDBLOCK) ? SHM_RING_ACK_PENDING
+                                                     : SHM_RING_ACK_NONE;
+  }
+  if (length == 0) return SHM_RING_ACK_NONE;
+
+  // A partial reply can only be told apart from other data by its prefix.
+  const uint32_t magic = SHM_RING_ACK_MAGIC;
+  size_t prefix = std::min((size_t)length, sizeof(magic));
+  if (memcmp(&ack, &magic, prefix) != 0) return SHM_RING_ACK_NONE;
+  if (length < (ssize_t)sizeof(ack)) return SHM_RING_ACK_PENDING;
+
+  OSI_NO_INTR(length = recv(socket_fd, &ack, sizeof(ack), MSG_DONTWAIT));
+  return ack.accepted ? SHM_RING_ACK_ACCEPTED : SHM_RING_ACK_DECLINED;
+}
@@ -287,6 +287,54 @@ TEST_F(AlarmTest, test_callback_ordering) {
   EXPECT_FALSE(WakeLockHeld());
 }
 
+// Test whether alarms set with decreasing deadlines fire in deadline order
+TEST_F(AlarmTest, test_callback_ordering_reverse_deadlines) {
+  alarm_t* alarms[50];
+
+  for (int i = 0; i < 50; i++) {
+    const std::string alarm_name =
+        "alarm_test.test_callback_ordering_reverse_deadlines[" +
+        std::to_string(i) + "]";
+    alarms[i] = alarm_new(alarm_name.c_str());
+  }
+
+  for (int i = 49; i >= 0; i--) {
+    alarm_set(alarms[i], 100 + i * 2, ordered_cb, INT_TO_PTR(i));
+  }
+
+  for (int i = 1; i <= 50; i++) {
+    semaphore_wait(semaphore);
+    EXPECT_GE(cb_counter, i);
+  }
+  EXPECT_EQ(cb_counter, 50);
+  EXPECT_EQ(cb_misordered_counter, 0);
+
+  for (int i = 0; i < 50; i++) alarm_free(alarms[i]);
+}
+
+// Test that a one-shot alarm within the coalescing slack fires early, together
+// with the alarm ahead of it
+TEST_F(AlarmTest, test_coalescing_slack) {
+  alarm_t* alarm[2] = {alarm_new("alarm_test.test_coalescing_slack_0"),
+                       alarm_new("alarm_test.test_coalescing_slack_1")};
+
+  alarm_set_coalescing_slack(500);
+  alarm_set(alarm[0], 10, ordered_cb, INT_TO_PTR(0));
+  alarm_set(alarm[1], 400, ordered_cb, INT_TO_PTR(1));
+
+  semaphore_wait(semaphore);
+  msleep(EPSILON_MS);
+  EXPECT_EQ(cb_counter, 2);
+  EXPECT_FALSE(alarm_is_scheduled(alarm[1]));
+
+  semaphore_wait(semaphore);
+  EXPECT_EQ(cb_misordered_counter, 0);
+  alarm_set_coalescing_slack(0);
+
+  alarm_free(alarm[0]);
+  alarm_free(alarm[1]);
+}
+
 // Test whether the callbacks are involed in the expected order on a
 // separate queue.
 TEST_F(AlarmTest, test_callback_ordering_on_queue) {
@@ -22,6 +22,7 @@
 #include "AllocationTestHarness.h"
 
 #include "osi/include/allocator.h"
+#include "osi/include/pool_allocator.h"
 
 class AllocatorTest : public AllocationTestHarness {};
 
@@ -50,3 +51,60 @@ TEST_F(AllocatorTest, test_osi_strndup) {
   EXPECT_EQ(0, strcmp(str, copy_str));
   osi_free(copy_str);
 }
+
+TEST_F(AllocatorTest, test_osi_pool_malloc_free) {
+  pool_allocator_class_stats_t before;
+  pool_allocator_get_class_stats(0, &before);
+
+  // Small buffers come from the first size class
+  uint8_t* buf = static_cast<uint8_t*>(osi_pool_malloc(64));
+  ASSERT_TRUE(buf != NULL);
+  memset(buf, 0xAA, 64);
+
+  pool_allocator_class_stats_t after;
+  pool_allocator_get_class_stats(0, &after);
+  EXPECT_EQ(before.hits + 1, after.hits);
+  EXPECT_EQ(before.in_use + 1, after.in_use);
+  EXPECT_GE(after.high_water, after.in_use);
+
+  osi_free(buf);
+  pool_allocator_get_class_stats(0, &after);
+  EXPECT_EQ(before.in_use, after.in_use);
+
+  // A freed block is reused and zeroed by osi_pool_calloc
+  buf = static_cast<uint8_t*>(osi_pool_calloc(64));
+  ASSERT_TRUE(buf != NULL);
+  for (size_t i = 0; i < 64; i++) EXPECT_EQ(0, buf[i]);
+  osi_free(buf);
+}
+
+TEST_F(AllocatorTest, test_osi_pool_malloc_oversized) {
+  // Sizes larger than every class fall back to the heap
+  void* buf = osi_pool_malloc(64 * 1024);
+  ASSERT_TRUE(buf != NULL);
+  EXPECT_FALSE(pool_allocator_owns(buf));
+  osi_free(buf);
+}
+
+TEST_F(AllocatorTest, test_osi_pool_malloc_exhausted) {
+  size_t last = pool_allocator_class_count() - 1;
+  pool_allocator_class_stats_t stats;
+  pool_allocator_get_class_stats(last, &stats);
+
+  // Allocating past the capacity of a class falls back to the heap and is
+  // recorded as a miss.
+  size_t count = stats.capacity + 1;
+  void** bufs = static_cast<void**>(osi_malloc(count * sizeof(void*)));
+  for (size_t i = 0; i < count; i++) bufs[i] = osi_pool_malloc(4096);
+
+  pool_allocator_class_stats_t after;
+  pool_allocator_get_class_stats(last, &after);
+  EXPECT_LT(stats.misses, after.misses);
+  EXPECT_EQ(stats.capacity, after.high_water);
+
+  for (size_t i = 0; i < count; i++) osi_free(bufs[i]);
+  osi_free(bufs);
+
+  pool_allocator_get_class_stats(last, &after);
+  EXPECT_EQ(stats.in_use, after.in_use);
+}
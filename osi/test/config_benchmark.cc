@@ -0,0 +1,135 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2017 Google, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <benchmark/benchmark.h>
+
+#include <stdio.h>
+
+#include "osi/include/config.h"
+
+#if defined(OS_GENERIC)
+static const char CONFIG_FILE[] = "/tmp/config_benchmark.conf";
+#else   // !defined(OS_GENERIC)
+static const char CONFIG_FILE[] = "/data/local/tmp/config_benchmark.conf";
+#endif  // defined(OS_GENERIC)
+
+// Number of bonded devices, each with its own section.
+static const int BONDED_DEVICES = 1000;
+
+static void device_section(int index, char* section, size_t len) {
+  snprintf(section, len, "00:11:22:%02x:%02x:%02x", (index >> 16) & 0xff,
+           (index >> 8) & 0xff, index & 0xff);
+}
+
+// Builds a config laid out like bt_config.conf: the adapter, then one
+// section per bonded device with the keys btif stores for it.
+static config_t* new_bonded_config(void) {
+  config_t* config = config_new_empty();
+
+  config_set_string(config, "Adapter", "Address", "00:11:22:33:44:55");
+  config_set_string(config, "Adapter", "Name", "Benchmark");
+  config_set_int(config, "Adapter", "ScanMode", 0);
+  config_set_int(config, "Adapter", "DiscoveryTimeout", 120);
+
+  for (int i = 0; i < BONDED_DEVICES; i++) {
+    char section[18];
+    device_section(i, section, sizeof(section));
+    config_set_string(config, section, "Name", "Headset");
+    config_set_int(config, section, "DevClass", 0x240404);
+    config_set_int(config, section, "DevType", 1);
+    config_set_int(config, section, "AddrType", 0);
+    config_set_int(config, section, "Timestamp", 1500000000 + i);
+    config_set_int(config, section, "Manufacturer", 15);
+    config_set_int(config, section, "LmpVer", 8);
+    config_set_int(config, section, "LmpSubVer", 8459);
+    config_set_string(config, section, "Service",
+                      "0000110b-0000-1000-8000-00805f9b34fb "
+                      "0000110e-0000-1000-8000-00805f9b34fb");
+    config_set_int(config, section, "LinkKeyType", 5);
+    config_set_int(config, section, "PinLength", 0);
+    config_set_string(config, section, "LinkKey",
+                      "00112233445566778899aabbccddeeff");
+  }
+  return config;
+}
+
+static void write_bonded_config(void) {
+  config_t* config = new_bonded_config();
+  config_save(config, CONFIG_FILE);
+  config_free(config);
+}
+
+// Loads the whole file, as at Bluetooth start-up.
+static void BM_ConfigLoad(benchmark::State& state) {
+  write_bonded_config();
+
+  while (state.KeepRunning()) {
+    config_t* config = config_new(CONFIG_FILE);
+    config_free(config);
+  }
+}
+
+// Reads a key of the last bonded device.
+static void BM_ConfigGetString(benchmark::State& state) {
+  config_t* config = new_bonded_config();
+  char section[18];
+  device_section(BONDED_DEVICES - 1, section, sizeof(section));
+
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(
+        config_get_string(config, section, "LinkKey", NULL));
+  }
+  config_free(config);
+}
+
+// Updates one device, then writes the whole config out.
+static void BM_ConfigSave(benchmark::State& state) {
+  config_t* config = new_bonded_config();
+  char section[18];
+  int i = 0;
+
+  while (state.KeepRunning()) {
+    device_section(i % BONDED_DEVICES, section, sizeof(section));
+    config_set_int(config, section, "Timestamp", i++);
+    config_save(config, CONFIG_FILE);
+  }
+  config_free(config);
+}
+
+// Updates one device, then saves the change to the journal, compacting it
+// as it fills up.
+static void BM_ConfigSaveJournal(benchmark::State& state) {
+  write_bonded_config();
+  config_t* config = config_new(CONFIG_FILE);
+  char section[18];
+  int i = 0;
+
+  while (state.KeepRunning()) {
+    device_section(i % BONDED_DEVICES, section, sizeof(section));
+    config_set_int(config, section, "Timestamp", i++);
+    config_save_journal(config, CONFIG_FILE, NULL);
+  }
+  config_free(config);
+}
+
+BENCHMARK(BM_ConfigLoad);
+BENCHMARK(BM_ConfigGetString);
+BENCHMARK(BM_ConfigSave);
+BENCHMARK(BM_ConfigSaveJournal);
+
+BENCHMARK_MAIN();
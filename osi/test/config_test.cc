@@ -1,10 +1,17 @@
 #include <gtest/gtest.h>
 
+#include <inttypes.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "AllocationTestHarness.h"
 
 #include "osi/include/config.h"
 
 static const char CONFIG_FILE[] = "/data/local/tmp/config_test.conf";
+static const char CONFIG_JOURNAL_FILE[] =
+    "/data/local/tmp/config_test.conf" CONFIG_JOURNAL_EXT;
 static const char CONFIG_FILE_CONTENT[] =
     "                                                                                    \n\
 first_key=value                                                                      \n\
@@ -53,6 +60,7 @@ class ConfigTest : public AllocationTestHarness {
     FILE* fp = fopen(CONFIG_FILE, "wt");
     fwrite(CONFIG_FILE_CONTENT, 1, sizeof(CONFIG_FILE_CONTENT), fp);
     fclose(fp);
+    unlink(CONFIG_JOURNAL_FILE);
   }
 };
 
@@ -200,3 +208,155 @@ TEST_F(ConfigTest, config_save_basic) {
   EXPECT_TRUE(config_save(config, CONFIG_FILE));
   config_free(config);
 }
+
+static bool journal_exists(void) {
+  return access(CONFIG_JOURNAL_FILE, F_OK) == 0;
+}
+
+TEST_F(ConfigTest, config_save_journal_reload) {
+  config_t* config = config_new(CONFIG_FILE);
+  config_set_string(config, "DID", "productId", "0x1300");
+  config_set_string(config, "New", "key", "value");
+  EXPECT_TRUE(config_save_journal(config, CONFIG_FILE, NULL));
+  EXPECT_TRUE(journal_exists());
+  config_free(config);
+
+  config = config_new(CONFIG_FILE);
+  EXPECT_EQ(config_get_int(config, "DID", "productId", 0), 0x1300);
+  EXPECT_EQ(config_get_int(config, "DID", "version", 0), 0x1436);
+  EXPECT_STREQ(config_get_string(config, "New", "key", NULL), "value");
+
+  // Replayed sections keep their place.
+  const config_section_node_t* section = config_section_begin(config);
+  section = config_section_next(section);
+  EXPECT_STREQ(config_section_name(section), "DID");
+  config_free(config);
+}
+
+TEST_F(ConfigTest, config_save_journal_remove) {
+  config_t* config = config_new(CONFIG_FILE);
+  config_set_string(config, "New", "key", "value");
+  EXPECT_TRUE(config_save_journal(config, CONFIG_FILE, NULL));
+  EXPECT_TRUE(config_remove_key(config, "DID", "productId"));
+  EXPECT_TRUE(config_remove_section(config, "New"));
+  EXPECT_TRUE(config_save_journal(config, CONFIG_FILE, NULL));
+  config_free(config);
+
+  config = config_new(CONFIG_FILE);
+  EXPECT_FALSE(config_has_key(config, "DID", "productId"));
+  EXPECT_TRUE(config_has_key(config, "DID", "version"));
+  EXPECT_FALSE(config_has_section(config, "New"));
+  config_free(config);
+}
+
+TEST_F(ConfigTest, config_save_journal_incomplete) {
+  config_t* config = config_new(CONFIG_FILE);
+  config_set_string(config, "DID", "productId", "0x1300");
+  EXPECT_TRUE(config_save_journal(config, CONFIG_FILE, NULL));
+  config_free(config);
+
+  // A save cut short leaves no commit line behind it.
+  FILE* fp = fopen(CONFIG_JOURNAL_FILE, "at");
+  fputs("[DID]\nproductId = 0x1400\n", fp);
+  fclose(fp);
+
+  config = config_new(CONFIG_FILE);
+  EXPECT_EQ(config_get_int(config, "DID", "productId", 0), 0x1300);
+
+  // The next save rewrites the file rather than appending after it.
+  config_set_string(config, "DID", "version", "0x1500");
+  EXPECT_TRUE(config_save_journal(config, CONFIG_FILE, NULL));
+  EXPECT_FALSE(journal_exists());
+  config_free(config);
+
+  config = config_new(CONFIG_FILE);
+  EXPECT_EQ(config_get_int(config, "DID", "productId", 0), 0x1300);
+  EXPECT_EQ(config_get_int(config, "DID", "version", 0), 0x1500);
+  config_free(config);
+}
+
+static bool filter_out_did(const config_t* config, const char* section) {
+  return strcmp(section, "DID") != 0;
+}
+
+TEST_F(ConfigTest, config_save_journal_filter) {
+  config_t* config = config_new(CONFIG_FILE);
+  config_set_string(config, "DID", "productId", "0x1300");
+  EXPECT_TRUE(config_save_journal(config, CONFIG_FILE, filter_out_did));
+  EXPECT_TRUE(config_has_section(config, "DID"));
+  config_free(config);
+
+  config = config_new(CONFIG_FILE);
+  EXPECT_FALSE(config_has_section(config, "DID"));
+  EXPECT_TRUE(config_has_key(config, CONFIG_DEFAULT_SECTION, "first_key"));
+  config_free(config);
+}
+
+TEST_F(ConfigTest, config_save_removes_journal) {
+  config_t* config = config_new(CONFIG_FILE);
+  config_set_string(config, "DID", "productId", "0x1300");
+  EXPECT_TRUE(config_save_journal(config, CONFIG_FILE, NULL));
+  EXPECT_TRUE(journal_exists());
+  EXPECT_TRUE(config_save(config, CONFIG_FILE));
+  EXPECT_FALSE(journal_exists());
+  config_free(config);
+}
+
+TEST_F(ConfigTest, config_save_writes_generation) {
+  uint64_t generation = 0;
+  config_t* config = config_new(CONFIG_FILE);
+  EXPECT_TRUE(config_save(config, CONFIG_FILE));
+  EXPECT_TRUE(config_save(config, CONFIG_FILE));
+  config_free(config);
+
+  FILE* fp = fopen(CONFIG_FILE, "rt");
+  EXPECT_EQ(fscanf(fp, "#generation %" SCNu64, &generation), 1);
+  EXPECT_EQ(generation, 2u);
+  fclose(fp);
+}
+
+TEST_F(ConfigTest, config_journal_of_other_generation_ignored) {
+  config_t* config = config_new(CONFIG_FILE);
+  config_set_string(config, "DID", "productId", "0x1300");
+  EXPECT_TRUE(config_save_journal(config, CONFIG_FILE, NULL));
+  config_free(config);
+
+  // Keep the journal, as if removing it failed after the file was rewritten.
+  static const char OLD_JOURNAL_FILE[] = "/data/local/tmp/config_test.old";
+  EXPECT_EQ(rename(CONFIG_JOURNAL_FILE, OLD_JOURNAL_FILE), 0);
+  config = config_new(CONFIG_FILE);
+  config_set_string(config, "DID", "productId", "0x1400");
+  EXPECT_TRUE(config_save(config, CONFIG_FILE));
+  config_free(config);
+  EXPECT_EQ(rename(OLD_JOURNAL_FILE, CONFIG_JOURNAL_FILE), 0);
+
+  config = config_new(CONFIG_FILE);
+  EXPECT_EQ(config_get_int(config, "DID", "productId", 0), 0x1400);
+
+  // Nothing is appended to it either: the next save compacts.
+  config_set_string(config, "DID", "version", "0x1500");
+  EXPECT_TRUE(config_save_journal(config, CONFIG_FILE, NULL));
+  EXPECT_FALSE(journal_exists());
+  config_free(config);
+
+  config = config_new(CONFIG_FILE);
+  EXPECT_EQ(config_get_int(config, "DID", "productId", 0), 0x1400);
+  EXPECT_EQ(config_get_int(config, "DID", "version", 0), 0x1500);
+  config_free(config);
+}
+
+TEST_F(ConfigTest, config_save_fails_if_journal_stays) {
+  // A directory in place of the journal can't be unlinked.
+  EXPECT_EQ(mkdir(CONFIG_JOURNAL_FILE, S_IRWXU), 0);
+
+  config_t* config = config_new(CONFIG_FILE);
+  config_set_string(config, "DID", "productId", "0x1300");
+  EXPECT_FALSE(config_save(config, CONFIG_FILE));
+  EXPECT_FALSE(config_save_journal(config, CONFIG_FILE, NULL));
+  config_free(config);
+  EXPECT_EQ(rmdir(CONFIG_JOURNAL_FILE), 0);
+
+  config = config_new(CONFIG_FILE);
+  EXPECT_EQ(config_get_int(config, "DID", "productId", 0), 0x1300);
+  config_free(config);
+}
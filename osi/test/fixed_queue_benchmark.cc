@@ -0,0 +1,74 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2017 Google, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <benchmark/benchmark.h>
+
+#include <thread>
+#include <vector>
+
+#include "osi/include/fixed_queue.h"
+#include "osi/include/osi.h"
+
+// Number of elements moved through the queue per benchmark iteration.
+static const int ITEMS_PER_ITERATION = 100000;
+
+// Matches the depth used for the BTU HCI message queue.
+static const size_t BENCHMARK_QUEUE_SIZE = 1024;
+
+// Args: queue mode, number of producer threads. A single consumer (the
+// benchmark thread) drains the queue with blocking dequeues, the same way
+// the BTU task does.
+static void BM_FixedQueueProducers(benchmark::State& state) {
+  fixed_queue_mode_t mode = static_cast<fixed_queue_mode_t>(state.range(0));
+  int producer_count = state.range(1);
+  int items_per_producer = ITEMS_PER_ITERATION / producer_count;
+
+  fixed_queue_t* queue = fixed_queue_new_with_mode(BENCHMARK_QUEUE_SIZE, mode);
+
+  while (state.KeepRunning()) {
+    std::vector<std::thread> producers;
+    for (int i = 0; i < producer_count; i++) {
+      producers.emplace_back([queue, items_per_producer]() {
+        for (int j = 1; j <= items_per_producer; j++)
+          fixed_queue_enqueue(queue, INT_TO_PTR(j));
+      });
+    }
+
+    for (int i = 0; i < items_per_producer * producer_count; i++)
+      benchmark::DoNotOptimize(fixed_queue_dequeue(queue));
+
+    for (auto& producer : producers) producer.join();
+  }
+
+  state.SetItemsProcessed(state.iterations() * items_per_producer *
+                          producer_count);
+  fixed_queue_free(queue, NULL);
+}
+
+BENCHMARK(BM_FixedQueueProducers)
+    ->ArgNames({"mode", "producers"})
+    ->Args({FIXED_QUEUE_MODE_LOCKED, 1})
+    ->Args({FIXED_QUEUE_MODE_LOCKED, 2})
+    ->Args({FIXED_QUEUE_MODE_LOCKED, 4})
+    ->Args({FIXED_QUEUE_MODE_RING_SPSC, 1})
+    ->Args({FIXED_QUEUE_MODE_RING_MPSC, 1})
+    ->Args({FIXED_QUEUE_MODE_RING_MPSC, 2})
+    ->Args({FIXED_QUEUE_MODE_RING_MPSC, 4})
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -348,3 +348,185 @@ TEST_F(FixedQueueTest, test_fixed_queue_register_dequeue) {
   thread_free(worker_thread);
   fixed_queue_free(queue, NULL);
 }
+
+TEST_F(FixedQueueTest, test_fixed_queue_ring_new_free) {
+  // Ring mode queues need a non-zero, bounded capacity
+  EXPECT_EQ(NULL, fixed_queue_new_with_mode(0, FIXED_QUEUE_MODE_RING_SPSC));
+  EXPECT_EQ(NULL,
+            fixed_queue_new_with_mode((size_t)-1, FIXED_QUEUE_MODE_RING_MPSC));
+
+  fixed_queue_t* queue =
+      fixed_queue_new_with_mode(TEST_QUEUE_SIZE, FIXED_QUEUE_MODE_RING_SPSC);
+  ASSERT_TRUE(queue != NULL);
+  EXPECT_EQ(TEST_QUEUE_SIZE, fixed_queue_capacity(queue));
+  fixed_queue_free(queue, NULL);
+
+  // Remaining entries are passed to the free callback
+  test_queue_entry_free_counter = 0;
+  queue =
+      fixed_queue_new_with_mode(TEST_QUEUE_SIZE, FIXED_QUEUE_MODE_RING_MPSC);
+  ASSERT_TRUE(queue != NULL);
+  fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING1);
+  fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING2);
+  fixed_queue_free(queue, test_queue_entry_free_cb);
+  EXPECT_EQ(2, test_queue_entry_free_counter);
+}
+
+TEST_F(FixedQueueTest, test_fixed_queue_ring_enqueue_dequeue) {
+  fixed_queue_t* queue =
+      fixed_queue_new_with_mode(TEST_QUEUE_SIZE, FIXED_QUEUE_MODE_RING_MPSC);
+  ASSERT_TRUE(queue != NULL);
+
+  // Test peek first/last from an empty queue
+  EXPECT_TRUE(fixed_queue_is_empty(queue));
+  EXPECT_EQ(NULL, fixed_queue_try_peek_first(queue));
+  EXPECT_EQ(NULL, fixed_queue_try_peek_last(queue));
+  EXPECT_EQ(NULL, fixed_queue_try_dequeue(queue));
+
+  fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING1);
+  fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING2);
+  EXPECT_EQ((size_t)2, fixed_queue_length(queue));
+  EXPECT_EQ(DUMMY_DATA_STRING1, fixed_queue_try_peek_first(queue));
+  EXPECT_EQ(DUMMY_DATA_STRING2, fixed_queue_try_peek_last(queue));
+  EXPECT_EQ(DUMMY_DATA_STRING1, fixed_queue_dequeue(queue));
+  EXPECT_EQ(DUMMY_DATA_STRING2, fixed_queue_try_dequeue(queue));
+  EXPECT_TRUE(fixed_queue_is_empty(queue));
+
+  // Wrap around the ring several times and fill it to capacity
+  for (size_t round = 0; round < 3; round++) {
+    for (size_t i = 0; i < TEST_QUEUE_SIZE; i++) {
+      EXPECT_TRUE(fixed_queue_try_enqueue(queue, (void*)DUMMY_DATA_STRING));
+    }
+    EXPECT_FALSE(fixed_queue_try_enqueue(queue, (void*)DUMMY_DATA_STRING));
+    EXPECT_EQ(TEST_QUEUE_SIZE, fixed_queue_length(queue));
+    for (size_t i = 0; i < TEST_QUEUE_SIZE; i++) {
+      EXPECT_EQ(DUMMY_DATA_STRING, fixed_queue_try_dequeue(queue));
+    }
+    EXPECT_EQ(NULL, fixed_queue_try_dequeue(queue));
+  }
+
+  fixed_queue_free(queue, NULL);
+}
+
+TEST_F(FixedQueueTest, test_fixed_queue_ring_dequeue_fd) {
+  fixed_queue_t* queue =
+      fixed_queue_new_with_mode(TEST_QUEUE_SIZE, FIXED_QUEUE_MODE_RING_SPSC);
+  ASSERT_TRUE(queue != NULL);
+
+  int dequeue_fd = fixed_queue_get_dequeue_fd(queue);
+  EXPECT_TRUE(dequeue_fd >= 0);
+  EXPECT_TRUE(dequeue_fd < FD_SETSIZE);
+
+  // The dequeue fd is readable for as long as the queue has elements
+  EXPECT_FALSE(is_fd_readable(dequeue_fd));
+  fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING1);
+  fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING2);
+  EXPECT_TRUE(is_fd_readable(dequeue_fd));
+  fixed_queue_dequeue(queue);
+  EXPECT_TRUE(is_fd_readable(dequeue_fd));
+  fixed_queue_dequeue(queue);
+  EXPECT_FALSE(is_fd_readable(dequeue_fd));
+
+  fixed_queue_free(queue, NULL);
+}
+
+TEST_F(FixedQueueTest, test_fixed_queue_ring_register_dequeue) {
+  fixed_queue_t* queue =
+      fixed_queue_new_with_mode(TEST_QUEUE_SIZE, FIXED_QUEUE_MODE_RING_MPSC);
+  ASSERT_TRUE(queue != NULL);
+
+  received_message_future = future_new();
+  ASSERT_TRUE(received_message_future != NULL);
+
+  thread_t* worker_thread = thread_new("test_fixed_queue_worker_thread");
+  ASSERT_TRUE(worker_thread != NULL);
+
+  fixed_queue_register_dequeue(queue, thread_get_reactor(worker_thread),
+                               fixed_queue_ready, NULL);
+
+  // Add a message to the queue, and expect to receive it
+  fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING);
+  const char* msg = (const char*)future_await(received_message_future);
+  EXPECT_EQ(DUMMY_DATA_STRING, msg);
+
+  fixed_queue_unregister_dequeue(queue);
+  thread_free(worker_thread);
+  fixed_queue_free(queue, NULL);
+}
+
+static const int RING_PRODUCER_COUNT = 4;
+static const int RING_ITEMS_PER_PRODUCER = 10000;
+
+static void ring_producer(void* context) {
+  fixed_queue_t* queue = static_cast<fixed_queue_t*>(context);
+  for (int i = 1; i <= RING_ITEMS_PER_PRODUCER; i++)
+    fixed_queue_enqueue(queue, INT_TO_PTR(i));
+}
+
+TEST_F(FixedQueueTest, test_fixed_queue_ring_multiple_producers) {
+  // A small ring forces producers through the blocking path
+  fixed_queue_t* queue =
+      fixed_queue_new_with_mode(4, FIXED_QUEUE_MODE_RING_MPSC);
+  ASSERT_TRUE(queue != NULL);
+
+  thread_t* producers[RING_PRODUCER_COUNT];
+  for (int i = 0; i < RING_PRODUCER_COUNT; i++) {
+    producers[i] = thread_new("test_fixed_queue_ring_producer");
+    ASSERT_TRUE(producers[i] != NULL);
+    thread_post(producers[i], ring_producer, queue);
+  }
+
+  long sum = 0;
+  for (int i = 0; i < RING_PRODUCER_COUNT * RING_ITEMS_PER_PRODUCER; i++)
+    sum += PTR_TO_INT(fixed_queue_dequeue(queue));
+
+  long expected = (long)RING_PRODUCER_COUNT * RING_ITEMS_PER_PRODUCER *
+                  (RING_ITEMS_PER_PRODUCER + 1) / 2;
+  EXPECT_EQ(expected, sum);
+  EXPECT_TRUE(fixed_queue_is_empty(queue));
+
+  for (int i = 0; i < RING_PRODUCER_COUNT; i++) thread_free(producers[i]);
+  fixed_queue_free(queue, NULL);
+}
+
+TEST_F(FixedQueueTest, test_fixed_queue_dequeue_batch) {
+  const fixed_queue_mode_t modes[] = {FIXED_QUEUE_MODE_LOCKED,
+                                      FIXED_QUEUE_MODE_RING_SPSC,
+                                      FIXED_QUEUE_MODE_RING_MPSC};
+  void* out[TEST_QUEUE_SIZE];
+
+  // Test dequeueing from a NULL queue
+  EXPECT_EQ((size_t)0, fixed_queue_dequeue_batch(NULL, out, TEST_QUEUE_SIZE));
+
+  for (fixed_queue_mode_t mode : modes) {
+    fixed_queue_t* queue = fixed_queue_new_with_mode(TEST_QUEUE_SIZE, mode);
+    ASSERT_TRUE(queue != NULL);
+
+    // Test dequeueing from an empty queue
+    EXPECT_EQ((size_t)0,
+              fixed_queue_dequeue_batch(queue, out, TEST_QUEUE_SIZE));
+
+    fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING1);
+    fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING2);
+    fixed_queue_enqueue(queue, (void*)DUMMY_DATA_STRING3);
+
+    // Test that |max_count| is honoured and order is preserved
+    EXPECT_EQ((size_t)2, fixed_queue_dequeue_batch(queue, out, 2));
+    EXPECT_EQ(DUMMY_DATA_STRING1, out[0]);
+    EXPECT_EQ(DUMMY_DATA_STRING2, out[1]);
+    EXPECT_EQ((size_t)1,
+              fixed_queue_dequeue_batch(queue, out, TEST_QUEUE_SIZE));
+    EXPECT_EQ(DUMMY_DATA_STRING3, out[0]);
+    EXPECT_TRUE(fixed_queue_is_empty(queue));
+
+    // The freed capacity can be used again
+    for (size_t i = 0; i < TEST_QUEUE_SIZE; i++) {
+      EXPECT_TRUE(fixed_queue_try_enqueue(queue, (void*)DUMMY_DATA_STRING));
+    }
+    EXPECT_EQ(TEST_QUEUE_SIZE,
+              fixed_queue_dequeue_batch(queue, out, TEST_QUEUE_SIZE));
+    EXPECT_FALSE(is_fd_readable(fixed_queue_get_dequeue_fd(queue)));
+
+    fixed_queue_free(queue, NULL);
+  }
+}
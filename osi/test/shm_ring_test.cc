@@ -0,0 +1,211 @@
+#include <gtest/gtest.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <thread>
+
+#include "AllocationTestHarness.h"
+
+#include "osi/include/osi.h"
+#include "osi/include/shm_ring.h"
+
+class ShmRingTest : public AllocationTestHarness {
+ protected:
+  virtual void SetUp() {
+    AllocationTestHarness::SetUp();
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+  }
+
+  virtual void TearDown() {
+    if (fds[0] != INVALID_FD) close(fds[0]);
+    if (fds[1] != INVALID_FD) close(fds[1]);
+    AllocationTestHarness::TearDown();
+  }
+
+  int fds[2];
+};
+
+TEST_F(ShmRingTest, test_new_simple) {
+  shm_ring_t* ring = shm_ring_new(4096);
+  ASSERT_TRUE(ring != NULL);
+  EXPECT_EQ((size_t)4096, shm_ring_capacity(ring));
+  EXPECT_EQ((size_t)0, shm_ring_bytes_readable(ring));
+  EXPECT_EQ((size_t)4096, shm_ring_bytes_writable(ring));
+  shm_ring_free(ring);
+}
+
+TEST_F(ShmRingTest, test_free_null) { shm_ring_free(NULL); }
+
+TEST_F(ShmRingTest, test_write_full) {
+  shm_ring_t* ring = shm_ring_new(5);
+  ASSERT_TRUE(ring != NULL);
+
+  uint8_t aa[] = {0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA};
+  EXPECT_EQ((size_t)5, shm_ring_write(ring, aa, sizeof(aa)));
+  EXPECT_EQ((size_t)0, shm_ring_bytes_writable(ring));
+  EXPECT_EQ((size_t)0, shm_ring_write(ring, aa, sizeof(aa)));
+
+  uint8_t peek[8] = {0};
+  EXPECT_EQ((size_t)5, shm_ring_read(ring, peek, sizeof(peek)));
+  EXPECT_EQ(0, memcmp(aa, peek, 5));
+  EXPECT_EQ((size_t)0, shm_ring_read(ring, peek, sizeof(peek)));
+
+  shm_ring_free(ring);
+}
+
+TEST_F(ShmRingTest, test_wrap_around) {
+  shm_ring_t* ring = shm_ring_new(100);
+  ASSERT_TRUE(ring != NULL);
+
+  uint8_t in[37];
+  uint8_t out[37];
+  uint8_t next_in = 0;
+  uint8_t next_out = 0;
+  for (int round = 0; round < 1000; round++) {
+    for (size_t i = 0; i < sizeof(in); i++) in[i] = next_in++;
+    ASSERT_EQ(sizeof(in), shm_ring_write(ring, in, sizeof(in)));
+    ASSERT_EQ(sizeof(out), shm_ring_read(ring, out, sizeof(out)));
+    for (size_t i = 0; i < sizeof(out); i++) ASSERT_EQ(next_out++, out[i]);
+  }
+
+  shm_ring_free(ring);
+}
+
+TEST_F(ShmRingTest, test_flush) {
+  shm_ring_t* ring = shm_ring_new(64);
+  ASSERT_TRUE(ring != NULL);
+
+  uint8_t buffer[10] = {0};
+  shm_ring_write(ring, buffer, sizeof(buffer));
+  EXPECT_EQ((size_t)10, shm_ring_flush(ring));
+  EXPECT_EQ((size_t)0, shm_ring_bytes_readable(ring));
+  EXPECT_EQ((size_t)64, shm_ring_bytes_writable(ring));
+
+  shm_ring_free(ring);
+}
+
+TEST_F(ShmRingTest, test_wait_timeout) {
+  shm_ring_t* ring = shm_ring_new(16);
+  ASSERT_TRUE(ring != NULL);
+
+  EXPECT_EQ(SHM_RING_TIMEOUT, shm_ring_wait_readable(ring, 10, INVALID_FD));
+  EXPECT_EQ(SHM_RING_READY, shm_ring_wait_writable(ring, 10, INVALID_FD));
+
+  uint8_t buffer[16] = {0};
+  shm_ring_write(ring, buffer, sizeof(buffer));
+  EXPECT_EQ(SHM_RING_READY, shm_ring_wait_readable(ring, 10, INVALID_FD));
+  EXPECT_EQ(SHM_RING_TIMEOUT, shm_ring_wait_writable(ring, 10, INVALID_FD));
+
+  shm_ring_free(ring);
+}
+
+TEST_F(ShmRingTest, test_wait_hangup) {
+  shm_ring_t* ring = shm_ring_new(16);
+  ASSERT_TRUE(ring != NULL);
+
+  close(fds[1]);
+  fds[1] = INVALID_FD;
+  EXPECT_EQ(SHM_RING_HANGUP, shm_ring_wait_readable(ring, 1000, fds[0]));
+
+  shm_ring_free(ring);
+}
+
+TEST_F(ShmRingTest, test_send_receive) {
+  shm_ring_t* ring = shm_ring_new(512);
+  ASSERT_TRUE(ring != NULL);
+  ASSERT_TRUE(shm_ring_send(fds[0], ring));
+
+  shm_ring_t* peer = shm_ring_receive(fds[1], 1000);
+  ASSERT_TRUE(peer != NULL);
+  EXPECT_EQ((size_t)512, shm_ring_capacity(peer));
+
+  EXPECT_EQ(SHM_RING_ACK_PENDING, shm_ring_receive_ack(fds[0]));
+  ASSERT_TRUE(shm_ring_send_ack(fds[1], true));
+  EXPECT_EQ(SHM_RING_ACK_ACCEPTED, shm_ring_receive_ack(fds[0]));
+  EXPECT_EQ(SHM_RING_ACK_PENDING, shm_ring_receive_ack(fds[0]));
+
+  uint8_t in[] = {1, 2, 3, 4, 5};
+  uint8_t out[5] = {0};
+  EXPECT_EQ(sizeof(in), shm_ring_write(peer, in, sizeof(in)));
+  EXPECT_EQ(sizeof(in), shm_ring_bytes_readable(ring));
+  EXPECT_EQ(sizeof(out), shm_ring_read(ring, out, sizeof(out)));
+  EXPECT_EQ(0, memcmp(in, out, sizeof(in)));
+  EXPECT_EQ((size_t)512, shm_ring_bytes_writable(peer));
+
+  shm_ring_free(peer);
+  shm_ring_free(ring);
+}
+
+TEST_F(ShmRingTest, test_receive_ack_leaves_other_data) {
+  uint8_t pcm[] = {0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70, 0x80};
+  ASSERT_EQ((ssize_t)sizeof(pcm), send(fds[1], pcm, sizeof(pcm), 0));
+
+  EXPECT_EQ(SHM_RING_ACK_NONE, shm_ring_receive_ack(fds[0]));
+
+  uint8_t out[sizeof(pcm)] = {0};
+  ASSERT_EQ((ssize_t)sizeof(pcm), recv(fds[0], out, sizeof(out), 0));
+  EXPECT_EQ(0, memcmp(pcm, out, sizeof(pcm)));
+}
+
+TEST_F(ShmRingTest, test_receive_declined) {
+  ASSERT_TRUE(shm_ring_send_ack(fds[1], false));
+  EXPECT_EQ(SHM_RING_ACK_DECLINED, shm_ring_receive_ack(fds[0]));
+}
+
+TEST_F(ShmRingTest, test_receive_garbage) {
+  uint8_t garbage[64] = {0};
+  ASSERT_EQ((ssize_t)sizeof(garbage), send(fds[0], garbage, sizeof(garbage), 0));
+  EXPECT_TRUE(shm_ring_receive(fds[1], 100) == NULL);
+  EXPECT_TRUE(shm_ring_receive(fds[1], 10) == NULL);
+}
+
+TEST_F(ShmRingTest, test_threaded_transfer) {
+  static const size_t kTotalBytes = 1 << 20;
+
+  shm_ring_t* reader = shm_ring_new(1000);
+  ASSERT_TRUE(reader != NULL);
+  ASSERT_TRUE(shm_ring_send(fds[0], reader));
+  shm_ring_t* writer = shm_ring_receive(fds[1], 1000);
+  ASSERT_TRUE(writer != NULL);
+
+  std::thread producer([writer]() {
+    uint8_t chunk[333];
+    uint8_t next = 0;
+    size_t sent = 0;
+    while (sent < kTotalBytes) {
+      size_t length = std::min(sizeof(chunk), kTotalBytes - sent);
+      for (size_t i = 0; i < length; i++) chunk[i] = next++;
+      size_t offset = 0;
+      while (offset < length) {
+        offset += shm_ring_write(writer, chunk + offset, length - offset);
+        if (offset < length &&
+            shm_ring_wait_writable(writer, 1000, INVALID_FD) !=
+                SHM_RING_READY)
+          return;
+      }
+      sent += length;
+    }
+  });
+
+  uint8_t chunk[256];
+  uint8_t next = 0;
+  size_t received = 0;
+  bool in_order = true;
+  while (received < kTotalBytes) {
+    size_t length = shm_ring_read(reader, chunk, sizeof(chunk));
+    if (length == 0) {
+      if (shm_ring_wait_readable(reader, 1000, INVALID_FD) != SHM_RING_READY)
+        break;
+      continue;
+    }
+    for (size_t i = 0; i < length; i++) in_order &= (chunk[i] == next++);
+    received += length;
+  }
+  producer.join();
+
+  EXPECT_EQ(kTotalBytes, received);
+  EXPECT_TRUE(in_order);
+
+  shm_ring_free(writer);
+  shm_ring_free(reader);
+}
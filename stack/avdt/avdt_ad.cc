@@ -424,12 +424,18 @@ void avdt_ad_tc_data_ind(tAVDT_TC_TBL* p_tbl, BT_HDR* p_buf) {
   else {
     p_scb =
         avdt_scb_by_hdl(avdt_cb.ad.rt_tbl[p_tbl->ccb_idx][p_tbl->tcid].scb_hdl);
-    if (p_scb != NULL) {
-      avdt_scb_event(p_scb, AVDT_SCB_TC_DATA_EVT, (tAVDT_SCB_EVT*)&p_buf);
-    } else {
+    if (p_scb == NULL) {
       osi_free(p_buf);
       AVDT_TRACE_ERROR(" avdt_ad_tc_data_ind buffer freed");
     }
+    /* while streaming, go straight to the packet handler the state table
+    ** would run; any other state goes through the state machine */
+    else if (p_scb->state == AVDT_SCB_STREAM_ST) {
+      p_scb->curr_evt = AVDT_SCB_TC_DATA_EVT;
+      avdt_scb_hdl_pkt(p_scb, (tAVDT_SCB_EVT*)&p_buf);
+    } else {
+      avdt_scb_event(p_scb, AVDT_SCB_TC_DATA_EVT, (tAVDT_SCB_EVT*)&p_buf);
+    }
   }
 }
 
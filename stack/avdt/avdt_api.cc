@@ -833,7 +833,15 @@ uint16_t AVDT_WriteReqOpt(uint8_t handle, BT_HDR* p_pkt, uint32_t time_stamp,
     evt.apiwrite.time_stamp = time_stamp;
     evt.apiwrite.m_pt = m_pt;
     evt.apiwrite.opt = opt;
-    avdt_scb_event(p_scb, AVDT_SCB_API_WRITE_REQ_EVT, &evt);
+
+    /* while streaming, run the state table's write actions directly */
+    if (p_scb->state == AVDT_SCB_STREAM_ST) {
+      p_scb->curr_evt = AVDT_SCB_API_WRITE_REQ_EVT;
+      avdt_scb_hdl_write_req(p_scb, &evt);
+      avdt_scb_chk_snd_pkt(p_scb, &evt);
+    } else {
+      avdt_scb_event(p_scb, AVDT_SCB_API_WRITE_REQ_EVT, &evt);
+    }
   }
 
   return result;
@@ -1042,7 +1050,8 @@ uint16_t AVDT_SendReport(uint8_t handle, AVDT_REPORT_TYPE type,
     /* build SR - assume fit in one packet */
     p_tbl = avdt_ad_tc_tbl_by_type(AVDT_CHAN_REPORT, p_scb->p_ccb, p_scb);
     if (p_tbl->state == AVDT_AD_ST_OPEN) {
-      BT_HDR* p_pkt = (BT_HDR*)osi_malloc(p_tbl->peer_mtu + sizeof(BT_HDR));
+      BT_HDR* p_pkt =
+          (BT_HDR*)osi_pool_malloc(p_tbl->peer_mtu + sizeof(BT_HDR));
 
       p_pkt->offset = L2CAP_MIN_OFFSET;
       p = (uint8_t*)(p_pkt + 1) + p_pkt->offset;
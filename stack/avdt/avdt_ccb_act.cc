@@ -757,7 +757,7 @@ void avdt_ccb_ret_cmd(tAVDT_CCB* p_ccb, tAVDT_CCB_EVT* p_data) {
     if ((!p_ccb->cong) && (p_ccb->p_curr_msg == NULL) &&
         (p_ccb->p_curr_cmd != NULL)) {
       /* make copy of message in p_curr_cmd and send it */
-      BT_HDR* p_msg = (BT_HDR*)osi_malloc(AVDT_CMD_BUF_SIZE);
+      BT_HDR* p_msg = (BT_HDR*)osi_pool_malloc(AVDT_CMD_BUF_SIZE);
       memcpy(p_msg, p_ccb->p_curr_cmd,
              (sizeof(BT_HDR) + p_ccb->p_curr_cmd->offset +
               p_ccb->p_curr_cmd->len));
@@ -796,7 +796,7 @@ void avdt_ccb_snd_cmd(tAVDT_CCB* p_ccb, UNUSED_ATTR tAVDT_CCB_EVT* p_data) {
     p_msg = (BT_HDR*)fixed_queue_try_dequeue(p_ccb->cmd_q);
     if (p_msg != NULL) {
       /* make a copy of buffer in p_curr_cmd */
-      p_ccb->p_curr_cmd = (BT_HDR*)osi_malloc(AVDT_CMD_BUF_SIZE);
+      p_ccb->p_curr_cmd = (BT_HDR*)osi_pool_malloc(AVDT_CMD_BUF_SIZE);
       memcpy(p_ccb->p_curr_cmd, p_msg,
              (sizeof(BT_HDR) + p_msg->offset + p_msg->len));
       avdt_msg_send(p_ccb, p_msg);
@@ -469,13 +469,14 @@ typedef struct {
   BT_HDR* p_pkt;                    /* packet waiting to be sent */
   tAVDT_CCB* p_ccb;                 /* ccb associated with this scb */
   uint16_t media_seq;               /* media packet sequence number */
+  bool use_rtp_header;              /* whether media packets get RTP header */
   bool allocated;                   /* whether scb is allocated or unused */
   bool in_use;                      /* whether stream being used by peer */
   uint8_t role;       /* initiator/acceptor role in current procedure */
   bool remove;        /* whether CB is marked for removal */
   uint8_t state;      /* state machine state */
   uint8_t peer_seid;  /* SEID of peer stream */
-  uint8_t curr_evt;   /* current event; set only by state machine */
+  uint8_t curr_evt;   /* current event; set only by event dispatch */
   bool cong;          /* Whether media transport channel is congested */
   uint8_t close_code; /* Error code received in close response */
 } tAVDT_SCB;
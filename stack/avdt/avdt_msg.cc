@@ -1074,7 +1074,7 @@ bool avdt_msg_send(tAVDT_CCB* p_ccb, BT_HDR* p_msg) {
              2;
 
       /* get a new buffer for fragment we are sending */
-      p_buf = (BT_HDR*)osi_malloc(AVDT_CMD_BUF_SIZE);
+      p_buf = (BT_HDR*)osi_pool_malloc(AVDT_CMD_BUF_SIZE);
 
       /* copy portion of data from current message to new buffer */
       p_buf->offset = L2CAP_MIN_OFFSET + hdr_len;
@@ -1091,7 +1091,7 @@ bool avdt_msg_send(tAVDT_CCB* p_ccb, BT_HDR* p_msg) {
       hdr_len = AVDT_LEN_TYPE_CONT;
 
       /* get a new buffer for fragment we are sending */
-      p_buf = (BT_HDR*)osi_malloc(AVDT_CMD_BUF_SIZE);
+      p_buf = (BT_HDR*)osi_pool_malloc(AVDT_CMD_BUF_SIZE);
 
       /* copy portion of data from current message to new buffer */
       p_buf->offset = L2CAP_MIN_OFFSET + hdr_len;
@@ -1215,7 +1215,7 @@ BT_HDR* avdt_msg_asmbl(tAVDT_CCB* p_ccb, BT_HDR* p_buf) {
      * not aware of possible packet size after reassembly, they
      * would have allocated smaller buffer.
      */
-    p_ccb->p_rx_msg = (BT_HDR*)osi_malloc(BT_DEFAULT_BUFFER_SIZE);
+    p_ccb->p_rx_msg = (BT_HDR*)osi_pool_malloc(BT_DEFAULT_BUFFER_SIZE);
     memcpy(p_ccb->p_rx_msg, p_buf, sizeof(BT_HDR) + p_buf->offset + p_buf->len);
 
     /* Free original buffer */
@@ -1302,7 +1302,7 @@ void avdt_msg_send_cmd(tAVDT_CCB* p_ccb, void* p_scb, uint8_t sig_id,
                        tAVDT_MSG* p_params) {
   uint8_t* p;
   uint8_t* p_start;
-  BT_HDR* p_buf = (BT_HDR*)osi_malloc(AVDT_CMD_BUF_SIZE);
+  BT_HDR* p_buf = (BT_HDR*)osi_pool_malloc(AVDT_CMD_BUF_SIZE);
 
   /* set up buf pointer and offset */
   p_buf->offset = AVDT_MSG_OFFSET;
@@ -1358,7 +1358,7 @@ void avdt_msg_send_cmd(tAVDT_CCB* p_ccb, void* p_scb, uint8_t sig_id,
 void avdt_msg_send_rsp(tAVDT_CCB* p_ccb, uint8_t sig_id, tAVDT_MSG* p_params) {
   uint8_t* p;
   uint8_t* p_start;
-  BT_HDR* p_buf = (BT_HDR*)osi_malloc(AVDT_CMD_BUF_SIZE);
+  BT_HDR* p_buf = (BT_HDR*)osi_pool_malloc(AVDT_CMD_BUF_SIZE);
 
   /* set up buf pointer and offset */
   p_buf->offset = AVDT_MSG_OFFSET;
@@ -1398,7 +1398,7 @@ void avdt_msg_send_rsp(tAVDT_CCB* p_ccb, uint8_t sig_id, tAVDT_MSG* p_params) {
 void avdt_msg_send_rej(tAVDT_CCB* p_ccb, uint8_t sig_id, tAVDT_MSG* p_params) {
   uint8_t* p;
   uint8_t* p_start;
-  BT_HDR* p_buf = (BT_HDR*)osi_malloc(AVDT_CMD_BUF_SIZE);
+  BT_HDR* p_buf = (BT_HDR*)osi_pool_malloc(AVDT_CMD_BUF_SIZE);
 
   /* set up buf pointer and offset */
   p_buf->offset = AVDT_MSG_OFFSET;
@@ -1449,7 +1449,7 @@ void avdt_msg_send_rej(tAVDT_CCB* p_ccb, uint8_t sig_id, tAVDT_MSG* p_params) {
 void avdt_msg_send_grej(tAVDT_CCB* p_ccb, uint8_t sig_id, tAVDT_MSG* p_params) {
   uint8_t* p;
   uint8_t* p_start;
-  BT_HDR* p_buf = (BT_HDR*)osi_malloc(AVDT_CMD_BUF_SIZE);
+  BT_HDR* p_buf = (BT_HDR*)osi_pool_malloc(AVDT_CMD_BUF_SIZE);
 
   /* set up buf pointer and offset */
   p_buf->offset = AVDT_MSG_OFFSET;
@@ -70,6 +70,24 @@ uint32_t avdt_scb_gen_ssrc(tAVDT_SCB* p_scb) {
       (uint32_t)(p_scb->cs.cfg.codec_info[1] | p_scb->cs.cfg.codec_info[2]));
 }
 
+/*******************************************************************************
+ *
+ * Function         avdt_scb_set_rtp_header
+ *
+ * Description      This function decides whether media packets written on
+ *                  the stream get an RTP header.  The configuration can't
+ *                  change while streaming, so this is done once when the
+ *                  stream starts rather than for every packet.
+ *
+ * Returns          Nothing.
+ *
+ ******************************************************************************/
+static void avdt_scb_set_rtp_header(tAVDT_SCB* p_scb) {
+  bool is_content_protection = (p_scb->curr_cfg.num_protect > 0);
+  p_scb->use_rtp_header =
+      A2DP_UsesRtpHeader(is_content_protection, p_scb->curr_cfg.codec_info);
+}
+
 /*******************************************************************************
  *
  * Function         avdt_scb_hdl_abort_cmd
@@ -236,6 +254,13 @@ void avdt_scb_hdl_pkt_no_frag(tAVDT_SCB* p_scb, tAVDT_SCB_EVT* p_data) {
 
   p = p_start = (uint8_t*)(p_data->p_pkt + 1) + p_data->p_pkt->offset;
 
+  /* the fixed header must be there before any of it is parsed */
+  if (p_data->p_pkt->len < AVDT_MEDIA_HDR_SIZE) {
+    AVDT_TRACE_WARNING("Got bad media packet");
+    osi_free_and_reset((void**)&p_data->p_pkt);
+    return;
+  }
+
   /* parse media packet header */
   AVDT_MSG_PRS_OCTET1(p, o_v, o_p, o_x, o_cc);
   AVDT_MSG_PRS_M_PT(p, m_pt, marker);
@@ -259,7 +284,7 @@ void avdt_scb_hdl_pkt_no_frag(tAVDT_SCB* p_scb, tAVDT_SCB_EVT* p_data) {
   /* adjust length for any padding at end of packet */
   if (o_p) {
     /* padding length in last byte of packet */
-    pad_len = *(p_start + p_data->p_pkt->len);
+    pad_len = *(p_start + p_data->p_pkt->len - 1);
   }
 
   /* do sanity check */
@@ -590,6 +615,7 @@ void avdt_scb_hdl_setconfig_rsp(tAVDT_SCB* p_scb,
  ******************************************************************************/
 void avdt_scb_hdl_start_cmd(tAVDT_SCB* p_scb,
                             UNUSED_ATTR tAVDT_SCB_EVT* p_data) {
+  avdt_scb_set_rtp_header(p_scb);
   (*p_scb->cs.p_ctrl_cback)(avdt_scb_to_hdl(p_scb),
                             p_scb->p_ccb ? p_scb->p_ccb->peer_addr : NULL,
                             AVDT_START_IND_EVT, NULL);
@@ -606,6 +632,7 @@ void avdt_scb_hdl_start_cmd(tAVDT_SCB* p_scb,
  *
  ******************************************************************************/
 void avdt_scb_hdl_start_rsp(tAVDT_SCB* p_scb, tAVDT_SCB_EVT* p_data) {
+  avdt_scb_set_rtp_header(p_scb);
   (*p_scb->cs.p_ctrl_cback)(avdt_scb_to_hdl(p_scb),
                             p_scb->p_ccb ? p_scb->p_ccb->peer_addr : NULL,
                             AVDT_START_CFM_EVT, (tAVDT_CTRL*)&p_data->msg.hdr);
@@ -876,12 +903,8 @@ void avdt_scb_hdl_write_req(tAVDT_SCB* p_scb, tAVDT_SCB_EVT* p_data) {
   }
   osi_free_and_reset((void**)&p_scb->p_pkt);
 
-  /* Recompute only if the RTP header wasn't disabled by the API */
-  if (add_rtp_header) {
-    bool is_content_protection = (p_scb->curr_cfg.num_protect > 0);
-    add_rtp_header =
-        A2DP_UsesRtpHeader(is_content_protection, p_scb->curr_cfg.codec_info);
-  }
+  /* Use the codec's choice unless the RTP header was disabled by the API */
+  if (add_rtp_header) add_rtp_header = p_scb->use_rtp_header;
 
   /* Build a media packet, and add an RTP header if required. */
   if (add_rtp_header) {
@@ -101,6 +101,15 @@
 
 #define BNEP_MAX_RETRANSMITS 3
 
+/* A range of protocols or multicast addresses let through by the peer's
+ * filters. Addresses are kept as 48-bit big-endian numbers so that ranges
+ * compare as integers.
+*/
+typedef struct {
+  uint64_t start;
+  uint64_t end;
+} tBNEP_FILTER_RANGE;
+
 /* Define the BNEP Connection Control Block
 */
 typedef struct {
@@ -138,13 +147,15 @@ typedef struct {
   BD_ADDR sent_mcast_filter_start[BNEP_MAX_MULTI_FILTERS];
   BD_ADDR sent_mcast_filter_end[BNEP_MAX_MULTI_FILTERS];
 
+  /* Filters set by the peer, as sent, and compiled into sorted disjoint
+   * ranges that are binary searched for every packet */
   uint16_t rcvd_num_filters;
-  uint16_t rcvd_prot_filter_start[BNEP_MAX_PROT_FILTERS];
-  uint16_t rcvd_prot_filter_end[BNEP_MAX_PROT_FILTERS];
+  uint16_t rcvd_prot_ranges;
+  tBNEP_FILTER_RANGE rcvd_prot_filter[BNEP_MAX_PROT_FILTERS];
 
   uint16_t rcvd_mcast_filters;
-  BD_ADDR rcvd_mcast_filter_start[BNEP_MAX_MULTI_FILTERS];
-  BD_ADDR rcvd_mcast_filter_end[BNEP_MAX_MULTI_FILTERS];
+  uint16_t rcvd_mcast_ranges;
+  tBNEP_FILTER_RANGE rcvd_mcast_filter[BNEP_MAX_MULTI_FILTERS];
 
   uint16_t bad_pkts_rcvd;
   uint8_t re_transmits;
@@ -212,6 +223,9 @@ extern void bnep_send_command_not_understood(tBNEP_CONN* p_bcb,
 extern void bnepu_process_peer_filter_set(tBNEP_CONN* p_bcb, uint8_t* p_filters,
                                           uint16_t len);
 extern void bnepu_process_peer_filter_rsp(tBNEP_CONN* p_bcb, uint8_t* p_data);
+extern void bnepu_process_peer_multicast_filter_set(tBNEP_CONN* p_bcb,
+                                                    uint8_t* p_filters,
+                                                    uint16_t len);
 extern void bnepu_process_multicast_filter_rsp(tBNEP_CONN* p_bcb,
                                                uint8_t* p_data);
 extern void bnep_send_conn_req(tBNEP_CONN* p_bcb);
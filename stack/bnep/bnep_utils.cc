@@ -40,6 +40,11 @@ extern fixed_queue_t* btu_general_alarm_queue;
 /******************************************************************************/
 static uint8_t* bnepu_init_hdr(BT_HDR* p_buf, uint16_t hdr_len,
                                uint8_t pkt_type);
+static uint16_t bnepu_compile_filter_ranges(tBNEP_FILTER_RANGE* p_ranges,
+                                            uint16_t num_ranges);
+static bool bnepu_is_in_filter_ranges(const tBNEP_FILTER_RANGE* p_ranges,
+                                      uint16_t num_ranges, uint64_t value);
+static uint64_t bnepu_bd_addr_to_uint64(const uint8_t* p_addr);
 
 void bnepu_process_peer_multicast_filter_set(tBNEP_CONN* p_bcb,
                                              uint8_t* p_filters, uint16_t len);
@@ -913,9 +918,11 @@ void bnepu_process_peer_filter_set(tBNEP_CONN* p_bcb, uint8_t* p_filters,
     BE_STREAM_TO_UINT16(start, p_filters);
     BE_STREAM_TO_UINT16(end, p_filters);
 
-    p_bcb->rcvd_prot_filter_start[xx] = start;
-    p_bcb->rcvd_prot_filter_end[xx] = end;
+    p_bcb->rcvd_prot_filter[xx].start = start;
+    p_bcb->rcvd_prot_filter[xx].end = end;
   }
+  p_bcb->rcvd_prot_ranges =
+      bnepu_compile_filter_ranges(p_bcb->rcvd_prot_filter, num_filters);
 
   bnepu_send_peer_filter_rsp(p_bcb, resp_code);
 }
@@ -1021,7 +1028,7 @@ void bnepu_process_peer_multicast_filter_set(tBNEP_CONN* p_bcb,
                                              uint8_t* p_filters, uint16_t len) {
   uint16_t resp_code = BNEP_FILTER_CRL_OK;
   uint16_t num_filters, xx;
-  uint8_t *p_temp_filters, null_bda[BD_ADDR_LEN] = {0, 0, 0, 0, 0, 0};
+  uint8_t* p_temp_filters;
 
   if ((p_bcb->con_state != BNEP_STATE_CONNECTED) &&
       (!(p_bcb->con_flags & BNEP_FLAGS_CONN_COMPLETED))) {
@@ -1062,21 +1069,23 @@ void bnepu_process_peer_multicast_filter_set(tBNEP_CONN* p_bcb,
 
   p_bcb->rcvd_mcast_filters = num_filters;
   for (xx = 0; xx < num_filters; xx++) {
-    memcpy(p_bcb->rcvd_mcast_filter_start[xx], p_filters, BD_ADDR_LEN);
-    memcpy(p_bcb->rcvd_mcast_filter_end[xx], p_filters + BD_ADDR_LEN,
-           BD_ADDR_LEN);
+    p_bcb->rcvd_mcast_filter[xx].start = bnepu_bd_addr_to_uint64(p_filters);
+    p_bcb->rcvd_mcast_filter[xx].end =
+        bnepu_bd_addr_to_uint64(p_filters + BD_ADDR_LEN);
     p_filters += (BD_ADDR_LEN * 2);
 
     /* Check if any of the ranges have all zeros as both starting and ending
      * addresses */
-    if ((memcmp(null_bda, p_bcb->rcvd_mcast_filter_start[xx], BD_ADDR_LEN) ==
-         0) &&
-        (memcmp(null_bda, p_bcb->rcvd_mcast_filter_end[xx], BD_ADDR_LEN) ==
-         0)) {
+    if (p_bcb->rcvd_mcast_filter[xx].start == 0 &&
+        p_bcb->rcvd_mcast_filter[xx].end == 0) {
       p_bcb->rcvd_mcast_filters = 0xFFFF;
       break;
     }
   }
+  p_bcb->rcvd_mcast_ranges = 0;
+  if (p_bcb->rcvd_mcast_filters != 0xFFFF)
+    p_bcb->rcvd_mcast_ranges =
+        bnepu_compile_filter_ranges(p_bcb->rcvd_mcast_filter, num_filters);
 
   BNEP_TRACE_EVENT("BNEP multicast filters %d", p_bcb->rcvd_mcast_filters);
   bnepu_send_peer_multicast_filter_rsp(p_bcb, resp_code);
@@ -1235,7 +1244,7 @@ tBNEP_RESULT bnep_is_packet_allowed(tBNEP_CONN* p_bcb, BD_ADDR p_dest_addr,
                                     uint16_t protocol, bool fw_ext_present,
                                     uint8_t* p_data) {
   if (p_bcb->rcvd_num_filters) {
-    uint16_t i, proto;
+    uint16_t proto;
 
     /* Findout the actual protocol to check for the filtering */
     proto = protocol;
@@ -1254,13 +1263,8 @@ tBNEP_RESULT bnep_is_packet_allowed(tBNEP_CONN* p_bcb, BD_ADDR p_dest_addr,
       BE_STREAM_TO_UINT16(proto, p_data);
     }
 
-    for (i = 0; i < p_bcb->rcvd_num_filters; i++) {
-      if ((p_bcb->rcvd_prot_filter_start[i] <= proto) &&
-          (proto <= p_bcb->rcvd_prot_filter_end[i]))
-        break;
-    }
-
-    if (i == p_bcb->rcvd_num_filters) {
+    if (!bnepu_is_in_filter_ranges(p_bcb->rcvd_prot_filter,
+                                   p_bcb->rcvd_prot_ranges, proto)) {
       BNEP_TRACE_DEBUG("Ignoring protocol 0x%x in BNEP data write", proto);
       return BNEP_IGNORE_CMD;
     }
@@ -1268,27 +1272,14 @@ tBNEP_RESULT bnep_is_packet_allowed(tBNEP_CONN* p_bcb, BD_ADDR p_dest_addr,
 
   /* Ckeck for multicast address filtering */
   if ((p_dest_addr[0] & 0x01) && p_bcb->rcvd_mcast_filters) {
-    uint16_t i;
-
-    /* Check if every multicast should be filtered */
-    if (p_bcb->rcvd_mcast_filters != 0xFFFF) {
-      /* Check if the address is mentioned in the filter range */
-      for (i = 0; i < p_bcb->rcvd_mcast_filters; i++) {
-        if ((memcmp(p_bcb->rcvd_mcast_filter_start[i], p_dest_addr,
-                    BD_ADDR_LEN) <= 0) &&
-            (memcmp(p_bcb->rcvd_mcast_filter_end[i], p_dest_addr,
-                    BD_ADDR_LEN) >= 0))
-          break;
-      }
-    }
-
     /*
     ** If every multicast should be filtered or the address is not in the filter
-    *range
-    ** drop the packet
+    ** range drop the packet
     */
     if ((p_bcb->rcvd_mcast_filters == 0xFFFF) ||
-        (i == p_bcb->rcvd_mcast_filters)) {
+        !bnepu_is_in_filter_ranges(p_bcb->rcvd_mcast_filter,
+                                   p_bcb->rcvd_mcast_ranges,
+                                   bnepu_bd_addr_to_uint64(p_dest_addr))) {
       BNEP_TRACE_DEBUG(
           "Ignoring multicast address %x.%x.%x.%x.%x.%x in BNEP data write",
           p_dest_addr[0], p_dest_addr[1], p_dest_addr[2], p_dest_addr[3],
@@ -1300,6 +1291,87 @@ tBNEP_RESULT bnep_is_packet_allowed(tBNEP_CONN* p_bcb, BD_ADDR p_dest_addr,
   return BNEP_SUCCESS;
 }
 
+/*******************************************************************************
+ *
+ * Function         bnepu_compile_filter_ranges
+ *
+ * Description      This function sorts filter ranges by their start and
+ *                  merges the ones that overlap or touch, so that a value
+ *                  can be looked up with a binary search
+ *
+ * Returns          uint16_t - number of ranges left
+ *
+ ******************************************************************************/
+static uint16_t bnepu_compile_filter_ranges(tBNEP_FILTER_RANGE* p_ranges,
+                                            uint16_t num_ranges) {
+  uint16_t xx, yy;
+
+  if (num_ranges == 0) return 0;
+
+  /* Insertion sort, there are at most a handful of ranges */
+  for (xx = 1; xx < num_ranges; xx++) {
+    tBNEP_FILTER_RANGE range = p_ranges[xx];
+    for (yy = xx; yy > 0 && p_ranges[yy - 1].start > range.start; yy--)
+      p_ranges[yy] = p_ranges[yy - 1];
+    p_ranges[yy] = range;
+  }
+
+  for (xx = 0, yy = 1; yy < num_ranges; yy++) {
+    if (p_ranges[yy].start <= p_ranges[xx].end + 1) {
+      if (p_ranges[yy].end > p_ranges[xx].end)
+        p_ranges[xx].end = p_ranges[yy].end;
+    } else {
+      p_ranges[++xx] = p_ranges[yy];
+    }
+  }
+
+  return xx + 1;
+}
+
+/*******************************************************************************
+ *
+ * Function         bnepu_is_in_filter_ranges
+ *
+ * Description      This function checks whether a value falls in one of the
+ *                  ranges compiled by bnepu_compile_filter_ranges
+ *
+ * Returns          true if the value is in a range
+ *
+ ******************************************************************************/
+static bool bnepu_is_in_filter_ranges(const tBNEP_FILTER_RANGE* p_ranges,
+                                      uint16_t num_ranges, uint64_t value) {
+  uint16_t low = 0, high = num_ranges;
+
+  /* Find the first range ending at or after the value */
+  while (low < high) {
+    uint16_t mid = low + (high - low) / 2;
+    if (p_ranges[mid].end < value)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  return low < num_ranges && p_ranges[low].start <= value;
+}
+
+/*******************************************************************************
+ *
+ * Function         bnepu_bd_addr_to_uint64
+ *
+ * Description      This function returns an address as a 48-bit big-endian
+ *                  number, which orders addresses the way memcmp does
+ *
+ * Returns          uint64_t
+ *
+ ******************************************************************************/
+static uint64_t bnepu_bd_addr_to_uint64(const uint8_t* p_addr) {
+  uint64_t value = 0;
+
+  for (int xx = 0; xx < BD_ADDR_LEN; xx++) value = (value << 8) | p_addr[xx];
+
+  return value;
+}
+
 /*******************************************************************************
  *
  * Function         bnep_get_uuid32
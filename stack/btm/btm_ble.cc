@@ -78,6 +78,7 @@ bool BTM_SecAddBleDevice(const BD_ADDR bd_addr, BD_NAME bd_name,
     memcpy(p_dev_rec->bd_addr, bd_addr, BD_ADDR_LEN);
     p_dev_rec->hci_handle = BTM_GetHCIConnHandle(bd_addr, BT_TRANSPORT_BR_EDR);
     p_dev_rec->ble_hci_handle = BTM_GetHCIConnHandle(bd_addr, BT_TRANSPORT_LE);
+    btm_sec_update_dev_index(p_dev_rec);
 
     /* update conn params, use default value for background connection params */
     p_dev_rec->conn_params.min_conn_int = BTM_BLE_CONN_PARAM_UNDEF;
@@ -100,6 +101,7 @@ bool BTM_SecAddBleDevice(const BD_ADDR bd_addr, BD_NAME bd_name,
   p_dev_rec->ble.ble_addr_type = addr_type;
 
   memcpy(p_dev_rec->ble.pseudo_addr, bd_addr, BD_ADDR_LEN);
+  btm_sec_update_dev_index(p_dev_rec);
   /* sync up with the Inq Data base*/
   tBTM_INQ_INFO* p_info = BTM_InqDbRead(bd_addr);
   if (p_info) {
@@ -1157,6 +1159,7 @@ void btm_sec_save_le_key(BD_ADDR bd_addr, tBTM_LE_KEY_TYPE key_type,
                         p_rec->ble.key_type);
         /* update device record address as static address */
         memcpy(p_rec->bd_addr, p_keys->pid_key.static_addr, BD_ADDR_LEN);
+        btm_sec_update_dev_index(p_rec);
         /* combine DUMO device security record if needed */
         btm_consolidate_dev(p_rec);
         break;
@@ -1733,6 +1736,7 @@ void btm_ble_connected(uint8_t* bda, uint16_t handle, uint8_t enc_mode,
   p_dev_rec->ble.ble_addr_type = addr_type;
   /* update pseudo address */
   memcpy(p_dev_rec->ble.pseudo_addr, bda, BD_ADDR_LEN);
+  btm_sec_update_dev_index(p_dev_rec);
 
   p_dev_rec->role_master = false;
   if (role == HCI_ROLE_MASTER) p_dev_rec->role_master = true;
@@ -31,6 +31,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <list>
+#include <unordered_map>
 #include <vector>
 
 #include "bt_types.h"
@@ -42,6 +43,7 @@
 #include "gap_api.h"
 #include "hcimsgs.h"
 #include "osi/include/osi.h"
+#include "osi/include/time.h"
 
 #include "advertise_data_parser.h"
 #include "btm_ble_int.h"
@@ -139,6 +141,70 @@ class AdvertisingCache {
  * on secondary channel */
 AdvertisingCache cache;
 
+class AdvertisingDupFilter {
+ public:
+  /* Last report delivered by a scan */
+  struct Delivery {
+    bool valid;
+    int8_t rssi;
+    uint32_t time_ms;
+  };
+
+  struct Item {
+    uint64_t key;
+    uint32_t hash;
+    Delivery last[BTM_BLE_DUP_FILTER_MAX];
+  };
+
+  /* Get the entry of device |key|, whose report data hashes to |hash|. What
+   * was delivered is forgotten if the data changed. */
+  Item& Find(uint64_t key, uint32_t hash) {
+    auto map_it = index.find(key);
+    if (map_it != index.end()) {
+      auto it = map_it->second;
+      items.splice(items.begin(), items, it);
+      if (it->hash != hash) {
+        it->hash = hash;
+        memset(it->last, 0, sizeof(it->last));
+      }
+      return *it;
+    }
+
+    if (items.size() >= BTM_BLE_DUP_FILTER_CACHE_SIZE) {
+      index.erase(items.back().key);
+      items.pop_back();
+    }
+
+    items.emplace_front();
+    Item& item = items.front();
+    item.key = key;
+    item.hash = hash;
+    memset(item.last, 0, sizeof(item.last));
+    index[key] = items.begin();
+    return item;
+  }
+
+  /* Forget what |scan| delivered */
+  void Reset(tBTM_BLE_DUP_FILTER_SCAN scan) {
+    for (Item& item : items) item.last[scan].valid = false;
+  }
+
+  size_t Size() const { return items.size(); }
+
+  void Clear() {
+    items.clear();
+    index.clear();
+  }
+
+ private:
+  /* most recently heard first */
+  std::list<Item> items;
+  std::unordered_map<uint64_t, std::list<Item>::iterator> index;
+};
+
+/* Devices whose reports were delivered while a duplicate filter is on */
+AdvertisingDupFilter dup_filter;
+
 }  // namespace
 
 #if (BLE_VND_INCLUDED == TRUE)
@@ -534,6 +600,7 @@ tBTM_STATUS BTM_BleObserve(bool start, uint8_t duration,
 
     if (status == BTM_CMD_STARTED) {
       btm_cb.ble_ctr_cb.scan_activity |= BTM_LE_OBSERVE_ACTIVE;
+      dup_filter.Reset(BTM_BLE_DUP_FILTER_OBSERVE);
       if (duration != 0) {
         /* start observer timer */
         period_ms_t duration_ms = duration * 1000;
@@ -552,6 +619,84 @@ tBTM_STATUS BTM_BleObserve(bool start, uint8_t duration,
   return status;
 }
 
+/*******************************************************************************
+ *
+ * Function         BTM_BleSetDupFilter
+ *
+ * Description      This function sets the host duplicate filter applied to the
+ *                  advertising reports delivered by |scan|, and clears its
+ *                  statistics.
+ *
+ * Returns          BTM_SUCCESS, or BTM_ILLEGAL_VALUE for an unknown scan.
+ *
+ ******************************************************************************/
+tBTM_STATUS BTM_BleSetDupFilter(tBTM_BLE_DUP_FILTER_SCAN scan,
+                                const tBTM_BLE_DUP_FILTER_PARAMS* p_params) {
+  if (scan >= BTM_BLE_DUP_FILTER_MAX || p_params == NULL)
+    return BTM_ILLEGAL_VALUE;
+
+  BTM_TRACE_EVENT("%s: scan:%d enable:%d rssi_threshold:%d window_ms:%d",
+                  __func__, scan, p_params->enable, p_params->rssi_threshold,
+                  p_params->window_ms);
+
+  btm_cb.ble_ctr_cb.dup_filter[scan] = *p_params;
+  memset(&btm_cb.ble_ctr_cb.dup_filter_stats[scan], 0,
+         sizeof(tBTM_BLE_DUP_FILTER_STATS));
+  dup_filter.Reset(scan);
+  return BTM_SUCCESS;
+}
+
+/*******************************************************************************
+ *
+ * Function         BTM_BleGetDupFilterStats
+ *
+ * Description      This function reads how many advertising reports |scan|
+ *                  delivered and suppressed.
+ *
+ * Returns          BTM_SUCCESS, or BTM_ILLEGAL_VALUE for an unknown scan.
+ *
+ ******************************************************************************/
+tBTM_STATUS BTM_BleGetDupFilterStats(tBTM_BLE_DUP_FILTER_SCAN scan,
+                                     tBTM_BLE_DUP_FILTER_STATS* p_stats) {
+  if (scan >= BTM_BLE_DUP_FILTER_MAX || p_stats == NULL)
+    return BTM_ILLEGAL_VALUE;
+
+  *p_stats = btm_cb.ble_ctr_cb.dup_filter_stats[scan];
+  return BTM_SUCCESS;
+}
+
+/*******************************************************************************
+ *
+ * Function         BTM_BleDebugDump
+ *
+ * Description      This function writes the LE advertising report duplicate
+ *                  filter settings and statistics to |fd|.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void BTM_BleDebugDump(int fd) {
+  static const char* scan_names[BTM_BLE_DUP_FILTER_MAX] = {"Inquiry",
+                                                           "Observe"};
+  tBTM_BLE_CB* p_cb = &btm_cb.ble_ctr_cb;
+
+  dprintf(fd, "\nLE Advertising Report Duplicate Filter:\n");
+  dprintf(fd, "  Advertisers remembered: %zu (max %d)\n", dup_filter.Size(),
+          BTM_BLE_DUP_FILTER_CACHE_SIZE);
+  for (int scan = 0; scan < BTM_BLE_DUP_FILTER_MAX; scan++) {
+    const tBTM_BLE_DUP_FILTER_PARAMS* p_params = &p_cb->dup_filter[scan];
+    const tBTM_BLE_DUP_FILTER_STATS* p_stats = &p_cb->dup_filter_stats[scan];
+
+    dprintf(fd, "  %-8s: %s", scan_names[scan],
+            p_params->enable ? "on" : "off");
+    if (p_params->enable)
+      dprintf(fd, ", rssi threshold %d dB, window %u ms",
+              p_params->rssi_threshold, p_params->window_ms);
+    dprintf(fd, ", delivered %u, suppressed %u\n", p_stats->delivered,
+            p_stats->suppressed);
+  }
+}
+
 #if (BLE_VND_INCLUDED == TRUE)
 /*******************************************************************************
  *
@@ -1499,6 +1644,7 @@ tBTM_STATUS btm_ble_start_inquiry(uint8_t mode, uint8_t duration) {
   if (status == BTM_CMD_STARTED) {
     p_inq->inq_active |= mode;
     p_ble_cb->scan_activity |= mode;
+    dup_filter.Reset(BTM_BLE_DUP_FILTER_INQUIRY);
 
     BTM_TRACE_DEBUG("btm_ble_start_inquiry inq_active = 0x%02x",
                     p_inq->inq_active);
@@ -1921,16 +2067,13 @@ void btm_ble_update_inq_result(tINQ_DB_ENT* p_i, uint8_t addr_type, BD_ADDR bda,
  *
  ******************************************************************************/
 void btm_clear_all_pending_le_entry(void) {
-  uint16_t xx;
-  tINQ_DB_ENT* p_ent = btm_cb.btm_inq_vars.inq_db;
-
-  for (xx = 0; xx < BTM_INQ_DB_SIZE; xx++, p_ent++) {
+  for (tINQ_DB_ENT* p_ent = btm_inq_db_first(); p_ent;
+       p_ent = btm_inq_db_next(p_ent)) {
     /* mark all pending LE entry as unused if an LE only device has scan
      * response outstanding */
-    if ((p_ent->in_use) &&
-        (p_ent->inq_info.results.device_type == BT_DEVICE_TYPE_BLE) &&
+    if ((p_ent->inq_info.results.device_type == BT_DEVICE_TYPE_BLE) &&
         !p_ent->scan_rsp)
-      p_ent->in_use = false;
+      btm_inq_db_free(p_ent);
   }
 }
 
@@ -2086,6 +2229,109 @@ void btm_ble_process_adv_pkt(uint8_t data_len, uint8_t* data) {
   }
 }
 
+/* Result bits of the scans with a duplicate filter */
+static const uint8_t btm_ble_dup_filter_result[BTM_BLE_DUP_FILTER_MAX] = {
+    BTM_BLE_INQ_RESULT, BTM_BLE_OBS_RESULT};
+
+/**
+ * Returns the result bits of the consumers currently taking advertising
+ * reports.
+ */
+static uint8_t btm_ble_adv_report_consumers(void) {
+  uint8_t scan_activity = btm_cb.ble_ctr_cb.scan_activity;
+  uint8_t consumers = 0;
+
+  if (BTM_BLE_IS_INQ_ACTIVE(scan_activity)) consumers |= BTM_BLE_INQ_RESULT;
+  if (BTM_BLE_IS_OBS_ACTIVE(scan_activity)) consumers |= BTM_BLE_OBS_RESULT;
+  return consumers;
+}
+
+/**
+ * Hashes the event type and data of an advertising report (FNV-1a).
+ */
+static uint32_t btm_ble_adv_report_hash(uint16_t evt_type,
+                                        std::vector<uint8_t> const& adv_data) {
+  uint32_t hash = 2166136261u;
+
+  hash = (hash ^ (evt_type & 0xFF)) * 16777619u;
+  hash = (hash ^ (evt_type >> 8)) * 16777619u;
+  for (uint8_t byte : adv_data) hash = (hash ^ byte) * 16777619u;
+  return hash;
+}
+
+/**
+ * Checks an advertising report against the duplicate filter of each scan
+ * taking reports. |pp_item| is set to the filter entry of the device, or NULL
+ * if no filter is on. Returns the result bits of the scans that must not
+ * deliver the report.
+ */
+static uint8_t btm_ble_dup_filter_check(uint8_t addr_type, BD_ADDR bda,
+                                        uint16_t evt_type, int8_t rssi,
+                                        std::vector<uint8_t> const& adv_data,
+                                        uint32_t now_ms,
+                                        AdvertisingDupFilter::Item** pp_item) {
+  tBTM_BLE_CB* p_cb = &btm_cb.ble_ctr_cb;
+  uint8_t consumers = btm_ble_adv_report_consumers();
+  uint8_t filtered = 0;
+  uint8_t suppressed = 0;
+
+  for (int scan = 0; scan < BTM_BLE_DUP_FILTER_MAX; scan++) {
+    if (p_cb->dup_filter[scan].enable &&
+        (consumers & btm_ble_dup_filter_result[scan]))
+      filtered |= btm_ble_dup_filter_result[scan];
+  }
+
+  *pp_item = NULL;
+  if (!filtered) return 0;
+
+  uint64_t key = addr_type;
+  for (int xx = 0; xx < BD_ADDR_LEN; xx++) key = (key << 8) | bda[xx];
+
+  AdvertisingDupFilter::Item& item =
+      dup_filter.Find(key, btm_ble_adv_report_hash(evt_type, adv_data));
+  *pp_item = &item;
+
+  for (int scan = 0; scan < BTM_BLE_DUP_FILTER_MAX; scan++) {
+    const tBTM_BLE_DUP_FILTER_PARAMS* p_params = &p_cb->dup_filter[scan];
+    const AdvertisingDupFilter::Delivery& last = item.last[scan];
+    int rssi_change = rssi - last.rssi;
+
+    if (!(filtered & btm_ble_dup_filter_result[scan]) || !last.valid)
+      continue;
+    if (p_params->window_ms && now_ms - last.time_ms >= p_params->window_ms)
+      continue;
+    if (rssi_change < 0) rssi_change = -rssi_change;
+    if (p_params->rssi_threshold && rssi_change >= p_params->rssi_threshold)
+      continue;
+
+    suppressed |= btm_ble_dup_filter_result[scan];
+    p_cb->dup_filter_stats[scan].suppressed++;
+  }
+
+  return suppressed;
+}
+
+/**
+ * Records that an advertising report is delivered by the scans in
+ * |delivered|, so that its duplicates can be suppressed.
+ */
+static void btm_ble_dup_filter_deliver(AdvertisingDupFilter::Item* p_item,
+                                       uint8_t delivered, int8_t rssi,
+                                       uint32_t now_ms) {
+  tBTM_BLE_CB* p_cb = &btm_cb.ble_ctr_cb;
+
+  for (int scan = 0; scan < BTM_BLE_DUP_FILTER_MAX; scan++) {
+    if (!(delivered & btm_ble_dup_filter_result[scan])) continue;
+
+    p_cb->dup_filter_stats[scan].delivered++;
+    if (p_item && p_cb->dup_filter[scan].enable) {
+      p_item->last[scan].valid = true;
+      p_item->last[scan].rssi = rssi;
+      p_item->last[scan].time_ms = now_ms;
+    }
+  }
+}
+
 /**
  * This function is called after random address resolution is done, and proceed
  * to process adv packet.
@@ -2136,6 +2382,16 @@ static void btm_ble_process_adv_pkt_cont(
     return;
   }
 
+  /* Drop duplicates before any work if no consumer wants them */
+  AdvertisingDupFilter::Item* p_dup;
+  uint32_t now_ms = time_get_os_boottime_ms();
+  uint8_t dup_mask = btm_ble_dup_filter_check(addr_type, bda, evt_type, rssi,
+                                              adv_data, now_ms, &p_dup);
+  if (dup_mask && dup_mask == btm_ble_adv_report_consumers()) {
+    cache.Clear(addr_type, bda);
+    return;
+  }
+
   tINQ_DB_ENT* p_i = btm_inq_db_find(bda);
 
   /* Check if this address has already been processed for this inquiry */
@@ -2170,6 +2426,7 @@ static void btm_ble_process_adv_pkt_cont(
   btm_ble_update_inq_result(p_i, addr_type, bda, evt_type, primary_phy,
                             secondary_phy, advertising_sid, tx_power, rssi,
                             periodic_adv_int, adv_data);
+  btm_inq_db_touch(p_i);
 
   uint8_t result = btm_ble_is_discoverable(bda, adv_data);
   if (result == 0) {
@@ -2181,6 +2438,13 @@ static void btm_ble_process_adv_pkt_cont(
   }
 
   if (!update) result &= ~BTM_BLE_INQ_RESULT;
+  result &= ~dup_mask;
+
+  uint8_t delivered = result;
+  if (!p_inq->p_inq_results_cb) delivered &= ~BTM_BLE_INQ_RESULT;
+  if (!btm_cb.ble_ctr_cb.p_obs_results_cb) delivered &= ~BTM_BLE_OBS_RESULT;
+  btm_ble_dup_filter_deliver(p_dup, delivered, rssi, now_ms);
+
   /* If the number of responses found and limited, issue a cancel inquiry */
   if (p_inq->inqparms.max_resps &&
       p_inq->inq_cmpl_info.num_resp == p_inq->inqparms.max_resps) {
@@ -2290,6 +2554,14 @@ void btm_ble_stop_scan(void) {
   /* stop discovery now */
   btm_send_hci_scan_enable(BTM_BLE_SCAN_DISABLE, BTM_BLE_DUPLICATE_ENABLE);
 
+  for (int scan = 0; scan < BTM_BLE_DUP_FILTER_MAX; scan++) {
+    tBTM_BLE_DUP_FILTER_STATS* p_stats =
+        &btm_cb.ble_ctr_cb.dup_filter_stats[scan];
+    BTM_TRACE_DEBUG("%s: scan:%d reports delivered:%d suppressed:%d",
+                    __func__, scan, p_stats->delivered, p_stats->suppressed);
+  }
+  dup_filter.Clear();
+
   btm_update_scanner_filter_policy(SP_ADV_ALL);
 }
 /*******************************************************************************
@@ -291,6 +291,10 @@ typedef struct {
   tBTM_CMPL_CB* p_obs_cmpl_cb;
   alarm_t* observer_timer;
 
+  /* host duplicate filter of the advertising report consumers */
+  tBTM_BLE_DUP_FILTER_PARAMS dup_filter[BTM_BLE_DUP_FILTER_MAX];
+  tBTM_BLE_DUP_FILTER_STATS dup_filter_stats[BTM_BLE_DUP_FILTER_MAX];
+
   /* background connection procedure cb value */
   tBTM_BLE_CONN_TYPE bg_conn_type;
   uint32_t scan_int;
@@ -26,6 +26,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unordered_map>
 
 #include "bt_common.h"
 #include "bt_types.h"
@@ -37,6 +38,151 @@
 #include "hcimsgs.h"
 #include "l2c_api.h"
 
+/* Secondary indexes over btm_cb.sec_dev_rec. The list owns the records and
+ * defines their order; the indexes map the addresses (bd_addr and
+ * ble.pseudo_addr) and ACL handles (hci_handle and ble_hci_handle) of each
+ * record back to it, so that the per-event lookups don't have to walk the
+ * list. Zero addresses and BTM_SEC_INVALID_HANDLE are not indexed. */
+typedef struct {
+  uint64_t order; /* records earlier in the list have lower values */
+  uint64_t bd_addr;
+  uint64_t pseudo_addr;
+  uint16_t hci_handle;
+  uint16_t ble_hci_handle;
+} tBTM_SEC_DEV_KEYS;
+
+typedef std::unordered_multimap<uint64_t, tBTM_SEC_DEV_REC*> tBTM_SEC_DEV_INDEX;
+
+static uint64_t btm_sec_dev_order;
+static std::unordered_map<const tBTM_SEC_DEV_REC*, tBTM_SEC_DEV_KEYS>
+    btm_sec_dev_keys;
+static tBTM_SEC_DEV_INDEX btm_sec_dev_by_addr;
+static tBTM_SEC_DEV_INDEX btm_sec_dev_by_handle;
+
+static uint64_t btm_sec_addr_key(const BD_ADDR bd_addr) {
+  uint64_t key = 0;
+  for (int i = 0; i < BD_ADDR_LEN; i++) key = (key << 8) | bd_addr[i];
+  return key;
+}
+
+static void btm_sec_index_add(tBTM_SEC_DEV_REC* p_dev_rec,
+                              const tBTM_SEC_DEV_KEYS& keys) {
+  if (keys.bd_addr != 0) btm_sec_dev_by_addr.emplace(keys.bd_addr, p_dev_rec);
+  if (keys.pseudo_addr != 0 && keys.pseudo_addr != keys.bd_addr)
+    btm_sec_dev_by_addr.emplace(keys.pseudo_addr, p_dev_rec);
+
+  if (keys.hci_handle != BTM_SEC_INVALID_HANDLE)
+    btm_sec_dev_by_handle.emplace(keys.hci_handle, p_dev_rec);
+  if (keys.ble_hci_handle != BTM_SEC_INVALID_HANDLE &&
+      keys.ble_hci_handle != keys.hci_handle)
+    btm_sec_dev_by_handle.emplace(keys.ble_hci_handle, p_dev_rec);
+}
+
+static void btm_sec_index_erase(tBTM_SEC_DEV_INDEX* p_index, uint64_t key,
+                                const tBTM_SEC_DEV_REC* p_dev_rec) {
+  auto range = p_index->equal_range(key);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second == p_dev_rec) {
+      p_index->erase(it);
+      return;
+    }
+  }
+}
+
+static void btm_sec_index_remove(const tBTM_SEC_DEV_REC* p_dev_rec,
+                                 const tBTM_SEC_DEV_KEYS& keys) {
+  btm_sec_index_erase(&btm_sec_dev_by_addr, keys.bd_addr, p_dev_rec);
+  btm_sec_index_erase(&btm_sec_dev_by_addr, keys.pseudo_addr, p_dev_rec);
+  btm_sec_index_erase(&btm_sec_dev_by_handle, keys.hci_handle, p_dev_rec);
+  btm_sec_index_erase(&btm_sec_dev_by_handle, keys.ble_hci_handle, p_dev_rec);
+}
+
+/* Returns the record for |key| that comes first in btm_cb.sec_dev_rec, which
+ * is the one a list_foreach() walk would have stopped at */
+static tBTM_SEC_DEV_REC* btm_sec_index_find(const tBTM_SEC_DEV_INDEX& index,
+                                            uint64_t key) {
+  auto range = index.equal_range(key);
+  if (range.first == range.second) return NULL;
+
+  tBTM_SEC_DEV_REC* p_first = range.first->second;
+  for (auto it = std::next(range.first); it != range.second; ++it) {
+    if (btm_sec_dev_keys[it->second].order < btm_sec_dev_keys[p_first].order)
+      p_first = it->second;
+  }
+  return p_first;
+}
+
+static void btm_sec_get_keys(const tBTM_SEC_DEV_REC* p_dev_rec,
+                             tBTM_SEC_DEV_KEYS* p_keys) {
+  p_keys->bd_addr = btm_sec_addr_key(p_dev_rec->bd_addr);
+  p_keys->pseudo_addr = btm_sec_addr_key(p_dev_rec->ble.pseudo_addr);
+  p_keys->hci_handle = p_dev_rec->hci_handle;
+  p_keys->ble_hci_handle = p_dev_rec->ble_hci_handle;
+}
+
+/* Adds a record that was just appended to btm_cb.sec_dev_rec */
+static void btm_sec_index_dev(tBTM_SEC_DEV_REC* p_dev_rec) {
+  tBTM_SEC_DEV_KEYS& keys = btm_sec_dev_keys[p_dev_rec];
+  keys.order = btm_sec_dev_order++;
+  btm_sec_get_keys(p_dev_rec, &keys);
+  btm_sec_index_add(p_dev_rec, keys);
+}
+
+/* Drops a record about to be removed from btm_cb.sec_dev_rec */
+static void btm_sec_unindex_dev(const tBTM_SEC_DEV_REC* p_dev_rec) {
+  auto it = btm_sec_dev_keys.find(p_dev_rec);
+  if (it == btm_sec_dev_keys.end()) return;
+
+  btm_sec_index_remove(p_dev_rec, it->second);
+  btm_sec_dev_keys.erase(it);
+}
+
+/*******************************************************************************
+ *
+ * Function         btm_sec_update_dev_index
+ *
+ * Description      Re-indexes a device record after its bd_addr,
+ *                  ble.pseudo_addr, hci_handle or ble_hci_handle has changed.
+ *                  Must be called for every such change so that btm_find_dev()
+ *                  and btm_find_dev_by_handle() keep finding the record.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void btm_sec_update_dev_index(tBTM_SEC_DEV_REC* p_dev_rec) {
+  auto it = btm_sec_dev_keys.find(p_dev_rec);
+  if (it == btm_sec_dev_keys.end()) return;
+
+  tBTM_SEC_DEV_KEYS keys = it->second;
+  btm_sec_get_keys(p_dev_rec, &keys);
+  if (keys.bd_addr == it->second.bd_addr &&
+      keys.pseudo_addr == it->second.pseudo_addr &&
+      keys.hci_handle == it->second.hci_handle &&
+      keys.ble_hci_handle == it->second.ble_hci_handle)
+    return;
+
+  btm_sec_index_remove(p_dev_rec, it->second);
+  it->second = keys;
+  btm_sec_index_add(p_dev_rec, keys);
+}
+
+/*******************************************************************************
+ *
+ * Function         btm_sec_clear_dev_index
+ *
+ * Description      Empties the device record indexes. Called when
+ *                  btm_cb.sec_dev_rec is (re)created.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void btm_sec_clear_dev_index(void) {
+  btm_sec_dev_order = 0;
+  btm_sec_dev_keys.clear();
+  btm_sec_dev_by_addr.clear();
+  btm_sec_dev_by_handle.clear();
+}
+
 /*******************************************************************************
  *
  * Function         BTM_SecAddDevice
@@ -70,6 +216,7 @@ bool BTM_SecAddDevice(BD_ADDR bd_addr, DEV_CLASS dev_class, BD_NAME bd_name,
 
     memcpy(p_dev_rec->bd_addr, bd_addr, BD_ADDR_LEN);
     p_dev_rec->hci_handle = BTM_GetHCIConnHandle(bd_addr, BT_TRANSPORT_BR_EDR);
+    btm_sec_update_dev_index(p_dev_rec);
 
     /* use default value for background connection params */
     /* update conn params, use default value for background connection params */
@@ -257,6 +404,7 @@ tBTM_SEC_DEV_REC* btm_sec_alloc_dev(BD_ADDR bd_addr) {
 
   p_dev_rec->ble_hci_handle = BTM_GetHCIConnHandle(bd_addr, BT_TRANSPORT_LE);
   p_dev_rec->hci_handle = BTM_GetHCIConnHandle(bd_addr, BT_TRANSPORT_BR_EDR);
+  btm_sec_update_dev_index(p_dev_rec);
 
   return (p_dev_rec);
 }
@@ -274,6 +422,7 @@ void btm_sec_free_dev(tBTM_SEC_DEV_REC* p_dev_rec) {
   p_dev_rec->sm4 = BTM_SM4_UNKNOWN;
   /* Clear out any saved BLE keys */
   btm_sec_clear_ble_keys(p_dev_rec);
+  btm_sec_unindex_dev(p_dev_rec);
   list_remove(btm_cb.sec_dev_rec, p_dev_rec);
 }
 
@@ -346,6 +495,9 @@ bool is_handle_equal(void* data, void* context) {
  *
  ******************************************************************************/
 tBTM_SEC_DEV_REC* btm_find_dev_by_handle(uint16_t handle) {
+  if (handle != BTM_SEC_INVALID_HANDLE)
+    return btm_sec_index_find(btm_sec_dev_by_handle, handle);
+
   list_node_t* n = list_foreach(btm_cb.sec_dev_rec, is_handle_equal, &handle);
   if (n) return static_cast<tBTM_SEC_DEV_REC*>(list_node(n));
 
@@ -377,6 +529,16 @@ bool is_address_equal(void* data, void* context) {
 tBTM_SEC_DEV_REC* btm_find_dev(const BD_ADDR bd_addr) {
   if (!bd_addr) return NULL;
 
+  uint64_t key = btm_sec_addr_key(bd_addr);
+  if (key != 0) {
+    tBTM_SEC_DEV_REC* p_dev_rec = btm_sec_index_find(btm_sec_dev_by_addr, key);
+    if (p_dev_rec) return p_dev_rec;
+
+    /* Other than by its address, a record can only be found through a
+     * resolvable private address that its IRK resolves */
+    if (!BTM_BLE_IS_RESOLVE_BDA(bd_addr)) return NULL;
+  }
+
   list_node_t* n =
       list_foreach(btm_cb.sec_dev_rec, is_address_equal, (void*)bd_addr);
   if (n) return static_cast<tBTM_SEC_DEV_REC*>(list_node(n));
@@ -419,8 +581,10 @@ void btm_consolidate_dev(tBTM_SEC_DEV_REC* p_target_rec) {
           temp_rec.new_encryption_key_is_p256;
       p_target_rec->no_smp_on_br = temp_rec.no_smp_on_br;
       p_target_rec->bond_type = temp_rec.bond_type;
+      btm_sec_update_dev_index(p_target_rec);
 
       /* remove the combined record */
+      btm_sec_unindex_dev(p_dev_rec);
       list_remove(btm_cb.sec_dev_rec, p_dev_rec);
       break;
     }
@@ -433,6 +597,7 @@ void btm_consolidate_dev(tBTM_SEC_DEV_REC* p_target_rec) {
         p_target_rec->device_type |= p_dev_rec->device_type;
 
         /* remove the combined record */
+        btm_sec_unindex_dev(p_dev_rec);
         list_remove(btm_cb.sec_dev_rec, p_dev_rec);
       }
       break;
@@ -523,6 +688,7 @@ tBTM_SEC_DEV_REC* btm_sec_allocate_dev_rec(void) {
 
   if (list_length(btm_cb.sec_dev_rec) > BTM_SEC_MAX_DEVICE_RECORDS) {
     p_dev_rec = btm_find_oldest_dev_rec();
+    btm_sec_unindex_dev(p_dev_rec);
     list_remove(btm_cb.sec_dev_rec, p_dev_rec);
   }
 
@@ -535,6 +701,9 @@ tBTM_SEC_DEV_REC* btm_sec_allocate_dev_rec(void) {
   p_dev_rec->bond_type = BOND_TYPE_UNKNOWN;
   p_dev_rec->timestamp = btm_cb.dev_rec_count++;
   p_dev_rec->rmt_io_caps = BTM_IO_CAP_UNKNOWN;
+  p_dev_rec->hci_handle = BTM_SEC_INVALID_HANDLE;
+  p_dev_rec->ble_hci_handle = BTM_SEC_INVALID_HANDLE;
+  btm_sec_index_dev(p_dev_rec);
 
   return p_dev_rec;
 }
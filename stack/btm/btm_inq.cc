@@ -30,6 +30,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+#include <vector>
+
 #include "device/include/controller.h"
 #include "osi/include/osi.h"
 #include "osi/include/time.h"
@@ -51,6 +54,13 @@
 #define BTM_INQ_DEBUG FALSE
 #endif
 
+/* Slots in the bdaddr database of an inquiry. Up to 3/4 of them are used,
+ * which still holds more addresses than a BT_DEFAULT_BUFFER_SIZE array */
+#define BTM_INQ_RESULT_FLT_SIZE 512
+
+static_assert(BTM_INQ_DB_SIZE < BTM_INQ_DB_NO_SLOT,
+              "BTM_INQ_DB_SIZE must fit the inquiry database slots");
+
 extern fixed_queue_t* btu_general_alarm_queue;
 
 /******************************************************************************/
@@ -116,6 +126,7 @@ static void btm_initiate_inquiry(tBTM_INQUIRY_VAR_ST* p_inq);
 static tBTM_STATUS btm_set_inq_event_filter(uint8_t filter_cond_type,
                                             tBTM_INQ_FILT_COND* p_filt_cond);
 static void btm_clr_inq_result_flt(void);
+static uint32_t btm_inq_bda_hash(const BD_ADDR p_bda);
 
 static uint8_t btm_convert_uuid_to_eir_service(uint16_t uuid16);
 static void btm_set_eir_uuid(uint8_t* p_eir, tBTM_INQ_RESULTS* p_results);
@@ -1041,12 +1052,8 @@ tBTM_INQ_INFO* BTM_InqDbRead(const BD_ADDR p_bda) {
  *
  ******************************************************************************/
 tBTM_INQ_INFO* BTM_InqDbFirst(void) {
-  uint16_t xx;
-  tINQ_DB_ENT* p_ent = btm_cb.btm_inq_vars.inq_db;
-
-  for (xx = 0; xx < BTM_INQ_DB_SIZE; xx++, p_ent++) {
-    if (p_ent->in_use) return (&p_ent->inq_info);
-  }
+  tINQ_DB_ENT* p_ent = btm_inq_db_first();
+  if (p_ent) return (&p_ent->inq_info);
 
   /* If here, no used entry found */
   return ((tBTM_INQ_INFO*)NULL);
@@ -1065,16 +1072,11 @@ tBTM_INQ_INFO* BTM_InqDbFirst(void) {
  ******************************************************************************/
 tBTM_INQ_INFO* BTM_InqDbNext(tBTM_INQ_INFO* p_cur) {
   tINQ_DB_ENT* p_ent;
-  uint16_t inx;
 
   if (p_cur) {
     p_ent = (tINQ_DB_ENT*)((uint8_t*)p_cur - offsetof(tINQ_DB_ENT, inq_info));
-    inx = (uint16_t)((p_ent - btm_cb.btm_inq_vars.inq_db) + 1);
-
-    for (p_ent = &btm_cb.btm_inq_vars.inq_db[inx]; inx < BTM_INQ_DB_SIZE;
-         inx++, p_ent++) {
-      if (p_ent->in_use) return (&p_ent->inq_info);
-    }
+    p_ent = btm_inq_db_next(p_ent);
+    if (p_ent) return (&p_ent->inq_info);
 
     /* If here, more entries found */
     return ((tBTM_INQ_INFO*)NULL);
@@ -1229,6 +1231,40 @@ void btm_inq_db_init(void) {
   btm_cb.btm_inq_vars.remote_name_timer =
       alarm_new("btm_inq.remote_name_timer");
   btm_cb.btm_inq_vars.no_inc_ssp = BTM_NO_SSP_ON_INQUIRY;
+  btm_cb.btm_inq_vars.inq_db_free = BTM_INQ_DB_NO_SLOT;
+  btm_cb.btm_inq_vars.inq_db_lru_head = BTM_INQ_DB_NO_SLOT;
+  btm_cb.btm_inq_vars.inq_db_lru_tail = BTM_INQ_DB_NO_SLOT;
+}
+
+/*******************************************************************************
+ *
+ * Function         btm_inq_db_cleanup
+ *
+ * Description      This function is called at shutdown, and before the control
+ *                  block is cleared for a new start up, to release the memory
+ *                  held by the inquiry database.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void btm_inq_db_cleanup(void) {
+  tBTM_INQUIRY_VAR_ST* p_inq = &btm_cb.btm_inq_vars;
+
+  alarm_free(p_inq->remote_name_timer);
+  p_inq->remote_name_timer = NULL;
+
+  btm_clr_inq_result_flt();
+
+  for (uint16_t xx = 0; xx < BTM_INQ_DB_BLOCKS; xx++) {
+    osi_free_and_reset((void**)&p_inq->inq_db_blocks[xx]);
+  }
+  p_inq->inq_db_slots = 0;
+  p_inq->inq_db_free = BTM_INQ_DB_NO_SLOT;
+  p_inq->inq_db_lru_head = BTM_INQ_DB_NO_SLOT;
+  p_inq->inq_db_lru_tail = BTM_INQ_DB_NO_SLOT;
+
+  osi_free_and_reset((void**)&p_inq->p_inq_db_hash);
+  p_inq->inq_db_hash_size = 0;
 }
 
 /*******************************************************************************
@@ -1293,22 +1329,18 @@ void btm_inq_clear_ssp(void) {
  *
  ******************************************************************************/
 void btm_clr_inq_db(BD_ADDR p_bda) {
-  tBTM_INQUIRY_VAR_ST* p_inq = &btm_cb.btm_inq_vars;
-  tINQ_DB_ENT* p_ent = p_inq->inq_db;
-  uint16_t xx;
+  tINQ_DB_ENT* p_ent;
 
 #if (BTM_INQ_DEBUG == TRUE)
   BTM_TRACE_DEBUG("btm_clr_inq_db: inq_active:0x%x state:%d",
                   btm_cb.btm_inq_vars.inq_active, btm_cb.btm_inq_vars.state);
 #endif
-  for (xx = 0; xx < BTM_INQ_DB_SIZE; xx++, p_ent++) {
-    if (p_ent->in_use) {
-      /* If this is the specified BD_ADDR or clearing all devices */
-      if (p_bda == NULL || (!memcmp(p_ent->inq_info.results.remote_bd_addr,
-                                    p_bda, BD_ADDR_LEN))) {
-        p_ent->in_use = false;
-      }
-    }
+  if (p_bda == NULL) {
+    for (p_ent = btm_inq_db_first(); p_ent; p_ent = btm_inq_db_next(p_ent))
+      btm_inq_db_free(p_ent);
+  } else {
+    p_ent = btm_inq_db_find(p_bda);
+    if (p_ent) btm_inq_db_free(p_ent);
   }
 #if (BTM_INQ_DEBUG == TRUE)
   BTM_TRACE_DEBUG("inq_active:0x%x state:%d", btm_cb.btm_inq_vars.inq_active,
@@ -1334,6 +1366,27 @@ static void btm_clr_inq_result_flt(void) {
   p_inq->max_bd_entries = 0;
 }
 
+/*******************************************************************************
+ *
+ * Function         btm_init_inq_result_flt
+ *
+ * Description      This function allocates an empty bdaddr database for the
+ *                  inquiry being started.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void btm_init_inq_result_flt(void) {
+  tBTM_INQUIRY_VAR_ST* p_inq = &btm_cb.btm_inq_vars;
+
+  btm_clr_inq_result_flt();
+
+  /* Allocate memory to hold bd_addrs responding */
+  p_inq->p_bd_db =
+      (tINQ_BDADDR*)osi_calloc(BTM_INQ_RESULT_FLT_SIZE * sizeof(tINQ_BDADDR));
+  p_inq->max_bd_entries = BTM_INQ_RESULT_FLT_SIZE;
+}
+
 /*******************************************************************************
  *
  * Function         btm_inq_find_bdaddr
@@ -1346,20 +1399,29 @@ static void btm_clr_inq_result_flt(void) {
  ******************************************************************************/
 bool btm_inq_find_bdaddr(BD_ADDR p_bda) {
   tBTM_INQUIRY_VAR_ST* p_inq = &btm_cb.btm_inq_vars;
-  tINQ_BDADDR* p_db = &p_inq->p_bd_db[0];
-  uint16_t xx;
+  uint32_t mask = p_inq->max_bd_entries - 1;
+  uint32_t pos;
+  tINQ_BDADDR* p_db;
 
   /* Don't bother searching, database doesn't exist or periodic mode */
-  if ((p_inq->inq_active & BTM_PERIODIC_INQUIRY_ACTIVE) || !p_db)
+  if ((p_inq->inq_active & BTM_PERIODIC_INQUIRY_ACTIVE) || !p_inq->p_bd_db)
     return (false);
 
-  for (xx = 0; xx < p_inq->num_bd_entries; xx++, p_db++) {
-    if (!memcmp(p_db->bd_addr, p_bda, BD_ADDR_LEN) &&
-        p_db->inq_count == p_inq->inq_counter)
-      return (true);
+  /* Unused slots have an inq_count of 0, inquiry counts start at 1 */
+  pos = btm_inq_bda_hash(p_bda) & mask;
+  for (p_db = &p_inq->p_bd_db[pos]; p_db->inq_count != 0;
+       pos = (pos + 1) & mask, p_db = &p_inq->p_bd_db[pos]) {
+    if (!memcmp(p_db->bd_addr, p_bda, BD_ADDR_LEN)) {
+      if (p_db->inq_count == p_inq->inq_counter) return (true);
+
+      /* Only seen in an earlier inquiry */
+      p_db->inq_count = p_inq->inq_counter;
+      return (false);
+    }
   }
 
-  if (xx < p_inq->max_bd_entries) {
+  /* Keep a quarter of the slots free so that probes stay short */
+  if (p_inq->num_bd_entries < p_inq->max_bd_entries / 4 * 3) {
     p_db->inq_count = p_inq->inq_counter;
     memcpy(p_db->bd_addr, p_bda, BD_ADDR_LEN);
     p_inq->num_bd_entries++;
@@ -1369,6 +1431,181 @@ bool btm_inq_find_bdaddr(BD_ADDR p_bda) {
   return (false);
 }
 
+/*******************************************************************************
+ *
+ * Function         btm_inq_bda_hash
+ *
+ * Description      Hashes a Bluetooth Device Address for the inquiry database
+ *                  and the bdaddr database. Multiplying spreads addresses that
+ *                  differ only in a few bits over the whole table.
+ *
+ * Returns          the hash
+ *
+ ******************************************************************************/
+static uint32_t btm_inq_bda_hash(const BD_ADDR p_bda) {
+  uint64_t key = 0;
+
+  for (int xx = 0; xx < BD_ADDR_LEN; xx++) key = (key << 8) | p_bda[xx];
+
+  return (uint32_t)((key * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+static tINQ_DB_ENT* btm_inq_db_entry(uint16_t slot) {
+  return &btm_cb.btm_inq_vars.inq_db_blocks[slot / BTM_INQ_DB_BLOCK_SIZE]
+                                           [slot % BTM_INQ_DB_BLOCK_SIZE];
+}
+
+/* Returns the position in p_inq_db_hash that holds |p_ent| */
+static uint32_t btm_inq_db_hash_pos(const tINQ_DB_ENT* p_ent) {
+  tBTM_INQUIRY_VAR_ST* p_inq = &btm_cb.btm_inq_vars;
+  uint32_t mask = p_inq->inq_db_hash_size - 1;
+  uint32_t pos = btm_inq_bda_hash(p_ent->inq_info.results.remote_bd_addr);
+
+  for (pos &= mask; p_inq->p_inq_db_hash[pos] != p_ent->slot;
+       pos = (pos + 1) & mask)
+    ;
+
+  return pos;
+}
+
+static void btm_inq_db_hash_insert(const tINQ_DB_ENT* p_ent) {
+  tBTM_INQUIRY_VAR_ST* p_inq = &btm_cb.btm_inq_vars;
+  uint32_t mask = p_inq->inq_db_hash_size - 1;
+  uint32_t pos = btm_inq_bda_hash(p_ent->inq_info.results.remote_bd_addr);
+
+  for (pos &= mask; p_inq->p_inq_db_hash[pos] != BTM_INQ_DB_NO_SLOT;
+       pos = (pos + 1) & mask)
+    ;
+
+  p_inq->p_inq_db_hash[pos] = p_ent->slot;
+}
+
+/* Removes |p_ent| from p_inq_db_hash, shifting back the entries that probed
+ * past it so that lookups never need tombstones */
+static void btm_inq_db_hash_remove(const tINQ_DB_ENT* p_ent) {
+  tBTM_INQUIRY_VAR_ST* p_inq = &btm_cb.btm_inq_vars;
+  uint32_t mask = p_inq->inq_db_hash_size - 1;
+  uint32_t hole = btm_inq_db_hash_pos(p_ent);
+  uint32_t pos = hole;
+
+  for (;;) {
+    pos = (pos + 1) & mask;
+    uint16_t slot = p_inq->p_inq_db_hash[pos];
+    if (slot == BTM_INQ_DB_NO_SLOT) break;
+
+    uint32_t home =
+        btm_inq_bda_hash(
+            btm_inq_db_entry(slot)->inq_info.results.remote_bd_addr) &
+        mask;
+    if (((pos - home) & mask) >= ((pos - hole) & mask)) {
+      p_inq->p_inq_db_hash[hole] = slot;
+      hole = pos;
+    }
+  }
+
+  p_inq->p_inq_db_hash[hole] = BTM_INQ_DB_NO_SLOT;
+}
+
+static void btm_inq_db_hash_resize(uint32_t size) {
+  tBTM_INQUIRY_VAR_ST* p_inq = &btm_cb.btm_inq_vars;
+
+  osi_free(p_inq->p_inq_db_hash);
+  p_inq->p_inq_db_hash = (uint16_t*)osi_malloc(size * sizeof(uint16_t));
+  memset(p_inq->p_inq_db_hash, 0xFF, size * sizeof(uint16_t));
+  p_inq->inq_db_hash_size = size;
+
+  for (tINQ_DB_ENT* p_ent = btm_inq_db_first(); p_ent;
+       p_ent = btm_inq_db_next(p_ent))
+    btm_inq_db_hash_insert(p_ent);
+}
+
+/* Points the neighbours of |p_ent| in the LRU list back at it */
+static void btm_inq_db_lru_link(tINQ_DB_ENT* p_ent) {
+  tBTM_INQUIRY_VAR_ST* p_inq = &btm_cb.btm_inq_vars;
+
+  if (p_ent->lru_prev == BTM_INQ_DB_NO_SLOT)
+    p_inq->inq_db_lru_head = p_ent->slot;
+  else
+    btm_inq_db_entry(p_ent->lru_prev)->lru_next = p_ent->slot;
+
+  if (p_ent->lru_next == BTM_INQ_DB_NO_SLOT)
+    p_inq->inq_db_lru_tail = p_ent->slot;
+  else
+    btm_inq_db_entry(p_ent->lru_next)->lru_prev = p_ent->slot;
+}
+
+static void btm_inq_db_lru_unlink(tINQ_DB_ENT* p_ent) {
+  tBTM_INQUIRY_VAR_ST* p_inq = &btm_cb.btm_inq_vars;
+
+  if (p_ent->lru_prev == BTM_INQ_DB_NO_SLOT)
+    p_inq->inq_db_lru_head = p_ent->lru_next;
+  else
+    btm_inq_db_entry(p_ent->lru_prev)->lru_next = p_ent->lru_next;
+
+  if (p_ent->lru_next == BTM_INQ_DB_NO_SLOT)
+    p_inq->inq_db_lru_tail = p_ent->lru_prev;
+  else
+    btm_inq_db_entry(p_ent->lru_next)->lru_prev = p_ent->lru_prev;
+}
+
+static void btm_inq_db_lru_append(tINQ_DB_ENT* p_ent) {
+  p_ent->lru_prev = btm_cb.btm_inq_vars.inq_db_lru_tail;
+  p_ent->lru_next = BTM_INQ_DB_NO_SLOT;
+  btm_inq_db_lru_link(p_ent);
+}
+
+/*******************************************************************************
+ *
+ * Function         btm_inq_db_alloc
+ *
+ * Description      This function takes an unused entry off the free list,
+ *                  allocating a new one while the database is below
+ *                  BTM_INQ_DB_SIZE. If it is full, the least recently updated
+ *                  entry is reused.
+ *
+ * Returns          pointer to entry, not in use
+ *
+ ******************************************************************************/
+static tINQ_DB_ENT* btm_inq_db_alloc(void) {
+  tBTM_INQUIRY_VAR_ST* p_inq = &btm_cb.btm_inq_vars;
+  tINQ_DB_ENT* p_ent;
+
+  if (p_inq->inq_db_free != BTM_INQ_DB_NO_SLOT) {
+    p_ent = btm_inq_db_entry(p_inq->inq_db_free);
+    p_inq->inq_db_free = p_ent->lru_next;
+    return (p_ent);
+  }
+
+  if (p_inq->inq_db_slots < BTM_INQ_DB_SIZE) {
+    uint16_t slot = p_inq->inq_db_slots;
+    tINQ_DB_ENT** pp_block =
+        &p_inq->inq_db_blocks[slot / BTM_INQ_DB_BLOCK_SIZE];
+
+    if (*pp_block == NULL)
+      *pp_block = (tINQ_DB_ENT*)osi_calloc(BTM_INQ_DB_BLOCK_SIZE *
+                                           sizeof(tINQ_DB_ENT));
+    p_inq->inq_db_slots++;
+
+    /* Keep the hash table at most half full */
+    if (2 * p_inq->inq_db_slots > p_inq->inq_db_hash_size)
+      btm_inq_db_hash_resize(p_inq->inq_db_hash_size
+                                 ? 2 * p_inq->inq_db_hash_size
+                                 : 2 * BTM_INQ_DB_BLOCK_SIZE);
+
+    p_ent = btm_inq_db_entry(slot);
+    p_ent->slot = slot;
+    return (p_ent);
+  }
+
+  /* If here, no free entry found. Reuse the least recently updated one. */
+  p_ent = btm_inq_db_entry(p_inq->inq_db_lru_head);
+  btm_inq_db_hash_remove(p_ent);
+  btm_inq_db_lru_unlink(p_ent);
+  p_ent->in_use = false;
+
+  return (p_ent);
+}
+
 /*******************************************************************************
  *
  * Function         btm_inq_db_find
@@ -1380,12 +1617,18 @@ bool btm_inq_find_bdaddr(BD_ADDR p_bda) {
  *
  ******************************************************************************/
 tINQ_DB_ENT* btm_inq_db_find(const BD_ADDR p_bda) {
-  uint16_t xx;
-  tINQ_DB_ENT* p_ent = btm_cb.btm_inq_vars.inq_db;
+  tBTM_INQUIRY_VAR_ST* p_inq = &btm_cb.btm_inq_vars;
+  uint32_t mask = p_inq->inq_db_hash_size - 1;
+  uint32_t pos;
+  uint16_t slot;
 
-  for (xx = 0; xx < BTM_INQ_DB_SIZE; xx++, p_ent++) {
-    if ((p_ent->in_use) &&
-        (!memcmp(p_ent->inq_info.results.remote_bd_addr, p_bda, BD_ADDR_LEN)))
+  if (p_inq->p_inq_db_hash == NULL) return (NULL);
+
+  pos = btm_inq_bda_hash(p_bda) & mask;
+  for (slot = p_inq->p_inq_db_hash[pos]; slot != BTM_INQ_DB_NO_SLOT;
+       pos = (pos + 1) & mask, slot = p_inq->p_inq_db_hash[pos]) {
+    tINQ_DB_ENT* p_ent = btm_inq_db_entry(slot);
+    if (!memcmp(p_ent->inq_info.results.remote_bd_addr, p_bda, BD_ADDR_LEN))
       return (p_ent);
   }
 
@@ -1398,40 +1641,115 @@ tINQ_DB_ENT* btm_inq_db_find(const BD_ADDR p_bda) {
  * Function         btm_inq_db_new
  *
  * Description      This function looks through the inquiry database for an
- *                  unused entry. If no entry is free, it allocates the oldest
- *                  entry.
+ *                  unused entry. If no entry is free, it allocates the least
+ *                  recently updated entry.
  *
  * Returns          pointer to entry
  *
  ******************************************************************************/
 tINQ_DB_ENT* btm_inq_db_new(BD_ADDR p_bda) {
-  uint16_t xx;
-  tINQ_DB_ENT* p_ent = btm_cb.btm_inq_vars.inq_db;
-  tINQ_DB_ENT* p_old = btm_cb.btm_inq_vars.inq_db;
-  uint32_t ot = 0xFFFFFFFF;
+  tINQ_DB_ENT* p_ent = btm_inq_db_find(p_bda);
+  uint16_t slot;
 
-  for (xx = 0; xx < BTM_INQ_DB_SIZE; xx++, p_ent++) {
-    if (!p_ent->in_use) {
-      memset(p_ent, 0, sizeof(tINQ_DB_ENT));
-      memcpy(p_ent->inq_info.results.remote_bd_addr, p_bda, BD_ADDR_LEN);
-      p_ent->in_use = true;
+  /* There is one entry per address */
+  if (p_ent) btm_inq_db_free(p_ent);
 
-      return (p_ent);
-    }
+  p_ent = btm_inq_db_alloc();
+  slot = p_ent->slot;
 
-    if (p_ent->time_of_resp < ot) {
-      p_old = p_ent;
-      ot = p_ent->time_of_resp;
-    }
+  memset(p_ent, 0, sizeof(tINQ_DB_ENT));
+  p_ent->slot = slot;
+  memcpy(p_ent->inq_info.results.remote_bd_addr, p_bda, BD_ADDR_LEN);
+  p_ent->in_use = true;
+
+  btm_inq_db_hash_insert(p_ent);
+  btm_inq_db_lru_append(p_ent);
+
+  return (p_ent);
+}
+
+/*******************************************************************************
+ *
+ * Function         btm_inq_db_free
+ *
+ * Description      This function removes an entry from the inquiry database.
+ *                  The memory stays valid, marked as not in use.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void btm_inq_db_free(tINQ_DB_ENT* p_ent) {
+  tBTM_INQUIRY_VAR_ST* p_inq = &btm_cb.btm_inq_vars;
+
+  if (!p_ent->in_use) return;
+
+  btm_inq_db_hash_remove(p_ent);
+  btm_inq_db_lru_unlink(p_ent);
+  p_ent->in_use = false;
+
+  p_ent->lru_next = p_inq->inq_db_free;
+  p_inq->inq_db_free = p_ent->slot;
+}
+
+/*******************************************************************************
+ *
+ * Function         btm_inq_db_touch
+ *
+ * Description      This function records that a response was just received
+ *                  for an entry, making it the last one to be reused.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void btm_inq_db_touch(tINQ_DB_ENT* p_ent) {
+  p_ent->time_of_resp = time_get_os_boottime_ms();
+
+  if (p_ent->slot == btm_cb.btm_inq_vars.inq_db_lru_tail) return;
+
+  btm_inq_db_lru_unlink(p_ent);
+  btm_inq_db_lru_append(p_ent);
+}
+
+/*******************************************************************************
+ *
+ * Function         btm_inq_db_first
+ *
+ * Description      This function returns the first entry in use, in database
+ *                  order.
+ *
+ * Returns          pointer to entry, or NULL if the database is empty
+ *
+ ******************************************************************************/
+tINQ_DB_ENT* btm_inq_db_first(void) {
+  tBTM_INQUIRY_VAR_ST* p_inq = &btm_cb.btm_inq_vars;
+
+  for (uint16_t slot = 0; slot < p_inq->inq_db_slots; slot++) {
+    tINQ_DB_ENT* p_ent = btm_inq_db_entry(slot);
+    if (p_ent->in_use) return (p_ent);
   }
 
-  /* If here, no free entry found. Return the oldest. */
+  return (NULL);
+}
 
-  memset(p_old, 0, sizeof(tINQ_DB_ENT));
-  memcpy(p_old->inq_info.results.remote_bd_addr, p_bda, BD_ADDR_LEN);
-  p_old->in_use = true;
+/*******************************************************************************
+ *
+ * Function         btm_inq_db_next
+ *
+ * Description      This function returns the entry in use that follows
+ *                  |p_ent|, which need not be in use any more.
+ *
+ * Returns          pointer to entry, or NULL if there are no more
+ *
+ ******************************************************************************/
+tINQ_DB_ENT* btm_inq_db_next(tINQ_DB_ENT* p_ent) {
+  tBTM_INQUIRY_VAR_ST* p_inq = &btm_cb.btm_inq_vars;
+
+  for (uint16_t slot = p_ent->slot + 1; slot < p_inq->inq_db_slots; slot++) {
+    p_ent = btm_inq_db_entry(slot);
+    if (p_ent->in_use) return (p_ent);
+  }
 
-  return (p_old);
+  return (NULL);
 }
 
 /*******************************************************************************
@@ -1664,12 +1982,7 @@ static void btm_initiate_inquiry(tBTM_INQUIRY_VAR_ST* p_inq) {
     btsnd_hcic_per_inq_mode(p_inq->per_max_delay, p_inq->per_min_delay, *lap,
                             p_inqparms->duration, p_inqparms->max_resps);
   } else {
-    btm_clr_inq_result_flt();
-
-    /* Allocate memory to hold bd_addrs responding */
-    p_inq->p_bd_db = (tINQ_BDADDR*)osi_calloc(BT_DEFAULT_BUFFER_SIZE);
-    p_inq->max_bd_entries =
-        (uint16_t)(BT_DEFAULT_BUFFER_SIZE / sizeof(tINQ_BDADDR));
+    btm_init_inq_result_flt();
 
     btsnd_hcic_inquiry(*lap, p_inqparms->duration, 0);
   }
@@ -1831,7 +2144,7 @@ void btm_process_inq_results(uint8_t* p, uint8_t inq_res_mode) {
       BTM_TRACE_WARNING ("btm_process_inq_results: Dev class: %02x-%02x-%02x",
                   p_cur->dev_class[0], p_cur->dev_class[1], p_cur->dev_class[2]);
 
-      p_i->time_of_resp = time_get_os_boottime_ms();
+      btm_inq_db_touch(p_i);
 
       if (p_i->inq_count != p_inq->inq_counter)
         p_inq->inq_cmpl_info.num_resp++; /* A new response was found */
@@ -1887,34 +2200,71 @@ void btm_process_inq_results(uint8_t* p, uint8_t inq_res_mode) {
  * Function         btm_sort_inq_result
  *
  * Description      This function is called when inquiry complete is received
- *                  from the device to sort inquiry results based on rssi.
+ *                  from the device to sort inquiry results based on rssi,
+ *                  strongest first. Each entry is moved at most once, and
+ *                  keeps its place in the LRU list.
  *
  * Returns          void
  *
  ******************************************************************************/
 void btm_sort_inq_result(void) {
-  uint8_t xx, yy, num_resp;
-  tINQ_DB_ENT* p_ent = btm_cb.btm_inq_vars.inq_db;
-  tINQ_DB_ENT* p_next = btm_cb.btm_inq_vars.inq_db + 1;
-  int size;
-  tINQ_DB_ENT* p_tmp = (tINQ_DB_ENT*)osi_malloc(sizeof(tINQ_DB_ENT));
+  tBTM_INQUIRY_VAR_ST* p_inq = &btm_cb.btm_inq_vars;
+  std::vector<uint16_t> slots; /* Slots in use, in database order */
+  std::vector<uint16_t> order; /* The same slots, strongest first */
+
+  for (tINQ_DB_ENT* p_ent = btm_inq_db_first(); p_ent;
+       p_ent = btm_inq_db_next(p_ent))
+    slots.push_back(p_ent->slot);
+  if (slots.size() < 2) return;
+
+  order = slots;
+  std::stable_sort(order.begin(), order.end(), [](uint16_t a, uint16_t b) {
+    return btm_inq_db_entry(a)->inq_info.results.rssi >
+           btm_inq_db_entry(b)->inq_info.results.rssi;
+  });
+
+  /* The entry in slot order[k] moves to slot slots[k] */
+  std::vector<uint16_t> new_slot(p_inq->inq_db_slots, BTM_INQ_DB_NO_SLOT);
+  std::vector<uint16_t> index(p_inq->inq_db_slots, 0);
+  for (size_t k = 0; k < slots.size(); k++) {
+    new_slot[order[k]] = slots[k];
+    index[slots[k]] = k;
+  }
 
-  num_resp = (btm_cb.btm_inq_vars.inq_cmpl_info.num_resp < BTM_INQ_DB_SIZE)
-                 ? btm_cb.btm_inq_vars.inq_cmpl_info.num_resp
-                 : BTM_INQ_DB_SIZE;
-
-  size = sizeof(tINQ_DB_ENT);
-  for (xx = 0; xx < num_resp - 1; xx++, p_ent++) {
-    for (yy = xx + 1, p_next = p_ent + 1; yy < num_resp; yy++, p_next++) {
-      if (p_ent->inq_info.results.rssi < p_next->inq_info.results.rssi) {
-        memcpy(p_tmp, p_next, size);
-        memcpy(p_next, p_ent, size);
-        memcpy(p_ent, p_tmp, size);
-      }
+  /* Move each entry once, following the cycles of the permutation */
+  tINQ_DB_ENT* p_tmp = (tINQ_DB_ENT*)osi_malloc(sizeof(tINQ_DB_ENT));
+  std::vector<bool> moved(slots.size(), false);
+  for (size_t k = 0; k < slots.size(); k++) {
+    if (moved[k] || order[k] == slots[k]) continue;
+
+    memcpy(p_tmp, btm_inq_db_entry(slots[k]), sizeof(tINQ_DB_ENT));
+    size_t j = k;
+    while (order[j] != slots[k]) {
+      memcpy(btm_inq_db_entry(slots[j]), btm_inq_db_entry(order[j]),
+             sizeof(tINQ_DB_ENT));
+      moved[j] = true;
+      j = index[order[j]];
     }
+    memcpy(btm_inq_db_entry(slots[j]), p_tmp, sizeof(tINQ_DB_ENT));
+    moved[j] = true;
   }
-
   osi_free(p_tmp);
+
+  /* Point the slot numbers, the LRU list and the hash at the new places */
+  for (uint16_t slot : slots) {
+    tINQ_DB_ENT* p_ent = btm_inq_db_entry(slot);
+    p_ent->slot = slot;
+    if (p_ent->lru_prev != BTM_INQ_DB_NO_SLOT)
+      p_ent->lru_prev = new_slot[p_ent->lru_prev];
+    if (p_ent->lru_next != BTM_INQ_DB_NO_SLOT)
+      p_ent->lru_next = new_slot[p_ent->lru_next];
+  }
+  p_inq->inq_db_lru_head = new_slot[p_inq->inq_db_lru_head];
+  p_inq->inq_db_lru_tail = new_slot[p_inq->inq_db_lru_tail];
+  for (uint32_t pos = 0; pos < p_inq->inq_db_hash_size; pos++) {
+    if (p_inq->p_inq_db_hash[pos] != BTM_INQ_DB_NO_SLOT)
+      p_inq->p_inq_db_hash[pos] = new_slot[p_inq->p_inq_db_hash[pos]];
+  }
 }
 
 /*******************************************************************************
@@ -47,6 +47,7 @@ extern tBTM_CB btm_cb;
  *******************************************
 */
 extern void btm_init(void);
+extern void btm_free(void);
 
 /* Internal functions provided by btm_inq.cc
  ******************************************
@@ -63,6 +64,7 @@ extern void btm_inq_remote_name_timer_timeout(void* data);
 /* Inquiry related functions */
 extern void btm_clr_inq_db(BD_ADDR p_bda);
 extern void btm_inq_db_init(void);
+extern void btm_inq_db_cleanup(void);
 extern void btm_process_inq_results(uint8_t* p, uint8_t inq_res_mode);
 extern void btm_process_inq_complete(uint8_t status, uint8_t mode);
 extern void btm_process_cancel_complete(uint8_t status, uint8_t mode);
@@ -70,6 +72,12 @@ extern void btm_event_filter_complete(uint8_t* p);
 extern void btm_inq_stop_on_ssp(void);
 extern void btm_inq_clear_ssp(void);
 extern tINQ_DB_ENT* btm_inq_db_find(const BD_ADDR p_bda);
+extern tINQ_DB_ENT* btm_inq_db_first(void);
+extern tINQ_DB_ENT* btm_inq_db_next(tINQ_DB_ENT* p_ent);
+extern void btm_inq_db_touch(tINQ_DB_ENT* p_ent);
+extern void btm_inq_db_free(tINQ_DB_ENT* p_ent);
+extern void btm_sort_inq_result(void);
+extern void btm_init_inq_result_flt(void);
 extern bool btm_inq_find_bdaddr(BD_ADDR p_bda);
 
 extern bool btm_lookup_eir(BD_ADDR_PTR p_rem_addr);
@@ -200,6 +208,8 @@ extern void btm_sec_free_dev(tBTM_SEC_DEV_REC* p_dev_rec);
 extern tBTM_SEC_DEV_REC* btm_find_dev(const BD_ADDR bd_addr);
 extern tBTM_SEC_DEV_REC* btm_find_or_alloc_dev(BD_ADDR bd_addr);
 extern tBTM_SEC_DEV_REC* btm_find_dev_by_handle(uint16_t handle);
+extern void btm_sec_update_dev_index(tBTM_SEC_DEV_REC* p_dev_rec);
+extern void btm_sec_clear_dev_index(void);
 extern tBTM_BOND_TYPE btm_get_bond_type_dev(BD_ADDR bd_addr);
 extern bool btm_set_bond_type_dev(BD_ADDR bd_addr, tBTM_BOND_TYPE bond_type);
 
@@ -208,8 +208,19 @@ typedef struct {
   tBTM_INQ_INFO inq_info;
   bool in_use;
   bool scan_rsp;
+  uint16_t slot;     /* Position of the entry in the inquiry database */
+  uint16_t lru_prev; /* Entries updated just before and just after this one, */
+  uint16_t lru_next; /* or BTM_INQ_DB_NO_SLOT. Free entries chain on lru_next */
 } tINQ_DB_ENT;
 
+/* The inquiry database holds up to BTM_INQ_DB_SIZE entries. They are
+ * allocated in blocks as results come in and never move afterwards, so
+ * pointers handed out by BTM_InqDbRead() and friends stay valid. */
+#define BTM_INQ_DB_NO_SLOT 0xFFFF
+#define BTM_INQ_DB_BLOCK_SIZE 16
+#define BTM_INQ_DB_BLOCKS \
+  ((BTM_INQ_DB_SIZE + BTM_INQ_DB_BLOCK_SIZE - 1) / BTM_INQ_DB_BLOCK_SIZE)
+
 enum { INQ_NONE, INQ_LE_OBSERVE, INQ_GENERAL };
 typedef uint8_t tBTM_INQ_TYPE;
 
@@ -248,10 +259,16 @@ typedef struct {
   uint32_t inq_counter; /* Counter incremented each time an inquiry completes */
   /* Used for determining whether or not duplicate devices */
   /* have responded to the same inquiry */
-  tINQ_BDADDR* p_bd_db;    /* Pointer to memory that holds bdaddrs */
+  tINQ_BDADDR* p_bd_db;    /* Hash table of the bdaddrs, open addressing */
   uint16_t num_bd_entries; /* Number of entries in database */
-  uint16_t max_bd_entries; /* Maximum number of entries that can be stored */
-  tINQ_DB_ENT inq_db[BTM_INQ_DB_SIZE];
+  uint16_t max_bd_entries; /* Number of slots in the table, a power of two */
+  tINQ_DB_ENT* inq_db_blocks[BTM_INQ_DB_BLOCKS];
+  uint16_t inq_db_slots;    /* Number of entries allocated in the blocks */
+  uint16_t inq_db_free;     /* First free entry, or BTM_INQ_DB_NO_SLOT */
+  uint16_t inq_db_lru_head; /* Least recently updated entry in use */
+  uint16_t inq_db_lru_tail; /* Most recently updated entry in use */
+  uint16_t* p_inq_db_hash;  /* Slots of the entries in use, open addressing */
+  uint32_t inq_db_hash_size; /* Size of p_inq_db_hash, a power of two */
   tBTM_INQ_PARMS inqparms; /* Contains the parameters for the current inquiry */
   tBTM_INQUIRY_CMPL
       inq_cmpl_info; /* Status and number of responses from the last inquiry */
@@ -45,6 +45,9 @@ tBTM_CB btm_cb;
  *
  ******************************************************************************/
 void btm_init(void) {
+  /* Release what a previous start up left in the control block */
+  btm_inq_db_cleanup();
+
   /* All fields are cleared; nonzero fields are reinitialized in appropriate
    * function */
   memset(&btm_cb, 0, sizeof(tBTM_CB));
@@ -71,6 +74,19 @@ void btm_init(void) {
 #endif
 
   btm_cb.sec_dev_rec = list_new(osi_free);
+  btm_sec_clear_dev_index();
 
   btm_dev_init(); /* Device Manager Structures & HCI_Reset */
 }
+
+/*******************************************************************************
+ *
+ * Function         btm_free
+ *
+ * Description      This function is called at BTM shutdown to release the
+ *                  memory held by the inquiry database.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void btm_free(void) { btm_inq_db_cleanup(); }
@@ -102,6 +102,8 @@ void btu_free_core(void) {
   /* Free the mandatory core stack components */
   l2c_free();
 
+  btm_free();
+
   gatt_free();
 }
 
@@ -18,6 +18,7 @@
 
 #define LOG_TAG "bt_btu_task"
 
+#include <inttypes.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -94,16 +95,60 @@ extern fixed_queue_t* btif_msg_queue;
 
 extern thread_t* bt_workqueue_thread;
 
+/* Maximum number of messages handled per reactor wakeup for each BTU queue.
+ * Whatever is left keeps the queue readable, so the reactor gets back to it
+ * after giving the other queues a turn. */
+#ifndef BTU_MSG_BATCH_MAX
+#define BTU_MSG_BATCH_MAX 16
+#endif
+
+typedef struct {
+  uint64_t wakeups;
+  uint64_t messages;
+  size_t max_batch;
+} btu_batch_stats_t;
+
+static btu_batch_stats_t btu_hci_batch_stats;
+static btu_batch_stats_t btu_bta_batch_stats;
+
 static void btu_hci_msg_process(BT_HDR* p_msg);
 
+static void btu_update_batch_stats(btu_batch_stats_t* stats, size_t count) {
+  stats->wakeups++;
+  stats->messages += count;
+  if (count > stats->max_batch) stats->max_batch = count;
+}
+
 void btu_hci_msg_ready(fixed_queue_t* queue, UNUSED_ATTR void* context) {
-  BT_HDR* p_msg = (BT_HDR*)fixed_queue_dequeue(queue);
-  btu_hci_msg_process(p_msg);
+  void* msgs[BTU_MSG_BATCH_MAX];
+  size_t count = fixed_queue_dequeue_batch(queue, msgs, BTU_MSG_BATCH_MAX);
+  btu_update_batch_stats(&btu_hci_batch_stats, count);
+
+  for (size_t i = 0; i < count; i++) btu_hci_msg_process((BT_HDR*)msgs[i]);
 }
 
 void btu_bta_msg_ready(fixed_queue_t* queue, UNUSED_ATTR void* context) {
-  BT_HDR* p_msg = (BT_HDR*)fixed_queue_dequeue(queue);
-  bta_sys_event(p_msg);
+  void* msgs[BTU_MSG_BATCH_MAX];
+  size_t count = fixed_queue_dequeue_batch(queue, msgs, BTU_MSG_BATCH_MAX);
+  btu_update_batch_stats(&btu_bta_batch_stats, count);
+
+  for (size_t i = 0; i < count; i++) bta_sys_event((BT_HDR*)msgs[i]);
+}
+
+static void btu_dump_batch_stats(int fd, const char* name,
+                                 const btu_batch_stats_t* stats) {
+  double average =
+      stats->wakeups ? (double)stats->messages / stats->wakeups : 0.0;
+  dprintf(fd, "  %-8s: wakeups %" PRIu64 ", messages %" PRIu64
+              ", avg batch %.2f, max batch %zu\n",
+          name, stats->wakeups, stats->messages, average, stats->max_batch);
+}
+
+void btu_debug_dump(int fd) {
+  dprintf(fd, "\nBTU Task Message Batching (max %d per wakeup):\n",
+          BTU_MSG_BATCH_MAX);
+  btu_dump_batch_stats(fd, "HCI", &btu_hci_batch_stats);
+  btu_dump_batch_stats(fd, "BTA", &btu_bta_batch_stats);
 }
 
 static void btu_hci_msg_process(BT_HDR* p_msg) {
@@ -424,6 +424,28 @@ tGATT_STATUS attp_send_sr_msg(tGATT_TCB* p_tcb, BT_HDR* p_msg) {
   return cmd_sent;
 }
 
+/*******************************************************************************
+ *
+ * Function         attp_cl_cmd_q_has_unsent
+ *
+ * Description      Check whether the client queue holds commands that have not
+ *                  been sent yet. A request that is only waiting for its
+ *                  response does not count.
+ *
+ * Returns          true if a command is waiting to be sent.
+ *
+ ******************************************************************************/
+static bool attp_cl_cmd_q_has_unsent(tGATT_TCB* p_tcb) {
+  uint8_t idx = p_tcb->pending_cl_req;
+
+  if (idx == p_tcb->next_slot_inq) return false;
+  if (p_tcb->cl_cmd_q[idx].to_send) return true;
+
+  /* only the head can be outstanding, anything behind it is unsent */
+  idx = (idx + 1) % GATT_CL_MAX_LCB;
+  return idx != p_tcb->next_slot_inq;
+}
+
 /*******************************************************************************
  *
  * Function         attp_cl_send_cmd
@@ -443,9 +465,12 @@ tGATT_STATUS attp_cl_send_cmd(tGATT_TCB* p_tcb, uint16_t clcb_idx,
   if (p_tcb != NULL) {
     cmd_code &= ~GATT_AUTH_SIGN_MASK;
 
-    /* no pending request or value confirmation */
+    /* no pending request or value confirmation. A write command needs no
+     * response, so it only waits for commands queued ahead of it and not for
+     * an outstanding request */
     if (p_tcb->pending_cl_req == p_tcb->next_slot_inq ||
-        cmd_code == GATT_HANDLE_VALUE_CONF) {
+        cmd_code == GATT_HANDLE_VALUE_CONF ||
+        (cmd_code == GATT_CMD_WRITE && !attp_cl_cmd_q_has_unsent(p_tcb))) {
       att_ret = attp_send_msg_to_l2cap(p_tcb, p_cmd);
       if (att_ret == GATT_CONGESTED || att_ret == GATT_SUCCESS) {
         /* do not enq cmd if handle value confirmation or set request */
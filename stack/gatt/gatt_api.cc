@@ -359,6 +359,7 @@ uint16_t GATTS_AddService(tGATT_IF gatt_if, btgatt_db_element_t* service,
   memcpy(&elem.app_uuid, &list.asgn_range.app_uuid128, sizeof(tBT_UUID));
   elem.type = list.asgn_range.is_primary ? GATT_UUID_PRI_SERVICE
                                          : GATT_UUID_SEC_SERVICE;
+  gatts_invalidate_attr_index();
 
   if (elem.type == GATT_UUID_PRI_SERVICE) {
     tBT_UUID* p_uuid = gatts_get_service_uuid(elem.p_db);
@@ -468,6 +469,7 @@ void GATTS_StopService(uint16_t service_handle) {
   }
 
   gatt_cb.srv_list_info->erase(it);
+  gatts_invalidate_attr_index();
   gatt_update_last_pri_srv_info();
 }
 /*******************************************************************************
@@ -181,8 +181,16 @@ void gatt_act_read(tGATT_CLCB* p_clcb, uint16_t offset) {
       break;
 
     case GATT_READ_INC_SRV_UUID128:
-      op_code = GATT_REQ_READ;
-      msg.handle = p_clcb->s_handle;
+      if (p_clcb->read_uuid128.num_results > 1) {
+        op_code = GATT_REQ_READ_MULTI;
+        msg.read_multi.num_handles = p_clcb->read_uuid128.num_results;
+        for (uint8_t i = 0; i < p_clcb->read_uuid128.num_results; i++)
+          msg.read_multi.handles[i] =
+              p_clcb->read_uuid128.result[i].value.incl_service.s_handle;
+      } else {
+        op_code = GATT_REQ_READ;
+        msg.handle = p_clcb->s_handle;
+      }
       p_clcb->op_subtype &= ~0x90;
       break;
 
@@ -473,7 +481,7 @@ void gatt_process_read_info_rsp(UNUSED_ATTR tGATT_TCB* p_tcb,
  * Returns          void.
  *
  ******************************************************************************/
-void gatt_proc_disc_error_rsp(UNUSED_ATTR tGATT_TCB* p_tcb, tGATT_CLCB* p_clcb,
+void gatt_proc_disc_error_rsp(tGATT_TCB* p_tcb, tGATT_CLCB* p_clcb,
                               uint8_t opcode, UNUSED_ATTR uint16_t handle,
                               uint8_t reason) {
   tGATT_STATUS status = (tGATT_STATUS)reason;
@@ -491,6 +499,27 @@ void gatt_proc_disc_error_rsp(UNUSED_ATTR tGATT_TCB* p_tcb, tGATT_CLCB* p_clcb,
         GATT_TRACE_DEBUG("Discovery completed");
       }
       break;
+    case GATT_REQ_READ_MULTI:
+      /* Read the first included service UUID on its own and resume
+       * discovery after it. Read Multiple is optional for the server, so a
+       * peer that does not support it gets single Reads for the rest of the
+       * connection; other errors, such as insufficient authentication, may
+       * not last and only affect this procedure. */
+      if (p_clcb->op_subtype == GATT_DISC_INC_SRVC &&
+          p_clcb->read_uuid128.wait_for_read_rsp) {
+        tGATT_READ_INC_UUID128* p_inc = &p_clcb->read_uuid128;
+
+        if (reason == GATT_REQ_NOT_SUPPORTED)
+          p_tcb->read_multi_unsupported = true;
+        p_inc->read_multi_failed = true;
+        p_inc->num_results = 1;
+        p_inc->next_disc_start_hdl = p_inc->result[0].handle + 1;
+        p_clcb->op_subtype |= 0x90;
+        gatt_act_read(p_clcb, 0);
+        return;
+      }
+      GATT_TRACE_ERROR("Incorrect discovery opcode %04x", opcode);
+      break;
     default:
       GATT_TRACE_ERROR("Incorrect discovery opcode %04x", opcode);
       break;
@@ -670,6 +699,29 @@ void gatt_process_notification(tGATT_TCB* p_tcb, uint8_t op_code, uint16_t len,
   }
 }
 
+/*******************************************************************************
+ *
+ * Function         gatt_inc_uuid128_read_limit
+ *
+ * Description      Number of 128-bit included service UUIDs to fetch with one
+ *                  read. A Read Multiple response holds (MTU - 1) / 16 of
+ *                  them; after Read Multiple failed, on this connection or in
+ *                  this procedure, they are read one at a time.
+ *
+ * Returns          number of UUIDs, at least 1.
+ *
+ ******************************************************************************/
+static uint8_t gatt_inc_uuid128_read_limit(tGATT_CLCB* p_clcb) {
+  tGATT_TCB* p_tcb = p_clcb->p_tcb;
+  uint16_t limit = (p_tcb->payload_size - 1) / LEN_UUID_128;
+
+  if (p_tcb->read_multi_unsupported || p_clcb->read_uuid128.read_multi_failed ||
+      limit < 1)
+    return 1;
+  if (limit > GATT_MAX_READ_MULTI_HANDLES) limit = GATT_MAX_READ_MULTI_HANDLES;
+  return (uint8_t)limit;
+}
+
 /*******************************************************************************
  *
  * Function         gatt_process_read_by_type_rsp
@@ -769,12 +821,23 @@ void gatt_process_read_by_type_rsp(tGATT_TCB* p_tcb, tGATT_CLCB* p_clcb,
         STREAM_TO_UINT16(record_value.incl_service.service_type.uu.uuid16, p);
         record_value.incl_service.service_type.len = LEN_UUID_16;
       } else if (value_len == 4) {
-        p_clcb->s_handle = record_value.incl_service.s_handle;
-        p_clcb->read_uuid128.wait_for_read_rsp = true;
-        p_clcb->read_uuid128.next_disc_start_hdl = handle + 1;
-        memcpy(&p_clcb->read_uuid128.result, &result, sizeof(result));
-        memcpy(&p_clcb->read_uuid128.result.value, &record_value,
-               sizeof(result.value));
+        tGATT_READ_INC_UUID128* p_inc = &p_clcb->read_uuid128;
+        tGATT_DISC_RES* p_res = &p_inc->result[p_inc->num_results++];
+
+        if (p_inc->num_results == 1)
+          p_clcb->s_handle = record_value.incl_service.s_handle;
+        p_inc->next_disc_start_hdl = handle + 1;
+        memcpy(p_res, &result, sizeof(result));
+        memcpy(&p_res->value, &record_value, sizeof(result.value));
+        len -= (value_len + handle_len);
+
+        /* all records of the response carry a 128-bit UUID; fetch as many
+         * as one Read Multiple response can return */
+        if (len >= (handle_len + value_len) &&
+            p_inc->num_results < gatt_inc_uuid128_read_limit(p_clcb))
+          continue;
+
+        p_inc->wait_for_read_rsp = true;
         p_clcb->op_subtype |= 0x90;
         gatt_act_read(p_clcb, 0);
         return;
@@ -919,18 +982,23 @@ void gatt_process_read_rsp(tGATT_TCB* p_tcb, tGATT_CLCB* p_clcb,
     if (p_clcb->operation == GATTC_OPTYPE_DISCOVERY &&
         p_clcb->op_subtype == GATT_DISC_INC_SRVC &&
         p_clcb->read_uuid128.wait_for_read_rsp) {
-      p_clcb->s_handle = p_clcb->read_uuid128.next_disc_start_hdl;
-      p_clcb->read_uuid128.wait_for_read_rsp = false;
-      if (len == LEN_UUID_128) {
-        memcpy(p_clcb->read_uuid128.result.value.incl_service.service_type.uu
-                   .uuid128,
-               p, len);
-        p_clcb->read_uuid128.result.value.incl_service.service_type.len =
-            LEN_UUID_128;
-        if (p_clcb->p_reg->app_cb.p_disc_res_cb)
-          (*p_clcb->p_reg->app_cb.p_disc_res_cb)(p_clcb->conn_id,
-                                                 p_clcb->op_subtype,
-                                                 &p_clcb->read_uuid128.result);
+      tGATT_READ_INC_UUID128* p_inc = &p_clcb->read_uuid128;
+      uint8_t num_results = p_inc->num_results;
+
+      p_clcb->s_handle = p_inc->next_disc_start_hdl;
+      p_inc->wait_for_read_rsp = false;
+      p_inc->num_results = 0;
+      /* Read Multiple returns the values back to back, each 16 octets */
+      if (len == num_results * LEN_UUID_128) {
+        for (uint8_t i = 0; i < num_results; i++, p += LEN_UUID_128) {
+          tBT_UUID* p_uuid = &p_inc->result[i].value.incl_service.service_type;
+
+          memcpy(p_uuid->uu.uuid128, p, LEN_UUID_128);
+          p_uuid->len = LEN_UUID_128;
+          if (p_clcb->p_reg->app_cb.p_disc_res_cb)
+            (*p_clcb->p_reg->app_cb.p_disc_res_cb)(
+                p_clcb->conn_id, p_clcb->op_subtype, &p_inc->result[i]);
+        }
         gatt_act_discovery(p_clcb);
       } else {
         gatt_end_operation(p_clcb, GATT_INVALID_PDU, (void*)p);
@@ -29,6 +29,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <algorithm>
 #include "btm_int.h"
 #include "gatt_int.h"
 #include "l2c_api.h"
@@ -234,8 +235,7 @@ static tGATT_STATUS read_attr_value(tGATT_ATTR& attr16, uint16_t offset,
  *
  * Description      Query attribute value by attribute type.
  *
- * Parameter        p_db: pointer to the attribute database.
- *                  p_rsp: Read By type response data.
+ * Parameter        p_rsp: Read By type response data.
  *                  s_handle: starting handle of the range we are looking for.
  *                  e_handle: ending handle of the range we are looking for.
  *                  type: Attribute type.
@@ -247,51 +247,69 @@ static tGATT_STATUS read_attr_value(tGATT_ATTR& attr16, uint16_t offset,
  *
  ******************************************************************************/
 tGATT_STATUS gatts_db_read_attr_value_by_type(
-    tGATT_TCB* p_tcb, tGATT_SVC_DB* p_db, uint8_t op_code, BT_HDR* p_rsp,
-    uint16_t s_handle, uint16_t e_handle, tBT_UUID type, uint16_t* p_len,
-    tGATT_SEC_FLAG sec_flag, uint8_t key_size, uint32_t trans_id,
-    uint16_t* p_cur_handle) {
+    tGATT_TCB* p_tcb, uint8_t op_code, BT_HDR* p_rsp, uint16_t s_handle,
+    uint16_t e_handle, tBT_UUID type, uint16_t* p_len, tGATT_SEC_FLAG sec_flag,
+    uint8_t key_size, uint32_t trans_id, uint16_t* p_cur_handle) {
   tGATT_STATUS status = GATT_NOT_FOUND;
   uint16_t len = 0;
   uint8_t* p = (uint8_t*)(p_rsp + 1) + p_rsp->len + L2CAP_MIN_OFFSET;
+  const tGATT_ATTR_INDEX& index = gatts_get_attr_index();
+  const std::vector<uint16_t>* p_pos = NULL;
+  size_t xx, count;
+
+  /* a 16 bits type only matches the attributes listed under it */
+  if (type.len == LEN_UUID_16) {
+    auto it = index.uuid16_pos.find(type.uu.uuid16);
+    if (it == index.uuid16_pos.end()) return GATT_NOT_FOUND;
+
+    p_pos = &it->second;
+    xx = std::lower_bound(p_pos->begin(), p_pos->end(), s_handle,
+                          [&index](uint16_t pos, uint16_t handle) {
+                            return index.handles[pos] < handle;
+                          }) -
+         p_pos->begin();
+    count = p_pos->size();
+  } else {
+    xx = gatts_attr_index_lower_bound(index, s_handle);
+    count = index.handles.size();
+  }
 
-  if (p_db) {
-    for (tGATT_ATTR& attr : p_db->attr_list) {
-      tBT_UUID attr_uuid = attr.uuid;
+  for (; xx < count; xx++) {
+    tGATT_ATTR& attr = *index.attrs[p_pos ? (*p_pos)[xx] : xx];
 
-      if (attr.handle >= s_handle && gatt_uuid_compare(type, attr_uuid)) {
-        if (*p_len <= 2) {
-          status = GATT_NO_RESOURCES;
-          break;
-        }
+    if (attr.handle > e_handle) break;
+    if (!p_pos && !gatt_uuid_compare(type, attr.uuid)) continue;
 
-        UINT16_TO_STREAM(p, attr.handle);
+    if (*p_len <= 2) {
+      status = GATT_NO_RESOURCES;
+      break;
+    }
 
-        status = read_attr_value(attr, 0, &p, false, (uint16_t)(*p_len - 2),
-                                 &len, sec_flag, key_size);
+    UINT16_TO_STREAM(p, attr.handle);
 
-        if (status == GATT_PENDING) {
-          status = gatts_send_app_read_request(p_tcb, op_code, attr.handle, 0,
-                                               trans_id, attr.gatt_type);
+    status = read_attr_value(attr, 0, &p, false, (uint16_t)(*p_len - 2), &len,
+                             sec_flag, key_size);
 
-          /* one callback at a time */
-          break;
-        } else if (status == GATT_SUCCESS) {
-          if (p_rsp->offset == 0) p_rsp->offset = len + 2;
-
-          if (p_rsp->offset == len + 2) {
-            p_rsp->len += (len + 2);
-            *p_len -= (len + 2);
-          } else {
-            GATT_TRACE_ERROR("format mismatch");
-            status = GATT_NO_RESOURCES;
-            break;
-          }
-        } else {
-          *p_cur_handle = attr.handle;
-          break;
-        }
+    if (status == GATT_PENDING) {
+      status = gatts_send_app_read_request(p_tcb, op_code, attr.handle, 0,
+                                           trans_id, attr.gatt_type);
+
+      /* one callback at a time */
+      break;
+    } else if (status == GATT_SUCCESS) {
+      if (p_rsp->offset == 0) p_rsp->offset = len + 2;
+
+      if (p_rsp->offset == len + 2) {
+        p_rsp->len += (len + 2);
+        *p_len -= (len + 2);
+      } else {
+        GATT_TRACE_ERROR("format mismatch");
+        status = GATT_NO_RESOURCES;
+        break;
       }
+    } else {
+      *p_cur_handle = attr.handle;
+      break;
     }
   }
 
@@ -446,12 +464,109 @@ uint16_t gatts_add_char_descr(tGATT_SVC_DB& db, tGATT_PERM perm,
 tGATT_ATTR* find_attr_by_handle(tGATT_SVC_DB* p_db, uint16_t handle) {
   if (!p_db) return nullptr;
 
-  for (auto& attr : p_db->attr_list) {
-    if (attr.handle == handle) return &attr;
-    if (attr.handle > handle) return nullptr;
+  /* attributes are allocated in handle order */
+  auto it = std::lower_bound(p_db->attr_list.begin(), p_db->attr_list.end(),
+                             handle, [](const tGATT_ATTR& attr, uint16_t h) {
+                               return attr.handle < h;
+                             });
+  if (it == p_db->attr_list.end() || it->handle != handle) return nullptr;
+
+  return &*it;
+}
+
+/* Returns the 16 bits alias of |uuid|, if it is one expanded from the base
+ * UUID */
+static bool gatts_get_uuid16_alias(const tBT_UUID& uuid, uint16_t* p_uuid16) {
+  uint8_t base[LEN_UUID_128];
+
+  switch (uuid.len) {
+    case LEN_UUID_16:
+      *p_uuid16 = uuid.uu.uuid16;
+      return true;
+
+    case LEN_UUID_32:
+      *p_uuid16 = (uint16_t)uuid.uu.uuid32;
+      return uuid.uu.uuid32 <= 0xFFFF;
+
+    case LEN_UUID_128:
+      *p_uuid16 = uuid.uu.uuid128[LEN_UUID_128 - 4] |
+                  (uuid.uu.uuid128[LEN_UUID_128 - 3] << 8);
+      gatt_convert_uuid16_to_uuid128(base, *p_uuid16);
+      return memcmp(base, uuid.uu.uuid128, LEN_UUID_128) == 0;
+
+    default:
+      return false;
   }
+}
+
+/**
+ * Marks the attribute index stale, after a service was started or stopped.
+ */
+void gatts_invalidate_attr_index(void) {
+  if (gatt_cb.attr_index) gatt_cb.attr_index->valid = false;
+}
+
+/**
+ * Returns the index of the attributes of all started services, building it if
+ * it is stale.
+ */
+const tGATT_ATTR_INDEX& gatts_get_attr_index(void) {
+  if (!gatt_cb.attr_index) gatt_cb.attr_index = new tGATT_ATTR_INDEX();
+
+  tGATT_ATTR_INDEX& index = *gatt_cb.attr_index;
+  if (index.valid) return index;
+
+  index.handles.clear();
+  index.attrs.clear();
+  index.srvs.clear();
+  index.uuid16_pos.clear();
+
+  /* services are kept in handle order */
+  for (tGATT_SRV_LIST_ELEM& el : *gatt_cb.srv_list_info) {
+    if (!el.p_db) continue;
+
+    for (tGATT_ATTR& attr : el.p_db->attr_list) {
+      uint16_t uuid16;
+
+      if (gatts_get_uuid16_alias(attr.uuid, &uuid16))
+        index.uuid16_pos[uuid16].push_back(index.handles.size());
+
+      index.handles.push_back(attr.handle);
+      index.attrs.push_back(&attr);
+      index.srvs.push_back(&el);
+    }
+  }
+
+  GATT_TRACE_DEBUG("%s: %d attributes, %d types", __func__,
+                   (int)index.handles.size(), (int)index.uuid16_pos.size());
+  index.valid = true;
+  return index;
+}
+
+/**
+ * Returns the position in |index| of the first attribute whose handle is
+ * |handle| or greater.
+ */
+size_t gatts_attr_index_lower_bound(const tGATT_ATTR_INDEX& index,
+                                    uint16_t handle) {
+  return std::lower_bound(index.handles.begin(), index.handles.end(),
+                          handle) -
+         index.handles.begin();
+}
+
+/**
+ * Finds the attribute of a started service with handle |handle|. The service
+ * is returned in |pp_srv|.
+ */
+tGATT_ATTR* gatts_find_attr(uint16_t handle, tGATT_SRV_LIST_ELEM** pp_srv) {
+  const tGATT_ATTR_INDEX& index = gatts_get_attr_index();
+  size_t pos = gatts_attr_index_lower_bound(index, handle);
+
+  if (pos == index.handles.size() || index.handles[pos] != handle)
+    return nullptr;
 
-  return nullptr;
+  if (pp_srv) *pp_srv = index.srvs[pos];
+  return index.attrs[pos];
 }
 
 /*******************************************************************************
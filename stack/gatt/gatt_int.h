@@ -29,6 +29,7 @@
 
 #include <string.h>
 #include <list>
+#include <unordered_map>
 #include <vector>
 
 #define GATT_CREATE_CONN_ID(tcb_idx, gatt_if) \
@@ -260,6 +261,17 @@ typedef struct {
   bool is_primary;
 } tGATT_SRV_LIST_ELEM;
 
+/* Attributes of all started services, sorted by handle. It is rebuilt on first
+ * use after a service is started or stopped. */
+typedef struct {
+  std::vector<uint16_t> handles;          /* attribute handles, ascending */
+  std::vector<tGATT_ATTR*> attrs;         /* attribute at each position */
+  std::vector<tGATT_SRV_LIST_ELEM*> srvs; /* service of each attribute */
+  /* positions of the attributes of each 16 bits type, ascending */
+  std::unordered_map<uint16_t, std::vector<uint16_t>> uuid16_pos;
+  bool valid;
+} tGATT_ATTR_INDEX;
+
 typedef struct {
   fixed_queue_t* pending_enc_clcb; /* pending encryption channel q */
   tGATT_SEC_ACTION sec_act;
@@ -290,6 +302,7 @@ typedef struct {
   alarm_t* ind_ack_timer; /* local app confirm to indication timer */
   uint8_t pending_cl_req;
   uint8_t next_slot_inq; /* index of next available slot in queue */
+  bool read_multi_unsupported; /* peer does not support Read Multiple */
 
   bool in_use;
   uint8_t tcb_idx;
@@ -299,8 +312,11 @@ typedef struct {
 typedef struct {
   uint16_t
       next_disc_start_hdl; /* starting handle for the next inc srvv discovery */
-  tGATT_DISC_RES result;
+  /* included services whose 128-bit UUID is being read */
+  tGATT_DISC_RES result[GATT_MAX_READ_MULTI_HANDLES];
+  uint8_t num_results;
   bool wait_for_read_rsp;
+  bool read_multi_failed; /* Read Multiple failed in this procedure */
 } tGATT_READ_INC_UUID128;
 typedef struct {
   tGATT_TCB* p_tcb; /* associated TCB of this CLCB */
@@ -375,6 +391,7 @@ typedef struct {
   tGATT_IF gatt_if;
   std::list<tGATT_HDL_LIST_ELEM>* hdl_list_info;
   std::list<tGATT_SRV_LIST_ELEM>* srv_list_info;
+  tGATT_ATTR_INDEX* attr_index;
 
   fixed_queue_t* srv_chg_clt_q; /* service change clients queue */
   tGATT_REG cl_rcb[GATT_MAX_APPS];
@@ -451,6 +468,8 @@ extern bool gatt_parse_uuid_from_cmd(tBT_UUID* p_uuid, uint16_t len,
                                      uint8_t** p_data);
 extern uint8_t gatt_build_uuid_to_stream(uint8_t** p_dst, tBT_UUID uuid);
 extern bool gatt_uuid_compare(tBT_UUID src, tBT_UUID tar);
+extern void gatt_convert_uuid16_to_uuid128(uint8_t uuid_128[LEN_UUID_128],
+                                           uint16_t uuid_16);
 extern void gatt_convert_uuid32_to_uuid128(uint8_t uuid_128[LEN_UUID_128],
                                            uint32_t uuid_32);
 extern void gatt_sr_get_sec_info(BD_ADDR rem_bda, tBT_TRANSPORT transport,
@@ -589,10 +608,9 @@ extern uint16_t gatts_add_characteristic(tGATT_SVC_DB& db, tGATT_PERM perm,
 extern uint16_t gatts_add_char_descr(tGATT_SVC_DB& db, tGATT_PERM perm,
                                      tBT_UUID& dscp_uuid);
 extern tGATT_STATUS gatts_db_read_attr_value_by_type(
-    tGATT_TCB* p_tcb, tGATT_SVC_DB* p_db, uint8_t op_code, BT_HDR* p_rsp,
-    uint16_t s_handle, uint16_t e_handle, tBT_UUID type, uint16_t* p_len,
-    tGATT_SEC_FLAG sec_flag, uint8_t key_size, uint32_t trans_id,
-    uint16_t* p_cur_handle);
+    tGATT_TCB* p_tcb, uint8_t op_code, BT_HDR* p_rsp, uint16_t s_handle,
+    uint16_t e_handle, tBT_UUID type, uint16_t* p_len, tGATT_SEC_FLAG sec_flag,
+    uint8_t key_size, uint32_t trans_id, uint16_t* p_cur_handle);
 extern tGATT_STATUS gatts_read_attr_value_by_handle(
     tGATT_TCB* p_tcb, tGATT_SVC_DB* p_db, uint8_t op_code, uint16_t handle,
     uint16_t offset, uint8_t* p_value, uint16_t* p_len, uint16_t mtu,
@@ -605,5 +623,11 @@ extern tGATT_STATUS gatts_read_attr_perm_check(tGATT_SVC_DB* p_db, bool is_long,
                                                tGATT_SEC_FLAG sec_flag,
                                                uint8_t key_size);
 extern tBT_UUID* gatts_get_service_uuid(tGATT_SVC_DB* p_db);
+extern void gatts_invalidate_attr_index(void);
+extern const tGATT_ATTR_INDEX& gatts_get_attr_index(void);
+extern size_t gatts_attr_index_lower_bound(const tGATT_ATTR_INDEX& index,
+                                           uint16_t handle);
+extern tGATT_ATTR* gatts_find_attr(uint16_t handle,
+                                   tGATT_SRV_LIST_ELEM** pp_srv);
 
 #endif
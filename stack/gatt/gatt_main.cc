@@ -178,6 +178,8 @@ void gatt_free(void) {
   gatt_cb.hdl_list_info = nullptr;
   gatt_cb.srv_list_info->clear();
   gatt_cb.srv_list_info = nullptr;
+  delete gatt_cb.attr_index;
+  gatt_cb.attr_index = nullptr;
 }
 
 /*******************************************************************************
@@ -508,59 +508,57 @@ static tGATT_STATUS gatt_build_primary_service_rsp(
  * Returns          true: if data filled sucessfully.
  *                  false: packet full, or format mismatch.
  */
-static tGATT_STATUS gatt_build_find_info_rsp(tGATT_SRV_LIST_ELEM& el,
-                                             BT_HDR* p_msg, uint16_t* p_len,
+static tGATT_STATUS gatt_build_find_info_rsp(BT_HDR* p_msg, uint16_t* p_len,
                                              uint16_t s_hdl, uint16_t e_hdl) {
   tGATT_STATUS status = GATT_NOT_FOUND;
   uint8_t* p;
   uint16_t len = *p_len;
   uint8_t info_pair_len[2] = {4, 18};
-
-  if (!el.p_db) return status;
+  const tGATT_ATTR_INDEX& index = gatts_get_attr_index();
 
   /* check the attribute database */
 
   p = (uint8_t*)(p_msg + 1) + L2CAP_MIN_OFFSET + p_msg->len;
 
-  for (auto& attr : el.p_db->attr_list) {
+  for (size_t xx = gatts_attr_index_lower_bound(index, s_hdl);
+       xx < index.handles.size(); xx++) {
+    const tGATT_ATTR& attr = *index.attrs[xx];
+
     if (attr.handle > e_hdl) {
       break;
     }
 
-    if (attr.handle >= s_hdl) {
-      if (p_msg->offset == 0)
-        p_msg->offset = (attr.uuid.len == LEN_UUID_16)
-                            ? GATT_INFO_TYPE_PAIR_16
-                            : GATT_INFO_TYPE_PAIR_128;
-
-      if (len >= info_pair_len[p_msg->offset - 1]) {
-        if (p_msg->offset == GATT_INFO_TYPE_PAIR_16 &&
-            attr.uuid.len == LEN_UUID_16) {
-          UINT16_TO_STREAM(p, attr.handle);
-          UINT16_TO_STREAM(p, attr.uuid.uu.uuid16);
-        } else if (p_msg->offset == GATT_INFO_TYPE_PAIR_128 &&
-                   attr.uuid.len == LEN_UUID_128) {
-          UINT16_TO_STREAM(p, attr.handle);
-          ARRAY_TO_STREAM(p, attr.uuid.uu.uuid128, LEN_UUID_128);
-        } else if (p_msg->offset == GATT_INFO_TYPE_PAIR_128 &&
-                   attr.uuid.len == LEN_UUID_32) {
-          UINT16_TO_STREAM(p, attr.handle);
-          gatt_convert_uuid32_to_uuid128(p, attr.uuid.uu.uuid32);
-          p += LEN_UUID_128;
-        } else {
-          GATT_TRACE_ERROR("format mismatch");
-          status = GATT_NO_RESOURCES;
-          break;
-          /* format mismatch */
-        }
-        p_msg->len += info_pair_len[p_msg->offset - 1];
-        len -= info_pair_len[p_msg->offset - 1];
-        status = GATT_SUCCESS;
-
+    if (p_msg->offset == 0)
+      p_msg->offset = (attr.uuid.len == LEN_UUID_16) ? GATT_INFO_TYPE_PAIR_16
+                                                     : GATT_INFO_TYPE_PAIR_128;
+
+    if (len >= info_pair_len[p_msg->offset - 1]) {
+      if (p_msg->offset == GATT_INFO_TYPE_PAIR_16 &&
+          attr.uuid.len == LEN_UUID_16) {
+        UINT16_TO_STREAM(p, attr.handle);
+        UINT16_TO_STREAM(p, attr.uuid.uu.uuid16);
+      } else if (p_msg->offset == GATT_INFO_TYPE_PAIR_128 &&
+                 attr.uuid.len == LEN_UUID_128) {
+        UINT16_TO_STREAM(p, attr.handle);
+        ARRAY_TO_STREAM(p, attr.uuid.uu.uuid128, LEN_UUID_128);
+      } else if (p_msg->offset == GATT_INFO_TYPE_PAIR_128 &&
+                 attr.uuid.len == LEN_UUID_32) {
+        UINT16_TO_STREAM(p, attr.handle);
+        gatt_convert_uuid32_to_uuid128(p, attr.uuid.uu.uuid32);
+        p += LEN_UUID_128;
       } else {
+        GATT_TRACE_ERROR("format mismatch");
         status = GATT_NO_RESOURCES;
         break;
+        /* format mismatch */
       }
+      p_msg->len += info_pair_len[p_msg->offset - 1];
+      len -= info_pair_len[p_msg->offset - 1];
+      status = GATT_SUCCESS;
+
+    } else {
+      status = GATT_NO_RESOURCES;
+      break;
     }
   }
 
@@ -715,15 +713,8 @@ static void gatts_process_find_info(tGATT_TCB* p_tcb, uint8_t op_code,
 
     buf_len = p_tcb->payload_size - 2;
 
-    for (tGATT_SRV_LIST_ELEM& el : *gatt_cb.srv_list_info) {
-      if (el.s_hdl <= e_hdl && el.e_hdl >= s_hdl) {
-        reason = gatt_build_find_info_rsp(el, p_msg, &buf_len, s_hdl, e_hdl);
-        if (reason == GATT_NO_RESOURCES) {
-          reason = GATT_SUCCESS;
-          break;
-        }
-      }
-    }
+    reason = gatt_build_find_info_rsp(p_msg, &buf_len, s_hdl, e_hdl);
+    if (reason == GATT_NO_RESOURCES) reason = GATT_SUCCESS;
 
     *p = (uint8_t)p_msg->offset;
 
@@ -817,7 +808,7 @@ void gatts_process_read_by_type_req(tGATT_TCB* p_tcb, uint8_t op_code,
   size_t msg_len = sizeof(BT_HDR) + p_tcb->payload_size + L2CAP_MIN_OFFSET;
   uint16_t buf_len, s_hdl, e_hdl, err_hdl = 0;
   BT_HDR* p_msg = NULL;
-  tGATT_STATUS reason, ret;
+  tGATT_STATUS reason;
   uint8_t* p;
   uint8_t sec_flag, key_size;
 
@@ -846,26 +837,16 @@ void gatts_process_read_by_type_req(tGATT_TCB* p_tcb, uint8_t op_code,
     p_msg->len = 2;
     buf_len = p_tcb->payload_size - 2;
 
-    reason = GATT_NOT_FOUND;
-
-    for (tGATT_SRV_LIST_ELEM& el : *gatt_cb.srv_list_info) {
-      if (el.s_hdl <= e_hdl && el.e_hdl >= s_hdl) {
-        gatt_sr_get_sec_info(p_tcb->peer_bda, p_tcb->transport, &sec_flag,
-                             &key_size);
-
-        ret = gatts_db_read_attr_value_by_type(p_tcb, el.p_db, op_code, p_msg,
-                                               s_hdl, e_hdl, uuid, &buf_len,
-                                               sec_flag, key_size, 0, &err_hdl);
-        if (ret != GATT_NOT_FOUND) {
-          reason = ret;
+    gatt_sr_get_sec_info(p_tcb->peer_bda, p_tcb->transport, &sec_flag,
+                         &key_size);
 
-          if (ret == GATT_NO_RESOURCES) reason = GATT_SUCCESS;
-        }
-        if (ret != GATT_SUCCESS && ret != GATT_NOT_FOUND) {
-          s_hdl = err_hdl;
-          break;
-        }
-      }
+    reason = gatts_db_read_attr_value_by_type(p_tcb, op_code, p_msg, s_hdl,
+                                              e_hdl, uuid, &buf_len, sec_flag,
+                                              key_size, 0, &err_hdl);
+    if (reason == GATT_NO_RESOURCES) {
+      reason = GATT_SUCCESS;
+    } else if (reason != GATT_SUCCESS && reason != GATT_NOT_FOUND) {
+      s_hdl = err_hdl;
     }
     *p = (uint8_t)p_msg->offset;
     p_msg->offset = L2CAP_MIN_OFFSET;
@@ -1046,34 +1027,27 @@ void gatts_process_attribute_req(tGATT_TCB* p_tcb, uint8_t op_code,
   }
 #endif
 
-  if (GATT_HANDLE_IS_VALID(handle)) {
-    for (auto& el : *gatt_cb.srv_list_info) {
-      if (el.s_hdl <= handle && el.e_hdl >= handle) {
-        for (const auto& attr : el.p_db->attr_list) {
-          if (attr.handle == handle) {
-            switch (op_code) {
-              case GATT_REQ_READ: /* read char/char descriptor value */
-              case GATT_REQ_READ_BLOB:
-                gatts_process_read_req(p_tcb, el, op_code, handle, len, p);
-                break;
-
-              case GATT_REQ_WRITE: /* write char/char descriptor value */
-              case GATT_CMD_WRITE:
-              case GATT_SIGN_CMD_WRITE:
-              case GATT_REQ_PREPARE_WRITE:
-                gatts_process_write_req(p_tcb, el, handle, op_code, len, p,
-                                        attr.gatt_type);
-                break;
-              default:
-                break;
-            }
-            status = GATT_SUCCESS;
-            break;
-          }
-        }
+  tGATT_SRV_LIST_ELEM* p_el;
+  tGATT_ATTR* p_attr;
+  if (GATT_HANDLE_IS_VALID(handle) &&
+      (p_attr = gatts_find_attr(handle, &p_el)) != NULL) {
+    switch (op_code) {
+      case GATT_REQ_READ: /* read char/char descriptor value */
+      case GATT_REQ_READ_BLOB:
+        gatts_process_read_req(p_tcb, *p_el, op_code, handle, len, p);
+        break;
+
+      case GATT_REQ_WRITE: /* write char/char descriptor value */
+      case GATT_CMD_WRITE:
+      case GATT_SIGN_CMD_WRITE:
+      case GATT_REQ_PREPARE_WRITE:
+        gatts_process_write_req(p_tcb, *p_el, handle, op_code, len, p,
+                                p_attr->gatt_type);
+        break;
+      default:
         break;
-      }
     }
+    status = GATT_SUCCESS;
   }
 
   if (status != GATT_SUCCESS && op_code != GATT_CMD_WRITE &&
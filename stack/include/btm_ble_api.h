@@ -195,6 +195,49 @@ extern tBTM_STATUS BTM_BleObserve(bool start, uint8_t duration,
                                   tBTM_INQ_RESULTS_CB* p_results_cb,
                                   tBTM_CMPL_CB* p_cmpl_cb);
 
+/*******************************************************************************
+ *
+ * Function         BTM_BleSetDupFilter
+ *
+ * Description      This function sets the host duplicate filter applied to the
+ *                  advertising reports delivered by |scan|, and clears its
+ *                  statistics. Reports are delivered unfiltered by default.
+ *
+ * Parameters       scan: BTM_BLE_DUP_FILTER_INQUIRY or
+ *                        BTM_BLE_DUP_FILTER_OBSERVE.
+ *                  p_params: filter settings.
+ *
+ * Returns          BTM_SUCCESS, or BTM_ILLEGAL_VALUE for an unknown scan.
+ *
+ ******************************************************************************/
+extern tBTM_STATUS BTM_BleSetDupFilter(
+    tBTM_BLE_DUP_FILTER_SCAN scan, const tBTM_BLE_DUP_FILTER_PARAMS* p_params);
+
+/*******************************************************************************
+ *
+ * Function         BTM_BleGetDupFilterStats
+ *
+ * Description      This function reads how many advertising reports |scan|
+ *                  delivered and suppressed.
+ *
+ * Returns          BTM_SUCCESS, or BTM_ILLEGAL_VALUE for an unknown scan.
+ *
+ ******************************************************************************/
+extern tBTM_STATUS BTM_BleGetDupFilterStats(tBTM_BLE_DUP_FILTER_SCAN scan,
+                                            tBTM_BLE_DUP_FILTER_STATS* p_stats);
+
+/*******************************************************************************
+ *
+ * Function         BTM_BleDebugDump
+ *
+ * Description      This function writes the LE advertising report duplicate
+ *                  filter settings and statistics to |fd|.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+extern void BTM_BleDebugDump(int fd);
+
 /*******************************************************************************
  *
  * Function         BTM_GetDeviceIDRoot
@@ -551,6 +551,30 @@ typedef void(tBTM_BLE_VERIFY_CBACK)(void* p_ref_data, bool match);
 /* random address set complete callback */
 typedef void(tBTM_BLE_RANDOM_SET_CBACK)(BD_ADDR random_bda);
 
+/* LE scans whose advertising reports can be filtered for duplicates on the
+ * host. All GATT scanner clients share the observe scan, so its filter
+ * applies to each of them. */
+#define BTM_BLE_DUP_FILTER_INQUIRY 0 /* results of BTM_StartInquiry() */
+#define BTM_BLE_DUP_FILTER_OBSERVE 1 /* results of BTM_BleObserve() */
+#define BTM_BLE_DUP_FILTER_MAX 2
+typedef uint8_t tBTM_BLE_DUP_FILTER_SCAN;
+
+/* Host duplicate filter of a scan. A report is not delivered when its event
+ * type and data are those last delivered for the address, its RSSI moved by
+ * less than rssi_threshold dB (0: RSSI is ignored), and less than window_ms
+ * passed since that delivery (0: no time limit). */
+typedef struct {
+  bool enable;
+  uint8_t rssi_threshold;
+  uint32_t window_ms;
+} tBTM_BLE_DUP_FILTER_PARAMS;
+
+/* Reports of a scan since its filter was last set */
+typedef struct {
+  uint32_t delivered;
+  uint32_t suppressed;
+} tBTM_BLE_DUP_FILTER_STATS;
+
 typedef void(tBTM_BLE_SCAN_REQ_CBACK)(BD_ADDR remote_bda,
                                       tBLE_ADDR_TYPE addr_type,
                                       uint8_t adv_evt);
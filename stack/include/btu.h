@@ -75,4 +75,9 @@ extern void btu_free_core(void);
 void BTU_StartUp(void);
 void BTU_ShutDown(void);
 
+/* Functions provided by btu_task.cc
+ ***********************************
+*/
+extern void btu_debug_dump(int fd);
+
 #endif
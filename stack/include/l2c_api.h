@@ -1235,4 +1235,16 @@ extern uint8_t L2CA_GetBleConnRole(BD_ADDR bd_addr);
 extern uint16_t L2CA_GetDisconnectReason(BD_ADDR remote_bda,
                                          tBT_TRANSPORT transport);
 
+/*******************************************************************************
+ *
+ * Function         L2CA_DebugDump
+ *
+ * Description      This function writes L2CAP debug information, such as the
+ *                  ERTM retransmission buffer counters, to |fd|.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+extern void L2CA_DebugDump(int fd);
+
 #endif /* L2C_API_H */
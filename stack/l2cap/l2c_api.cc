@@ -2198,7 +2198,8 @@ uint16_t L2CA_FlushChannel(uint16_t lcid, uint16_t num_to_flush) {
   /* If needed, flush buffers in the CCB xmit hold queue */
   while ((num_to_flush != 0) && (!fixed_queue_is_empty(p_ccb->xmit_hold_q))) {
     BT_HDR* p_buf = (BT_HDR*)fixed_queue_try_dequeue(p_ccb->xmit_hold_q);
-    osi_free(p_buf);
+    /* ERTM may still hold sent segments of the first one */
+    l2c_fcr_free_xmit_sdu(p_ccb, p_buf);
     num_to_flush--;
     num_flushed2++;
   }
@@ -2227,3 +2228,14 @@ uint16_t L2CA_FlushChannel(uint16_t lcid, uint16_t num_to_flush) {
 
   return (num_left);
 }
+
+/*******************************************************************************
+ *
+ * Function         L2CA_DebugDump
+ *
+ * Description      This function writes L2CAP debug information to |fd|.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void L2CA_DebugDump(int fd) { l2c_fcr_debug_dump(fd); }
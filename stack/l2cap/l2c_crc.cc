@@ -0,0 +1,355 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2017 Google, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/******************************************************************************
+ *
+ *  This file contains the CRC-16 engine used for the L2CAP Frame Check
+ *  Sequence.
+ *
+ *  The CRC is reflected: the register holds the remainder with x^15 in bit 0,
+ *  and each message byte enters least significant bit first. Three kernels
+ *  compute it:
+ *
+ *  - byte:   the classic one-lookup-per-byte loop.
+ *  - slice8: eight tables, where table k gives the effect of a byte followed
+ *            by k zero bytes, so 8 bytes take 8 independent lookups.
+ *  - clmul:  folds the message 64 bytes at a time with carry-less multiplies
+ *            until 16 bytes are left, which the tables finish. Folding a
+ *            128-bit block A forward by D bits replaces it with
+ *            A_hi * (x^(D+63) mod P) + A_lo * (x^(D-1) mod P); the extra -1
+ *            in the exponents makes up for the product of two reflected
+ *            64-bit values coming out one bit short.
+ *
+ ******************************************************************************/
+
+#include "l2c_crc.h"
+
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define L2C_CRC_CLMUL
+#endif
+
+/* Reflected generator polynomial, and the unreflected one with x^16 */
+#define L2C_CRC_POLY_REFLECTED 0xA001
+#define L2C_CRC_POLY 0x18005
+
+/* Below this length the table kernels are faster than folding */
+#define L2C_CRC_CLMUL_MIN_LEN 64
+
+/* Look-up table for the CRC calculation */
+static const uint16_t crctab[256] = {
+    0x0000, 0xc0c1, 0xc181, 0x0140, 0xc301, 0x03c0, 0x0280, 0xc241, 0xc601,
+    0x06c0, 0x0780, 0xc741, 0x0500, 0xc5c1, 0xc481, 0x0440, 0xcc01, 0x0cc0,
+    0x0d80, 0xcd41, 0x0f00, 0xcfc1, 0xce81, 0x0e40, 0x0a00, 0xcac1, 0xcb81,
+    0x0b40, 0xc901, 0x09c0, 0x0880, 0xc841, 0xd801, 0x18c0, 0x1980, 0xd941,
+    0x1b00, 0xdbc1, 0xda81, 0x1a40, 0x1e00, 0xdec1, 0xdf81, 0x1f40, 0xdd01,
+    0x1dc0, 0x1c80, 0xdc41, 0x1400, 0xd4c1, 0xd581, 0x1540, 0xd701, 0x17c0,
+    0x1680, 0xd641, 0xd201, 0x12c0, 0x1380, 0xd341, 0x1100, 0xd1c1, 0xd081,
+    0x1040, 0xf001, 0x30c0, 0x3180, 0xf141, 0x3300, 0xf3c1, 0xf281, 0x3240,
+    0x3600, 0xf6c1, 0xf781, 0x3740, 0xf501, 0x35c0, 0x3480, 0xf441, 0x3c00,
+    0xfcc1, 0xfd81, 0x3d40, 0xff01, 0x3fc0, 0x3e80, 0xfe41, 0xfa01, 0x3ac0,
+    0x3b80, 0xfb41, 0x3900, 0xf9c1, 0xf881, 0x3840, 0x2800, 0xe8c1, 0xe981,
+    0x2940, 0xeb01, 0x2bc0, 0x2a80, 0xea41, 0xee01, 0x2ec0, 0x2f80, 0xef41,
+    0x2d00, 0xedc1, 0xec81, 0x2c40, 0xe401, 0x24c0, 0x2580, 0xe541, 0x2700,
+    0xe7c1, 0xe681, 0x2640, 0x2200, 0xe2c1, 0xe381, 0x2340, 0xe101, 0x21c0,
+    0x2080, 0xe041, 0xa001, 0x60c0, 0x6180, 0xa141, 0x6300, 0xa3c1, 0xa281,
+    0x6240, 0x6600, 0xa6c1, 0xa781, 0x6740, 0xa501, 0x65c0, 0x6480, 0xa441,
+    0x6c00, 0xacc1, 0xad81, 0x6d40, 0xaf01, 0x6fc0, 0x6e80, 0xae41, 0xaa01,
+    0x6ac0, 0x6b80, 0xab41, 0x6900, 0xa9c1, 0xa881, 0x6840, 0x7800, 0xb8c1,
+    0xb981, 0x7940, 0xbb01, 0x7bc0, 0x7a80, 0xba41, 0xbe01, 0x7ec0, 0x7f80,
+    0xbf41, 0x7d00, 0xbdc1, 0xbc81, 0x7c40, 0xb401, 0x74c0, 0x7580, 0xb541,
+    0x7700, 0xb7c1, 0xb681, 0x7640, 0x7200, 0xb2c1, 0xb381, 0x7340, 0xb101,
+    0x71c0, 0x7080, 0xb041, 0x5000, 0x90c1, 0x9181, 0x5140, 0x9301, 0x53c0,
+    0x5280, 0x9241, 0x9601, 0x56c0, 0x5780, 0x9741, 0x5500, 0x95c1, 0x9481,
+    0x5440, 0x9c01, 0x5cc0, 0x5d80, 0x9d41, 0x5f00, 0x9fc1, 0x9e81, 0x5e40,
+    0x5a00, 0x9ac1, 0x9b81, 0x5b40, 0x9901, 0x59c0, 0x5880, 0x9841, 0x8801,
+    0x48c0, 0x4980, 0x8941, 0x4b00, 0x8bc1, 0x8a81, 0x4a40, 0x4e00, 0x8ec1,
+    0x8f81, 0x4f40, 0x8d01, 0x4dc0, 0x4c80, 0x8c41, 0x4400, 0x84c1, 0x8581,
+    0x4540, 0x8701, 0x47c0, 0x4680, 0x8641, 0x8201, 0x42c0, 0x4380, 0x8341,
+    0x4100, 0x81c1, 0x8081, 0x4040,
+};
+
+typedef uint16_t(tL2C_CRC_FN)(uint16_t crc, uint8_t* dst, const uint8_t* src,
+                              size_t len);
+
+typedef struct {
+  /* slice_tab[k][b]: byte b followed by k zero bytes; slice_tab[0] = crctab */
+  uint16_t slice_tab[8][256];
+
+  /* x2n_tab[k]: x^(2^k) mod P, reflected */
+  uint16_t x2n_tab[32];
+
+#if defined(L2C_CRC_CLMUL)
+  /* Folding constants, see the file header: {x^(D+63), x^(D-1)} mod P */
+  uint64_t fold128[2];
+  uint64_t fold512[2];
+#endif
+
+  tL2C_CRC_KERNEL kernel;
+  tL2C_CRC_FN* p_fn;
+} tL2C_CRC_CB;
+
+static tL2C_CRC_CB l2c_crc_cb;
+
+/*******************************************************************************
+ *  Table kernels. A NULL |dst| means "don't copy".
+ ******************************************************************************/
+static uint16_t l2c_crc16_byte(uint16_t crc, uint8_t* dst, const uint8_t* src,
+                               size_t len) {
+  if (dst != NULL) memcpy(dst, src, len);
+
+  while (len--) crc = (crc >> 8) ^ crctab[(crc ^ *src++) & 0xff];
+
+  return crc;
+}
+
+static uint16_t l2c_crc16_slice8(uint16_t crc, uint8_t* dst,
+                                 const uint8_t* src, size_t len) {
+  const uint16_t(*t)[256] = l2c_crc_cb.slice_tab;
+
+  while (len >= 8) {
+    if (dst != NULL) {
+      memcpy(dst, src, 8);
+      dst += 8;
+    }
+    crc = t[7][(src[0] ^ crc) & 0xff] ^ t[6][(src[1] ^ (crc >> 8)) & 0xff] ^
+          t[5][src[2]] ^ t[4][src[3]] ^ t[3][src[4]] ^ t[2][src[5]] ^
+          t[1][src[6]] ^ t[0][src[7]];
+    src += 8;
+    len -= 8;
+  }
+
+  return l2c_crc16_byte(crc, dst, src, len);
+}
+
+#if defined(L2C_CRC_CLMUL)
+/*******************************************************************************
+ *  Carry-less multiply kernel
+ ******************************************************************************/
+__attribute__((target("sse2,pclmul"))) static inline __m128i l2c_crc16_fold(
+    __m128i x, __m128i k, __m128i next) {
+  return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00),
+                                     _mm_clmulepi64_si128(x, k, 0x11)),
+                       next);
+}
+
+__attribute__((target("sse2,pclmul"))) static inline __m128i l2c_crc16_load(
+    uint8_t* dst, const uint8_t* src) {
+  __m128i x = _mm_loadu_si128((const __m128i*)src);
+  if (dst != NULL) _mm_storeu_si128((__m128i*)dst, x);
+  return x;
+}
+
+__attribute__((target("sse2,pclmul"))) static uint16_t l2c_crc16_clmul(
+    uint16_t crc, uint8_t* dst, const uint8_t* src, size_t len) {
+  if (len < L2C_CRC_CLMUL_MIN_LEN) return l2c_crc16_slice8(crc, dst, src, len);
+
+  const __m128i k128 =
+      _mm_set_epi64x(l2c_crc_cb.fold128[1], l2c_crc_cb.fold128[0]);
+  const __m128i k512 =
+      _mm_set_epi64x(l2c_crc_cb.fold512[1], l2c_crc_cb.fold512[0]);
+
+  /* the CRC register lines up with the first two message bytes */
+  __m128i x0 = _mm_xor_si128(l2c_crc16_load(dst, src), _mm_cvtsi32_si128(crc));
+  __m128i x1 = l2c_crc16_load(dst ? dst + 16 : NULL, src + 16);
+  __m128i x2 = l2c_crc16_load(dst ? dst + 32 : NULL, src + 32);
+  __m128i x3 = l2c_crc16_load(dst ? dst + 48 : NULL, src + 48);
+  src += 64;
+  if (dst != NULL) dst += 64;
+  len -= 64;
+
+  /* four independent lanes hide the latency of the multiplier */
+  while (len >= 64) {
+    x0 = l2c_crc16_fold(x0, k512, l2c_crc16_load(dst, src));
+    x1 = l2c_crc16_fold(x1, k512, l2c_crc16_load(dst ? dst + 16 : NULL,
+                                                 src + 16));
+    x2 = l2c_crc16_fold(x2, k512, l2c_crc16_load(dst ? dst + 32 : NULL,
+                                                 src + 32));
+    x3 = l2c_crc16_fold(x3, k512, l2c_crc16_load(dst ? dst + 48 : NULL,
+                                                 src + 48));
+    src += 64;
+    if (dst != NULL) dst += 64;
+    len -= 64;
+  }
+
+  x0 = l2c_crc16_fold(x0, k128, x1);
+  x0 = l2c_crc16_fold(x0, k128, x2);
+  x0 = l2c_crc16_fold(x0, k128, x3);
+
+  while (len >= 16) {
+    x0 = l2c_crc16_fold(x0, k128, l2c_crc16_load(dst, src));
+    src += 16;
+    if (dst != NULL) dst += 16;
+    len -= 16;
+  }
+
+  /* the last block is congruent to everything folded so far */
+  uint8_t block[16];
+  _mm_storeu_si128((__m128i*)block, x0);
+  crc = l2c_crc16_slice8(0, NULL, block, sizeof(block));
+  return l2c_crc16_slice8(crc, dst, src, len);
+}
+
+/* Returns x^|n| mod P, reflected into the low 16 bits of a 64-bit lane */
+static uint64_t l2c_crc16_clmul_constant(unsigned int n) {
+  uint32_t r = 1;
+  while (n--) {
+    r <<= 1;
+    if (r & 0x10000) r ^= L2C_CRC_POLY;
+  }
+
+  uint64_t reflected = 0;
+  for (int i = 0; i < 16; i++) {
+    if (r & (1u << i)) reflected |= (uint64_t)1 << (63 - i);
+  }
+  return reflected;
+}
+
+static bool l2c_crc16_clmul_supported(void) {
+  return __builtin_cpu_supports("pclmul");
+}
+#endif
+
+/*******************************************************************************
+ *  Polynomial arithmetic for l2c_crc16_combine()
+ ******************************************************************************/
+
+/* Returns a * b mod P; x^0 is 0x8000 in the reflected representation */
+static uint16_t l2c_crc16_multmodp(uint16_t a, uint16_t b) {
+  uint16_t m = 0x8000;
+  uint16_t p = 0;
+
+  while (m != 0) {
+    if (a & m) p ^= b;
+    m >>= 1;
+    b = (b & 1) ? (b >> 1) ^ L2C_CRC_POLY_REFLECTED : b >> 1;
+  }
+  return p;
+}
+
+/* Returns x^(n * 2^k) mod P */
+static uint16_t l2c_crc16_x2nmodp(size_t n, unsigned int k) {
+  uint16_t p = 0x8000;
+
+  while (n) {
+    if (n & 1) p = l2c_crc16_multmodp(l2c_crc_cb.x2n_tab[k & 31], p);
+    n >>= 1;
+    k++;
+  }
+  return p;
+}
+
+/*******************************************************************************
+ *  Initialization
+ ******************************************************************************/
+static const char* l2c_crc16_kernel_name(tL2C_CRC_KERNEL kernel) {
+  switch (kernel) {
+    case L2C_CRC_KERNEL_BYTE:
+      return "byte";
+    case L2C_CRC_KERNEL_SLICE8:
+      return "slice8";
+    case L2C_CRC_KERNEL_CLMUL:
+      return "clmul";
+  }
+  return "unknown";
+}
+
+static tL2C_CRC_CB* l2c_crc16_init(void) {
+  tL2C_CRC_CB* p_cb = &l2c_crc_cb;
+
+  memcpy(p_cb->slice_tab[0], crctab, sizeof(crctab));
+  for (int k = 1; k < 8; k++) {
+    for (int b = 0; b < 256; b++) {
+      uint16_t c = p_cb->slice_tab[k - 1][b];
+      p_cb->slice_tab[k][b] = (c >> 8) ^ crctab[c & 0xff];
+    }
+  }
+
+  uint16_t p = 0x4000; /* x^1 */
+  for (int k = 0; k < 32; k++) {
+    p_cb->x2n_tab[k] = p;
+    p = l2c_crc16_multmodp(p, p);
+  }
+
+#if defined(L2C_CRC_CLMUL)
+  p_cb->fold128[0] = l2c_crc16_clmul_constant(128 + 63);
+  p_cb->fold128[1] = l2c_crc16_clmul_constant(128 - 1);
+  p_cb->fold512[0] = l2c_crc16_clmul_constant(512 + 63);
+  p_cb->fold512[1] = l2c_crc16_clmul_constant(512 - 1);
+
+  if (l2c_crc16_clmul_supported()) {
+    p_cb->kernel = L2C_CRC_KERNEL_CLMUL;
+    p_cb->p_fn = l2c_crc16_clmul;
+    return p_cb;
+  }
+#endif
+
+  p_cb->kernel = L2C_CRC_KERNEL_SLICE8;
+  p_cb->p_fn = l2c_crc16_slice8;
+  return p_cb;
+}
+
+/* Set up before main(), so the L2CAP threads never race to do it */
+static const tL2C_CRC_CB* const l2c_crc_cb_ready = l2c_crc16_init();
+
+/*******************************************************************************
+ *  Public API
+ ******************************************************************************/
+uint16_t l2c_crc16(uint16_t crc, const uint8_t* p, size_t len) {
+  return l2c_crc_cb_ready->p_fn(crc, NULL, p, len);
+}
+
+uint16_t l2c_crc16_copy(uint16_t crc, uint8_t* dst, const uint8_t* src,
+                        size_t len) {
+  return l2c_crc_cb_ready->p_fn(crc, dst, src, len);
+}
+
+uint16_t l2c_crc16_combine(uint16_t crc1, uint16_t crc2, size_t len2) {
+  /* feeding |len2| zero bytes multiplies the register by x^(8 * len2) */
+  return l2c_crc16_multmodp(l2c_crc16_x2nmodp(len2, 3), crc1) ^ crc2;
+}
+
+bool l2c_crc16_set_kernel(tL2C_CRC_KERNEL kernel) {
+  switch (kernel) {
+    case L2C_CRC_KERNEL_BYTE:
+      l2c_crc_cb.p_fn = l2c_crc16_byte;
+      break;
+    case L2C_CRC_KERNEL_SLICE8:
+      l2c_crc_cb.p_fn = l2c_crc16_slice8;
+      break;
+    case L2C_CRC_KERNEL_CLMUL:
+#if defined(L2C_CRC_CLMUL)
+      if (!l2c_crc16_clmul_supported()) return false;
+      l2c_crc_cb.p_fn = l2c_crc16_clmul;
+      break;
+#else
+      return false;
+#endif
+    default:
+      return false;
+  }
+
+  l2c_crc_cb.kernel = kernel;
+  return true;
+}
+
+const char* l2c_crc16_get_kernel_name(void) {
+  return l2c_crc16_kernel_name(l2c_crc_cb_ready->kernel);
+}
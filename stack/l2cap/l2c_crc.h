@@ -0,0 +1,101 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2017 Google, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+/******************************************************************************
+ *
+ *  This file contains the CRC-16 engine used for the L2CAP Frame Check
+ *  Sequence (generator x^16 + x^15 + x^2 + 1, bits processed LSB first)
+ *
+ ******************************************************************************/
+#ifndef L2C_CRC_H
+#define L2C_CRC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Implementations of the CRC. All of them produce the same results. */
+typedef enum {
+  L2C_CRC_KERNEL_BYTE,   /* one table lookup per byte */
+  L2C_CRC_KERNEL_SLICE8, /* eight table lookups per 8 bytes */
+  L2C_CRC_KERNEL_CLMUL,  /* carry-less multiply folding, x86 PCLMULQDQ */
+} tL2C_CRC_KERNEL;
+
+/*******************************************************************************
+ *
+ * Function         l2c_crc16
+ *
+ * Description      Continues the CRC |crc| over |len| bytes at |p|.
+ *
+ * Returns          The updated CRC
+ *
+ ******************************************************************************/
+extern uint16_t l2c_crc16(uint16_t crc, const uint8_t* p, size_t len);
+
+/*******************************************************************************
+ *
+ * Function         l2c_crc16_copy
+ *
+ * Description      Copies |len| bytes from |src| to |dst| and continues the
+ *                  CRC |crc| over them in the same pass. The areas must not
+ *                  overlap.
+ *
+ * Returns          The updated CRC
+ *
+ ******************************************************************************/
+extern uint16_t l2c_crc16_copy(uint16_t crc, uint8_t* dst, const uint8_t* src,
+                               size_t len);
+
+/*******************************************************************************
+ *
+ * Function         l2c_crc16_combine
+ *
+ * Description      Given |crc1|, the CRC of a block A, and |crc2|, the CRC of
+ *                  a block B of |len2| bytes started from 0, computes the CRC
+ *                  of A followed by B without reading either block.
+ *
+ * Returns          The CRC of the concatenation
+ *
+ ******************************************************************************/
+extern uint16_t l2c_crc16_combine(uint16_t crc1, uint16_t crc2, size_t len2);
+
+/*******************************************************************************
+ *
+ * Function         l2c_crc16_set_kernel
+ *
+ * Description      Selects the implementation used by l2c_crc16() and
+ *                  l2c_crc16_copy(). The fastest one the CPU supports is
+ *                  selected by default.
+ *
+ * Returns          true if |kernel| is supported and now in use
+ *
+ ******************************************************************************/
+extern bool l2c_crc16_set_kernel(tL2C_CRC_KERNEL kernel);
+
+/*******************************************************************************
+ *
+ * Function         l2c_crc16_get_kernel_name
+ *
+ * Description      Names the implementation in use, e.g. "slice8".
+ *
+ * Returns          A static string
+ *
+ ******************************************************************************/
+extern const char* l2c_crc16_get_kernel_name(void);
+
+#endif /* L2C_CRC_H */
@@ -24,6 +24,7 @@
  ******************************************************************************/
 
 #include <base/logging.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -35,6 +36,7 @@
 #include "btu.h"
 #include "hcimsgs.h"
 #include "l2c_api.h"
+#include "l2c_crc.h"
 #include "l2c_int.h"
 #include "l2cdefs.h"
 
@@ -51,38 +53,13 @@ static const char* SAR_types[] = {"Unsegmented", "Start", "End",
                                   "Continuation"};
 static const char* SUP_types[] = {"RR", "REJ", "RNR", "SREJ"};
 
-/* Look-up table for the CRC calculation */
-static const unsigned short crctab[256] = {
-    0x0000, 0xc0c1, 0xc181, 0x0140, 0xc301, 0x03c0, 0x0280, 0xc241, 0xc601,
-    0x06c0, 0x0780, 0xc741, 0x0500, 0xc5c1, 0xc481, 0x0440, 0xcc01, 0x0cc0,
-    0x0d80, 0xcd41, 0x0f00, 0xcfc1, 0xce81, 0x0e40, 0x0a00, 0xcac1, 0xcb81,
-    0x0b40, 0xc901, 0x09c0, 0x0880, 0xc841, 0xd801, 0x18c0, 0x1980, 0xd941,
-    0x1b00, 0xdbc1, 0xda81, 0x1a40, 0x1e00, 0xdec1, 0xdf81, 0x1f40, 0xdd01,
-    0x1dc0, 0x1c80, 0xdc41, 0x1400, 0xd4c1, 0xd581, 0x1540, 0xd701, 0x17c0,
-    0x1680, 0xd641, 0xd201, 0x12c0, 0x1380, 0xd341, 0x1100, 0xd1c1, 0xd081,
-    0x1040, 0xf001, 0x30c0, 0x3180, 0xf141, 0x3300, 0xf3c1, 0xf281, 0x3240,
-    0x3600, 0xf6c1, 0xf781, 0x3740, 0xf501, 0x35c0, 0x3480, 0xf441, 0x3c00,
-    0xfcc1, 0xfd81, 0x3d40, 0xff01, 0x3fc0, 0x3e80, 0xfe41, 0xfa01, 0x3ac0,
-    0x3b80, 0xfb41, 0x3900, 0xf9c1, 0xf881, 0x3840, 0x2800, 0xe8c1, 0xe981,
-    0x2940, 0xeb01, 0x2bc0, 0x2a80, 0xea41, 0xee01, 0x2ec0, 0x2f80, 0xef41,
-    0x2d00, 0xedc1, 0xec81, 0x2c40, 0xe401, 0x24c0, 0x2580, 0xe541, 0x2700,
-    0xe7c1, 0xe681, 0x2640, 0x2200, 0xe2c1, 0xe381, 0x2340, 0xe101, 0x21c0,
-    0x2080, 0xe041, 0xa001, 0x60c0, 0x6180, 0xa141, 0x6300, 0xa3c1, 0xa281,
-    0x6240, 0x6600, 0xa6c1, 0xa781, 0x6740, 0xa501, 0x65c0, 0x6480, 0xa441,
-    0x6c00, 0xacc1, 0xad81, 0x6d40, 0xaf01, 0x6fc0, 0x6e80, 0xae41, 0xaa01,
-    0x6ac0, 0x6b80, 0xab41, 0x6900, 0xa9c1, 0xa881, 0x6840, 0x7800, 0xb8c1,
-    0xb981, 0x7940, 0xbb01, 0x7bc0, 0x7a80, 0xba41, 0xbe01, 0x7ec0, 0x7f80,
-    0xbf41, 0x7d00, 0xbdc1, 0xbc81, 0x7c40, 0xb401, 0x74c0, 0x7580, 0xb541,
-    0x7700, 0xb7c1, 0xb681, 0x7640, 0x7200, 0xb2c1, 0xb381, 0x7340, 0xb101,
-    0x71c0, 0x7080, 0xb041, 0x5000, 0x90c1, 0x9181, 0x5140, 0x9301, 0x53c0,
-    0x5280, 0x9241, 0x9601, 0x56c0, 0x5780, 0x9741, 0x5500, 0x95c1, 0x9481,
-    0x5440, 0x9c01, 0x5cc0, 0x5d80, 0x9d41, 0x5f00, 0x9fc1, 0x9e81, 0x5e40,
-    0x5a00, 0x9ac1, 0x9b81, 0x5b40, 0x9901, 0x59c0, 0x5880, 0x9841, 0x8801,
-    0x48c0, 0x4980, 0x8941, 0x4b00, 0x8bc1, 0x8a81, 0x4a40, 0x4e00, 0x8ec1,
-    0x8f81, 0x4f40, 0x8d01, 0x4dc0, 0x4c80, 0x8c41, 0x4400, 0x84c1, 0x8581,
-    0x4540, 0x8701, 0x47c0, 0x4680, 0x8641, 0x8201, 0x42c0, 0x4380, 0x8341,
-    0x4100, 0x81c1, 0x8081, 0x4040,
-};
+/* Counters for the ERTM transmit path, see l2c_fcr_debug_dump() */
+static struct {
+  uint64_t frames_kept;      /* I-frames kept for retransmission */
+  uint64_t copy_bytes_saved; /* Octets that used to be copied to keep them */
+  uint64_t frames_resent;    /* I-frames rendered again for retransmission */
+  uint64_t fcs_bytes_reused; /* Payload octets whose CRC was reused */
+} l2c_fcr_tx_stats;
 
 /*******************************************************************************
  *  Static local functions
@@ -93,7 +70,12 @@ static void process_i_frame(tL2C_CCB* p_ccb, BT_HDR* p_buf, uint16_t ctrl_word,
                             bool delay_ack);
 static bool retransmit_i_frames(tL2C_CCB* p_ccb, uint8_t tx_seq);
 static void prepare_I_frame(tL2C_CCB* p_ccb, BT_HDR* p_buf,
-                            bool is_retransmission);
+                            bool is_retransmission, uint16_t payload_fcs,
+                            uint16_t payload_len);
+static BT_HDR* l2c_fcr_clone_buf_fcs(BT_HDR* p_buf, uint16_t new_offset,
+                                     uint16_t no_of_bytes,
+                                     uint16_t* p_payload_fcs);
+static void l2c_fcr_free_tx_frame(void* p_data);
 static void process_stream_frame(tL2C_CCB* p_ccb, BT_HDR* p_buf);
 static bool do_sar_reassembly(tL2C_CCB* p_ccb, BT_HDR* p_buf,
                               uint16_t ctrl_word);
@@ -102,41 +84,29 @@ static bool do_sar_reassembly(tL2C_CCB* p_ccb, BT_HDR* p_buf,
 static void l2c_fcr_collect_ack_delay(tL2C_CCB* p_ccb, uint8_t num_bufs_acked);
 #endif
 
-/*******************************************************************************
- *
- * Function         l2c_fcr_updcrc
- *
- * Description      This function computes the CRC using the look-up table.
- *
- * Returns          CRC
- *
- ******************************************************************************/
-static unsigned short l2c_fcr_updcrc(unsigned short icrc, unsigned char* icp,
-                                     int icnt) {
-  unsigned short crc = icrc;
-  unsigned char* cp = icp;
-  int cnt = icnt;
-
-  while (cnt--) {
-    crc = ((crc >> 8) & 0xff) ^ crctab[(crc & 0xff) ^ *cp++];
-  }
-
-  return (crc);
-}
-
 /*******************************************************************************
  *
  * Function         l2c_fcr_tx_get_fcs
  *
  * Description      This function computes the CRC for a frame to be TXed.
+ *                  If |payload_len| is not 0, the last |payload_len| octets
+ *                  of the frame are not read again: |payload_fcs| is their
+ *                  CRC started from 0, as computed when they were copied.
  *
  * Returns          CRC
  *
  ******************************************************************************/
-static uint16_t l2c_fcr_tx_get_fcs(BT_HDR* p_buf) {
+static uint16_t l2c_fcr_tx_get_fcs(BT_HDR* p_buf, uint16_t payload_fcs,
+                                   uint16_t payload_len) {
   uint8_t* p = ((uint8_t*)(p_buf + 1)) + p_buf->offset;
+  uint16_t fcs;
+
+  CHECK(payload_len <= p_buf->len);
+
+  fcs = l2c_crc16(L2CAP_FCR_INIT_CRC, p, p_buf->len - payload_len);
+  if (payload_len == 0) return (fcs);
 
-  return (l2c_fcr_updcrc(L2CAP_FCR_INIT_CRC, p, p_buf->len));
+  return (l2c_crc16_combine(fcs, payload_fcs, payload_len));
 }
 
 /*******************************************************************************
@@ -154,8 +124,7 @@ static uint16_t l2c_fcr_rx_get_fcs(BT_HDR* p_buf) {
   /* offset points past the L2CAP header, but the CRC check includes it */
   p -= L2CAP_PKT_OVERHEAD;
 
-  return (
-      l2c_fcr_updcrc(L2CAP_FCR_INIT_CRC, p, p_buf->len + L2CAP_PKT_OVERHEAD));
+  return (l2c_crc16(L2CAP_FCR_INIT_CRC, p, p_buf->len + L2CAP_PKT_OVERHEAD));
 }
 
 /*******************************************************************************
@@ -220,15 +189,18 @@ void l2c_fcr_cleanup(tL2C_CCB* p_ccb) {
 
   osi_free_and_reset((void**)&p_fcrb->p_rx_sdu);
 
-  fixed_queue_free(p_fcrb->waiting_for_ack_q, osi_free);
+  fixed_queue_free(p_fcrb->waiting_for_ack_q, l2c_fcr_free_tx_frame);
   p_fcrb->waiting_for_ack_q = NULL;
 
   fixed_queue_free(p_fcrb->srej_rcv_hold_q, osi_free);
   p_fcrb->srej_rcv_hold_q = NULL;
 
-  fixed_queue_free(p_fcrb->retrans_q, osi_free);
+  fixed_queue_free(p_fcrb->retrans_q, l2c_fcr_free_tx_frame);
   p_fcrb->retrans_q = NULL;
 
+  /* A partly sent SDU still belongs to xmit_hold_q, which frees it */
+  osi_free_and_reset((void**)&p_fcrb->p_tx_sdu);
+
 #if (L2CAP_ERTM_STATS == TRUE)
   if ((p_ccb->local_cid >= L2CAP_BASE_APPL_CID) &&
       (p_ccb->peer_cfg.fcr.mode == L2CAP_FCR_ERTM_MODE)) {
@@ -341,29 +313,232 @@ void l2c_fcr_cleanup(tL2C_CCB* p_ccb) {
  ******************************************************************************/
 BT_HDR* l2c_fcr_clone_buf(BT_HDR* p_buf, uint16_t new_offset,
                           uint16_t no_of_bytes) {
+  return (l2c_fcr_clone_buf_fcs(p_buf, new_offset, no_of_bytes, NULL));
+}
+
+/*******************************************************************************
+ *
+ * Function         l2c_fcr_clone_buf_fcs
+ *
+ * Description      Same as l2c_fcr_clone_buf(), but if |p_payload_fcs| is not
+ *                  NULL it also receives the CRC (started from 0) of the
+ *                  copied octets, computed in the same pass as the copy.
+ *
+ * Returns          pointer to new buffer
+ *
+ ******************************************************************************/
+static BT_HDR* l2c_fcr_clone_buf_fcs(BT_HDR* p_buf, uint16_t new_offset,
+                                     uint16_t no_of_bytes,
+                                     uint16_t* p_payload_fcs) {
   CHECK(p_buf != NULL);
   /*
    * NOTE: We allocate extra L2CAP_FCS_LEN octets, in case we need to put
    * the FCS (Frame Check Sequence) at the end of the buffer.
    */
   uint16_t buf_size = no_of_bytes + sizeof(BT_HDR) + new_offset + L2CAP_FCS_LEN;
-#if (L2CAP_ERTM_STATS == TRUE)
-  /*
-   * NOTE: If L2CAP_ERTM_STATS is enabled, we need 4 extra octets at the
-   * end for a timestamp at the end of an I-frame.
-   */
-  buf_size += sizeof(uint32_t);
-#endif
-  BT_HDR* p_buf2 = (BT_HDR*)osi_malloc(buf_size);
+  BT_HDR* p_buf2 = (BT_HDR*)osi_pool_malloc(buf_size);
 
   p_buf2->offset = new_offset;
   p_buf2->len = no_of_bytes;
-  memcpy(((uint8_t*)(p_buf2 + 1)) + p_buf2->offset,
-         ((uint8_t*)(p_buf + 1)) + p_buf->offset, no_of_bytes);
+
+  uint8_t* p_dst = ((uint8_t*)(p_buf2 + 1)) + p_buf2->offset;
+  const uint8_t* p_src = ((uint8_t*)(p_buf + 1)) + p_buf->offset;
+  if (p_payload_fcs != NULL)
+    *p_payload_fcs = l2c_crc16_copy(0, p_dst, p_src, no_of_bytes);
+  else
+    memcpy(p_dst, p_src, no_of_bytes);
 
   return (p_buf2);
 }
 
+/*******************************************************************************
+ *
+ * Function         l2c_fcr_new_tx_frame
+ *
+ * Description      This function creates the retransmission record of an
+ *                  I-frame that has just been prepared for its first
+ *                  transmission. The payload is referred to in |p_sdu|,
+ *                  starting at |payload_offset|.
+ *
+ * Returns          the new record
+ *
+ ******************************************************************************/
+static tL2C_FCR_TX_FRAME* l2c_fcr_new_tx_frame(BT_HDR* p_xmit,
+                                               tL2C_FCR_TX_SDU* p_sdu,
+                                               uint16_t payload_offset,
+                                               uint16_t payload_len,
+                                               uint16_t payload_fcs) {
+  tL2C_FCR_TX_FRAME* p_frame =
+      (tL2C_FCR_TX_FRAME*)osi_malloc(sizeof(tL2C_FCR_TX_FRAME));
+  uint8_t* p = ((uint8_t*)(p_xmit + 1)) + p_xmit->offset + L2CAP_PKT_OVERHEAD;
+
+  p_frame->p_sdu = p_sdu;
+  p_sdu->ref_count++;
+
+  p_frame->payload_offset = payload_offset;
+  p_frame->payload_len = payload_len;
+  p_frame->payload_fcs = payload_fcs;
+  p_frame->layer_specific = p_xmit->layer_specific;
+  STREAM_TO_UINT16(p_frame->ctrl_word, p);
+  p_frame->sdu_len = 0;
+  if ((p_frame->layer_specific & L2CAP_FCR_SAR_BITS) == L2CAP_FCR_START_SDU)
+    STREAM_TO_UINT16(p_frame->sdu_len, p);
+#if (L2CAP_ERTM_STATS == TRUE)
+  p_frame->timestamp = time_get_os_boottime_ms();
+#endif
+
+  return (p_frame);
+}
+
+/*******************************************************************************
+ *
+ * Function         l2c_fcr_dup_tx_frame
+ *
+ * Description      This function makes another record of the same I-frame,
+ *                  sharing its payload.
+ *
+ * Returns          the new record
+ *
+ ******************************************************************************/
+static tL2C_FCR_TX_FRAME* l2c_fcr_dup_tx_frame(
+    const tL2C_FCR_TX_FRAME* p_frame) {
+  tL2C_FCR_TX_FRAME* p_dup =
+      (tL2C_FCR_TX_FRAME*)osi_malloc(sizeof(tL2C_FCR_TX_FRAME));
+
+  *p_dup = *p_frame;
+  p_dup->p_sdu->ref_count++;
+
+  return (p_dup);
+}
+
+/*******************************************************************************
+ *
+ * Function         l2c_fcr_release_tx_sdu
+ *
+ * Description      This function frees an SDU once it is neither referred to
+ *                  by an I-frame nor still on the transmit hold queue.
+ *
+ * Returns          -
+ *
+ ******************************************************************************/
+static void l2c_fcr_release_tx_sdu(tL2C_FCR_TX_SDU* p_sdu) {
+  if ((p_sdu->ref_count != 0) || p_sdu->on_hold_q) return;
+
+  osi_free(p_sdu->p_buf);
+  osi_free(p_sdu);
+}
+
+/*******************************************************************************
+ *
+ * Function         l2c_fcr_free_tx_frame
+ *
+ * Description      This function frees an I-frame record, and its SDU with
+ *                  the last reference to it.
+ *
+ * Returns          -
+ *
+ ******************************************************************************/
+static void l2c_fcr_free_tx_frame(void* p_data) {
+  tL2C_FCR_TX_FRAME* p_frame = (tL2C_FCR_TX_FRAME*)p_data;
+
+  if (p_frame == NULL) return;
+
+  CHECK(p_frame->p_sdu->ref_count > 0);
+  p_frame->p_sdu->ref_count--;
+  l2c_fcr_release_tx_sdu(p_frame->p_sdu);
+
+  osi_free(p_frame);
+}
+
+/*******************************************************************************
+ *
+ * Function         l2c_fcr_render_tx_frame
+ *
+ * Description      This function builds a buffer holding an I-frame to be
+ *                  retransmitted: L2CAP header, control word, SDU length if
+ *                  it is a start segment, and the payload copied from the
+ *                  SDU. The FCS is left to prepare_I_frame().
+ *
+ * Returns          pointer to the new buffer
+ *
+ ******************************************************************************/
+static BT_HDR* l2c_fcr_render_tx_frame(tL2C_CCB* p_ccb,
+                                       const tL2C_FCR_TX_FRAME* p_frame) {
+  uint16_t hdr_len = L2CAP_PKT_OVERHEAD + L2CAP_FCR_OVERHEAD;
+  bool is_start =
+      (p_frame->layer_specific & L2CAP_FCR_SAR_BITS) == L2CAP_FCR_START_SDU;
+
+  if (is_start) hdr_len += L2CAP_SDU_LEN_OVERHEAD;
+
+  /* Room for the HCI header in front, and for the FCS at the end */
+  BT_HDR* p_buf = (BT_HDR*)osi_pool_malloc(
+      sizeof(BT_HDR) + HCI_DATA_PREAMBLE_SIZE + hdr_len +
+      p_frame->payload_len + L2CAP_FCS_LEN);
+
+  p_buf->event = p_ccb->local_cid;
+  p_buf->offset = HCI_DATA_PREAMBLE_SIZE;
+  p_buf->len = hdr_len + p_frame->payload_len;
+  p_buf->layer_specific = p_frame->layer_specific;
+
+  uint8_t* p = ((uint8_t*)(p_buf + 1)) + p_buf->offset;
+  UINT16_TO_STREAM(p, p_buf->len - L2CAP_PKT_OVERHEAD);
+  UINT16_TO_STREAM(p, p_ccb->remote_cid);
+  UINT16_TO_STREAM(p, p_frame->ctrl_word);
+  if (is_start) UINT16_TO_STREAM(p, p_frame->sdu_len);
+
+  const BT_HDR* p_sdu = p_frame->p_sdu->p_buf;
+  memcpy(p, ((const uint8_t*)(p_sdu + 1)) + p_frame->payload_offset,
+         p_frame->payload_len);
+
+  return (p_buf);
+}
+
+/*******************************************************************************
+ *
+ * Function         l2c_fcr_free_xmit_sdu
+ *
+ * Description      This function frees an SDU taken off the transmit hold
+ *                  queue without being sent. If segments of it are still
+ *                  kept for retransmission, it is freed with the last one.
+ *
+ * Returns          -
+ *
+ ******************************************************************************/
+void l2c_fcr_free_xmit_sdu(tL2C_CCB* p_ccb, BT_HDR* p_buf) {
+  CHECK(p_ccb != NULL);
+  tL2C_FCR_TX_SDU* p_sdu = p_ccb->fcrb.p_tx_sdu;
+
+  if ((p_sdu == NULL) || (p_sdu->p_buf != p_buf)) {
+    osi_free(p_buf);
+    return;
+  }
+
+  p_ccb->fcrb.p_tx_sdu = NULL;
+  p_sdu->on_hold_q = false;
+  l2c_fcr_release_tx_sdu(p_sdu);
+}
+
+/*******************************************************************************
+ *
+ * Function         l2c_fcr_debug_dump
+ *
+ * Description      This function writes the ERTM transmit counters to |fd|.
+ *
+ * Returns          -
+ *
+ ******************************************************************************/
+void l2c_fcr_debug_dump(int fd) {
+  dprintf(fd, "\nL2CAP ERTM Transmit Buffers:\n");
+  dprintf(fd, "  I-frames kept for retransmission: %" PRIu64 "\n",
+          l2c_fcr_tx_stats.frames_kept);
+  dprintf(fd, "  Octets not copied to keep them: %" PRIu64 "\n",
+          l2c_fcr_tx_stats.copy_bytes_saved);
+  dprintf(fd, "  I-frames retransmitted: %" PRIu64 "\n",
+          l2c_fcr_tx_stats.frames_resent);
+  dprintf(fd, "  Payload octets not checksummed again: %" PRIu64 "\n",
+          l2c_fcr_tx_stats.fcs_bytes_reused);
+}
+
 /*******************************************************************************
  *
  * Function         l2c_fcr_is_flow_controlled
@@ -401,13 +576,16 @@ bool l2c_fcr_is_flow_controlled(tL2C_CCB* p_ccb) {
  *
  * Description      This function sets the FCR variables in an I-frame that is
  *                  about to be sent to HCI for transmission. This may be the
- *                  first time the I-frame is sent, or a retransmission
+ *                  first time the I-frame is sent, or a retransmission.
+ *                  |payload_fcs| and |payload_len| are passed on to
+ *                  l2c_fcr_tx_get_fcs(); payload_len is 0 if unknown.
  *
  * Returns          -
  *
  ******************************************************************************/
 static void prepare_I_frame(tL2C_CCB* p_ccb, BT_HDR* p_buf,
-                            bool is_retransmission) {
+                            bool is_retransmission, uint16_t payload_fcs,
+                            uint16_t payload_len) {
   CHECK(p_ccb != NULL);
   CHECK(p_buf != NULL);
   tL2C_FCRB* p_fcrb = &p_ccb->fcrb;
@@ -456,7 +634,7 @@ static void prepare_I_frame(tL2C_CCB* p_ccb, BT_HDR* p_buf,
     UINT16_TO_STREAM(p, p_buf->len + L2CAP_FCS_LEN - L2CAP_PKT_OVERHEAD);
 
     /* Calculate the FCS */
-    fcs = l2c_fcr_tx_get_fcs(p_buf);
+    fcs = l2c_fcr_tx_get_fcs(p_buf, payload_fcs, payload_len);
 
     /* Point to the end of the buffer and put the FCS there */
     /*
@@ -529,7 +707,7 @@ void l2c_fcr_send_S_frame(tL2C_CCB* p_ccb, uint16_t function_code,
   ctrl_word |= (p_ccb->fcrb.next_seq_expected << L2CAP_FCR_REQ_SEQ_BITS_SHIFT);
   ctrl_word |= pf_bit;
 
-  BT_HDR* p_buf = (BT_HDR*)osi_malloc(L2CAP_CMD_BUF_SIZE);
+  BT_HDR* p_buf = (BT_HDR*)osi_pool_malloc(L2CAP_CMD_BUF_SIZE);
   p_buf->offset = HCI_DATA_PREAMBLE_SIZE;
   p_buf->len = L2CAP_PKT_OVERHEAD + L2CAP_FCR_OVERHEAD;
 
@@ -543,7 +721,7 @@ void l2c_fcr_send_S_frame(tL2C_CCB* p_ccb, uint16_t function_code,
 
   /* Compute the FCS and add to the end of the buffer if not bypassed */
   if (p_ccb->bypass_fcs != L2CAP_BYPASS_FCS) {
-    fcs = l2c_fcr_tx_get_fcs(p_buf);
+    fcs = l2c_fcr_tx_get_fcs(p_buf, 0, 0);
 
     UINT16_TO_STREAM(p, fcs);
     p_buf->len += L2CAP_FCS_LEN;
@@ -844,7 +1022,7 @@ void l2c_lcc_proc_pdu(tL2C_CCB* p_ccb, BT_HDR* p_buf) {
       return;
     }
 
-    p_data = (BT_HDR*)osi_malloc(L2CAP_MAX_BUF_SIZE);
+    p_data = (BT_HDR*)osi_pool_malloc(L2CAP_MAX_BUF_SIZE);
     if (p_data == NULL) {
       osi_free(p_buf);
       return;
@@ -1004,8 +1182,8 @@ static bool process_reqseq(tL2C_CCB* p_ccb, uint16_t ctrl_word) {
 #endif
 
     for (xx = 0; xx < num_bufs_acked; xx++) {
-      BT_HDR* p_tmp =
-          (BT_HDR*)fixed_queue_try_dequeue(p_fcrb->waiting_for_ack_q);
+      tL2C_FCR_TX_FRAME* p_tmp = (tL2C_FCR_TX_FRAME*)fixed_queue_try_dequeue(
+          p_fcrb->waiting_for_ack_q);
       if (p_tmp == NULL) {
         L2CAP_TRACE_WARNING ("%s: Unable to dequeue", __func__);
         return (FALSE);
@@ -1015,7 +1193,7 @@ static bool process_reqseq(tL2C_CCB* p_ccb, uint16_t ctrl_word) {
       if ((ls == L2CAP_FCR_UNSEG_SDU) || (ls == L2CAP_FCR_END_SDU))
         full_sdus_xmitted++;
 
-      osi_free(p_tmp);
+      l2c_fcr_free_tx_frame(p_tmp);
     }
 
     /* If we are still in a wait_ack state, do not mess with the timer */
@@ -1461,7 +1639,7 @@ static bool do_sar_reassembly(tL2C_CCB* p_ccb, BT_HDR* p_buf,
                             p_fcrb->rx_sdu_len, p_fcrb->rx_sdu_len);
         packet_ok = false;
       } else {
-        p_fcrb->p_rx_sdu = (BT_HDR*)osi_malloc(L2CAP_MAX_BUF_SIZE);
+        p_fcrb->p_rx_sdu = (BT_HDR*)osi_pool_malloc(L2CAP_MAX_BUF_SIZE);
         p_fcrb->p_rx_sdu->offset = OBX_BUF_MIN_OFFSET;
         p_fcrb->p_rx_sdu->len = 0;
       }
@@ -1529,10 +1707,8 @@ static bool do_sar_reassembly(tL2C_CCB* p_ccb, BT_HDR* p_buf,
 static bool retransmit_i_frames(tL2C_CCB* p_ccb, uint8_t tx_seq) {
   CHECK(p_ccb != NULL);
 
-  BT_HDR* p_buf = NULL;
-  uint8_t* p;
+  tL2C_FCR_TX_FRAME* p_frame = NULL;
   uint8_t buf_seq;
-  uint16_t ctrl_word;
 
   if ((!fixed_queue_is_empty(p_ccb->fcrb.waiting_for_ack_q)) &&
       (p_ccb->peer_cfg.fcr.max_transmit != 0) &&
@@ -1561,14 +1737,9 @@ static bool retransmit_i_frames(tL2C_CCB* p_ccb, uint8_t tx_seq) {
     */
     if (list_ack != NULL) {
       for (; node_ack != list_end(list_ack); node_ack = list_next(node_ack)) {
-        p_buf = (BT_HDR*)list_node(node_ack);
-        /* Get the old control word */
-        p = ((uint8_t*)(p_buf + 1)) + p_buf->offset + L2CAP_PKT_OVERHEAD;
-
-        STREAM_TO_UINT16(ctrl_word, p);
-
-        buf_seq =
-            (ctrl_word & L2CAP_FCR_TX_SEQ_BITS) >> L2CAP_FCR_TX_SEQ_BITS_SHIFT;
+        p_frame = (tL2C_FCR_TX_FRAME*)list_node(node_ack);
+        buf_seq = (p_frame->ctrl_word & L2CAP_FCR_TX_SEQ_BITS) >>
+                  L2CAP_FCR_TX_SEQ_BITS_SHIFT;
 
         L2CAP_TRACE_DEBUG(
             "retransmit_i_frames()   cur seq: %u  looking for: %u", buf_seq,
@@ -1578,7 +1749,7 @@ static bool retransmit_i_frames(tL2C_CCB* p_ccb, uint8_t tx_seq) {
       }
     }
 
-    if (!p_buf) {
+    if (!p_frame) {
       L2CAP_TRACE_ERROR("retransmit_i_frames() UNKNOWN seq: %u  q_count: %u",
                         tx_seq,
                         fixed_queue_length(p_ccb->fcrb.waiting_for_ack_q));
@@ -1601,24 +1772,21 @@ static bool retransmit_i_frames(tL2C_CCB* p_ccb, uint8_t tx_seq) {
 
     /* Also flush our retransmission queue */
     while (!fixed_queue_is_empty(p_ccb->fcrb.retrans_q))
-      osi_free(fixed_queue_try_dequeue(p_ccb->fcrb.retrans_q));
+      l2c_fcr_free_tx_frame(fixed_queue_try_dequeue(p_ccb->fcrb.retrans_q));
 
     if (list_ack != NULL) node_ack = list_begin(list_ack);
   }
 
   if (list_ack != NULL) {
     while (node_ack != list_end(list_ack)) {
-      p_buf = (BT_HDR*)list_node(node_ack);
+      p_frame = (tL2C_FCR_TX_FRAME*)list_node(node_ack);
       node_ack = list_next(node_ack);
 
-      BT_HDR* p_buf2 = l2c_fcr_clone_buf(p_buf, p_buf->offset, p_buf->len);
-      if (p_buf2) {
-        p_buf2->layer_specific = p_buf->layer_specific;
+      /* The frame is rendered again when it is dequeued for sending */
+      fixed_queue_enqueue(p_ccb->fcrb.retrans_q,
+                          l2c_fcr_dup_tx_frame(p_frame));
 
-        fixed_queue_enqueue(p_ccb->fcrb.retrans_q, p_buf2);
-      }
-
-      if ((tx_seq != L2C_FCR_RETX_ALL_PKTS) || (p_buf2 == NULL)) break;
+      if (tx_seq != L2C_FCR_RETX_ALL_PKTS) break;
     }
   }
 
@@ -1652,16 +1820,26 @@ BT_HDR* l2c_fcr_get_next_xmit_sdu_seg(tL2C_CCB* p_ccb,
   BT_HDR *p_buf, *p_xmit;
   uint8_t* p;
   uint16_t max_pdu = p_ccb->tx_mps /* Needed? - L2CAP_MAX_HEADER_FCS*/;
+  uint16_t payload_fcs = 0, payload_len = 0, payload_offset = 0;
+  uint16_t xmit_copy_len = 0; /* Octets copied that used to be sent in place */
+  bool is_ertm = (p_ccb->peer_cfg.fcr.mode == L2CAP_FCR_ERTM_MODE);
+  tL2C_FCR_TX_SDU* p_sdu = NULL;
 
   /* If there is anything in the retransmit queue, that goes first
   */
-  p_buf = (BT_HDR*)fixed_queue_try_dequeue(p_ccb->fcrb.retrans_q);
-  if (p_buf != NULL) {
+  tL2C_FCR_TX_FRAME* p_frame =
+      (tL2C_FCR_TX_FRAME*)fixed_queue_try_dequeue(p_ccb->fcrb.retrans_q);
+  if (p_frame != NULL) {
+    p_buf = l2c_fcr_render_tx_frame(p_ccb, p_frame);
+
     /* Update Rx Seq and FCS if we acked some packets while this one was queued
      */
-    prepare_I_frame(p_ccb, p_buf, true);
+    prepare_I_frame(p_ccb, p_buf, true, p_frame->payload_fcs,
+                    p_frame->payload_len);
 
-    p_buf->event = p_ccb->local_cid;
+    l2c_fcr_tx_stats.frames_resent++;
+    l2c_fcr_tx_stats.fcs_bytes_reused += p_frame->payload_len;
+    l2c_fcr_free_tx_frame(p_frame);
 
 #if (L2CAP_ERTM_STATS == TRUE)
     p_ccb->fcrb.pkts_retransmitted++;
@@ -1694,9 +1872,33 @@ BT_HDR* l2c_fcr_get_next_xmit_sdu_seg(tL2C_CCB* p_ccb,
     } else
       mid_seg = true;
 
-    /* Get a new buffer and copy the data that can be sent in a PDU */
-    p_xmit = l2c_fcr_clone_buf(p_buf, L2CAP_MIN_OFFSET + L2CAP_SDU_LEN_OFFSET,
-                               max_pdu);
+    /* In ERTM, the segments are kept for retransmission by reference to
+     * the SDU, which stays on the hold queue until its last segment */
+    if (is_ertm) {
+      if (p_ccb->fcrb.p_tx_sdu == NULL) {
+        p_sdu = (tL2C_FCR_TX_SDU*)osi_malloc(sizeof(tL2C_FCR_TX_SDU));
+        p_sdu->p_buf = p_buf;
+        p_sdu->ref_count = 0;
+        p_sdu->on_hold_q = true;
+        p_ccb->fcrb.p_tx_sdu = p_sdu;
+      }
+      p_sdu = p_ccb->fcrb.p_tx_sdu;
+      CHECK(p_sdu->p_buf == p_buf);
+      payload_offset = p_buf->offset;
+    }
+
+    /* Get a new buffer and copy the data that can be sent in a PDU. The
+     * payload CRC is taken during the copy. ERTM always needs it, as the
+     * FCS may be turned on before a retransmission. */
+    if (is_ertm || (p_ccb->bypass_fcs != L2CAP_BYPASS_FCS)) {
+      p_xmit = l2c_fcr_clone_buf_fcs(
+          p_buf, L2CAP_MIN_OFFSET + L2CAP_SDU_LEN_OFFSET, max_pdu,
+          &payload_fcs);
+      payload_len = max_pdu;
+    } else {
+      p_xmit = l2c_fcr_clone_buf(
+          p_buf, L2CAP_MIN_OFFSET + L2CAP_SDU_LEN_OFFSET, max_pdu);
+    }
 
     if (p_xmit != NULL) {
       p_buf->event = p_ccb->local_cid;
@@ -1714,6 +1916,30 @@ BT_HDR* l2c_fcr_get_next_xmit_sdu_seg(tL2C_CCB* p_ccb,
           "L2CAP - cannot get buffer for segmentation, max_pdu: %u", max_pdu);
       return (NULL);
     }
+  } else if (is_ertm) /* No segmentation, or the last segment: keep the SDU
+                          for retransmission and send a copy */
+  {
+    p_sdu = p_ccb->fcrb.p_tx_sdu;
+    if (p_sdu == NULL) {
+      p_sdu = (tL2C_FCR_TX_SDU*)osi_malloc(sizeof(tL2C_FCR_TX_SDU));
+      p_sdu->p_buf = p_buf;
+      p_sdu->ref_count = 0;
+    }
+    CHECK(p_sdu->p_buf == p_buf);
+
+    payload_offset = p_buf->offset;
+    payload_len = p_buf->len;
+    p_xmit = l2c_fcr_clone_buf_fcs(
+        p_buf, L2CAP_MIN_OFFSET + L2CAP_SDU_LEN_OFFSET, payload_len,
+        &payload_fcs);
+    xmit_copy_len = payload_len;
+    p_xmit->layer_specific = p_buf->layer_specific;
+    if (p_buf->event != 0) last_seg = true;
+    p_xmit->event = p_ccb->local_cid;
+
+    fixed_queue_try_dequeue(p_ccb->xmit_hold_q);
+    p_sdu->on_hold_q = false;
+    p_ccb->fcrb.p_tx_sdu = NULL;
   } else /* Use the original buffer if no segmentation, or the last segment */
   {
     void *seg_msg = fixed_queue_try_dequeue(p_ccb->xmit_hold_q);
@@ -1764,39 +1990,21 @@ BT_HDR* l2c_fcr_get_next_xmit_sdu_seg(tL2C_CCB* p_ccb,
   else
     p_xmit->layer_specific |= L2CAP_FCR_UNSEG_SDU;
 
-  prepare_I_frame(p_ccb, p_xmit, false);
-
-  if (p_ccb->peer_cfg.fcr.mode == L2CAP_FCR_ERTM_MODE) {
-    BT_HDR* p_wack =
-        l2c_fcr_clone_buf(p_xmit, HCI_DATA_PREAMBLE_SIZE, p_xmit->len);
-
-    if (!p_wack) {
-      L2CAP_TRACE_ERROR(
-          "L2CAP - no buffer for xmit cloning, CID: 0x%04x  Length: %u",
-          p_ccb->local_cid, p_xmit->len);
+  prepare_I_frame(p_ccb, p_xmit, false, payload_fcs, payload_len);
 
-      /* We will not save the FCS in case we reconfigure and change options */
-      if (p_ccb->bypass_fcs != L2CAP_BYPASS_FCS) p_xmit->len -= L2CAP_FCS_LEN;
+  if (is_ertm) {
+    /* Keep the header fields and a reference to the payload; the frame is
+     * rendered again if it has to be retransmitted */
+    fixed_queue_enqueue(p_ccb->fcrb.waiting_for_ack_q,
+                        l2c_fcr_new_tx_frame(p_xmit, p_sdu, payload_offset,
+                                             payload_len, payload_fcs));
 
-      /* Pretend we sent it and it got lost */
-      fixed_queue_enqueue(p_ccb->fcrb.waiting_for_ack_q, p_xmit);
-      return (NULL);
-    } else {
-#if (L2CAP_ERTM_STATS == TRUE)
-      /* set timestamp at the end of tx I-frame to get acking delay */
-      /*
-       * NOTE: Here we assume the allocate buffer is large enough
-       * to include extra 4 octets at the end.
-       */
-      p = ((uint8_t*)(p_wack + 1)) + p_wack->offset + p_wack->len;
-      UINT32_TO_STREAM(p, time_get_os_boottime_ms());
-#endif
-      /* We will not save the FCS in case we reconfigure and change options */
-      if (p_ccb->bypass_fcs != L2CAP_BYPASS_FCS) p_wack->len -= L2CAP_FCS_LEN;
+    /* The whole frame, less its FCS, used to be copied to keep it */
+    uint16_t frame_len = p_xmit->len;
+    if (p_ccb->bypass_fcs != L2CAP_BYPASS_FCS) frame_len -= L2CAP_FCS_LEN;
 
-      p_wack->layer_specific = p_xmit->layer_specific;
-      fixed_queue_enqueue(p_ccb->fcrb.waiting_for_ack_q, p_wack);
-    }
+    l2c_fcr_tx_stats.frames_kept++;
+    l2c_fcr_tx_stats.copy_bytes_saved += frame_len - xmit_copy_len;
 
 #if (L2CAP_ERTM_STATS == TRUE)
     p_ccb->fcrb.ertm_pkt_counts[0]++;
@@ -2375,9 +2583,8 @@ uint8_t l2c_fcr_process_peer_cfg_req(tL2C_CCB* p_ccb, tL2CAP_CFG_INFO* p_cfg) {
  ******************************************************************************/
 static void l2c_fcr_collect_ack_delay(tL2C_CCB* p_ccb, uint8_t num_bufs_acked) {
   uint32_t index;
-  BT_HDR* p_buf;
-  uint8_t* p;
-  uint32_t timestamp, delay;
+  tL2C_FCR_TX_FRAME* p_frame;
+  uint32_t delay;
   uint8_t xx;
   uint8_t str[120];
 
@@ -2405,19 +2612,13 @@ static void l2c_fcr_collect_ack_delay(tL2C_CCB* p_ccb, uint8_t num_bufs_acked) {
     for (const list_node_t *node = list_begin(list), xx = 0;
          (node != list_end(list)) && (xx < num_bufs_acked);
          node = list_next(node), xx++) {
-      p_buf = list_node(node);
+      p_frame = (tL2C_FCR_TX_FRAME*)list_node(node);
       /* adding up length of acked I-frames to get throughput */
-      p_ccb->fcrb.throughput[index] += p_buf->len - 8;
+      p_ccb->fcrb.throughput[index] += p_frame->payload_len;
 
       if (xx == num_bufs_acked - 1) {
         /* get timestamp from tx I-frame that receiver is acking */
-        p = ((uint8_t*)(p_buf + 1)) + p_buf->offset + p_buf->len;
-        if (p_ccb->bypass_fcs != L2CAP_BYPASS_FCS) {
-          p += L2CAP_FCS_LEN;
-        }
-
-        STREAM_TO_UINT32(timestamp, p);
-        delay = time_get_os_boottime_ms() - timestamp;
+        delay = time_get_os_boottime_ms() - p_frame->timestamp;
 
         p_ccb->fcrb.ack_delay_avg[index] += delay;
         if (delay > p_ccb->fcrb.ack_delay_max[index])
@@ -168,6 +168,29 @@ typedef enum {
 
 typedef uint8_t tL2C_BLE_FIXED_CHNLS_MASK;
 
+/* An SDU sent in ERTM. All of its segments are kept for retransmission by
+ * reference to the SDU buffer instead of as copies. */
+typedef struct {
+  BT_HDR* p_buf;      /* The SDU */
+  uint16_t ref_count; /* Number of tL2C_FCR_TX_FRAME referring to it */
+  bool on_hold_q;     /* Still being segmented: xmit_hold_q owns p_buf */
+} tL2C_FCR_TX_SDU;
+
+/* An I-frame waiting to be acknowledged or retransmitted. Its header and FCS
+ * are rendered again from these fields for every retransmission. */
+typedef struct {
+  tL2C_FCR_TX_SDU* p_sdu;  /* SDU holding the payload */
+  uint16_t payload_offset; /* Offset of the payload in the SDU data */
+  uint16_t payload_len;    /* Length of the payload */
+  uint16_t payload_fcs;    /* CRC of the payload alone, started from 0 */
+  uint16_t layer_specific; /* SAR bits and flushable flag */
+  uint16_t ctrl_word;      /* Control word as last transmitted */
+  uint16_t sdu_len;        /* SDU length, for a start segment */
+#if (L2CAP_ERTM_STATS == TRUE)
+  uint32_t timestamp; /* Time of the first transmission */
+#endif
+} tL2C_FCR_TX_FRAME;
+
 typedef struct {
   uint8_t next_tx_seq;       /* Next sequence number to be Tx'ed */
   uint8_t last_rx_ack;       /* Last sequence number ack'ed by the peer */
@@ -189,9 +212,10 @@ typedef struct {
   uint16_t rx_sdu_len; /* Length of the SDU being received */
   BT_HDR* p_rx_sdu;    /* Buffer holding the SDU being received */
   fixed_queue_t*
-      waiting_for_ack_q;          /* Buffers sent and waiting for peer to ack */
+      waiting_for_ack_q; /* tL2C_FCR_TX_FRAME sent and waiting for peer ack */
   fixed_queue_t* srej_rcv_hold_q; /* Buffers rcvd but held pending SREJ rsp */
-  fixed_queue_t* retrans_q;       /* Buffers being retransmitted */
+  fixed_queue_t* retrans_q;       /* tL2C_FCR_TX_FRAME being retransmitted */
+  tL2C_FCR_TX_SDU* p_tx_sdu;      /* SDU being segmented, if any */
 
   alarm_t* ack_timer;         /* Timer delaying RR */
   alarm_t* mon_retrans_timer; /* Timer Monitor or Retransmission */
@@ -764,6 +788,8 @@ extern void l2c_fcr_send_S_frame(tL2C_CCB* p_ccb, uint16_t function_code,
                                  uint16_t pf_bit);
 extern BT_HDR* l2c_fcr_clone_buf(BT_HDR* p_buf, uint16_t new_offset,
                                  uint16_t no_of_bytes);
+extern void l2c_fcr_free_xmit_sdu(tL2C_CCB* p_ccb, BT_HDR* p_buf);
+extern void l2c_fcr_debug_dump(int fd);
 extern bool l2c_fcr_is_flow_controlled(tL2C_CCB* p_ccb);
 extern BT_HDR* l2c_fcr_get_next_xmit_sdu_seg(tL2C_CCB* p_ccb,
                                              uint16_t max_packet_length);
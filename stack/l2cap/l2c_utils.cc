@@ -333,7 +333,7 @@ bool l2c_is_cmd_rejected(uint8_t cmd_code, uint8_t id, tL2C_LCB* p_lcb) {
  ******************************************************************************/
 BT_HDR* l2cu_build_header(tL2C_LCB* p_lcb, uint16_t len, uint8_t cmd,
                           uint8_t id) {
-  BT_HDR* p_buf = (BT_HDR*)osi_malloc(L2CAP_CMD_BUF_SIZE);
+  BT_HDR* p_buf = (BT_HDR*)osi_pool_malloc(L2CAP_CMD_BUF_SIZE);
   uint8_t* p;
 
   p_buf->offset = L2CAP_SEND_CMD_OFFSET;
@@ -760,7 +760,7 @@ void l2cu_send_peer_config_rej(tL2C_CCB* p_ccb, uint8_t* p_data,
     return;
   }
 
-  BT_HDR* p_buf = (BT_HDR*)osi_malloc(len + rej_len);
+  BT_HDR* p_buf = (BT_HDR*)osi_pool_malloc(len + rej_len);
   p_buf->offset = L2CAP_SEND_CMD_OFFSET;
   p = (uint8_t*)(p_buf + 1) + L2CAP_SEND_CMD_OFFSET;
 
@@ -25,6 +25,7 @@
 #define LOG_TAG "bt_port_api"
 
 #include <string.h>
+#include <sys/uio.h>
 
 #include "osi/include/log.h"
 #include "osi/include/mutex.h"
@@ -1474,9 +1475,7 @@ int PORT_WriteDataCO(uint16_t handle, int* p_len) {
 
   mutex_global_unlock();
 
-  // int max_read = length < p_port->peer_mtu ? length : p_port->peer_mtu;
-
-  // max_read = available < max_read ? available : max_read;
+  if (p_port->peer_mtu < length) length = p_port->peer_mtu;
 
   while (available) {
     /* if we're over buffer high water mark, we're done */
@@ -1491,41 +1490,77 @@ int PORT_WriteDataCO(uint16_t handle, int* p_len) {
       break;
     }
 
-    /* continue with rfcomm data write */
-    p_buf = (BT_HDR*)osi_malloc(RFCOMM_DATA_BUF_SIZE);
-    p_buf->offset = L2CAP_MIN_OFFSET + RFCOMM_MIN_OFFSET;
-    p_buf->layer_specific = handle;
+    /* A server port that is not open refuses data: leave it in the socket */
+    if (p_port->is_server && (p_port->rfc.state != RFC_STATE_OPENED)) {
+      rc = PORT_CLOSED;
+      break;
+    }
 
-    if (p_port->peer_mtu < length) length = p_port->peer_mtu;
-    if (available < (int)length) length = (uint16_t)available;
-    p_buf->len = length;
-    p_buf->event = BT_EVT_TO_BTU_SP_DATA;
+    /* Read as many buffers in one call as the queue can take before going
+     * over the high water marks, should they all end up queued. Staying
+     * under the critical water marks too, port_write() takes every buffer
+     * read, so no data read from the socket is dropped. */
+    BT_HDR* bufs[PORT_TX_BUF_HIGH_WM + 1];
+    struct iovec iov[PORT_TX_BUF_HIGH_WM + 1];
+    int max_bufs = PORT_TX_BUF_HIGH_WM + 1;
+    int max_bytes = PORT_TX_HIGH_WM;
+    int num_bufs = 0;
+    int read_len = 0;
+
+    if (PORT_TX_BUF_CRITICAL_WM < PORT_TX_BUF_HIGH_WM)
+      max_bufs = PORT_TX_BUF_CRITICAL_WM + 1;
+    if (PORT_TX_CRITICAL_WM < PORT_TX_HIGH_WM) max_bytes = PORT_TX_CRITICAL_WM;
+    max_bufs -= (int)fixed_queue_length(p_port->tx.queue);
+    max_bytes -= (int)p_port->tx.queue_size;
+
+    while (num_bufs < max_bufs && read_len <= max_bytes &&
+           read_len < available) {
+      uint16_t buf_len = length;
+      if (available - read_len < (int)buf_len)
+        buf_len = (uint16_t)(available - read_len);
+
+      p_buf = (BT_HDR*)osi_pool_malloc(RFCOMM_DATA_BUF_SIZE);
+      p_buf->offset = L2CAP_MIN_OFFSET + RFCOMM_MIN_OFFSET;
+      p_buf->layer_specific = handle;
+      p_buf->len = buf_len;
+      p_buf->event = BT_EVT_TO_BTU_SP_DATA;
+
+      iov[num_bufs].iov_base = (uint8_t*)(p_buf + 1) + p_buf->offset;
+      iov[num_bufs].iov_len = buf_len;
+      bufs[num_bufs++] = p_buf;
+      read_len += buf_len;
+    }
 
-    // memcpy ((uint8_t *)(p_buf + 1) + p_buf->offset, p_data, length);
-    // if(recv(fd, (uint8_t *)(p_buf + 1) + p_buf->offset, (int)length, 0) !=
-    // (int)length)
-    if (p_port->p_data_co_callback(
-            handle, (uint8_t*)(p_buf + 1) + p_buf->offset, length,
-            DATA_CO_CALLBACK_TYPE_OUTGOING) == false) {
+    if (p_port->p_data_co_callback(handle, (uint8_t*)iov, num_bufs,
+                                   DATA_CO_CALLBACK_TYPE_OUTGOING_VEC) ==
+        false) {
       error(
-          "p_data_co_callback DATA_CO_CALLBACK_TYPE_OUTGOING failed, length:%d",
-          length);
+          "p_data_co_callback DATA_CO_CALLBACK_TYPE_OUTGOING_VEC failed, "
+          "length:%d",
+          read_len);
+      for (int i = 0; i < num_bufs; i++) osi_free(bufs[i]);
       return (PORT_UNKNOWN_ERROR);
     }
 
-    RFCOMM_TRACE_EVENT("PORT_WriteData %d bytes", length);
+    for (int i = 0; i < num_bufs; i++) {
+      uint16_t buf_len = bufs[i]->len;
 
-    rc = port_write(p_port, p_buf);
+      RFCOMM_TRACE_EVENT("PORT_WriteData %d bytes", buf_len);
 
-    /* If queue went below the threashold need to send flow control */
-    event |= port_flow_control_user(p_port);
+      rc = port_write(p_port, bufs[i]);
 
-    if (rc == PORT_SUCCESS) event |= PORT_EV_TXCHAR;
+      /* If queue went below the threashold need to send flow control */
+      event |= port_flow_control_user(p_port);
 
-    if ((rc != PORT_SUCCESS) && (rc != PORT_CMD_PENDING)) break;
+      if (rc == PORT_SUCCESS) event |= PORT_EV_TXCHAR;
 
-    *p_len += length;
-    available -= (int)length;
+      if ((rc != PORT_SUCCESS) && (rc != PORT_CMD_PENDING)) continue;
+
+      *p_len += buf_len;
+      available -= (int)buf_len;
+    }
+
+    if ((rc != PORT_SUCCESS) && (rc != PORT_CMD_PENDING)) break;
   }
   if (!available && (rc != PORT_CMD_PENDING) && (rc != PORT_TX_QUEUE_DISABLED))
     event |= PORT_EV_TXEMPTY;
@@ -1612,7 +1647,7 @@ int PORT_WriteData(uint16_t handle, const char* p_data, uint16_t max_len,
       break;
 
     /* continue with rfcomm data write */
-    p_buf = (BT_HDR*)osi_malloc(RFCOMM_DATA_BUF_SIZE);
+    p_buf = (BT_HDR*)osi_pool_malloc(RFCOMM_DATA_BUF_SIZE);
     p_buf->offset = L2CAP_MIN_OFFSET + RFCOMM_MIN_OFFSET;
     p_buf->layer_specific = handle;
 
@@ -1679,7 +1714,7 @@ int PORT_Test(uint16_t handle, uint8_t* p_data, uint16_t len) {
     return (PORT_UNKNOWN_ERROR);
   }
 
-  BT_HDR* p_buf = (BT_HDR*)osi_malloc(RFCOMM_CMD_BUF_SIZE);
+  BT_HDR* p_buf = (BT_HDR*)osi_pool_malloc(RFCOMM_CMD_BUF_SIZE);
   p_buf->offset = L2CAP_MIN_OFFSET + RFCOMM_MIN_OFFSET + 2;
   p_buf->len = len;
 
@@ -41,7 +41,7 @@
 void rfc_send_sabme(tRFC_MCB* p_mcb, uint8_t dlci) {
   uint8_t* p_data;
   uint8_t cr = RFCOMM_CR(p_mcb->is_initiator, true);
-  BT_HDR* p_buf = (BT_HDR*)osi_malloc(RFCOMM_CMD_BUF_SIZE);
+  BT_HDR* p_buf = (BT_HDR*)osi_pool_malloc(RFCOMM_CMD_BUF_SIZE);
 
   p_buf->offset = L2CAP_MIN_OFFSET;
   p_data = (uint8_t*)(p_buf + 1) + L2CAP_MIN_OFFSET;
@@ -69,7 +69,7 @@ void rfc_send_sabme(tRFC_MCB* p_mcb, uint8_t dlci) {
 void rfc_send_ua(tRFC_MCB* p_mcb, uint8_t dlci) {
   uint8_t* p_data;
   uint8_t cr = RFCOMM_CR(p_mcb->is_initiator, false);
-  BT_HDR* p_buf = (BT_HDR*)osi_malloc(RFCOMM_CMD_BUF_SIZE);
+  BT_HDR* p_buf = (BT_HDR*)osi_pool_malloc(RFCOMM_CMD_BUF_SIZE);
 
   p_buf->offset = L2CAP_MIN_OFFSET;
   p_data = (uint8_t*)(p_buf + 1) + L2CAP_MIN_OFFSET;
@@ -96,7 +96,7 @@ void rfc_send_ua(tRFC_MCB* p_mcb, uint8_t dlci) {
 void rfc_send_dm(tRFC_MCB* p_mcb, uint8_t dlci, bool pf) {
   uint8_t* p_data;
   uint8_t cr = RFCOMM_CR(p_mcb->is_initiator, false);
-  BT_HDR* p_buf = (BT_HDR*)osi_malloc(RFCOMM_CMD_BUF_SIZE);
+  BT_HDR* p_buf = (BT_HDR*)osi_pool_malloc(RFCOMM_CMD_BUF_SIZE);
 
   p_buf->offset = L2CAP_MIN_OFFSET;
   p_data = (uint8_t*)(p_buf + 1) + L2CAP_MIN_OFFSET;
@@ -123,7 +123,7 @@ void rfc_send_dm(tRFC_MCB* p_mcb, uint8_t dlci, bool pf) {
 void rfc_send_disc(tRFC_MCB* p_mcb, uint8_t dlci) {
   uint8_t* p_data;
   uint8_t cr = RFCOMM_CR(p_mcb->is_initiator, true);
-  BT_HDR* p_buf = (BT_HDR*)osi_malloc(RFCOMM_CMD_BUF_SIZE);
+  BT_HDR* p_buf = (BT_HDR*)osi_pool_malloc(RFCOMM_CMD_BUF_SIZE);
 
   p_buf->offset = L2CAP_MIN_OFFSET;
   p_data = (uint8_t*)(p_buf + 1) + L2CAP_MIN_OFFSET;
@@ -202,7 +202,7 @@ void rfc_send_buf_uih(tRFC_MCB* p_mcb, uint8_t dlci, BT_HDR* p_buf) {
 void rfc_send_pn(tRFC_MCB* p_mcb, uint8_t dlci, bool is_command, uint16_t mtu,
                  uint8_t cl, uint8_t k) {
   uint8_t* p_data;
-  BT_HDR* p_buf = (BT_HDR*)osi_malloc(RFCOMM_CMD_BUF_SIZE);
+  BT_HDR* p_buf = (BT_HDR*)osi_pool_malloc(RFCOMM_CMD_BUF_SIZE);
 
   p_buf->offset = L2CAP_MIN_OFFSET + RFCOMM_CTRL_FRAME_LEN;
   p_data = (uint8_t*)(p_buf + 1) + p_buf->offset;
@@ -244,7 +244,7 @@ void rfc_send_pn(tRFC_MCB* p_mcb, uint8_t dlci, bool is_command, uint16_t mtu,
  ******************************************************************************/
 void rfc_send_fcon(tRFC_MCB* p_mcb, bool is_command) {
   uint8_t* p_data;
-  BT_HDR* p_buf = (BT_HDR*)osi_malloc(RFCOMM_CMD_BUF_SIZE);
+  BT_HDR* p_buf = (BT_HDR*)osi_pool_malloc(RFCOMM_CMD_BUF_SIZE);
 
   p_buf->offset = L2CAP_MIN_OFFSET + RFCOMM_CTRL_FRAME_LEN;
   p_data = (uint8_t*)(p_buf + 1) + p_buf->offset;
@@ -267,7 +267,7 @@ void rfc_send_fcon(tRFC_MCB* p_mcb, bool is_command) {
  ******************************************************************************/
 void rfc_send_fcoff(tRFC_MCB* p_mcb, bool is_command) {
   uint8_t* p_data;
-  BT_HDR* p_buf = (BT_HDR*)osi_malloc(RFCOMM_CMD_BUF_SIZE);
+  BT_HDR* p_buf = (BT_HDR*)osi_pool_malloc(RFCOMM_CMD_BUF_SIZE);
 
   p_buf->offset = L2CAP_MIN_OFFSET + RFCOMM_CTRL_FRAME_LEN;
   p_data = (uint8_t*)(p_buf + 1) + p_buf->offset;
@@ -294,7 +294,7 @@ void rfc_send_msc(tRFC_MCB* p_mcb, uint8_t dlci, bool is_command,
   uint8_t signals;
   uint8_t break_duration;
   uint8_t len;
-  BT_HDR* p_buf = (BT_HDR*)osi_malloc(RFCOMM_CMD_BUF_SIZE);
+  BT_HDR* p_buf = (BT_HDR*)osi_pool_malloc(RFCOMM_CMD_BUF_SIZE);
 
   signals = p_pars->modem_signal;
   break_duration = p_pars->break_signal;
@@ -338,7 +338,7 @@ void rfc_send_msc(tRFC_MCB* p_mcb, uint8_t dlci, bool is_command,
 void rfc_send_rls(tRFC_MCB* p_mcb, uint8_t dlci, bool is_command,
                   uint8_t status) {
   uint8_t* p_data;
-  BT_HDR* p_buf = (BT_HDR*)osi_malloc(RFCOMM_CMD_BUF_SIZE);
+  BT_HDR* p_buf = (BT_HDR*)osi_pool_malloc(RFCOMM_CMD_BUF_SIZE);
 
   p_buf->offset = L2CAP_MIN_OFFSET + RFCOMM_CTRL_FRAME_LEN;
   p_data = (uint8_t*)(p_buf + 1) + p_buf->offset;
@@ -364,7 +364,7 @@ void rfc_send_rls(tRFC_MCB* p_mcb, uint8_t dlci, bool is_command,
  ******************************************************************************/
 void rfc_send_nsc(tRFC_MCB* p_mcb) {
   uint8_t* p_data;
-  BT_HDR* p_buf = (BT_HDR*)osi_malloc(RFCOMM_CMD_BUF_SIZE);
+  BT_HDR* p_buf = (BT_HDR*)osi_pool_malloc(RFCOMM_CMD_BUF_SIZE);
 
   p_buf->offset = L2CAP_MIN_OFFSET + RFCOMM_CTRL_FRAME_LEN;
   p_data = (uint8_t*)(p_buf + 1) + p_buf->offset;
@@ -392,7 +392,7 @@ void rfc_send_nsc(tRFC_MCB* p_mcb) {
 void rfc_send_rpn(tRFC_MCB* p_mcb, uint8_t dlci, bool is_command,
                   tPORT_STATE* p_pars, uint16_t mask) {
   uint8_t* p_data;
-  BT_HDR* p_buf = (BT_HDR*)osi_malloc(RFCOMM_CMD_BUF_SIZE);
+  BT_HDR* p_buf = (BT_HDR*)osi_pool_malloc(RFCOMM_CMD_BUF_SIZE);
 
   p_buf->offset = L2CAP_MIN_OFFSET + RFCOMM_CTRL_FRAME_LEN;
   p_data = (uint8_t*)(p_buf + 1) + p_buf->offset;
@@ -439,8 +439,9 @@ void rfc_send_test(tRFC_MCB* p_mcb, bool is_command, BT_HDR* p_buf) {
   if (p_buf->offset < (L2CAP_MIN_OFFSET + RFCOMM_MIN_OFFSET + 2)) {
     uint8_t* p_src = (uint8_t*)(p_buf + 1) + p_buf->offset + p_buf->len - 1;
     BT_HDR* p_new_buf =
-        (BT_HDR*)osi_malloc(p_buf->len + (L2CAP_MIN_OFFSET + RFCOMM_MIN_OFFSET +
-                                          2 + sizeof(BT_HDR) + 1));
+        (BT_HDR*)osi_pool_malloc(p_buf->len + (L2CAP_MIN_OFFSET +
+                                               RFCOMM_MIN_OFFSET + 2 +
+                                               sizeof(BT_HDR) + 1));
 
     p_new_buf->offset = L2CAP_MIN_OFFSET + RFCOMM_MIN_OFFSET + 2;
     p_new_buf->len = p_buf->len;
@@ -476,7 +477,7 @@ void rfc_send_test(tRFC_MCB* p_mcb, bool is_command, BT_HDR* p_buf) {
 void rfc_send_credit(tRFC_MCB* p_mcb, uint8_t dlci, uint8_t credit) {
   uint8_t* p_data;
   uint8_t cr = RFCOMM_CR(p_mcb->is_initiator, true);
-  BT_HDR* p_buf = (BT_HDR*)osi_malloc(RFCOMM_CMD_BUF_SIZE);
+  BT_HDR* p_buf = (BT_HDR*)osi_pool_malloc(RFCOMM_CMD_BUF_SIZE);
 
   p_buf->offset = L2CAP_MIN_OFFSET;
   p_data = (uint8_t*)(p_buf + 1) + p_buf->offset;
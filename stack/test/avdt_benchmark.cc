@@ -0,0 +1,130 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2017 Google, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <benchmark/benchmark.h>
+
+#include <string.h>
+
+#include "a2dp_constants.h"
+#include "avdt_api.h"
+#include "avdt_int.h"
+#include "bt_types.h"
+#include "l2cdefs.h"
+#include "osi/include/allocator.h"
+#include "osi/include/osi.h"
+
+#define MEDIA_LCID 0x0040
+#define MEDIA_PAYLOAD_LEN 600
+
+static uint64_t packets_received;
+static uint64_t packets_sent;
+
+// Counts the packet; it is reused, so it is not freed here.
+static void sink_data_cback(UNUSED_ATTR uint8_t handle,
+                            UNUSED_ATTR BT_HDR* p_pkt,
+                            UNUSED_ATTR uint32_t time_stamp,
+                            UNUSED_ATTR uint8_t m_pt) {
+  packets_received++;
+}
+
+static void ctrl_cback(UNUSED_ATTR uint8_t handle, UNUSED_ATTR BD_ADDR bd_addr,
+                       uint8_t event, UNUSED_ATTR tAVDT_CTRL* p_data) {
+  if (event == AVDT_WRITE_CFM_EVT) packets_sent++;
+}
+
+// Sets up one SBC stream in the streaming state, with its media channel
+// open, and returns the channel. The benchmarks stand in for L2CAP: received
+// packets are handed to the AVDTP adaption layer, and sent ones go to a
+// channel L2CAP does not know, which drops them.
+static tAVDT_TC_TBL* setup_stream(void) {
+  memset(&avdt_cb, 0, sizeof(avdt_cb));
+  avdt_cb.trace_level = BT_TRACE_LEVEL_NONE;
+  avdt_scb_init();
+  avdt_ad_init();
+
+  tAVDT_SCB* p_scb = &avdt_cb.scb[0];
+  p_scb->allocated = true;
+  p_scb->state = AVDT_SCB_STREAM_ST;
+  p_scb->p_ccb = &avdt_cb.ccb[0];
+  p_scb->cs.p_sink_data_cback = sink_data_cback;
+  p_scb->cs.p_ctrl_cback = ctrl_cback;
+  p_scb->curr_cfg.codec_info[AVDT_CODEC_TYPE_INDEX] = A2DP_MEDIA_CT_SBC;
+  p_scb->use_rtp_header = true;
+
+  uint8_t tcid = avdt_ad_type_to_tcid(AVDT_CHAN_MEDIA, p_scb);
+  tAVDT_TC_TBL* p_tbl = &avdt_cb.ad.tc_tbl[1];
+  p_tbl->tcid = tcid;
+  p_tbl->ccb_idx = 0;
+  p_tbl->lcid = MEDIA_LCID;
+  p_tbl->state = AVDT_AD_ST_OPEN;
+  avdt_cb.ad.lcid_tbl[MEDIA_LCID - L2CAP_BASE_APPL_CID] = 1;
+  avdt_cb.ad.rt_tbl[0][tcid].scb_hdl = avdt_scb_to_hdl(p_scb);
+  avdt_cb.ad.rt_tbl[0][tcid].lcid = MEDIA_LCID;
+  return p_tbl;
+}
+
+// Receives media packets with an RTP header on a streaming SCB.
+static void BM_AvdtMediaDataInd(benchmark::State& state) {
+  tAVDT_TC_TBL* p_tbl = setup_stream();
+
+  BT_HDR* p_buf = (BT_HDR*)osi_calloc(sizeof(BT_HDR) + AVDT_MEDIA_HDR_SIZE +
+                                      MEDIA_PAYLOAD_LEN);
+  uint8_t* p = (uint8_t*)(p_buf + 1);
+  UINT8_TO_BE_STREAM(p, AVDT_MEDIA_OCTET1);
+  UINT8_TO_BE_STREAM(p, 0x60);
+  UINT16_TO_BE_STREAM(p, 1);
+  UINT32_TO_BE_STREAM(p, 0x1000);
+  UINT32_TO_BE_STREAM(p, 0x1234);
+
+  packets_received = 0;
+  while (state.KeepRunning()) {
+    // The data indication moves the offset past the RTP header.
+    p_buf->offset = 0;
+    p_buf->len = AVDT_MEDIA_HDR_SIZE + MEDIA_PAYLOAD_LEN;
+    avdt_ad_tc_data_ind(p_tbl, p_buf);
+  }
+  osi_free(p_buf);
+
+  if (packets_received != (uint64_t)state.iterations())
+    state.SkipWithError("media packet dropped");
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Sends media packets on a streaming SCB, adding the RTP header.
+static void BM_AvdtMediaWriteReq(benchmark::State& state) {
+  setup_stream();
+
+  packets_sent = 0;
+  uint32_t time_stamp = 0;
+  while (state.KeepRunning()) {
+    BT_HDR* p_buf = (BT_HDR*)osi_malloc(sizeof(BT_HDR) + AVDT_MEDIA_OFFSET +
+                                        MEDIA_PAYLOAD_LEN);
+    p_buf->offset = AVDT_MEDIA_OFFSET;
+    p_buf->len = MEDIA_PAYLOAD_LEN;
+    AVDT_WriteReqOpt(1, p_buf, time_stamp++, 0x60, AVDT_DATA_OPT_NONE);
+  }
+
+  if (packets_sent != (uint64_t)state.iterations())
+    state.SkipWithError("media packet not sent");
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_AvdtMediaDataInd);
+BENCHMARK(BM_AvdtMediaWriteReq);
+
+BENCHMARK_MAIN();
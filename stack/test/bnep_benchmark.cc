@@ -0,0 +1,145 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2017 Google, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <benchmark/benchmark.h>
+
+#include <string.h>
+
+#include "bnep_int.h"
+#include "bt_types.h"
+#include "osi/include/allocator.h"
+#include "osi/include/osi.h"
+
+#define RX_CID 0x0040
+#define TX_CID 0x0041
+#define ETH_PAYLOAD_LEN 1400
+
+/* IPv4, ARP and IPv6 */
+static const uint16_t protocols[] = {0x0800, 0x0806, 0x86DD};
+
+static uint64_t frames_forwarded;
+
+// Forwards each received frame to the second connection the way a NAP does,
+// which is where the peer's filters apply. The frames are reused, so they
+// are not freed here.
+static void forward_data_buf(UNUSED_ATTR uint16_t handle,
+                             UNUSED_ATTR uint8_t* p_src, uint8_t* p_dst,
+                             uint16_t protocol, BT_HDR* p_buf,
+                             bool fw_ext_present) {
+  uint8_t* p_data = (uint8_t*)(p_buf + 1) + p_buf->offset;
+  if (bnep_is_packet_allowed(&bnep_cb.bcb[1], p_dst, protocol, fw_ext_present,
+                             p_data) == BNEP_SUCCESS)
+    frames_forwarded++;
+}
+
+static void open_connection(tBNEP_CONN* p_bcb, uint16_t cid) {
+  memset(p_bcb, 0, sizeof(*p_bcb));
+  p_bcb->con_state = BNEP_STATE_CONNECTED;
+  p_bcb->l2cap_cid = cid;
+  p_bcb->handle = (uint16_t)(p_bcb - bnep_cb.bcb) + 1;
+}
+
+// Sets up a connection frames are received on and one they are forwarded
+// to, which has |num_filters| protocol and multicast filters of its peer.
+// The benchmark stands in for L2CAP and calls BNEP's data indication itself.
+static void setup_connections(uint16_t num_filters) {
+  memset(&bnep_cb, 0, sizeof(bnep_cb));
+  bnep_cb.trace_level = BT_TRACE_LEVEL_NONE;
+  bnep_register_with_l2cap();
+  bnep_cb.p_data_buf_cb = forward_data_buf;
+
+  open_connection(&bnep_cb.bcb[0], RX_CID);
+  tBNEP_CONN* p_bcb = &bnep_cb.bcb[1];
+  open_connection(p_bcb, TX_CID);
+
+  // The range the frames fall in is sent last, after ranges above it, so
+  // that the peer's order does not favor a scan from the start.
+  uint8_t filters[BNEP_MAX_MULTI_FILTERS * 2 * BD_ADDR_LEN];
+  uint8_t* p = filters;
+  for (uint16_t i = 0; i < num_filters; i++) {
+    uint16_t start = 0xF000 - i * 0x1000;
+    if (i == num_filters - 1) start = 0x0800;
+    UINT16_TO_BE_STREAM(p, start);
+    UINT16_TO_BE_STREAM(p, i == num_filters - 1 ? 0x88FF : start + 0x0FFF);
+  }
+  if (num_filters) bnepu_process_peer_filter_set(p_bcb, filters, p - filters);
+
+  p = filters;
+  for (uint16_t i = 0; i < num_filters; i++) {
+    uint8_t start[BD_ADDR_LEN] = {0x01, 0x00, 0x5E, 0, 0, 0};
+    start[3] = (uint8_t)(0xF0 - i * 0x10);
+    if (i == num_filters - 1) start[3] = 0;
+    memcpy(p, start, BD_ADDR_LEN);
+    p += BD_ADDR_LEN;
+    start[3] |= 0x0F;
+    memcpy(p, start, BD_ADDR_LEN);
+    p += BD_ADDR_LEN;
+  }
+  if (num_filters)
+    bnepu_process_peer_multicast_filter_set(p_bcb, filters, p - filters);
+}
+
+// Builds a general Ethernet frame to a multicast address, as mDNS and
+// neighbour discovery traffic arrives.
+static BT_HDR* make_frame(uint16_t protocol) {
+  BT_HDR* p_buf = (BT_HDR*)osi_calloc(sizeof(BT_HDR) + 1 + 14 +
+                                      ETH_PAYLOAD_LEN);
+  uint8_t* p = (uint8_t*)(p_buf + 1);
+  static const uint8_t dst[BD_ADDR_LEN] = {0x01, 0x00, 0x5E, 0x00, 0x00, 0xFB};
+  static const uint8_t src[BD_ADDR_LEN] = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55};
+
+  UINT8_TO_STREAM(p, BNEP_FRAME_GENERAL_ETHERNET);
+  memcpy(p, dst, BD_ADDR_LEN);
+  p += BD_ADDR_LEN;
+  memcpy(p, src, BD_ADDR_LEN);
+  p += BD_ADDR_LEN;
+  UINT16_TO_BE_STREAM(p, protocol);
+  p_buf->len = 1 + 14 + ETH_PAYLOAD_LEN;
+  return p_buf;
+}
+
+// Receives frames on one connection and filters them for the other. Arg:
+// number of protocol and multicast filter ranges set by the peer.
+static void BM_BnepDataIndFiltered(benchmark::State& state) {
+  const uint16_t num_filters = state.range(0);
+  const size_t num_frames = sizeof(protocols) / sizeof(protocols[0]);
+  setup_connections(num_filters);
+
+  BT_HDR* frames[num_frames];
+  for (size_t i = 0; i < num_frames; i++) frames[i] = make_frame(protocols[i]);
+
+  frames_forwarded = 0;
+  size_t next = 0;
+  while (state.KeepRunning()) {
+    // bnep_data_ind() moves the offset past the headers it consumed.
+    BT_HDR* p_buf = frames[next++ % num_frames];
+    p_buf->offset = 0;
+    p_buf->len = 1 + 14 + ETH_PAYLOAD_LEN;
+    bnep_cb.reg_info.pL2CA_DataInd_Cb(RX_CID, p_buf);
+  }
+
+  for (BT_HDR* p_buf : frames) osi_free(p_buf);
+  if (frames_forwarded != (uint64_t)state.iterations())
+    state.SkipWithError("frame filtered out");
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(state.iterations() * ETH_PAYLOAD_LEN);
+}
+
+BENCHMARK(BM_BnepDataIndFiltered)->Arg(0)->Arg(BNEP_MAX_PROT_FILTERS);
+
+BENCHMARK_MAIN();
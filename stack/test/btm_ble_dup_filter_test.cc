@@ -0,0 +1,192 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2017 Google, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include <vector>
+
+#include "bt_types.h"
+#include "btm_ble_api.h"
+#include "btm_ble_int.h"
+#include "btm_int.h"
+#include "hcidefs.h"
+#include "osi/include/allocator.h"
+#include "osi/include/list.h"
+
+#define ADV_NONCONN_IND 0x03
+
+static size_t observed_count;
+
+static void observe_results_cb(tBTM_INQ_RESULTS* p_inq_results,
+                               uint8_t* p_eir, uint16_t eir_len) {
+  observed_count++;
+}
+
+class BtmBleDupFilterTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    btm_inq_db_cleanup();
+    memset(&btm_cb, 0, sizeof(btm_cb));
+    btm_inq_db_init();
+    btm_cb.sec_dev_rec = list_new(osi_free);
+    btm_cb.ble_ctr_cb.scan_activity = BTM_LE_OBSERVE_ACTIVE;
+    btm_cb.ble_ctr_cb.inq_var.scan_type = BTM_BLE_SCAN_MODE_PASS;
+    btm_cb.ble_ctr_cb.p_obs_results_cb = observe_results_cb;
+    observed_count = 0;
+  }
+
+  void TearDown() override {
+    list_free(btm_cb.sec_dev_rec);
+    btm_cb.sec_dev_rec = NULL;
+    btm_inq_db_cleanup();
+  }
+
+  // Turns on the duplicate filter of the observe scan.
+  void SetObserveFilter(bool enable, uint8_t rssi_threshold) {
+    tBTM_BLE_DUP_FILTER_PARAMS params;
+    params.enable = enable;
+    params.rssi_threshold = rssi_threshold;
+    params.window_ms = 0;
+    ASSERT_EQ(BTM_SUCCESS,
+              BTM_BleSetDupFilter(BTM_BLE_DUP_FILTER_OBSERVE, &params));
+  }
+
+  // Hands a legacy non-connectable advertising report from advertiser
+  // |index| (a public address) to BTM.
+  void Report(uint32_t index, uint8_t data, int8_t rssi) {
+    uint8_t adv_data[] = {0x02, HCI_EIR_MANUFACTURER_SPECIFIC_TYPE, data};
+    std::vector<uint8_t> event;
+
+    event.push_back(1); /* num_reports */
+    event.push_back(ADV_NONCONN_IND);
+    event.push_back(BLE_ADDR_PUBLIC);
+    /* BD_ADDR, little endian */
+    event.push_back((uint8_t)index);
+    event.push_back((uint8_t)(index >> 8));
+    event.push_back((uint8_t)(index >> 16));
+    event.push_back(0);
+    event.push_back(0);
+    event.push_back(0);
+    event.push_back(sizeof(adv_data));
+    event.insert(event.end(), adv_data, adv_data + sizeof(adv_data));
+    event.push_back((uint8_t)rssi);
+
+    btm_ble_process_adv_pkt(event.size(), event.data());
+  }
+
+  tBTM_BLE_DUP_FILTER_STATS ObserveStats() {
+    tBTM_BLE_DUP_FILTER_STATS stats;
+    EXPECT_EQ(BTM_SUCCESS,
+              BTM_BleGetDupFilterStats(BTM_BLE_DUP_FILTER_OBSERVE, &stats));
+    return stats;
+  }
+};
+
+TEST_F(BtmBleDupFilterTest, unknown_scan) {
+  tBTM_BLE_DUP_FILTER_PARAMS params = {true, 0, 0};
+  tBTM_BLE_DUP_FILTER_STATS stats;
+
+  EXPECT_EQ(BTM_ILLEGAL_VALUE,
+            BTM_BleSetDupFilter(BTM_BLE_DUP_FILTER_MAX, &params));
+  EXPECT_EQ(BTM_ILLEGAL_VALUE,
+            BTM_BleGetDupFilterStats(BTM_BLE_DUP_FILTER_MAX, &stats));
+}
+
+TEST_F(BtmBleDupFilterTest, off_delivers_every_report) {
+  SetObserveFilter(false, 0);
+
+  for (int i = 0; i < 3; i++) Report(1, 0xAA, -50);
+
+  EXPECT_EQ(3u, observed_count);
+  EXPECT_EQ(3u, ObserveStats().delivered);
+  EXPECT_EQ(0u, ObserveStats().suppressed);
+}
+
+TEST_F(BtmBleDupFilterTest, repeated_report_is_suppressed) {
+  SetObserveFilter(true, 0);
+
+  Report(1, 0xAA, -50);
+  Report(1, 0xAA, -60);
+  Report(1, 0xAA, -50);
+
+  EXPECT_EQ(1u, observed_count);
+  EXPECT_EQ(1u, ObserveStats().delivered);
+  EXPECT_EQ(2u, ObserveStats().suppressed);
+}
+
+TEST_F(BtmBleDupFilterTest, changed_data_or_address_is_delivered) {
+  SetObserveFilter(true, 0);
+
+  Report(1, 0xAA, -50);
+  Report(2, 0xAA, -50);
+  Report(1, 0xBB, -50);
+  Report(1, 0xBB, -50);
+
+  EXPECT_EQ(3u, observed_count);
+  EXPECT_EQ(3u, ObserveStats().delivered);
+  EXPECT_EQ(1u, ObserveStats().suppressed);
+}
+
+TEST_F(BtmBleDupFilterTest, rssi_change_over_threshold_is_delivered) {
+  SetObserveFilter(true, 10);
+
+  Report(1, 0xAA, -50);
+  Report(1, 0xAA, -59); /* suppressed */
+  Report(1, 0xAA, -60); /* delivered, 10 dB from -50 */
+  Report(1, 0xAA, -51); /* suppressed, 9 dB from -60 */
+
+  EXPECT_EQ(2u, observed_count);
+  EXPECT_EQ(2u, ObserveStats().delivered);
+  EXPECT_EQ(2u, ObserveStats().suppressed);
+}
+
+TEST_F(BtmBleDupFilterTest, setting_filter_forgets_deliveries) {
+  SetObserveFilter(true, 0);
+  Report(1, 0xAA, -50);
+  Report(1, 0xAA, -50);
+
+  SetObserveFilter(true, 0);
+  EXPECT_EQ(0u, ObserveStats().delivered);
+  EXPECT_EQ(0u, ObserveStats().suppressed);
+
+  Report(1, 0xAA, -50);
+  EXPECT_EQ(2u, observed_count);
+  EXPECT_EQ(1u, ObserveStats().delivered);
+}
+
+TEST_F(BtmBleDupFilterTest, least_recently_heard_is_evicted) {
+  const uint32_t count = BTM_BLE_DUP_FILTER_CACHE_SIZE;
+  SetObserveFilter(true, 0);
+
+  /* Advertiser 1 is heard first, then |count| others push it out */
+  for (uint32_t index = 1; index <= count + 1; index++)
+    Report(index, 0xAA, -50);
+  EXPECT_EQ(count + 1, observed_count);
+
+  /* The most recently heard one is still remembered */
+  Report(count + 1, 0xAA, -50);
+  EXPECT_EQ(count + 1, observed_count);
+
+  /* Advertiser 1 was forgotten, so its repeat is delivered again */
+  Report(1, 0xAA, -50);
+  EXPECT_EQ(count + 2, observed_count);
+  EXPECT_EQ(count + 2, ObserveStats().delivered);
+  EXPECT_EQ(1u, ObserveStats().suppressed);
+}
@@ -0,0 +1,119 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2017 Google, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <benchmark/benchmark.h>
+
+#include <string.h>
+
+#include "bt_types.h"
+#include "btm_int.h"
+#include "btu.h"
+#include "hcidefs.h"
+#include "osi/include/allocator.h"
+#include "osi/include/list.h"
+
+// Peer |index| is 00:00:00:00:xx:xx with ACL handle |index|.
+static void make_peer_address(size_t index, BD_ADDR bd_addr) {
+  memset(bd_addr, 0, BD_ADDR_LEN);
+  bd_addr[4] = (uint8_t)(index >> 8);
+  bd_addr[5] = (uint8_t)index;
+}
+
+// Fills the security database with |count| BR/EDR peers, all connected.
+static void populate_dev_records(size_t count) {
+  if (btm_cb.sec_dev_rec) list_free(btm_cb.sec_dev_rec);
+  btm_cb.sec_dev_rec = list_new(osi_free);
+  btm_sec_clear_dev_index();
+
+  for (size_t i = 1; i <= count; i++) {
+    BD_ADDR bd_addr;
+    make_peer_address(i, bd_addr);
+    tBTM_SEC_DEV_REC* p_dev_rec = btm_find_or_alloc_dev(bd_addr);
+    p_dev_rec->hci_handle = (uint16_t)i;
+    btm_sec_update_dev_index(p_dev_rec);
+  }
+}
+
+static BT_HDR* start_event(uint8_t event_code, uint8_t** pp) {
+  BT_HDR* p_msg =
+      (BT_HDR*)osi_calloc(sizeof(BT_HDR) + HCIE_PREAMBLE_SIZE + 255);
+  *pp = (uint8_t*)(p_msg + 1);
+  UINT8_TO_STREAM(*pp, event_code);
+  (*pp)++; /* length, set by finish_event() */
+  return p_msg;
+}
+
+static void finish_event(BT_HDR* p_msg, uint8_t* p) {
+  uint8_t* p_start = (uint8_t*)(p_msg + 1);
+  p_msg->len = p - p_start;
+  p_start[1] = p_msg->len - HCIE_PREAMBLE_SIZE;
+}
+
+// Looked up by address: Remote Host Supported Features Notification for the
+// peer added last. Arg: number of device records.
+static void BM_BtmRemoteHostFeaturesEvent(benchmark::State& state) {
+  const size_t count = state.range(0);
+  populate_dev_records(count);
+
+  uint8_t* p;
+  BT_HDR* p_msg = start_event(HCI_RMT_HOST_SUP_FEAT_NOTIFY_EVT, &p);
+  BD_ADDR bd_addr;
+  make_peer_address(count, bd_addr);
+  BDADDR_TO_STREAM(p, bd_addr);
+  memset(p, 0, HCI_FEATURE_BYTES_PER_PAGE);
+  p += HCI_FEATURE_BYTES_PER_PAGE;
+  finish_event(p_msg, p);
+
+  while (state.KeepRunning()) {
+    btu_hcif_process_event(0, p_msg);
+  }
+  osi_free(p_msg);
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Looked up by handle: Encryption Key Refresh Complete for the peer added
+// last. Arg: number of device records.
+static void BM_BtmKeyRefreshEvent(benchmark::State& state) {
+  const size_t count = state.range(0);
+  populate_dev_records(count);
+
+  uint8_t* p;
+  BT_HDR* p_msg = start_event(HCI_ENCRYPTION_KEY_REFRESH_COMP_EVT, &p);
+  UINT8_TO_STREAM(p, HCI_SUCCESS);
+  UINT16_TO_STREAM(p, (uint16_t)count);
+  finish_event(p_msg, p);
+
+  while (state.KeepRunning()) {
+    btu_hcif_process_event(0, p_msg);
+  }
+  osi_free(p_msg);
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_BtmRemoteHostFeaturesEvent)
+    ->Arg(1)
+    ->Arg(10)
+    ->Arg(BTM_SEC_MAX_DEVICE_RECORDS);
+BENCHMARK(BM_BtmKeyRefreshEvent)
+    ->Arg(1)
+    ->Arg(10)
+    ->Arg(BTM_SEC_MAX_DEVICE_RECORDS);
+
+BENCHMARK_MAIN();
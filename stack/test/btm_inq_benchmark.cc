@@ -0,0 +1,115 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2017 Google, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <benchmark/benchmark.h>
+
+#include <string.h>
+
+#include <vector>
+
+#include "bt_types.h"
+#include "btm_int.h"
+#include "btu.h"
+#include "hcidefs.h"
+#include "osi/include/allocator.h"
+
+/* bdaddr, page scan rep/period mode, class of device, clock offset, RSSI */
+#define RSSI_RESULT_LEN (BD_ADDR_LEN + 2 + DEV_CLASS_LEN + 2 + 1)
+#define RESULTS_PER_EVENT (255 / RSSI_RESULT_LEN)
+
+// Advertiser |index| is 00:00:00:xx:xx:xx.
+static void make_peer_address(size_t index, BD_ADDR bd_addr) {
+  memset(bd_addr, 0, BD_ADDR_LEN);
+  bd_addr[3] = (uint8_t)(index >> 16);
+  bd_addr[4] = (uint8_t)(index >> 8);
+  bd_addr[5] = (uint8_t)index;
+}
+
+// Builds Inquiry Result with RSSI events reporting advertisers 1..|count|,
+// each |repeats| times, interleaved the way they arrive during a scan.
+static std::vector<BT_HDR*> make_scan(size_t count, size_t repeats) {
+  std::vector<BT_HDR*> events;
+  const size_t total = count * repeats;
+
+  for (size_t i = 0; i < total; i += RESULTS_PER_EVENT) {
+    const size_t num_resp =
+        (total - i < RESULTS_PER_EVENT) ? total - i : RESULTS_PER_EVENT;
+    BT_HDR* p_msg =
+        (BT_HDR*)osi_calloc(sizeof(BT_HDR) + HCIE_PREAMBLE_SIZE + 255);
+    uint8_t* p_start = (uint8_t*)(p_msg + 1);
+    uint8_t* p = p_start;
+
+    UINT8_TO_STREAM(p, HCI_INQUIRY_RSSI_RESULT_EVT);
+    UINT8_TO_STREAM(p, 1 + num_resp * RSSI_RESULT_LEN);
+    UINT8_TO_STREAM(p, num_resp);
+    for (size_t j = i; j < i + num_resp; j++) {
+      BD_ADDR bd_addr;
+      make_peer_address(j % count + 1, bd_addr);
+      BDADDR_TO_STREAM(p, bd_addr);
+      UINT8_TO_STREAM(p, HCI_PAGE_SCAN_REP_MODE_R1);
+      UINT8_TO_STREAM(p, 0); /* reserved */
+      UINT8_TO_STREAM(p, 0x0C);
+      UINT8_TO_STREAM(p, 0x02);
+      UINT8_TO_STREAM(p, 0x5A);
+      UINT16_TO_STREAM(p, (uint16_t)j);
+      UINT8_TO_STREAM(p, (uint8_t)(-40 - (int)(j % 50)));
+    }
+    p_msg->len = p - p_start;
+    events.push_back(p_msg);
+  }
+  return events;
+}
+
+// Replays one scan in which every advertiser answers 4 times, the way a
+// general inquiry with duplicate reporting sees them. Arg: number of
+// advertisers.
+static void BM_BtmInquiryScanReplay(benchmark::State& state) {
+  const size_t count = state.range(0);
+  const size_t repeats = 4;
+  tBTM_INQUIRY_VAR_ST* p_inq = &btm_cb.btm_inq_vars;
+
+  btm_inq_db_cleanup();
+  btm_inq_db_init();
+  memset(&p_inq->inqparms, 0, sizeof(p_inq->inqparms));
+  p_inq->inqparms.report_dup = true;
+  p_inq->inq_counter = 1;
+  p_inq->inq_active = BTM_GENERAL_INQUIRY_ACTIVE;
+
+  std::vector<BT_HDR*> events = make_scan(count, repeats);
+
+  while (state.KeepRunning()) {
+    p_inq->inq_counter++;
+    p_inq->inq_cmpl_info.num_resp = 0;
+    btm_init_inq_result_flt();
+    for (BT_HDR* p_msg : events) btu_hcif_process_event(0, p_msg);
+  }
+
+  for (BT_HDR* p_msg : events) osi_free(p_msg);
+  p_inq->inq_active = BTM_INQUIRY_INACTIVE;
+  btm_inq_db_cleanup();
+
+  state.SetItemsProcessed(state.iterations() * count * repeats);
+}
+
+BENCHMARK(BM_BtmInquiryScanReplay)
+    ->Arg(10)
+    ->Arg(BTM_INQ_DB_SIZE)
+    ->Arg(1000)
+    ->Arg(10000);
+
+BENCHMARK_MAIN();
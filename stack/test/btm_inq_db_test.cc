@@ -0,0 +1,189 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2017 Google, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include <set>
+#include <vector>
+
+#include "bt_types.h"
+#include "btm_int.h"
+
+// Device |index| is 00:00:00:00:xx:xx.
+static void make_address(uint16_t index, BD_ADDR bd_addr) {
+  memset(bd_addr, 0, BD_ADDR_LEN);
+  bd_addr[4] = (uint8_t)(index >> 8);
+  bd_addr[5] = (uint8_t)index;
+}
+
+// An RSSI for device |index| that is not in index order, with ties.
+static int8_t rssi_of(uint16_t index) { return -40 - (index * 7) % 23; }
+
+class BtmInqDbTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    btm_inq_db_cleanup();
+    memset(&btm_cb, 0, sizeof(btm_cb));
+    btm_inq_db_init();
+  }
+
+  void TearDown() override { btm_inq_db_cleanup(); }
+
+  // Adds device |index| to the inquiry database, as the most recent one.
+  void Add(uint16_t index) {
+    BD_ADDR bd_addr;
+    make_address(index, bd_addr);
+    tINQ_DB_ENT* p_ent = btm_inq_db_new(bd_addr);
+    p_ent->inq_info.results.rssi = rssi_of(index);
+  }
+
+  tINQ_DB_ENT* Find(uint16_t index) {
+    BD_ADDR bd_addr;
+    make_address(index, bd_addr);
+    return btm_inq_db_find(bd_addr);
+  }
+
+  // Adds devices 1..|count|, oldest first.
+  void Fill(uint16_t count) {
+    for (uint16_t index = 1; index <= count; index++) Add(index);
+  }
+
+  // Checks that every device in 1..|count| is found under its own address.
+  void ExpectFound(uint16_t count) {
+    for (uint16_t index = 1; index <= count; index++) {
+      BD_ADDR bd_addr;
+      make_address(index, bd_addr);
+      tINQ_DB_ENT* p_ent = btm_inq_db_find(bd_addr);
+      ASSERT_NE(nullptr, p_ent) << "device " << index;
+      EXPECT_EQ(0, memcmp(bd_addr, p_ent->inq_info.results.remote_bd_addr,
+                          BD_ADDR_LEN));
+      EXPECT_EQ(rssi_of(index), p_ent->inq_info.results.rssi);
+    }
+  }
+};
+
+TEST_F(BtmInqDbTest, sort_orders_by_rssi) {
+  Fill(BTM_INQ_DB_SIZE);
+
+  btm_sort_inq_result();
+
+  std::set<uint16_t> slots;
+  size_t count = 0;
+  int8_t last_rssi = INT8_MAX;
+  for (tINQ_DB_ENT* p_ent = btm_inq_db_first(); p_ent;
+       p_ent = btm_inq_db_next(p_ent)) {
+    EXPECT_LE(p_ent->inq_info.results.rssi, last_rssi);
+    last_rssi = p_ent->inq_info.results.rssi;
+    slots.insert(p_ent->slot);
+    count++;
+  }
+  EXPECT_EQ((size_t)BTM_INQ_DB_SIZE, count);
+  EXPECT_EQ((size_t)BTM_INQ_DB_SIZE, slots.size());
+}
+
+TEST_F(BtmInqDbTest, sort_keeps_free_entries_free) {
+  Fill(BTM_INQ_DB_SIZE);
+  for (uint16_t index = 2; index <= BTM_INQ_DB_SIZE; index += 3)
+    btm_inq_db_free(Find(index));
+
+  btm_sort_inq_result();
+
+  int8_t last_rssi = INT8_MAX;
+  for (tINQ_DB_ENT* p_ent = btm_inq_db_first(); p_ent;
+       p_ent = btm_inq_db_next(p_ent)) {
+    EXPECT_LE(p_ent->inq_info.results.rssi, last_rssi);
+    last_rssi = p_ent->inq_info.results.rssi;
+  }
+  for (uint16_t index = 1; index <= BTM_INQ_DB_SIZE; index++) {
+    if (index % 3 == 2)
+      EXPECT_EQ(nullptr, Find(index));
+    else
+      EXPECT_NE(nullptr, Find(index));
+  }
+
+  /* The freed entries are reused before the LRU one is evicted */
+  Add(BTM_INQ_DB_SIZE + 1);
+  EXPECT_NE(nullptr, Find(1));
+}
+
+TEST_F(BtmInqDbTest, lookup_after_sort) {
+  Fill(BTM_INQ_DB_SIZE);
+
+  btm_sort_inq_result();
+
+  ExpectFound(BTM_INQ_DB_SIZE);
+  for (uint16_t index = BTM_INQ_DB_SIZE + 1; index < 2 * BTM_INQ_DB_SIZE;
+       index++)
+    EXPECT_EQ(nullptr, Find(index));
+}
+
+TEST_F(BtmInqDbTest, lru_eviction_after_sort) {
+  Fill(BTM_INQ_DB_SIZE);
+  /* Device 1 answers again, so device 2 is now the least recent */
+  btm_inq_db_touch(Find(1));
+
+  btm_sort_inq_result();
+
+  /* Each new device evicts the least recent one left, in LRU order */
+  for (uint16_t index = 2; index <= BTM_INQ_DB_SIZE; index++) {
+    Add(BTM_INQ_DB_SIZE + index);
+    EXPECT_EQ(nullptr, Find(index)) << "device " << index;
+    if (index < BTM_INQ_DB_SIZE)
+      EXPECT_NE(nullptr, Find(index + 1)) << "device " << index + 1;
+  }
+  EXPECT_NE(nullptr, Find(1));
+
+  Add(3 * BTM_INQ_DB_SIZE);
+  EXPECT_EQ(nullptr, Find(1));
+}
+
+TEST_F(BtmInqDbTest, free_after_sort) {
+  Fill(BTM_INQ_DB_SIZE);
+  btm_sort_inq_result();
+
+  /* Removing entries works from the hash and LRU list the sort rebuilt */
+  for (uint16_t index = 1; index <= BTM_INQ_DB_SIZE; index += 2)
+    btm_inq_db_free(Find(index));
+
+  for (uint16_t index = 1; index <= BTM_INQ_DB_SIZE; index++) {
+    if (index % 2 == 1)
+      EXPECT_EQ(nullptr, Find(index));
+    else
+      EXPECT_NE(nullptr, Find(index));
+  }
+}
+
+TEST_F(BtmInqDbTest, sort_of_sorted_database_changes_nothing) {
+  Fill(BTM_INQ_DB_SIZE);
+  btm_sort_inq_result();
+
+  std::vector<uint8_t> before;
+  for (tINQ_DB_ENT* p_ent = btm_inq_db_first(); p_ent;
+       p_ent = btm_inq_db_next(p_ent))
+    before.push_back(p_ent->inq_info.results.remote_bd_addr[5]);
+
+  btm_sort_inq_result();
+
+  size_t k = 0;
+  for (tINQ_DB_ENT* p_ent = btm_inq_db_first(); p_ent;
+       p_ent = btm_inq_db_next(p_ent), k++)
+    EXPECT_EQ(before[k], p_ent->inq_info.results.remote_bd_addr[5]);
+  ExpectFound(BTM_INQ_DB_SIZE);
+}
@@ -0,0 +1,355 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2017 Google, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include <vector>
+
+#include "gatt_int.h"
+#include "l2c_api.h"
+#include "osi/include/allocator.h"
+
+#define TEST_GATT_IF 1
+#define TEST_CONN_ID GATT_CREATE_CONN_ID(0, TEST_GATT_IF)
+
+tGATT_CB gatt_cb;
+fixed_queue_t* btu_general_alarm_queue;
+
+// ATT PDUs sent to the peer, oldest first
+static std::vector<std::vector<uint8_t>> sent_pdus;
+
+uint16_t L2CA_SendFixedChnlData(uint16_t fixed_cid, BD_ADDR rem_bda,
+                                BT_HDR* p_buf) {
+  uint8_t* p = p_buf->data + p_buf->offset;
+  sent_pdus.push_back(std::vector<uint8_t>(p, p + p_buf->len));
+  osi_free(p_buf);
+  return L2CAP_DW_SUCCESS;
+}
+
+uint8_t L2CA_DataWrite(uint16_t cid, BT_HDR* p_data) {
+  osi_free(p_data);
+  return L2CAP_DW_SUCCESS;
+}
+
+// The rest of the stack is not under test here
+void LogMsg(uint32_t trace_set_mask, const char* fmt_str, ...) {}
+bool BTM_BleUpdateBgConnDev(bool add_remove, BD_ADDR remote_bda) {
+  return true;
+}
+bool BTM_GetSecurityFlagsByTransport(BD_ADDR bd_addr, uint8_t* p_sec_flags,
+                                     tBT_TRANSPORT transport) {
+  *p_sec_flags = 0;
+  return true;
+}
+bool SDP_AddAttribute(uint32_t handle, uint16_t attr_id, uint8_t attr_type,
+                      uint32_t attr_len, uint8_t* p_val) {
+  return true;
+}
+bool SDP_AddProtocolList(uint32_t handle, uint16_t num_elem,
+                         tSDP_PROTOCOL_ELEM* p_elem_list) {
+  return true;
+}
+bool SDP_AddServiceClassIdList(uint32_t handle, uint16_t num_services,
+                               uint16_t* p_service_uuids) {
+  return true;
+}
+bool SDP_AddUuidSequence(uint32_t handle, uint16_t attr_id, uint16_t num_uuids,
+                         uint16_t* p_uuids) {
+  return true;
+}
+uint32_t SDP_CreateRecord(void) { return 1; }
+bool SDP_DeleteRecord(uint32_t handle) { return true; }
+void alarm_cancel(alarm_t* alarm) {}
+void alarm_free(alarm_t* alarm) {}
+alarm_t* alarm_new(const char* name) { return NULL; }
+void alarm_set_on_queue(alarm_t* alarm, period_ms_t interval_ms,
+                        alarm_callback_t cb, void* data,
+                        fixed_queue_t* queue) {}
+uint8_t btm_ble_read_sec_key_size(BD_ADDR bd_addr) { return 16; }
+void gatt_dequeue_sr_cmd(tGATT_TCB* p_tcb) {}
+bool gatt_disconnect(tGATT_TCB* p_tcb) { return true; }
+tGATT_CH_STATE gatt_get_ch_state(tGATT_TCB* p_tcb) { return GATT_CH_OPEN; }
+tGATT_STATUS gatt_get_link_encrypt_status(tGATT_TCB* p_tcb) {
+  return GATT_SUCCESS;
+}
+void gatt_set_ch_state(tGATT_TCB* p_tcb, tGATT_CH_STATE ch_state) {}
+void gatt_update_app_use_link_flag(tGATT_IF gatt_if, tGATT_TCB* p_tcb,
+                                   bool is_add, bool check_acl_link) {}
+void l2cble_set_fixed_channel_tx_data_length(BD_ADDR remote_bda,
+                                             uint16_t fix_cid,
+                                             uint16_t tx_mtu) {}
+
+static std::vector<tGATT_DISC_RES> disc_results;
+static std::vector<tGATT_STATUS> disc_cmpl_statuses;
+static std::vector<tGATTC_OPTYPE> cmpl_ops;
+
+static void disc_res_cb(uint16_t conn_id, tGATT_DISC_TYPE disc_type,
+                        tGATT_DISC_RES* p_data) {
+  disc_results.push_back(*p_data);
+}
+
+static void disc_cmpl_cb(uint16_t conn_id, tGATT_DISC_TYPE disc_type,
+                         tGATT_STATUS status) {
+  disc_cmpl_statuses.push_back(status);
+}
+
+static void cmpl_cb(uint16_t conn_id, tGATTC_OPTYPE op, tGATT_STATUS status,
+                    tGATT_CL_COMPLETE* p_data) {
+  cmpl_ops.push_back(op);
+}
+
+class GattClTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    memset(&gatt_cb, 0, sizeof(gatt_cb));
+    sent_pdus.clear();
+    disc_results.clear();
+    disc_cmpl_statuses.clear();
+    cmpl_ops.clear();
+
+    tGATT_REG* p_reg = &gatt_cb.cl_rcb[TEST_GATT_IF - 1];
+    p_reg->in_use = true;
+    p_reg->gatt_if = TEST_GATT_IF;
+    p_reg->app_cb.p_disc_res_cb = disc_res_cb;
+    p_reg->app_cb.p_disc_cmpl_cb = disc_cmpl_cb;
+    p_reg->app_cb.p_cmpl_cb = cmpl_cb;
+
+    p_tcb = &gatt_cb.tcb[0];
+    p_tcb->in_use = true;
+    p_tcb->tcb_idx = 0;
+    p_tcb->att_lcid = L2CAP_ATT_CID;
+    p_tcb->transport = BT_TRANSPORT_LE;
+    p_tcb->payload_size = 100;
+  }
+
+  // Starts discovery of the included services in handles 1 to 0x40.
+  void DiscoverIncludedServices() {
+    tGATT_CLCB* p_clcb = gatt_clcb_alloc(TEST_CONN_ID);
+    p_clcb->operation = GATTC_OPTYPE_DISCOVERY;
+    p_clcb->op_subtype = GATT_DISC_INC_SRVC;
+    p_clcb->s_handle = 1;
+    p_clcb->e_handle = 0x40;
+    gatt_act_discovery(p_clcb);
+  }
+
+  // Answers a Read By Type request with |count| included services that have
+  // a 128-bit UUID. Include |i| is declared at handle |first_handle| + i and
+  // refers to the service starting at handle 0x100 * (i + 1).
+  void ReadByTypeRsp(uint16_t first_handle, int count) {
+    uint8_t pdu[GATT_MAX_MTU_SIZE];
+    uint8_t* p = pdu;
+    UINT8_TO_STREAM(p, 6);
+    for (int i = 0; i < count; i++) {
+      UINT16_TO_STREAM(p, first_handle + i);
+      UINT16_TO_STREAM(p, 0x100 * (i + 1));
+      UINT16_TO_STREAM(p, 0x100 * (i + 1) + 0x0f);
+    }
+    gatt_client_handle_server_rsp(p_tcb, GATT_RSP_READ_BY_TYPE, p - pdu, pdu);
+  }
+
+  // Answers a read with |count| UUIDs; octet j of UUID i is 16 * i + j.
+  void ReadRsp(uint8_t op_code, int count) {
+    uint8_t pdu[GATT_MAX_MTU_SIZE];
+    for (int i = 0; i < count * LEN_UUID_128; i++) pdu[i] = i;
+    gatt_client_handle_server_rsp(p_tcb, op_code, count * LEN_UUID_128, pdu);
+  }
+
+  void ErrorRsp(uint8_t req_op_code, uint16_t handle, uint8_t reason) {
+    uint8_t pdu[4];
+    uint8_t* p = pdu;
+    UINT8_TO_STREAM(p, req_op_code);
+    UINT16_TO_STREAM(p, handle);
+    UINT8_TO_STREAM(p, reason);
+    gatt_client_handle_server_rsp(p_tcb, GATT_RSP_ERROR, sizeof(pdu), pdu);
+  }
+
+  void Read(uint16_t handle) {
+    tGATT_CLCB* p_clcb = gatt_clcb_alloc(TEST_CONN_ID);
+    p_clcb->operation = GATTC_OPTYPE_READ;
+    p_clcb->op_subtype = GATT_READ_BY_HANDLE;
+    p_clcb->s_handle = handle;
+    gatt_act_read(p_clcb, 0);
+  }
+
+  void WriteCommand(uint16_t handle) {
+    tGATT_VALUE* p_value = (tGATT_VALUE*)osi_calloc(sizeof(tGATT_VALUE));
+    p_value->handle = handle;
+    p_value->len = 1;
+    tGATT_CLCB* p_clcb = gatt_clcb_alloc(TEST_CONN_ID);
+    p_clcb->operation = GATTC_OPTYPE_WRITE;
+    p_clcb->op_subtype = GATT_WRITE_NO_RSP;
+    p_clcb->p_attr_buf = (uint8_t*)p_value;
+    gatt_act_write(p_clcb, 0);
+  }
+
+  uint8_t LastOpCode() { return sent_pdus.back()[0]; }
+
+  uint16_t LastHandle() {
+    return sent_pdus.back()[1] | (sent_pdus.back()[2] << 8);
+  }
+
+  tGATT_TCB* p_tcb;
+};
+
+TEST_F(GattClTest, write_command_sent_while_request_outstanding) {
+  Read(5);
+  ASSERT_EQ(1u, sent_pdus.size());
+
+  WriteCommand(7);
+  ASSERT_EQ(2u, sent_pdus.size());
+  EXPECT_EQ(GATT_CMD_WRITE, LastOpCode());
+  EXPECT_EQ(7, LastHandle());
+  EXPECT_EQ(1u, cmpl_ops.size());
+
+  /* The read response still goes to the read */
+  uint8_t value[2] = {1, 2};
+  gatt_client_handle_server_rsp(p_tcb, GATT_RSP_READ, sizeof(value), value);
+  ASSERT_EQ(2u, cmpl_ops.size());
+  EXPECT_EQ(GATTC_OPTYPE_READ, cmpl_ops[1]);
+  EXPECT_EQ(p_tcb->next_slot_inq, p_tcb->pending_cl_req);
+}
+
+TEST_F(GattClTest, write_command_waits_behind_queued_request) {
+  Read(5);
+  Read(6);
+  ASSERT_EQ(1u, sent_pdus.size());
+
+  /* Sending it now would overtake the second read */
+  WriteCommand(7);
+  EXPECT_EQ(1u, sent_pdus.size());
+  EXPECT_EQ(0u, cmpl_ops.size());
+
+  uint8_t value[2] = {1, 2};
+  gatt_client_handle_server_rsp(p_tcb, GATT_RSP_READ, sizeof(value), value);
+  ASSERT_EQ(2u, sent_pdus.size());
+  EXPECT_EQ(GATT_REQ_READ, LastOpCode());
+  EXPECT_EQ(6, LastHandle());
+
+  gatt_client_handle_server_rsp(p_tcb, GATT_RSP_READ, sizeof(value), value);
+  ASSERT_EQ(3u, sent_pdus.size());
+  EXPECT_EQ(GATT_CMD_WRITE, LastOpCode());
+  EXPECT_EQ(7, LastHandle());
+  EXPECT_EQ(3u, cmpl_ops.size());
+  EXPECT_EQ(p_tcb->next_slot_inq, p_tcb->pending_cl_req);
+}
+
+TEST_F(GattClTest, read_multiple_fetches_included_service_uuids) {
+  DiscoverIncludedServices();
+  ReadByTypeRsp(0x10, 3);
+
+  /* One Read Multiple of the three included service start handles */
+  ASSERT_EQ(2u, sent_pdus.size());
+  ASSERT_EQ(7u, sent_pdus.back().size());
+  EXPECT_EQ(GATT_REQ_READ_MULTI, LastOpCode());
+  EXPECT_EQ(0x100, LastHandle());
+
+  ReadRsp(GATT_RSP_READ_MULTI, 3);
+  ASSERT_EQ(3u, disc_results.size());
+  for (int i = 0; i < 3; i++) {
+    tGATT_INCL_SRVC* p_incl = &disc_results[i].value.incl_service;
+    EXPECT_EQ(0x10 + i, disc_results[i].handle);
+    EXPECT_EQ(0x100 * (i + 1), p_incl->s_handle);
+    EXPECT_EQ(0x100 * (i + 1) + 0x0f, p_incl->e_handle);
+    ASSERT_EQ(LEN_UUID_128, p_incl->service_type.len);
+    for (int j = 0; j < LEN_UUID_128; j++)
+      EXPECT_EQ(LEN_UUID_128 * i + j, p_incl->service_type.uu.uuid128[j]);
+  }
+
+  /* Discovery resumes after the last include */
+  EXPECT_EQ(GATT_REQ_READ_BY_TYPE, LastOpCode());
+  EXPECT_EQ(0x13, LastHandle());
+  ErrorRsp(GATT_REQ_READ_BY_TYPE, 0x13, GATT_NOT_FOUND);
+  ASSERT_EQ(1u, disc_cmpl_statuses.size());
+  EXPECT_EQ(GATT_SUCCESS, disc_cmpl_statuses[0]);
+}
+
+TEST_F(GattClTest, read_multiple_with_wrong_length_fails) {
+  DiscoverIncludedServices();
+  ReadByTypeRsp(0x10, 3);
+
+  ReadRsp(GATT_RSP_READ_MULTI, 2);
+  EXPECT_EQ(0u, disc_results.size());
+  ASSERT_EQ(1u, disc_cmpl_statuses.size());
+  EXPECT_EQ(GATT_INVALID_PDU, disc_cmpl_statuses[0]);
+}
+
+TEST_F(GattClTest, default_mtu_reads_one_uuid) {
+  p_tcb->payload_size = GATT_DEF_BLE_MTU_SIZE;
+  DiscoverIncludedServices();
+  ReadByTypeRsp(0x10, 3);
+
+  EXPECT_EQ(GATT_REQ_READ, LastOpCode());
+  EXPECT_EQ(0x100, LastHandle());
+  ReadRsp(GATT_RSP_READ, 1);
+  EXPECT_EQ(1u, disc_results.size());
+  EXPECT_EQ(GATT_REQ_READ_BY_TYPE, LastOpCode());
+  EXPECT_EQ(0x11, LastHandle());
+}
+
+TEST_F(GattClTest, read_multiple_not_supported_falls_back_for_connection) {
+  DiscoverIncludedServices();
+  ReadByTypeRsp(0x10, 2);
+  ErrorRsp(GATT_REQ_READ_MULTI, 0x100, GATT_REQ_NOT_SUPPORTED);
+
+  /* The first UUID is read on its own, then discovery resumes after it */
+  EXPECT_TRUE(p_tcb->read_multi_unsupported);
+  EXPECT_EQ(GATT_REQ_READ, LastOpCode());
+  EXPECT_EQ(0x100, LastHandle());
+  ReadRsp(GATT_RSP_READ, 1);
+  ASSERT_EQ(1u, disc_results.size());
+  EXPECT_EQ(0x10, disc_results[0].handle);
+  EXPECT_EQ(GATT_REQ_READ_BY_TYPE, LastOpCode());
+  EXPECT_EQ(0x11, LastHandle());
+  ErrorRsp(GATT_REQ_READ_BY_TYPE, 0x11, GATT_NOT_FOUND);
+  ASSERT_EQ(1u, disc_cmpl_statuses.size());
+
+  /* Later procedures on the connection don't try Read Multiple again */
+  DiscoverIncludedServices();
+  ReadByTypeRsp(0x10, 2);
+  EXPECT_EQ(GATT_REQ_READ, LastOpCode());
+  EXPECT_EQ(0x100, LastHandle());
+}
+
+TEST_F(GattClTest, read_multiple_error_falls_back_for_procedure) {
+  DiscoverIncludedServices();
+  ReadByTypeRsp(0x10, 2);
+  ErrorRsp(GATT_REQ_READ_MULTI, 0x100, GATT_INSUF_AUTHENTICATION);
+
+  EXPECT_FALSE(p_tcb->read_multi_unsupported);
+  EXPECT_EQ(GATT_REQ_READ, LastOpCode());
+  EXPECT_EQ(0x100, LastHandle());
+  ReadRsp(GATT_RSP_READ, 1);
+  ASSERT_EQ(1u, disc_results.size());
+
+  /* The rest of this procedure reads one UUID at a time */
+  EXPECT_EQ(GATT_REQ_READ_BY_TYPE, LastOpCode());
+  ReadByTypeRsp(0x11, 2);
+  EXPECT_EQ(GATT_REQ_READ, LastOpCode());
+  ReadRsp(GATT_RSP_READ, 1);
+  ASSERT_EQ(2u, disc_results.size());
+  EXPECT_EQ(0x11, disc_results[1].handle);
+  ErrorRsp(GATT_REQ_READ_BY_TYPE, 0x12, GATT_NOT_FOUND);
+  ASSERT_EQ(1u, disc_cmpl_statuses.size());
+
+  /* The next procedure tries Read Multiple again */
+  DiscoverIncludedServices();
+  ReadByTypeRsp(0x10, 2);
+  EXPECT_EQ(GATT_REQ_READ_MULTI, LastOpCode());
+}
@@ -0,0 +1,145 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2017 Google, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <benchmark/benchmark.h>
+
+#include <string.h>
+
+#include "bt_types.h"
+#include "gatt_api.h"
+#include "gatt_int.h"
+#include "l2cdefs.h"
+
+/* service declaration, then characteristics with a value and a CCC */
+#define CHARS_PER_SERVICE 4
+#define ATTRS_PER_SERVICE (1 + CHARS_PER_SERVICE * 3)
+
+static tGATT_CBACK server_callbacks;
+
+static void set_uuid16(bt_uuid_t* p_uuid, uint16_t uuid16) {
+  /* Bluetooth base UUID, little endian */
+  static const uint8_t base[16] = {0xFB, 0x34, 0x9B, 0x5F, 0x80, 0x00,
+                                   0x00, 0x80, 0x00, 0x10, 0x00, 0x00,
+                                   0x00, 0x00, 0x00, 0x00};
+  memcpy(p_uuid->uu, base, sizeof(base));
+  p_uuid->uu[12] = (uint8_t)uuid16;
+  p_uuid->uu[13] = (uint8_t)(uuid16 >> 8);
+}
+
+// Restarts GATT with about |num_attrs| application attributes, and returns the
+// connection the requests are served on.
+static tGATT_TCB* populate_server(size_t num_attrs) {
+  static bool started = false;
+  if (started) gatt_free();
+  gatt_init();
+  started = true;
+
+  tBT_UUID app_uuid = {LEN_UUID_128, {0}};
+  memset(app_uuid.uu.uuid128, 0x42, LEN_UUID_128);
+  tGATT_IF gatt_if = GATT_Register(&app_uuid, &server_callbacks);
+
+  for (size_t s = 0; s * ATTRS_PER_SERVICE < num_attrs; s++) {
+    btgatt_db_element_t service[1 + CHARS_PER_SERVICE * 2];
+    memset(service, 0, sizeof(service));
+
+    service[0].type = BTGATT_DB_PRIMARY_SERVICE;
+    set_uuid16(&service[0].uuid, 0xA000 + s);
+    for (int c = 0; c < CHARS_PER_SERVICE; c++) {
+      btgatt_db_element_t* p_char = &service[1 + c * 2];
+      p_char->type = BTGATT_DB_CHARACTERISTIC;
+      set_uuid16(&p_char->uuid, 0xB000 + c);
+      p_char->properties = GATT_CHAR_PROP_BIT_READ | GATT_CHAR_PROP_BIT_NOTIFY;
+      p_char->permissions = GATT_PERM_READ;
+
+      btgatt_db_element_t* p_ccc = p_char + 1;
+      p_ccc->type = BTGATT_DB_DESCRIPTOR;
+      set_uuid16(&p_ccc->uuid, GATT_UUID_CHAR_CLIENT_CONFIG);
+      p_ccc->permissions = GATT_PERM_READ | GATT_PERM_WRITE;
+    }
+    GATTS_AddService(gatt_if, service, 1 + CHARS_PER_SERVICE * 2);
+  }
+
+  tGATT_TCB* p_tcb = &gatt_cb.tcb[0];
+  p_tcb->in_use = true;
+  p_tcb->transport = BT_TRANSPORT_LE;
+  p_tcb->att_lcid = L2CAP_ATT_CID;
+  p_tcb->payload_size = GATT_DEF_BLE_MTU_SIZE;
+  return p_tcb;
+}
+
+// Handle of the service declaration in the middle of the database.
+static uint16_t middle_service_handle(void) {
+  uint16_t handle = gatt_cb.srv_list_info->back().s_hdl;
+  size_t count = gatt_cb.srv_list_info->size() / 2;
+  for (const tGATT_SRV_LIST_ELEM& el : *gatt_cb.srv_list_info) {
+    handle = el.s_hdl;
+    if (count-- == 0) break;
+  }
+  return handle;
+}
+
+// Find Information from the middle of the database, as during descriptor
+// discovery. Arg: number of attributes.
+static void BM_GattsFindInformation(benchmark::State& state) {
+  tGATT_TCB* p_tcb = populate_server(state.range(0));
+  uint8_t pdu[4];
+  uint8_t* p = pdu;
+  UINT16_TO_STREAM(p, middle_service_handle());
+  UINT16_TO_STREAM(p, 0xFFFF);
+
+  while (state.KeepRunning()) {
+    gatt_server_handle_client_req(p_tcb, GATT_REQ_FIND_INFO, sizeof(pdu), pdu);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Read By Type of the characteristic declarations from the middle of the
+// database, as during characteristic discovery. Arg: number of attributes.
+static void BM_GattsReadByTypeCharacteristic(benchmark::State& state) {
+  tGATT_TCB* p_tcb = populate_server(state.range(0));
+  uint8_t pdu[6];
+  uint8_t* p = pdu;
+  UINT16_TO_STREAM(p, middle_service_handle());
+  UINT16_TO_STREAM(p, 0xFFFF);
+  UINT16_TO_STREAM(p, GATT_UUID_CHAR_DECLARE);
+
+  while (state.KeepRunning()) {
+    gatt_server_handle_client_req(p_tcb, GATT_REQ_READ_BY_TYPE, sizeof(pdu),
+                                  pdu);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Read of the last characteristic declaration. Arg: number of attributes.
+static void BM_GattsReadLastAttribute(benchmark::State& state) {
+  tGATT_TCB* p_tcb = populate_server(state.range(0));
+  uint8_t pdu[2];
+  uint8_t* p = pdu;
+  UINT16_TO_STREAM(p, gatt_cb.srv_list_info->back().e_hdl - 2);
+
+  while (state.KeepRunning()) {
+    gatt_server_handle_client_req(p_tcb, GATT_REQ_READ, sizeof(pdu), pdu);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_GattsFindInformation)->Arg(50)->Arg(500);
+BENCHMARK(BM_GattsReadByTypeCharacteristic)->Arg(50)->Arg(500);
+BENCHMARK(BM_GattsReadLastAttribute)->Arg(50)->Arg(500);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,100 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2017 Google, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <benchmark/benchmark.h>
+
+#include <string.h>
+
+#include "l2c_crc.h"
+
+static uint8_t src_buffer[0x10000];
+static uint8_t dst_buffer[0x10000];
+
+static void fill_source(void) {
+  uint32_t seed = 0x2545F491;
+  for (size_t i = 0; i < sizeof(src_buffer); i++) {
+    seed = seed * 1664525 + 1013904223;
+    src_buffer[i] = (uint8_t)(seed >> 24);
+  }
+}
+
+// Args: kernel, frame length. 1010 is the default BR/EDR MPS.
+static void BM_L2cCrc16(benchmark::State& state) {
+  if (!l2c_crc16_set_kernel((tL2C_CRC_KERNEL)state.range(0))) {
+    state.SkipWithError("kernel not supported");
+    return;
+  }
+  state.SetLabel(l2c_crc16_get_kernel_name());
+  fill_source();
+
+  const size_t len = state.range(1);
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(l2c_crc16(0, src_buffer, len));
+  }
+
+  state.SetBytesProcessed(state.iterations() * len);
+}
+
+// Copy and CRC in one pass, as done when segmenting an SDU
+static void BM_L2cCrc16Copy(benchmark::State& state) {
+  if (!l2c_crc16_set_kernel((tL2C_CRC_KERNEL)state.range(0))) {
+    state.SkipWithError("kernel not supported");
+    return;
+  }
+  state.SetLabel(l2c_crc16_get_kernel_name());
+  fill_source();
+
+  const size_t len = state.range(1);
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(l2c_crc16_copy(0, dst_buffer, src_buffer, len));
+  }
+
+  state.SetBytesProcessed(state.iterations() * len);
+}
+
+// The copy followed by a separate CRC pass, as done before
+static void BM_L2cMemcpyThenCrc16(benchmark::State& state) {
+  if (!l2c_crc16_set_kernel((tL2C_CRC_KERNEL)state.range(0))) {
+    state.SkipWithError("kernel not supported");
+    return;
+  }
+  state.SetLabel(l2c_crc16_get_kernel_name());
+  fill_source();
+
+  const size_t len = state.range(1);
+  while (state.KeepRunning()) {
+    memcpy(dst_buffer, src_buffer, len);
+    benchmark::DoNotOptimize(l2c_crc16(0, dst_buffer, len));
+  }
+
+  state.SetBytesProcessed(state.iterations() * len);
+}
+
+static void l2c_crc_args(benchmark::internal::Benchmark* b) {
+  b->ArgNames({"kernel", "len"});
+  for (int kernel :
+       {L2C_CRC_KERNEL_BYTE, L2C_CRC_KERNEL_SLICE8, L2C_CRC_KERNEL_CLMUL}) {
+    for (int len : {64, 339, 1010, 0xFFFF}) b->Args({kernel, len});
+  }
+}
+
+BENCHMARK(BM_L2cCrc16)->Apply(l2c_crc_args);
+BENCHMARK(BM_L2cCrc16Copy)->Apply(l2c_crc_args);
+BENCHMARK(BM_L2cMemcpyThenCrc16)->Apply(l2c_crc_args);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,140 @@
+/******************************************************************************
+ *
+ *  Copyright (C) 2017 Google, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at:
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+#include <random>
+#include <vector>
+
+#include "l2c_crc.h"
+
+// The MPS field of the L2CAP configuration option is 16 bits wide
+static const size_t kMaxMps = 0xFFFF;
+
+static const tL2C_CRC_KERNEL kKernels[] = {
+    L2C_CRC_KERNEL_BYTE, L2C_CRC_KERNEL_SLICE8, L2C_CRC_KERNEL_CLMUL,
+};
+
+// Bit at a time straight from the generator polynomial
+static uint16_t reference_crc16(uint16_t crc, const uint8_t* p, size_t len) {
+  while (len--) {
+    crc ^= *p++;
+    for (int i = 0; i < 8; i++)
+      crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+  }
+  return crc;
+}
+
+class L2cCrcTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    default_kernel_ = l2c_crc16_get_kernel_name();
+    data_.resize(kMaxMps + 16);
+    for (auto& b : data_) b = (uint8_t)random_();
+  }
+
+  virtual void TearDown() {
+    // Put back the kernel chosen at start up
+    for (tL2C_CRC_KERNEL kernel : kKernels) {
+      if (l2c_crc16_set_kernel(kernel) &&
+          strcmp(default_kernel_, l2c_crc16_get_kernel_name()) == 0)
+        return;
+    }
+  }
+
+  std::mt19937 random_{0x4c324341};
+  std::vector<uint8_t> data_;
+  const char* default_kernel_;
+};
+
+TEST_F(L2cCrcTest, check_value) {
+  const uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+
+  for (tL2C_CRC_KERNEL kernel : kKernels) {
+    if (!l2c_crc16_set_kernel(kernel)) continue;
+    EXPECT_EQ(0xBB3D, l2c_crc16(0, check, sizeof(check)))
+        << l2c_crc16_get_kernel_name();
+    EXPECT_EQ(0xFFFF, l2c_crc16(0xFFFF, check, 0));
+  }
+}
+
+TEST_F(L2cCrcTest, slice8_always_supported) {
+  EXPECT_TRUE(l2c_crc16_set_kernel(L2C_CRC_KERNEL_BYTE));
+  EXPECT_STREQ("byte", l2c_crc16_get_kernel_name());
+  EXPECT_TRUE(l2c_crc16_set_kernel(L2C_CRC_KERNEL_SLICE8));
+  EXPECT_STREQ("slice8", l2c_crc16_get_kernel_name());
+}
+
+TEST_F(L2cCrcTest, kernels_match_reference) {
+  for (tL2C_CRC_KERNEL kernel : kKernels) {
+    if (!l2c_crc16_set_kernel(kernel)) continue;
+
+    // Every length around the block sizes, then random frames up to the MPS
+    for (size_t len = 0; len < 300; len++) {
+      ASSERT_EQ(reference_crc16(0, data_.data(), len),
+                l2c_crc16(0, data_.data(), len))
+          << l2c_crc16_get_kernel_name() << " len " << len;
+    }
+    for (int i = 0; i < 200; i++) {
+      size_t len = random_() % (kMaxMps + 1);
+      size_t misalign = random_() % 16;
+      uint16_t init = random_();
+      ASSERT_EQ(reference_crc16(init, data_.data() + misalign, len),
+                l2c_crc16(init, data_.data() + misalign, len))
+          << l2c_crc16_get_kernel_name() << " len " << len;
+    }
+  }
+}
+
+TEST_F(L2cCrcTest, copy_matches_reference) {
+  std::vector<uint8_t> dst(kMaxMps + 32);
+
+  for (tL2C_CRC_KERNEL kernel : kKernels) {
+    if (!l2c_crc16_set_kernel(kernel)) continue;
+
+    for (int i = 0; i < 200; i++) {
+      size_t len = random_() % (kMaxMps + 1);
+      size_t misalign = random_() % 16;
+      uint16_t init = random_();
+
+      // Guard bytes catch writes past the end
+      memset(dst.data(), 0x5A, dst.size());
+      ASSERT_EQ(reference_crc16(init, data_.data(), len),
+                l2c_crc16_copy(init, dst.data() + misalign, data_.data(), len))
+          << l2c_crc16_get_kernel_name() << " len " << len;
+      ASSERT_EQ(0, memcmp(data_.data(), dst.data() + misalign, len));
+      for (size_t j = misalign + len; j < dst.size(); j++)
+        ASSERT_EQ(0x5A, dst[j]);
+    }
+  }
+}
+
+TEST_F(L2cCrcTest, combine) {
+  for (int i = 0; i < 500; i++) {
+    size_t len1 = random_() % 16;
+    size_t len2 = random_() % (kMaxMps + 1 - len1);
+    uint16_t init = random_();
+
+    uint16_t crc1 = reference_crc16(init, data_.data(), len1);
+    uint16_t crc2 = reference_crc16(0, data_.data() + len1, len2);
+    ASSERT_EQ(reference_crc16(init, data_.data(), len1 + len2),
+              l2c_crc16_combine(crc1, crc2, len2))
+        << "len1 " << len1 << " len2 " << len2;
+  }
+}
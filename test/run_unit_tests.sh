@@ -13,7 +13,10 @@ known_tests=(
   net_test_stack_multi_adv
   net_test_stack_ad_parser
   net_test_stack_smp
+  net_test_stack_l2cap_crc
   net_test_osi
+  net_test_sbc_decoder
+  net_test_sbc_encoder
 )
 
 known_remote_tests=(
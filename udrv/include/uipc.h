@@ -45,6 +45,7 @@ typedef enum {
 #define UIPC_REG_CBACK 2
 #define UIPC_REG_REMOVE_ACTIVE_READSET 3
 #define UIPC_SET_READ_POLL_TMO 4
+#define UIPC_SET_SHM_RING 5 /* offer a shared-memory ring of param bytes */
 
 typedef void(tUIPC_RCV_CBACK)(
     tUIPC_CH_ID ch_id,
@@ -123,4 +124,16 @@ uint32_t UIPC_Read(tUIPC_CH_ID ch_id, uint16_t* p_msg_evt, uint8_t* p_buf,
  ******************************************************************************/
 bool UIPC_Ioctl(tUIPC_CH_ID ch_id, uint32_t request, void* param);
 
+/*******************************************************************************
+ *
+ * Function         UIPC_DebugDump
+ *
+ * Description      Dumps the per-channel read and dispatch latency counters
+ *                  to |fd|.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+void UIPC_DebugDump(int fd);
+
 #endif /* UIPC_H */
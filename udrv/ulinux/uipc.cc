@@ -30,10 +30,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/poll.h>
 #include <sys/prctl.h>
-#include <sys/select.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/un.h>
@@ -45,7 +47,9 @@
 #include "bt_types.h"
 #include "bt_utils.h"
 #include "osi/include/osi.h"
+#include "osi/include/shm_ring.h"
 #include "osi/include/socket_utils/sockets.h"
+#include "osi/include/time.h"
 #include "uipc.h"
 
 /*****************************************************************************
@@ -54,18 +58,24 @@
 
 #define PCM_FILENAME "/data/test.pcm"
 
-#define MAX(a, b) ((a) > (b) ? (a) : (b))
-
 #define CASE_RETURN_STR(const) \
   case const:                  \
     return #const;
 
 #define UIPC_DISCONNECTED (-1)
 
-#define SAFE_FD_ISSET(fd, set) (((fd) == -1) ? false : FD_ISSET((fd), (set)))
-
 #define UIPC_FLUSH_BUFFER_SIZE 1024
 
+/* Maximum number of events handled per epoll_wait() call */
+#define UIPC_MAX_EVENTS 8
+
+/* How long UIPC_Send waits for room in the socket before giving up */
+#define UIPC_SEND_TMO_MS 500
+
+/* Tags in the low 32 bits of the epoll data; the fd sits in the high bits */
+#define UIPC_EPOLL_TAG_WAKEUP 0xFFFFFFFF
+#define UIPC_EPOLL_TAG_SERVER 0x100 /* or-ed with the channel id */
+
 /*****************************************************************************
  *  Local type definitions
  *****************************************************************************/
@@ -74,23 +84,52 @@ typedef enum {
   UIPC_TASK_FLAG_DISCONNECT_CHAN = 0x1,
 } tUIPC_TASK_FLAGS;
 
+typedef enum {
+  UIPC_SHM_NONE,    /* data goes through the socket */
+  UIPC_SHM_OFFERED, /* ring sent to the peer, waiting for its answer */
+  UIPC_SHM_ACTIVE,  /* data goes through the ring */
+} tUIPC_SHM_STATE;
+
+typedef struct {
+  uint64_t reads;             /* UIPC_Read calls on a connected channel */
+  uint64_t bytes_read;        /* bytes returned by UIPC_Read */
+  uint64_t waits;             /* reads that had to wait for the peer */
+  uint64_t wait_us_total;     /* time spent waiting for the peer */
+  uint64_t wait_us_max;       /* longest single wait for the peer */
+  uint64_t short_reads;       /* reads that timed out before |len| bytes */
+  uint64_t dispatches;        /* callback events delivered by the read task */
+  uint64_t dispatch_us_total; /* wakeup-to-callback delay, summed */
+  uint64_t dispatch_us_max;   /* longest wakeup-to-callback delay */
+} tUIPC_CHAN_STATS;
+
 typedef struct {
+  /* Protects every field of the channel. Channels don't share a lock, so the
+   * audio data path never waits behind the control channel and vice versa.
+   * Callbacks are invoked with this lock held, and only from the read task. */
+  std::recursive_mutex mutex;
+
   int srvfd;
   int fd;
+  bool fd_polled; /* |fd| is registered with the read task */
   int read_poll_tmo_ms;
   int task_evt_flags; /* event flags pending to be processed in read task */
   tUIPC_RCV_CBACK* cback;
+
+  size_t shm_ring_size; /* capacity of the ring offered on connect, or 0 */
+  tUIPC_SHM_STATE shm_state;
+  shm_ring_t* shm_ring;
+  bool shm_ring_busy; /* a reader uses |shm_ring| outside the lock */
+
+  tUIPC_CHAN_STATS stats;
 } tUIPC_CHAN;
 
 typedef struct {
   pthread_t tid; /* main thread id */
   int running;
-  std::recursive_mutex mutex;
+  std::recursive_mutex mutex; /* protects the read task life cycle */
 
-  fd_set active_set;
-  fd_set read_set;
-  int max_fd;
-  int signal_fds[2];
+  int epoll_fd;
+  int wakeup_fd;
 
   tUIPC_CHAN ch[UIPC_CH_NUM];
 } tUIPC_MAIN;
@@ -106,6 +145,7 @@ static tUIPC_MAIN uipc_main;
  *****************************************************************************/
 
 static int uipc_close_ch_locked(tUIPC_CH_ID ch_id);
+void uipc_close_locked(tUIPC_CH_ID ch_id);
 
 /*****************************************************************************
  *  Externs
@@ -132,7 +172,7 @@ const char* dump_uipc_event(tUIPC_EVENT event) {
  ****************************************************************************/
 
 static inline int create_server_socket(const char* name) {
-  int s = socket(AF_LOCAL, SOCK_STREAM, 0);
+  int s = socket(AF_LOCAL, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
   if (s < 0) return -1;
 
   BTIF_TRACE_EVENT("create_server_socket %s", name);
@@ -159,30 +199,20 @@ static inline int create_server_socket(const char* name) {
   return s;
 }
 
+/* Returns the accepted socket, or -1 with errno set to EAGAIN if there is no
+ * pending connection left on |sfd|. */
 static int accept_server_socket(int sfd) {
   struct sockaddr_un remote;
-  struct pollfd pfd;
   int fd;
   socklen_t len = sizeof(struct sockaddr_un);
 
   BTIF_TRACE_EVENT("accept fd %d", sfd);
 
-  /* make sure there is data to process */
-  pfd.fd = sfd;
-  pfd.events = POLLIN;
-
-  int poll_ret;
-  OSI_NO_INTR(poll_ret = poll(&pfd, 1, 0));
-  if (poll_ret == 0) {
-    BTIF_TRACE_WARNING("accept poll timeout");
-    return -1;
-  }
-
-  // BTIF_TRACE_EVENT("poll revents 0x%x", pfd.revents);
-
-  OSI_NO_INTR(fd = accept(sfd, (struct sockaddr*)&remote, &len));
+  OSI_NO_INTR(fd = accept4(sfd, (struct sockaddr*)&remote, &len,
+                           SOCK_NONBLOCK | SOCK_CLOEXEC));
   if (fd == -1) {
-    BTIF_TRACE_ERROR("sock accept failed (%s)", strerror(errno));
+    if (errno != EAGAIN && errno != EWOULDBLOCK)
+      BTIF_TRACE_ERROR("sock accept failed (%s)", strerror(errno));
     return -1;
   }
 
@@ -199,6 +229,46 @@ static int accept_server_socket(int sfd) {
   return fd;
 }
 
+/* Returns the number of bytes queued on |fd|, or 0 if that is unknown */
+static int uipc_bytes_pending(int fd) {
+  int pending = 0;
+  if (ioctl(fd, FIONREAD, &pending) < 0) return 0;
+  return pending;
+}
+
+/*****************************************************************************
+ *
+ *   epoll helper functions
+ *
+ ****************************************************************************/
+
+static bool uipc_epoll_add(int fd, uint32_t events, uint32_t tag) {
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = events;
+  event.data.u64 = ((uint64_t)(uint32_t)fd << 32) | tag;
+
+  int ret;
+  OSI_NO_INTR(ret = epoll_ctl(uipc_main.epoll_fd, EPOLL_CTL_ADD, fd, &event));
+  if (ret < 0) {
+    BTIF_TRACE_ERROR("%s: unable to watch fd %d (%s)", __func__, fd,
+                     strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+static void uipc_epoll_del(int fd) {
+  epoll_ctl(uipc_main.epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+/* Returns the channel an epoll event belongs to, or UIPC_CH_NUM for none */
+static tUIPC_CH_ID uipc_epoll_channel(const struct epoll_event* event) {
+  uint32_t tag = (uint32_t)event->data.u64;
+  if (tag == UIPC_EPOLL_TAG_WAKEUP) return UIPC_CH_NUM;
+  return tag & ~UIPC_EPOLL_TAG_SERVER;
+}
+
 /*****************************************************************************
  *
  *   uipc helper functions
@@ -212,28 +282,40 @@ static int uipc_main_init(void) {
 
   uipc_main.tid = 0;
   uipc_main.running = 0;
-  memset(&uipc_main.active_set, 0, sizeof(uipc_main.active_set));
-  memset(&uipc_main.read_set, 0, sizeof(uipc_main.read_set));
-  uipc_main.max_fd = 0;
-  memset(&uipc_main.signal_fds, 0, sizeof(uipc_main.signal_fds));
-  memset(&uipc_main.ch, 0, sizeof(uipc_main.ch));
-
-  /* setup interrupt socket pair */
-  if (socketpair(AF_UNIX, SOCK_STREAM, 0, uipc_main.signal_fds) < 0) {
-    return -1;
-  }
-
-  FD_SET(uipc_main.signal_fds[0], &uipc_main.active_set);
-  uipc_main.max_fd = MAX(uipc_main.max_fd, uipc_main.signal_fds[0]);
 
   for (i = 0; i < UIPC_CH_NUM; i++) {
     tUIPC_CHAN* p = &uipc_main.ch[i];
+    std::lock_guard<std::recursive_mutex> lock(p->mutex);
     p->srvfd = UIPC_DISCONNECTED;
     p->fd = UIPC_DISCONNECTED;
+    p->fd_polled = false;
+    p->read_poll_tmo_ms = 0;
     p->task_evt_flags = 0;
     p->cback = NULL;
+    p->shm_ring_size = 0;
+    p->shm_state = UIPC_SHM_NONE;
+    p->shm_ring = NULL;
+    p->shm_ring_busy = false;
+    memset(&p->stats, 0, sizeof(p->stats));
+  }
+
+  uipc_main.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (uipc_main.epoll_fd < 0) {
+    BTIF_TRACE_ERROR("%s: epoll_create1 failed (%s)", __func__,
+                     strerror(errno));
+    return -1;
+  }
+
+  /* setup interrupt event */
+  uipc_main.wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (uipc_main.wakeup_fd < 0) {
+    close(uipc_main.epoll_fd);
+    uipc_main.epoll_fd = -1;
+    return -1;
   }
 
+  uipc_epoll_add(uipc_main.wakeup_fd, EPOLLIN, UIPC_EPOLL_TAG_WAKEUP);
+
   return 0;
 }
 
@@ -242,18 +324,25 @@ void uipc_main_cleanup(void) {
 
   BTIF_TRACE_EVENT("uipc_main_cleanup");
 
-  close(uipc_main.signal_fds[0]);
-  close(uipc_main.signal_fds[1]);
-
   /* close any open channels */
-  for (i = 0; i < UIPC_CH_NUM; i++) uipc_close_ch_locked(i);
+  for (i = 0; i < UIPC_CH_NUM; i++) {
+    std::lock_guard<std::recursive_mutex> lock(uipc_main.ch[i].mutex);
+    uipc_close_ch_locked(i);
+  }
+
+  close(uipc_main.wakeup_fd);
+  uipc_main.wakeup_fd = -1;
+  close(uipc_main.epoll_fd);
+  uipc_main.epoll_fd = -1;
 }
 
 /* check pending events in read task */
-static void uipc_check_task_flags_locked(void) {
+static void uipc_check_task_flags(void) {
   int i;
 
   for (i = 0; i < UIPC_CH_NUM; i++) {
+    std::lock_guard<std::recursive_mutex> lock(uipc_main.ch[i].mutex);
+
     if (uipc_main.ch[i].task_evt_flags & UIPC_TASK_FLAG_DISCONNECT_CHAN) {
       uipc_main.ch[i].task_evt_flags &= ~UIPC_TASK_FLAG_DISCONNECT_CHAN;
       uipc_close_ch_locked(i);
@@ -263,68 +352,284 @@ static void uipc_check_task_flags_locked(void) {
   }
 }
 
-static int uipc_check_fd_locked(tUIPC_CH_ID ch_id) {
-  if (ch_id >= UIPC_CH_NUM) return -1;
+/* Closes the connected socket of |ch_id|, if any. Must hold the channel lock */
+static void uipc_close_fd_locked(tUIPC_CH_ID ch_id);
+
+/*****************************************************************************
+ *
+ *   shared-memory ring helper functions
+ *
+ ****************************************************************************/
 
-  // BTIF_TRACE_EVENT("CHECK SRVFD %d (ch %d)", uipc_main.ch[ch_id].srvfd,
-  // ch_id);
+static void uipc_release_shm_ring_locked(tUIPC_CH_ID ch_id) {
+  tUIPC_CHAN* p = &uipc_main.ch[ch_id];
 
-  if (SAFE_FD_ISSET(uipc_main.ch[ch_id].srvfd, &uipc_main.read_set)) {
-    BTIF_TRACE_EVENT("INCOMING CONNECTION ON CH %d", ch_id);
+  /* a busy ring is freed by its reader once it notices it was detached */
+  if (!p->shm_ring_busy) shm_ring_free(p->shm_ring);
+  p->shm_ring = NULL;
+  p->shm_state = UIPC_SHM_NONE;
+}
 
-    // Close the previous connection
-    if (uipc_main.ch[ch_id].fd != UIPC_DISCONNECTED) {
-      BTIF_TRACE_EVENT("CLOSE CONNECTION (FD %d)", uipc_main.ch[ch_id].fd);
-      close(uipc_main.ch[ch_id].fd);
-      FD_CLR(uipc_main.ch[ch_id].fd, &uipc_main.active_set);
-      uipc_main.ch[ch_id].fd = UIPC_DISCONNECTED;
+static void uipc_offer_shm_ring_locked(tUIPC_CH_ID ch_id) {
+  tUIPC_CHAN* p = &uipc_main.ch[ch_id];
+
+  uipc_release_shm_ring_locked(ch_id);
+
+  p->shm_ring = shm_ring_new(p->shm_ring_size);
+  if (p->shm_ring == NULL) {
+    BTIF_TRACE_WARNING("CH %d: NO SHARED MEMORY, USING SOCKET", ch_id);
+    return;
+  }
+
+  if (!shm_ring_send(p->fd, p->shm_ring)) {
+    uipc_release_shm_ring_locked(ch_id);
+    return;
+  }
+
+  BTIF_TRACE_EVENT("CH %d: OFFERED SHARED MEMORY RING (%zu BYTES)", ch_id,
+                   p->shm_ring_size);
+  p->shm_state = UIPC_SHM_OFFERED;
+}
+
+/* Consumes the peer's answer to the ring offer, if it has arrived */
+static void uipc_check_shm_ack_locked(tUIPC_CH_ID ch_id) {
+  tUIPC_CHAN* p = &uipc_main.ch[ch_id];
+
+  if (p->shm_state != UIPC_SHM_OFFERED) return;
+
+  switch (shm_ring_receive_ack(p->fd)) {
+    case SHM_RING_ACK_ACCEPTED:
+      BTIF_TRACE_EVENT("CH %d: SHARED MEMORY RING ACCEPTED", ch_id);
+      p->shm_state = UIPC_SHM_ACTIVE;
+      break;
+
+    case SHM_RING_ACK_PENDING:
+      break;
+
+    case SHM_RING_ACK_DECLINED:
+    case SHM_RING_ACK_NONE:
+      BTIF_TRACE_EVENT("CH %d: SHARED MEMORY RING NOT USED", ch_id);
+      uipc_release_shm_ring_locked(ch_id);
+      break;
+  }
+}
+
+static void uipc_update_read_stats(tUIPC_CH_ID ch_id, uint32_t n_read,
+                                   uint32_t len, uint64_t wait_us,
+                                   bool waited) {
+  tUIPC_CHAN_STATS* stats = &uipc_main.ch[ch_id].stats;
+
+  std::lock_guard<std::recursive_mutex> lock(uipc_main.ch[ch_id].mutex);
+  stats->reads++;
+  stats->bytes_read += n_read;
+  if (waited) {
+    stats->waits++;
+    stats->wait_us_total += wait_us;
+    if (wait_us > stats->wait_us_max) stats->wait_us_max = wait_us;
+  }
+  if (n_read < len) stats->short_reads++;
+}
+
+/* Reads from the ring of |ch_id|. Returns false if the channel doesn't use a
+ * ring (any more), in which case the caller falls back to the socket. */
+static bool uipc_read_shm(tUIPC_CH_ID ch_id, uint8_t* p_buf, uint32_t len,
+                          uint32_t* p_read) {
+  tUIPC_CHAN* p = &uipc_main.ch[ch_id];
+  shm_ring_t* ring;
+  int fd;
+  int tmo_ms;
+
+  *p_read = 0;
+
+  {
+    std::lock_guard<std::recursive_mutex> lock(p->mutex);
+    fd = p->fd;
+    tmo_ms = p->read_poll_tmo_ms;
+    if (p->shm_state != UIPC_SHM_OFFERED) fd = UIPC_DISCONNECTED;
+  }
+
+  if (fd != UIPC_DISCONNECTED) {
+    /* give the peer one poll period to answer the offer */
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    int poll_ret;
+    OSI_NO_INTR(poll_ret = poll(&pfd, 1, tmo_ms));
+  }
+
+  {
+    std::lock_guard<std::recursive_mutex> lock(p->mutex);
+    uipc_check_shm_ack_locked(ch_id);
+    if (p->shm_state == UIPC_SHM_OFFERED) {
+      BTIF_TRACE_WARNING("CH %d: NO ANSWER TO SHARED MEMORY OFFER YET", ch_id);
+      return true;
+    }
+    if (p->shm_state != UIPC_SHM_ACTIVE) return false;
+
+    ring = p->shm_ring;
+    fd = p->fd;
+    p->shm_ring_busy = true;
+  }
+
+  bool detached = false;
+  bool waited = false;
+  uint64_t wait_us = 0;
+  uint32_t n_read = 0;
+  while (n_read < len) {
+    n_read += shm_ring_read(ring, p_buf + n_read, len - n_read);
+    if (n_read == len) break;
+
+    uint64_t wait_start_us = time_get_os_boottime_us();
+    shm_ring_wait_result_t result = shm_ring_wait_readable(ring, tmo_ms, fd);
+    wait_us += time_get_os_boottime_us() - wait_start_us;
+    waited = true;
+    if (result == SHM_RING_READY) continue;
+    if (result == SHM_RING_TIMEOUT) {
+      BTIF_TRACE_WARNING("poll timeout (%d ms)", tmo_ms);
+      break;
     }
+    BTIF_TRACE_WARNING("UIPC_Read : channel detached remotely");
+    detached = true;
+    break;
+  }
+
+  {
+    std::lock_guard<std::recursive_mutex> lock(p->mutex);
+    p->shm_ring_busy = false;
+    if (p->shm_ring != ring) shm_ring_free(ring);
+    if (detached) uipc_close_locked(ch_id);
+  }
 
-    uipc_main.ch[ch_id].fd = accept_server_socket(uipc_main.ch[ch_id].srvfd);
+  *p_read = detached ? 0 : n_read;
+  uipc_update_read_stats(ch_id, *p_read, len, wait_us, waited);
+  return true;
+}
 
-    BTIF_TRACE_EVENT("NEW FD %d", uipc_main.ch[ch_id].fd);
+/*****************************************************************************
+ *
+ *   read task event handlers
+ *
+ ****************************************************************************/
 
-    if ((uipc_main.ch[ch_id].fd >= 0) && uipc_main.ch[ch_id].cback) {
-      /*  if we have a callback we should add this fd to the active set
-          and notify user with callback event */
-      BTIF_TRACE_EVENT("ADD FD %d TO ACTIVE SET", uipc_main.ch[ch_id].fd);
-      FD_SET(uipc_main.ch[ch_id].fd, &uipc_main.active_set);
-      uipc_main.max_fd = MAX(uipc_main.max_fd, uipc_main.ch[ch_id].fd);
+static void uipc_dispatch_locked(tUIPC_CH_ID ch_id, tUIPC_EVENT event,
+                                 uint64_t wakeup_us) {
+  tUIPC_CHAN* p = &uipc_main.ch[ch_id];
+
+  if (!p->cback) return;
+
+  uint64_t delay_us = time_get_os_boottime_us() - wakeup_us;
+  p->stats.dispatches++;
+  p->stats.dispatch_us_total += delay_us;
+  if (delay_us > p->stats.dispatch_us_max) p->stats.dispatch_us_max = delay_us;
+
+  p->cback(ch_id, event);
+}
+
+static void uipc_handle_accept(tUIPC_CH_ID ch_id, uint64_t wakeup_us) {
+  tUIPC_CHAN* p = &uipc_main.ch[ch_id];
+
+  std::lock_guard<std::recursive_mutex> lock(p->mutex);
+
+  /* the listening socket is edge triggered: take every pending connection */
+  while (p->srvfd != UIPC_DISCONNECTED) {
+    int fd = accept_server_socket(p->srvfd);
+    if (fd < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+        BTIF_TRACE_ERROR("FAILED TO ACCEPT CH %d (%s)", ch_id,
+                         strerror(errno));
+      return;
     }
 
-    if (uipc_main.ch[ch_id].fd < 0) {
-      BTIF_TRACE_ERROR("FAILED TO ACCEPT CH %d (%s)", ch_id, strerror(errno));
-      return -1;
+    BTIF_TRACE_EVENT("INCOMING CONNECTION ON CH %d", ch_id);
+
+    // Close the previous connection
+    uipc_close_fd_locked(ch_id);
+
+    p->fd = fd;
+
+    BTIF_TRACE_EVENT("NEW FD %d", p->fd);
+
+    if (p->shm_ring_size) uipc_offer_shm_ring_locked(ch_id);
+
+    if (p->cback) {
+      /*  if we have a callback we should watch this fd and notify user with
+          callback event */
+      BTIF_TRACE_EVENT("ADD FD %d TO ACTIVE SET", p->fd);
+      p->fd_polled = uipc_epoll_add(
+          p->fd, EPOLLIN | EPOLLRDHUP | EPOLLET, (uint32_t)ch_id);
     }
 
-    if (uipc_main.ch[ch_id].cback)
-      uipc_main.ch[ch_id].cback(ch_id, UIPC_OPEN_EVT);
+    uipc_dispatch_locked(ch_id, UIPC_OPEN_EVT, wakeup_us);
   }
+}
+
+static void uipc_handle_rx(tUIPC_CH_ID ch_id, int fd, bool hangup,
+                           uint64_t wakeup_us) {
+  tUIPC_CHAN* p = &uipc_main.ch[ch_id];
+
+  std::lock_guard<std::recursive_mutex> lock(p->mutex);
+
+  /* drop events for a socket that was replaced or handed to a direct reader */
+  if (p->fd != fd || !p->fd_polled) return;
 
-  // BTIF_TRACE_EVENT("CHECK FD %d (ch %d)", uipc_main.ch[ch_id].fd, ch_id);
+  int pending = uipc_bytes_pending(fd);
+  if (pending == 0 && !hangup) return;
 
-  if (SAFE_FD_ISSET(uipc_main.ch[ch_id].fd, &uipc_main.read_set)) {
+  /* The socket is edge triggered, so keep notifying for as long as the
+   * callback makes progress; a peer that hung up right after writing gets
+   * one more notification once the data is gone, to read the end of file. */
+  while (true) {
     // BTIF_TRACE_EVENT("INCOMING DATA ON CH %d", ch_id);
+    uipc_dispatch_locked(ch_id, UIPC_RX_DATA_READY_EVT, wakeup_us);
 
-    if (uipc_main.ch[ch_id].cback)
-      uipc_main.ch[ch_id].cback(ch_id, UIPC_RX_DATA_READY_EVT);
+    if (p->fd != fd || !p->fd_polled) return;
+
+    int left = uipc_bytes_pending(fd);
+    if (left > 0 && left < pending) {
+      pending = left;
+      continue;
+    }
+    if (left == 0 && pending > 0 && hangup) {
+      pending = 0;
+      continue;
+    }
+    return;
   }
-  return 0;
 }
 
-static void uipc_check_interrupt_locked(void) {
-  if (SAFE_FD_ISSET(uipc_main.signal_fds[0], &uipc_main.read_set)) {
-    char sig_recv = 0;
-    OSI_NO_INTR(recv(uipc_main.signal_fds[0], &sig_recv, sizeof(sig_recv),
-                     MSG_WAITALL));
+static void uipc_handle_wakeup(void) {
+  eventfd_t value;
+
+  /* clear any wakeup interrupt */
+  eventfd_read(uipc_main.wakeup_fd, &value);
+
+  /* check pending task events */
+  uipc_check_task_flags();
+}
+
+static void uipc_handle_event(const struct epoll_event* event,
+                              uint64_t wakeup_us) {
+  uint32_t tag = (uint32_t)event->data.u64;
+  int fd = (int)(event->data.u64 >> 32);
+
+  if (tag == UIPC_EPOLL_TAG_WAKEUP) {
+    uipc_handle_wakeup();
+    return;
+  }
+
+  if (tag & UIPC_EPOLL_TAG_SERVER) {
+    uipc_handle_accept(tag & ~UIPC_EPOLL_TAG_SERVER, wakeup_us);
+    return;
   }
+
+  uipc_handle_rx(tag, fd, (event->events & (EPOLLHUP | EPOLLRDHUP)) != 0,
+                 wakeup_us);
 }
 
 static inline void uipc_wakeup_locked(void) {
-  char sig_on = 1;
   BTIF_TRACE_EVENT("UIPC SEND WAKE UP");
 
-  OSI_NO_INTR(send(uipc_main.signal_fds[1], &sig_on, sizeof(sig_on), 0));
+  eventfd_write(uipc_main.wakeup_fd, 1);
 }
 
 static int uipc_setup_server_locked(tUIPC_CH_ID ch_id, const char* name,
@@ -335,8 +640,6 @@ static int uipc_setup_server_locked(tUIPC_CH_ID ch_id, const char* name,
 
   if (ch_id >= UIPC_CH_NUM) return -1;
 
-  std::lock_guard<std::recursive_mutex> guard(uipc_main.mutex);
-
   fd = create_server_socket(name);
 
   if (fd < 0) {
@@ -345,16 +648,15 @@ static int uipc_setup_server_locked(tUIPC_CH_ID ch_id, const char* name,
   }
 
   BTIF_TRACE_EVENT("ADD SERVER FD TO ACTIVE SET %d", fd);
-  FD_SET(fd, &uipc_main.active_set);
-  uipc_main.max_fd = MAX(uipc_main.max_fd, fd);
+  if (!uipc_epoll_add(fd, EPOLLIN | EPOLLET, UIPC_EPOLL_TAG_SERVER | ch_id)) {
+    close(fd);
+    return -1;
+  }
 
   uipc_main.ch[ch_id].srvfd = fd;
   uipc_main.ch[ch_id].cback = cback;
   uipc_main.ch[ch_id].read_poll_tmo_ms = DEFAULT_READ_POLL_TMO_MS;
 
-  /* trigger main thread to update read set */
-  uipc_wakeup_locked();
-
   return 0;
 }
 
@@ -370,6 +672,14 @@ static void uipc_flush_ch_locked(tUIPC_CH_ID ch_id) {
     return;
   }
 
+  /* don't flush away the answer to a ring offer */
+  uipc_check_shm_ack_locked(ch_id);
+  if (uipc_main.ch[ch_id].shm_state == UIPC_SHM_OFFERED) return;
+  if (uipc_main.ch[ch_id].shm_state == UIPC_SHM_ACTIVE) {
+    shm_ring_flush(uipc_main.ch[ch_id].shm_ring);
+    return;
+  }
+
   while (1) {
     int ret;
     OSI_NO_INTR(ret = poll(&pfd, 1, 1));
@@ -411,36 +721,37 @@ static void uipc_flush_locked(tUIPC_CH_ID ch_id) {
   }
 }
 
-static int uipc_close_ch_locked(tUIPC_CH_ID ch_id) {
-  int wakeup = 0;
+static void uipc_close_fd_locked(tUIPC_CH_ID ch_id) {
+  tUIPC_CHAN* p = &uipc_main.ch[ch_id];
+
+  if (p->fd == UIPC_DISCONNECTED) return;
+
+  BTIF_TRACE_EVENT("CLOSE CONNECTION (FD %d)", p->fd);
+  uipc_release_shm_ring_locked(ch_id);
+  if (p->fd_polled) uipc_epoll_del(p->fd);
+  p->fd_polled = false;
+  close(p->fd);
+  p->fd = UIPC_DISCONNECTED;
+}
 
+static int uipc_close_ch_locked(tUIPC_CH_ID ch_id) {
   BTIF_TRACE_EVENT("CLOSE CHANNEL %d", ch_id);
 
   if (ch_id >= UIPC_CH_NUM) return -1;
 
   if (uipc_main.ch[ch_id].srvfd != UIPC_DISCONNECTED) {
     BTIF_TRACE_EVENT("CLOSE SERVER (FD %d)", uipc_main.ch[ch_id].srvfd);
+    uipc_epoll_del(uipc_main.ch[ch_id].srvfd);
     close(uipc_main.ch[ch_id].srvfd);
-    FD_CLR(uipc_main.ch[ch_id].srvfd, &uipc_main.active_set);
     uipc_main.ch[ch_id].srvfd = UIPC_DISCONNECTED;
-    wakeup = 1;
   }
 
-  if (uipc_main.ch[ch_id].fd != UIPC_DISCONNECTED) {
-    BTIF_TRACE_EVENT("CLOSE CONNECTION (FD %d)", uipc_main.ch[ch_id].fd);
-    close(uipc_main.ch[ch_id].fd);
-    FD_CLR(uipc_main.ch[ch_id].fd, &uipc_main.active_set);
-    uipc_main.ch[ch_id].fd = UIPC_DISCONNECTED;
-    wakeup = 1;
-  }
+  uipc_close_fd_locked(ch_id);
 
   /* notify this connection is closed */
   if (uipc_main.ch[ch_id].cback)
     uipc_main.ch[ch_id].cback(ch_id, UIPC_CLOSE_EVT);
 
-  /* trigger main thread update if something was updated */
-  if (wakeup) uipc_wakeup_locked();
-
   return 0;
 }
 
@@ -456,46 +767,34 @@ void uipc_close_locked(tUIPC_CH_ID ch_id) {
 }
 
 static void* uipc_read_task(UNUSED_ATTR void* arg) {
-  int ch_id;
+  struct epoll_event events[UIPC_MAX_EVENTS];
   int result;
+  int i;
 
   prctl(PR_SET_NAME, (unsigned long)"uipc-main", 0, 0, 0);
 
   raise_priority_a2dp(TASK_UIPC_READ);
 
   while (uipc_main.running) {
-    uipc_main.read_set = uipc_main.active_set;
-
-    result =
-        select(uipc_main.max_fd + 1, &uipc_main.read_set, NULL, NULL, NULL);
-
-    if (result == 0) {
-      BTIF_TRACE_EVENT("select timeout");
-      continue;
-    }
+    OSI_NO_INTR(result = epoll_wait(uipc_main.epoll_fd, events,
+                                    UIPC_MAX_EVENTS, -1));
     if (result < 0) {
-      if (errno != EINTR) {
-        BTIF_TRACE_EVENT("select failed %s", strerror(errno));
-      }
+      BTIF_TRACE_EVENT("epoll_wait failed %s", strerror(errno));
       continue;
     }
 
-    {
-      std::lock_guard<std::recursive_mutex> guard(uipc_main.mutex);
-
-      /* clear any wakeup interrupt */
-      uipc_check_interrupt_locked();
+    uint64_t wakeup_us = time_get_os_boottime_us();
 
-      /* check pending task events */
-      uipc_check_task_flags_locked();
-
-      /* make sure we service audio channel first */
-      uipc_check_fd_locked(UIPC_CH_ID_AV_AUDIO);
+    /* make sure we service audio channel first */
+    for (i = 0; i < result; i++) {
+      if (uipc_epoll_channel(&events[i]) == UIPC_CH_ID_AV_AUDIO)
+        uipc_handle_event(&events[i], wakeup_us);
+    }
 
-      /* check for other connections */
-      for (ch_id = 0; ch_id < UIPC_CH_NUM; ch_id++) {
-        if (ch_id != UIPC_CH_ID_AV_AUDIO) uipc_check_fd_locked(ch_id);
-      }
+    /* check for other connections and task events */
+    for (i = 0; i < result; i++) {
+      if (uipc_epoll_channel(&events[i]) != UIPC_CH_ID_AV_AUDIO)
+        uipc_handle_event(&events[i], wakeup_us);
     }
   }
 
@@ -551,7 +850,12 @@ void uipc_stop_main_server_thread(void) {
 void UIPC_Init(UNUSED_ATTR void* p_data) {
   BTIF_TRACE_DEBUG("UIPC_Init");
 
-  uipc_main_init();
+  std::lock_guard<std::recursive_mutex> lock(uipc_main.mutex);
+
+  if (uipc_main_init() < 0) {
+    BTIF_TRACE_ERROR("UIPC_Init : unable to set up the read task");
+    return;
+  }
   uipc_start_main_server_thread();
 }
 
@@ -567,12 +871,12 @@ void UIPC_Init(UNUSED_ATTR void* p_data) {
 bool UIPC_Open(tUIPC_CH_ID ch_id, tUIPC_RCV_CBACK* p_cback) {
   BTIF_TRACE_DEBUG("UIPC_Open : ch_id %d, p_cback %x", ch_id, p_cback);
 
-  std::lock_guard<std::recursive_mutex> lock(uipc_main.mutex);
-
   if (ch_id >= UIPC_CH_NUM) {
     return false;
   }
 
+  std::lock_guard<std::recursive_mutex> lock(uipc_main.ch[ch_id].mutex);
+
   if (uipc_main.ch[ch_id].srvfd != UIPC_DISCONNECTED) {
     BTIF_TRACE_EVENT("CHANNEL %d ALREADY OPEN", ch_id);
     return 0;
@@ -606,7 +910,8 @@ void UIPC_Close(tUIPC_CH_ID ch_id) {
 
   /* special case handling uipc shutdown */
   if (ch_id != UIPC_CH_ID_ALL) {
-    std::lock_guard<std::recursive_mutex> lock(uipc_main.mutex);
+    if (ch_id >= UIPC_CH_NUM) return;
+    std::lock_guard<std::recursive_mutex> lock(uipc_main.ch[ch_id].mutex);
     uipc_close_locked(ch_id);
     return;
   }
@@ -628,12 +933,34 @@ bool UIPC_Send(tUIPC_CH_ID ch_id, UNUSED_ATTR uint16_t msg_evt,
                const uint8_t* p_buf, uint16_t msglen) {
   BTIF_TRACE_DEBUG("UIPC_Send : ch_id:%d %d bytes", ch_id, msglen);
 
-  std::lock_guard<std::recursive_mutex> lock(uipc_main.mutex);
+  if (ch_id >= UIPC_CH_NUM) return false;
 
-  ssize_t ret;
-  OSI_NO_INTR(ret = write(uipc_main.ch[ch_id].fd, p_buf, msglen));
-  if (ret < 0) {
-    BTIF_TRACE_ERROR("failed to write (%s)", strerror(errno));
+  std::lock_guard<std::recursive_mutex> lock(uipc_main.ch[ch_id].mutex);
+
+  /* the socket is nonblocking, wait for room if the peer is behind */
+  size_t sent = 0;
+  while (sent < msglen) {
+    ssize_t ret;
+    OSI_NO_INTR(ret = send(uipc_main.ch[ch_id].fd, p_buf + sent,
+                           msglen - sent, MSG_NOSIGNAL));
+    if (ret >= 0) {
+      sent += ret;
+      continue;
+    }
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      BTIF_TRACE_ERROR("failed to write (%s)", strerror(errno));
+      break;
+    }
+
+    struct pollfd pfd;
+    pfd.fd = uipc_main.ch[ch_id].fd;
+    pfd.events = POLLOUT;
+    int poll_ret;
+    OSI_NO_INTR(poll_ret = poll(&pfd, 1, UIPC_SEND_TMO_MS));
+    if (poll_ret <= 0 || (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))) {
+      BTIF_TRACE_ERROR("failed to write (peer not reading)");
+      break;
+    }
   }
 
   return false;
@@ -652,7 +979,9 @@ bool UIPC_Send(tUIPC_CH_ID ch_id, UNUSED_ATTR uint16_t msg_evt,
 uint32_t UIPC_Read(tUIPC_CH_ID ch_id, UNUSED_ATTR uint16_t* p_msg_evt,
                    uint8_t* p_buf, uint32_t len) {
   int n_read = 0;
-  int fd = uipc_main.ch[ch_id].fd;
+  int fd;
+  int tmo_ms;
+  tUIPC_SHM_STATE shm_state;
   struct pollfd pfd;
 
   if (ch_id >= UIPC_CH_NUM) {
@@ -660,23 +989,63 @@ uint32_t UIPC_Read(tUIPC_CH_ID ch_id, UNUSED_ATTR uint16_t* p_msg_evt,
     return 0;
   }
 
+  {
+    std::lock_guard<std::recursive_mutex> lock(uipc_main.ch[ch_id].mutex);
+    fd = uipc_main.ch[ch_id].fd;
+    tmo_ms = uipc_main.ch[ch_id].read_poll_tmo_ms;
+    shm_state = uipc_main.ch[ch_id].shm_state;
+  }
+
   if (fd == UIPC_DISCONNECTED) {
     BTIF_TRACE_ERROR("UIPC_Read : channel %d closed", ch_id);
     return 0;
   }
 
+  if (shm_state != UIPC_SHM_NONE) {
+    uint32_t shm_read;
+    if (uipc_read_shm(ch_id, p_buf, len, &shm_read)) return shm_read;
+  }
+
+  bool waited = false;
+  uint64_t wait_us = 0;
   while (n_read < (int)len) {
+    /* the socket is nonblocking: take whatever is queued first, and only
+       poll when the peer hasn't written enough yet */
+    ssize_t n;
+    OSI_NO_INTR(n = recv(fd, p_buf + n_read, len - n_read, 0));
+
+    // BTIF_TRACE_EVENT("read %d bytes", n);
+
+    if (n > 0) {
+      n_read += n;
+      continue;
+    }
+
+    if (n == 0) {
+      BTIF_TRACE_WARNING("UIPC_Read : channel detached remotely");
+      std::lock_guard<std::recursive_mutex> lock(uipc_main.ch[ch_id].mutex);
+      uipc_close_locked(ch_id);
+      return 0;
+    }
+
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      BTIF_TRACE_WARNING("UIPC_Read : read failed (%s)", strerror(errno));
+      return 0;
+    }
+
     pfd.fd = fd;
     pfd.events = POLLIN | POLLHUP;
 
     /* make sure there is data prior to attempting read to avoid blocking
        a read for more than poll timeout */
 
+    uint64_t wait_start_us = time_get_os_boottime_us();
     int poll_ret;
-    OSI_NO_INTR(poll_ret = poll(&pfd, 1, uipc_main.ch[ch_id].read_poll_tmo_ms));
+    OSI_NO_INTR(poll_ret = poll(&pfd, 1, tmo_ms));
+    wait_us += time_get_os_boottime_us() - wait_start_us;
+    waited = true;
     if (poll_ret == 0) {
-      BTIF_TRACE_WARNING("poll timeout (%d ms)",
-                         uipc_main.ch[ch_id].read_poll_tmo_ms);
+      BTIF_TRACE_WARNING("poll timeout (%d ms)", tmo_ms);
       break;
     }
     if (poll_ret < 0) {
@@ -687,33 +1056,16 @@ uint32_t UIPC_Read(tUIPC_CH_ID ch_id, UNUSED_ATTR uint16_t* p_msg_evt,
 
     // BTIF_TRACE_EVENT("poll revents %x", pfd.revents);
 
-    if (pfd.revents & (POLLHUP | POLLNVAL)) {
+    if ((pfd.revents & POLLNVAL) ||
+        ((pfd.revents & POLLHUP) && !(pfd.revents & POLLIN))) {
       BTIF_TRACE_WARNING("poll : channel detached remotely");
-      std::lock_guard<std::recursive_mutex> lock(uipc_main.mutex);
+      std::lock_guard<std::recursive_mutex> lock(uipc_main.ch[ch_id].mutex);
       uipc_close_locked(ch_id);
       return 0;
     }
-
-    ssize_t n;
-    OSI_NO_INTR(n = recv(fd, p_buf + n_read, len - n_read, 0));
-
-    // BTIF_TRACE_EVENT("read %d bytes", n);
-
-    if (n == 0) {
-      BTIF_TRACE_WARNING("UIPC_Read : channel detached remotely");
-      std::lock_guard<std::recursive_mutex> lock(uipc_main.mutex);
-      uipc_close_locked(ch_id);
-      return 0;
-    }
-
-    if (n < 0) {
-      BTIF_TRACE_WARNING("UIPC_Read : read failed (%s)", strerror(errno));
-      return 0;
-    }
-
-    n_read += n;
   }
 
+  uipc_update_read_stats(ch_id, n_read, len, wait_us, waited);
   return n_read;
 }
 
@@ -730,7 +1082,9 @@ uint32_t UIPC_Read(tUIPC_CH_ID ch_id, UNUSED_ATTR uint16_t* p_msg_evt,
 extern bool UIPC_Ioctl(tUIPC_CH_ID ch_id, uint32_t request, void* param) {
   BTIF_TRACE_DEBUG("#### UIPC_Ioctl : ch_id %d, request %d ####", ch_id,
                    request);
-  std::lock_guard<std::recursive_mutex> lock(uipc_main.mutex);
+  if (ch_id >= UIPC_CH_NUM) return false;
+
+  std::lock_guard<std::recursive_mutex> lock(uipc_main.ch[ch_id].mutex);
 
   switch (request) {
     case UIPC_REQ_RX_FLUSH:
@@ -744,16 +1098,20 @@ extern bool UIPC_Ioctl(tUIPC_CH_ID ch_id, uint32_t request, void* param) {
       break;
 
     case UIPC_REG_REMOVE_ACTIVE_READSET:
-      /* user will read data directly and not use select loop */
-      if (uipc_main.ch[ch_id].fd != UIPC_DISCONNECTED) {
-        /* remove this channel from active set */
-        FD_CLR(uipc_main.ch[ch_id].fd, &uipc_main.active_set);
-
-        /* refresh active set */
-        uipc_wakeup_locked();
+      /* user will read data directly and not use the read task */
+      if (uipc_main.ch[ch_id].fd_polled) {
+        uipc_epoll_del(uipc_main.ch[ch_id].fd);
+        uipc_main.ch[ch_id].fd_polled = false;
       }
       break;
 
+    case UIPC_SET_SHM_RING:
+      /* takes effect with the next connection */
+      uipc_main.ch[ch_id].shm_ring_size = (uintptr_t)param;
+      BTIF_TRACE_EVENT("UIPC_SET_SHM_RING : CH %d, SIZE %zu", ch_id,
+                       uipc_main.ch[ch_id].shm_ring_size);
+      break;
+
     case UIPC_SET_READ_POLL_TMO:
       uipc_main.ch[ch_id].read_poll_tmo_ms = (intptr_t)param;
       BTIF_TRACE_EVENT("UIPC_SET_READ_POLL_TMO : CH %d, TMO %d ms", ch_id,
@@ -767,3 +1125,56 @@ extern bool UIPC_Ioctl(tUIPC_CH_ID ch_id, uint32_t request, void* param) {
 
   return false;
 }
+
+/*******************************************************************************
+ *
+ * Function         UIPC_DebugDump
+ *
+ * Description      Dumps the per-channel latency counters to |fd|.
+ *
+ * Returns          void
+ *
+ ******************************************************************************/
+
+void UIPC_DebugDump(int fd) {
+  static const char* names[UIPC_CH_NUM] = {"AV_CTRL", "AV_AUDIO"};
+
+  dprintf(fd, "\nUIPC:\n");
+
+  for (int i = 0; i < UIPC_CH_NUM; i++) {
+    tUIPC_CHAN_STATS stats;
+    bool connected;
+    tUIPC_SHM_STATE shm_state;
+    {
+      std::lock_guard<std::recursive_mutex> lock(uipc_main.ch[i].mutex);
+      stats = uipc_main.ch[i].stats;
+      connected = uipc_main.ch[i].fd != UIPC_DISCONNECTED;
+      shm_state = uipc_main.ch[i].shm_state;
+    }
+
+    dprintf(fd, "  Channel %s (%s%s):\n", names[i],
+            connected ? "connected" : "disconnected",
+            (shm_state == UIPC_SHM_ACTIVE) ? ", shared memory" : "");
+    dprintf(fd,
+            "    Reads (total/bytes/short)                 : %llu / %llu / "
+            "%llu\n",
+            (unsigned long long)stats.reads,
+            (unsigned long long)stats.bytes_read,
+            (unsigned long long)stats.short_reads);
+    dprintf(fd,
+            "    Waits for peer (count/avg us/max us)      : %llu / %llu / "
+            "%llu\n",
+            (unsigned long long)stats.waits,
+            (unsigned long long)(stats.waits ? stats.wait_us_total / stats.waits
+                                             : 0),
+            (unsigned long long)stats.wait_us_max);
+    dprintf(fd,
+            "    Dispatch delay (count/avg us/max us)      : %llu / %llu / "
+            "%llu\n",
+            (unsigned long long)stats.dispatches,
+            (unsigned long long)(stats.dispatches ? stats.dispatch_us_total /
+                                                        stats.dispatches
+                                                  : 0),
+            (unsigned long long)stats.dispatch_us_max);
+  }
+}